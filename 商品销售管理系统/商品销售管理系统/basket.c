@@ -0,0 +1,458 @@
+#include "basket.h"
+#include "orderlog.h"
+#include "thread_util.h"
+#include "idmap.h"
+#include "outbuf.h"
+#include "metrics.h"
+#include "timeutil.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------- per-product support ---------- */
+
+typedef struct {
+    int*      ids;
+    uint32_t* counts;
+    size_t    size;
+    size_t    capacity;
+    IdMap     index;     /* id -> slot */
+} ItemTable;
+
+static void items_free(ItemTable* t) {
+    free(t->ids);
+    free(t->counts);
+    idmap_free(&t->index);
+    memset(t, 0, sizeof(*t));
+}
+
+static int items_add(ItemTable* t, int id, uint32_t n) {
+    long idx = idmap_find(&t->index, id);
+    if (idx >= 0) {
+        t->counts[idx] += n;
+        return 0;
+    }
+    if (t->size >= t->capacity) {
+        size_t newCap = t->capacity == 0 ? 1024 : t->capacity * 2;
+        int* ids = (int*)realloc(t->ids, newCap * sizeof(int));
+        if (!ids) return -1;
+        t->ids = ids;
+        uint32_t* counts = (uint32_t*)realloc(t->counts, newCap * sizeof(uint32_t));
+        if (!counts) return -1;
+        t->counts = counts;
+        t->capacity = newCap;
+    }
+    if (idmap_put(&t->index, id, t->size) != 0) return -1;
+    t->ids[t->size] = id;
+    t->counts[t->size] = n;
+    t->size++;
+    return 0;
+}
+
+/* ---------- sparse pair counter ---------- */
+
+typedef struct {
+    uint64_t* keys;      /* (a << 32) | b with a < b; 0 = empty slot */
+    uint32_t* counts;
+    uint32_t* deltas;    /* floor when the entry was added: most it can have missed */
+    size_t    cap;       /* power of two, load kept at or below 1/2 */
+    size_t    size;
+    size_t    budget;    /* most entries kept, 0 = unbounded */
+    unsigned  floor;     /* entries with count + delta up to this were dropped */
+} PairTable;
+
+static size_t pair_slot(uint64_t key, size_t cap) {
+    uint64_t h = key * 0x9E3779B97F4A7C15ull;
+    return (size_t)(h ^ (h >> 32)) & (cap - 1);
+}
+
+static void pairs_free(PairTable* t) {
+    free(t->keys);
+    free(t->counts);
+    free(t->deltas);
+    memset(t, 0, sizeof(*t));
+}
+
+/* rebuilds into newCap slots, keeping the pairs whose count + delta
+ * exceeds keepAbove */
+static int pairs_rehash(PairTable* t, size_t newCap, unsigned keepAbove) {
+    uint64_t* keys = (uint64_t*)calloc(newCap, sizeof(uint64_t));
+    uint32_t* counts = (uint32_t*)malloc(newCap * sizeof(uint32_t));
+    uint32_t* deltas = (uint32_t*)malloc(newCap * sizeof(uint32_t));
+    if (!keys || !counts || !deltas) {
+        free(keys);
+        free(counts);
+        free(deltas);
+        return -1;
+    }
+    size_t size = 0;
+    for (size_t i = 0; i < t->cap; ++i) {
+        if (t->keys[i] == 0 || (uint64_t)t->counts[i] + t->deltas[i] <= keepAbove) continue;
+        size_t s = pair_slot(t->keys[i], newCap);
+        while (keys[s] != 0) s = (s + 1) & (newCap - 1);
+        keys[s] = t->keys[i];
+        counts[s] = t->counts[i];
+        deltas[s] = t->deltas[i];
+        size++;
+    }
+    free(t->keys);
+    free(t->counts);
+    free(t->deltas);
+    t->keys = keys;
+    t->counts = counts;
+    t->deltas = deltas;
+    t->cap = newCap;
+    t->size = size;
+    return 0;
+}
+
+static int pairs_add(PairTable* t, uint64_t key, uint32_t n) {
+    if ((t->size + 1) * 2 > t->cap) {
+        if (t->budget == 0 || t->cap < 2 * t->budget) {
+            if (pairs_rehash(t, t->cap ? t->cap * 2 : 1024, 0) != 0) return -1;
+        }
+        else {
+            /* over budget: drop the rarest pairs until half of it is free */
+            do {
+                t->floor++;
+                if (pairs_rehash(t, t->cap, t->floor) != 0) return -1;
+            } while (t->size > t->budget / 2);
+        }
+    }
+    size_t s = pair_slot(key, t->cap);
+    while (t->keys[s] != 0 && t->keys[s] != key) s = (s + 1) & (t->cap - 1);
+    if (t->keys[s] == key) {
+        t->counts[s] += n;
+    }
+    else {
+        t->keys[s] = key;
+        t->counts[s] = n;
+        t->deltas[s] = t->floor;
+        t->size++;
+    }
+    return 0;
+}
+
+/* ---------- workers ---------- */
+
+/* the log's segments one after another; workers split the combined bytes */
+typedef struct {
+    SegmentFiles files;
+    uint64_t*    sizes;      /* 0 for a segment that cannot be opened */
+    uint64_t     total;
+} LogSpan;
+
+typedef struct {
+    const LogSpan* span;
+    uint64_t     begin;      /* records whose header starts in [begin, end) */
+    uint64_t     end;        /* of the combined bytes */
+    int          pass;       /* 1 = item support, 2 = pairs */
+    const IdMap* frequent;   /* pass 2 */
+    ItemTable    items;
+    PairTable    pairs;
+    long long    orders;
+    long long    baskets;
+    int*         basket;
+    size_t       basketCap;
+    uint64_t     damaged;    /* recorded by the caller after the join */
+    int          rc;
+} BasketWorker;
+
+static int cmp_int(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+/* the order's distinct products (frequent ones only in pass 2), sorted */
+static long collect_basket(BasketWorker* w, const OrderLogRecord* rec) {
+    if (rec->itemCount > w->basketCap) {
+        int* nb = (int*)realloc(w->basket, rec->itemCount * sizeof(int));
+        if (!nb) return -1;
+        w->basket = nb;
+        w->basketCap = rec->itemCount;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < rec->itemCount; ++i) {
+        int id = rec->items[i].productId;
+        if (w->frequent && idmap_find(w->frequent, id) < 0) continue;
+        w->basket[n++] = id;
+    }
+    if (n > 1) qsort(w->basket, n, sizeof(int), cmp_int);
+    size_t u = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (u == 0 || w->basket[u - 1] != w->basket[i]) w->basket[u++] = w->basket[i];
+    }
+    return (long)u;
+}
+
+static void scan_range(BasketWorker* w, const char* path, uint64_t begin, uint64_t end) {
+    OrderLogReader r;
+    if (orderlog_openRange(&r, path, begin, end) != 0) return;   /* archived since */
+    OrderLogRecord rec;
+    while (w->rc == 0 && orderlog_next(&r, &rec)) {
+        if (rec.status != ORDER_PAID) continue;
+        long n = collect_basket(w, &rec);
+        if (n < 0) {
+            w->rc = -2;
+            break;
+        }
+        if (w->pass == 1) {
+            w->orders++;
+            for (long i = 0; i < n && w->rc == 0; ++i) {
+                if (items_add(&w->items, w->basket[i], 1) != 0) w->rc = -2;
+            }
+            continue;
+        }
+        if (n < 2) continue;
+        w->baskets++;
+        for (long i = 0; i < n && w->rc == 0; ++i) {
+            uint64_t hi = (uint64_t)(uint32_t)w->basket[i] << 32;
+            for (long j = i + 1; j < n; ++j) {
+                if (pairs_add(&w->pairs, hi | (uint32_t)w->basket[j], 1) != 0) {
+                    w->rc = -2;
+                    break;
+                }
+            }
+        }
+    }
+    w->damaged += r.damaged;
+    r.damaged = 0;
+    orderlog_close(&r);
+}
+
+static void worker_main(void* arg) {
+    BasketWorker* w = (BasketWorker*)arg;
+    uint64_t base = 0;
+    for (size_t f = 0; w->rc == 0 && f < w->span->files.count; base += w->span->sizes[f++]) {
+        uint64_t size = w->span->sizes[f];
+        if (size == 0 || w->end <= base || w->begin >= base + size) continue;
+        scan_range(w, w->span->files.paths[f], w->begin > base ? w->begin - base : 0,
+            w->end - base < size ? w->end - base : UINT64_MAX);
+    }
+}
+
+/* every worker on its own thread; inline when a thread cannot start */
+static int run_workers(BasketWorker* ws, unsigned k) {
+    ThreadHandle th[BASKET_MAX_THREADS];
+    int started[BASKET_MAX_THREADS];
+    for (unsigned i = 0; i < k; ++i) {
+        started[i] = k > 1 && thread_start(&th[i], worker_main, &ws[i]) == 0;
+        if (!started[i]) worker_main(&ws[i]);
+    }
+    int rc = 0;
+    for (unsigned i = 0; i < k; ++i) {
+        if (started[i]) thread_join(th[i]);
+        if (ws[i].rc != 0 && rc == 0) rc = ws[i].rc;
+    }
+    return rc;
+}
+
+static uint64_t log_size(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return 0;
+#if defined(_MSC_VER)
+    long long n = _fseeki64(fp, 0, SEEK_END) == 0 ? _ftelli64(fp) : 0;
+#else
+    off_t n = fseeko(fp, 0, SEEK_END) == 0 ? ftello(fp) : 0;
+#endif
+    fclose(fp);
+    return n > 0 ? (uint64_t)n : 0;
+}
+
+static int cmp_pair(const void* a, const void* b) {
+    const BasketPair* x = (const BasketPair*)a;
+    const BasketPair* y = (const BasketPair*)b;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    if (x->lift != y->lift) return x->lift < y->lift ? 1 : -1;
+    if (x->a != y->a) return x->a < y->a ? -1 : 1;
+    return (x->b > y->b) - (x->b < y->b);
+}
+
+static int build_impl(BasketReport* r, const char* orderPath, const BasketOptions* opt) {
+    memset(r, 0, sizeof(*r));
+    LogSpan span;
+    memset(&span, 0, sizeof(span));
+    if (seglog_select(orderPath, 0, 0, &span.files) != 0) return -2;
+    span.sizes = (uint64_t*)calloc(span.files.count, sizeof(uint64_t));
+    if (!span.sizes) {
+        seglog_freeFiles(&span.files);
+        return -2;
+    }
+    int opened = 0;
+    for (size_t f = 0; f < span.files.count; ++f) {
+        FILE* fp = fopen(span.files.paths[f], "rb");
+        if (!fp) continue;
+        fclose(fp);
+        opened = 1;
+        span.sizes[f] = log_size(span.files.paths[f]);
+        span.total += span.sizes[f];
+    }
+    if (!opened) {
+        free(span.sizes);
+        seglog_freeFiles(&span.files);
+        return -1;
+    }
+    uint64_t size = span.total;
+
+    unsigned k = opt && opt->threads ? opt->threads : thread_cpuCount();
+    if (k > BASKET_MAX_THREADS) k = BASKET_MAX_THREADS;
+    uint64_t byChunk = size / BASKET_MIN_CHUNK;
+    if ((uint64_t)k > byChunk) k = byChunk > 0 ? (unsigned)byChunk : 1;
+    r->threads = k;
+    size_t maxPairs = opt && opt->maxPairs ? opt->maxPairs : BASKET_DEFAULT_MAX_PAIRS;
+
+    BasketWorker* ws = (BasketWorker*)calloc(k, sizeof(BasketWorker));
+    if (!ws) {
+        free(span.sizes);
+        seglog_freeFiles(&span.files);
+        return -2;
+    }
+    for (unsigned i = 0; i < k; ++i) {
+        ws[i].span = &span;
+        ws[i].begin = size * i / k;
+        ws[i].end = size * (i + 1) / k;
+        ws[i].pass = 1;
+        idmap_init(&ws[i].items.index);
+    }
+
+    ItemTable support;
+    memset(&support, 0, sizeof(support));
+    idmap_init(&support.index);
+    IdMap frequent;
+    idmap_init(&frequent);
+    PairTable merged;
+    memset(&merged, 0, sizeof(merged));
+
+    /* pass 1: support per product. Pass 2 reads the same bytes, so the
+     * damaged records are counted once, here. */
+    int rc = run_workers(ws, k);
+    uint64_t damaged = 0;
+    for (unsigned i = 0; i < k; ++i) damaged += ws[i].damaged;
+    if (damaged > 0 && METRICS_ON()) metrics_count(CTR_ORDER_LOG_DAMAGED, damaged);
+    for (unsigned i = 0; rc == 0 && i < k; ++i) {
+        r->orders += ws[i].orders;
+        for (size_t j = 0; rc == 0 && j < ws[i].items.size; ++j) {
+            if (items_add(&support, ws[i].items.ids[j], ws[i].items.counts[j]) != 0) rc = -2;
+        }
+        items_free(&ws[i].items);
+    }
+    r->products = support.size;
+    r->minSupport = opt && opt->minSupport ? opt->minSupport
+        : (unsigned)(r->orders / BASKET_AUTO_SUPPORT_DIV > 2 ? r->orders / BASKET_AUTO_SUPPORT_DIV : 2);
+    for (size_t j = 0; rc == 0 && j < support.size; ++j) {
+        if (support.counts[j] < r->minSupport) continue;
+        if (idmap_put(&frequent, support.ids[j], j) != 0) rc = -2;
+        r->frequentProducts++;
+    }
+
+    /* pass 2: pairs of frequent products */
+    if (rc == 0 && r->frequentProducts >= 2) {
+        for (unsigned i = 0; i < k; ++i) {
+            ws[i].pass = 2;
+            ws[i].frequent = &frequent;
+            ws[i].pairs.budget = maxPairs / k > 1024 ? maxPairs / k : 1024;
+        }
+        rc = run_workers(ws, k);
+        for (unsigned i = 0; rc == 0 && i < k; ++i) {
+            r->baskets += ws[i].baskets;
+            r->pruneFloor += ws[i].pairs.floor;
+            for (size_t s = 0; rc == 0 && s < ws[i].pairs.cap; ++s) {
+                if (ws[i].pairs.keys[s] && pairs_add(&merged, ws[i].pairs.keys[s], ws[i].pairs.counts[s]) != 0) rc = -2;
+            }
+            pairs_free(&ws[i].pairs);
+        }
+    }
+
+    /* frequent pairs with their lift */
+    size_t n = 0;
+    for (size_t s = 0; s < merged.cap; ++s) n += merged.keys[s] && merged.counts[s] >= r->minSupport;
+    if (rc == 0 && n > 0) {
+        r->pairs = (BasketPair*)malloc(n * sizeof(BasketPair));
+        if (!r->pairs) rc = -2;
+    }
+    for (size_t s = 0; rc == 0 && s < merged.cap; ++s) {
+        if (!merged.keys[s] || merged.counts[s] < r->minSupport) continue;
+        BasketPair* p = &r->pairs[r->pairCount++];
+        p->a = (int)(merged.keys[s] >> 32);
+        p->b = (int)(merged.keys[s] & 0xffffffffu);
+        p->count = merged.counts[s];
+        p->supportA = support.counts[idmap_find(&frequent, p->a)];
+        p->supportB = support.counts[idmap_find(&frequent, p->b)];
+        p->lift = (double)p->count * (double)r->orders / ((double)p->supportA * (double)p->supportB);
+    }
+    if (rc == 0 && r->pairCount > 1) qsort(r->pairs, r->pairCount, sizeof(BasketPair), cmp_pair);
+
+    for (unsigned i = 0; i < k; ++i) {
+        items_free(&ws[i].items);
+        pairs_free(&ws[i].pairs);
+        free(ws[i].basket);
+    }
+    free(ws);
+    free(span.sizes);
+    seglog_freeFiles(&span.files);
+    pairs_free(&merged);
+    idmap_free(&frequent);
+    items_free(&support);
+    if (rc != 0) basket_free(r);
+    return rc;
+}
+
+int basket_build(BasketReport* r, const char* orderPath, const BasketOptions* opt) {
+    TRACE_BEGIN("basket_build");
+    int rc;
+    if (!METRICS_ON()) {
+        rc = build_impl(r, orderPath, opt);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        rc = build_impl(r, orderPath, opt);
+        metrics_record(MET_REPORT_BASKET, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+    return rc;
+}
+
+void basket_free(BasketReport* r) {
+    free(r->pairs);
+    r->pairs = NULL;
+    r->pairCount = 0;
+}
+
+static const char* pct_str(double num, double den, char* buf, size_t cap) {
+    if (den <= 0) snprintf(buf, cap, "-");
+    else snprintf(buf, cap, "%.2f%%", 100.0 * num / den);
+    return buf;
+}
+
+static const char* name_of(ProductList* products, int id) {
+    const Product* p = products ? findProductById(products, id) : NULL;
+    return p ? productName(products, p) : "(unknown)";
+}
+
+void basket_print(const BasketReport* r, ProductList* products, int topN) {
+    OutBuf out;
+    outbuf_init(&out, stdout, OUTBUF_DEFAULT_CAP);
+    if (topN <= 0) topN = 20;
+    outbuf_printf(&out, "\n=== Frequently Bought Together ===\n");
+    outbuf_printf(&out, "Paid orders: %lld (%lld with 2+ frequent products), min support %u orders\n",
+        r->orders, r->baskets, r->minSupport);
+    outbuf_printf(&out, "Products: %zu sold, %zu frequent; %zu frequent pairs; %u thread(s)\n",
+        r->products, r->frequentProducts, r->pairCount, r->threads);
+    if (r->pruneFloor > 0) {
+        outbuf_printf(&out, "(pair budget reached: counts may be low by up to %u)\n", r->pruneFloor);
+    }
+    outbuf_printf(&out, "%-6s %-16s %-6s %-16s %-9s %-8s %-8s %-8s %-6s\n",
+        "A", "Name", "B", "Name", "Together", "Support", "A->B", "B->A", "Lift");
+    char sup[16], ab[16], ba[16];
+    for (size_t i = 0; i < r->pairCount && i < (size_t)topN; ++i) {
+        const BasketPair* p = &r->pairs[i];
+        outbuf_printf(&out, "%-6d %-16.16s %-6d %-16.16s %-9u %-8s %-8s %-8s %-6.2f\n",
+            p->a, name_of(products, p->a), p->b, name_of(products, p->b), p->count,
+            pct_str(p->count, (double)r->orders, sup, sizeof(sup)),
+            pct_str(p->count, p->supportA, ab, sizeof(ab)),
+            pct_str(p->count, p->supportB, ba, sizeof(ba)), p->lift);
+    }
+    if (r->pairCount == 0) outbuf_printf(&out, "(no pair reaches the minimum support)\n");
+    outbuf_free(&out);
+}
@@ -0,0 +1,74 @@
+#pragma once
+#ifndef BASKET_H
+#define BASKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "product.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* "Frequently bought together": product pairs that share paid orders.
+     *
+     * Two passes over orders.log, every live segment of it, each split
+     * into byte ranges of the segments taken together. Worker threads read
+     * their ranges independently (orderlog_openRange), and the per-thread
+     * tables are merged at the end:
+     *   1. item support: the paid orders that contain each product;
+     *   2. pair counts, for products with at least minSupport orders only
+     *      (a pair can never be more frequent than either of its products),
+     *      in a sparse open-addressing table keyed by the id pair.
+     * Each worker's pair table is capped at maxPairs / threads entries. When
+     * it fills up, the floor rises and pairs whose count plus the floor at
+     * the time they were added does not exceed it are dropped (lossy
+     * counting), so memory stays bounded and a reported count is low by at
+     * most the sum of the workers' final floors (pruneFloor).
+     *
+     * lift = P(a and b) / (P(a) P(b)): above 1 the products are bought
+     * together more often than independent choices would be.
+     */
+
+#define BASKET_DEFAULT_MAX_PAIRS  (8u << 20)
+#define BASKET_MAX_THREADS        16
+#define BASKET_MIN_CHUNK          (1u << 20)  /* bytes per thread at least */
+#define BASKET_AUTO_SUPPORT_DIV   10000       /* auto min support: orders / this, at least 2 */
+
+    typedef struct {
+        unsigned minSupport;   /* orders per pair; 0 = automatic */
+        unsigned threads;      /* 0 = one per processor */
+        size_t   maxPairs;     /* 0 = BASKET_DEFAULT_MAX_PAIRS */
+    } BasketOptions;
+
+    typedef struct {
+        int      a;            /* a < b */
+        int      b;
+        uint32_t count;        /* paid orders with both */
+        uint32_t supportA;
+        uint32_t supportB;
+        double   lift;
+    } BasketPair;
+
+    typedef struct {
+        long long   orders;          /* paid orders */
+        long long   baskets;         /* of which with 2+ frequent products */
+        unsigned    minSupport;
+        unsigned    threads;
+        unsigned    pruneFloor;      /* most a count can be low by; 0 unless the pair budget forced pruning */
+        size_t      products;        /* distinct products sold */
+        size_t      frequentProducts;
+        BasketPair* pairs;           /* count >= minSupport, most frequent first */
+        size_t      pairCount;
+    } BasketReport;
+
+    /* 0 ok, -1 if the log cannot be opened, -2 when out of memory */
+    int  basket_build(BasketReport* r, const char* orderPath, const BasketOptions* opt);
+    void basket_free(BasketReport* r);
+    void basket_print(const BasketReport* r, ProductList* products, int topN);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1106 @@
+/* Microbenchmarks for the hot paths of the sales system.
+ *
+ *   sales_bench [--min-scale 1000] [--max-scale 100000] [--repeats 3]
+ *               [--filter substr] [--out results.json] [--metrics 0|1]
+ *
+ * Scales go up by 10x from min to max (10^3 .. 10^7 supported). Each case
+ * builds synthetic data for the scale, times only the operation under test
+ * and reports best/median over the repeats. Results are JSON on stdout
+ * (or --out), progress goes to stderr. Temporary files are created in the
+ * current directory with a "bench_" prefix and removed afterwards.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench_util.h"
+#include "timeutil.h"
+#include "metrics.h"
+#include "product.h"
+#include "inventory.h"
+#include "order.h"
+#include "persistence.h"
+#include "persist_queue.h"
+#include "purchase.h"
+#include "reorder.h"
+#include "lowstock.h"
+#include "valuation.h"
+#include "forecast.h"
+#include "partial.h"
+#include "replica.h"
+#include "snapshot.h"
+#include "receiving.h"
+#include "ledger.h"
+#include "margin.h"
+#include "basket.h"
+#include "report.h"
+#include "productstore.h"
+
+#define BENCH_PRODUCTS_CSV "bench_products.csv"
+#define BENCH_ORDERS_LOG   "bench_orders.log"
+#define BENCH_ORDERS_BIN   "bench_orders.bin"
+#define BENCH_APPEND_LOG   "bench_append.log"
+#define BENCH_PURCHASE_LOG "bench_purchase_log.csv"
+#define BENCH_PRODUCTS_DAT "bench_products.dat"
+#define BENCH_PARTIAL_FILE "bench_partial.agg"
+#define BENCH_SNAPSHOT_DIR "bench_snapshot"
+#define BENCH_MANIFEST     "bench_manifest.csv"
+#define BENCH_LEDGER       "bench_stock_ledger.log"
+#define BENCH_LEDGER_OUT   "bench_stock_asof.csv"
+#define BENCH_LEDGER_BASE  1700000000LL
+#define BENCH_LEDGER_SPAN  (365LL * 86400)
+
+static volatile uint64_t g_sink; /* defeats dead-code elimination */
+
+typedef uint64_t(*BenchFn)(size_t n, uint64_t* ops);
+
+typedef struct {
+    const char* name;
+    size_t      maxN;   /* 0 = no limit; caps quadratic paths */
+    BenchFn     run;    /* returns the timed nanoseconds */
+} BenchCase;
+
+/* ---------- synthetic data ---------- */
+
+static void build_products(ProductList* list, size_t n, BenchRng* rng) {
+    char name[32];
+    for (size_t i = 0; i < n; ++i) {
+        snprintf(name, sizeof(name), "SKU-%08zu", i + 1);
+        addProduct(list, name, 100 + (Money)bench_below(rng, 100000),
+            (int)bench_below(rng, 200));
+    }
+}
+
+/* n orders of 1..5 items, about half of them PAID, spread over a year */
+static int write_orders_log(const char* path, size_t n, size_t productCount, BenchRng* rng) {
+    FILE* fp = fopen(path, "w");
+    if (!fp) return -1;
+    Product p;
+    memset(&p, 0, sizeof(p));
+    char buf[1024];
+    time_t base = (time_t)1700000000;
+    for (size_t i = 0; i < n; ++i) {
+        Order o;
+        initOrder(&o, (int)(i + 1));
+        o.createdAt = base + (time_t)bench_below(rng, 365u * 86400u);
+        size_t items = 1 + bench_below(rng, 5);
+        for (size_t k = 0; k < items; ++k) {
+            p.id = 1 + (int)bench_below(rng, productCount);
+            p.price = 100 + (Money)bench_below(rng, 10000);
+            addOrderItem(&o, &p, 1 + (int)bench_below(rng, 4));
+        }
+        if (bench_below(rng, 2)) {
+            o.status = ORDER_PAID;
+            o.paidAt = o.createdAt + 60;
+        }
+        size_t len = formatOrderRecord(&o, buf, sizeof(buf));
+        if (len < sizeof(buf)) fwrite(buf, 1, len, fp);
+        freeOrder(&o);
+    }
+    fclose(fp);
+    return 0;
+}
+
+/* ---------- cases ---------- */
+
+static uint64_t bm_find_product_by_id(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 1);
+    ProductList list;
+    initProductList(&list);
+    build_products(&list, n, &rng);
+
+    const size_t lookups = 2000;
+    int* ids = (int*)malloc(lookups * sizeof(int));
+    for (size_t i = 0; i < lookups; ++i) ids[i] = 1 + (int)bench_below(&rng, n);
+
+    uint64_t acc = 0;
+    uint64_t t0 = timeutil_nowNs();
+    for (size_t i = 0; i < lookups; ++i) {
+        Product* p = findProductById(&list, ids[i]);
+        if (p) acc += (uint64_t)p->stock;
+    }
+    uint64_t dt = timeutil_nowNs() - t0;
+
+    g_sink += acc;
+    free(ids);
+    freeProductList(&list);
+    *ops = lookups;
+    return dt;
+}
+
+/* one pass over every product counting low stock: the walk the low-stock
+ * and replenish reports make, bound by the size of Product */
+static uint64_t bm_catalog_stock_scan(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 1);
+    ProductList list;
+    initProductList(&list);
+    build_products(&list, n, &rng);
+
+    const int passes = 20;
+    uint64_t acc = 0;
+    uint64_t t0 = timeutil_nowNs();
+    for (int k = 0; k < passes; ++k) {
+        for (size_t i = 0; i < list.size; ++i) {
+            acc += list.data[i].stock < 10 + k;
+        }
+    }
+    uint64_t dt = timeutil_nowNs() - t0;
+
+    g_sink += acc;
+    freeProductList(&list);
+    *ops = (uint64_t)passes * n;
+    return dt;
+}
+
+static uint64_t bm_add_product(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 2);
+    ProductList list;
+    initProductList(&list);
+    uint64_t t0 = timeutil_nowNs();
+    build_products(&list, n, &rng);
+    uint64_t dt = timeutil_nowNs() - t0;
+    g_sink += list.size;
+    freeProductList(&list);
+    *ops = n;
+    return dt;
+}
+
+static uint64_t bm_delete_product(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 3);
+    ProductList list;
+    initProductList(&list);
+    build_products(&list, n, &rng);
+
+    size_t dels = n < 200 ? n : 200;
+    int* ids = (int*)malloc(dels * sizeof(int));
+    /* distinct ids: stride through the id space */
+    for (size_t i = 0; i < dels; ++i) ids[i] = 1 + (int)((i * (n / dels) + bench_below(&rng, n / dels)) % n);
+
+    uint64_t t0 = timeutil_nowNs();
+    for (size_t i = 0; i < dels; ++i) {
+        g_sink += (uint64_t)deleteProduct(&list, ids[i]);
+    }
+    uint64_t dt = timeutil_nowNs() - t0;
+
+    free(ids);
+    freeProductList(&list);
+    *ops = dels;
+    return dt;
+}
+
+static uint64_t bm_add_order_item(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 4);
+    Product p;
+    memset(&p, 0, sizeof(p));
+    p.price = 999;
+
+    uint64_t t0 = timeutil_nowNs();
+    size_t done = 0;
+    while (done < n) {
+        Order o;
+        initOrder(&o, (int)done);
+        for (int k = 0; k < 16 && done < n; ++k, ++done) {
+            p.id = (int)(done & 0xFFFF) + 1;
+            addOrderItem(&o, &p, 1 + (k & 3));
+        }
+        g_sink += o.size;
+        freeOrder(&o);
+    }
+    uint64_t dt = timeutil_nowNs() - t0;
+    *ops = n;
+    return dt;
+}
+
+static uint64_t bm_load_products_csv(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 5);
+    ProductList src;
+    initProductList(&src);
+    build_products(&src, n, &rng);
+    saveProductsToCSV(BENCH_PRODUCTS_CSV, &src);
+    freeProductList(&src);
+
+    ProductList list;
+    initProductList(&list);
+    uint64_t t0 = timeutil_nowNs();
+    int loaded = loadProductsFromCSV(BENCH_PRODUCTS_CSV, &list);
+    uint64_t dt = timeutil_nowNs() - t0;
+
+    g_sink += (uint64_t)loaded;
+    freeProductList(&list);
+    remove(BENCH_PRODUCTS_CSV);
+    *ops = n;
+    return dt;
+}
+
+/* startup read of an n-record purchase log: only the last 256 records */
+static uint64_t bm_purchase_load_tail(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 15);
+    FILE* fp = fopen(BENCH_PURCHASE_LOG, "w");
+    if (!fp) return 0;
+    char line[128];
+    for (size_t i = 0; i < n; ++i) {
+        Purchase p = { (int)i + 1, 1 + (int)bench_below(&rng, 1000), 1 + (int)bench_below(&rng, 50),
+            100 + (Money)bench_below(&rng, 5000), 1700000000LL + (long long)i };
+        int len = formatPurchaseRecord(&p, line, sizeof(line));
+        fwrite(line, 1, (size_t)len, fp);
+    }
+    fclose(fp);
+
+    PurchaseList tail;
+    initPurchaseList(&tail);
+    purchase_setLimit(&tail, 256);
+    int lastId = 0;
+    uint64_t t0 = timeutil_nowNs();
+    int loaded = purchase_loadTail(BENCH_PURCHASE_LOG, &tail, 256, &lastId);
+    uint64_t dt = timeutil_nowNs() - t0;
+
+    g_sink += (uint64_t)loaded + (uint64_t)lastId;
+    freePurchaseList(&tail);
+    remove(BENCH_PURCHASE_LOG);
+    *ops = 1;
+    return dt;
+}
+
+/* the full rewrite that used to be the only way stock reached disk */
+static uint64_t bm_save_products_csv(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 14);
+    ProductList list;
+    initProductList(&list);
+    build_products(&list, n, &rng);
+
+    uint64_t t0 = timeutil_nowNs();
+    int rc = saveProductsToCSV(BENCH_PRODUCTS_CSV, &list);
+    uint64_t dt = timeutil_nowNs() - t0;
+
+    g_sink += (uint64_t)rc;
+    freeProductList(&list);
+    remove(BENCH_PRODUCTS_CSV);
+    *ops = 1;
+    return dt;
+}
+
+/* one order's worth of stock changes (3 products) persisted per op */
+static uint64_t bm_pstore_order_flush(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 15);
+    ProductList list;
+    initProductList(&list);
+    build_products(&list, n, &rng);
+    remove(BENCH_PRODUCTS_DAT);
+    ProductStore* st = pstore_open(BENCH_PRODUCTS_DAT);
+    if (!st || pstore_rewrite(st, &list) != 0) {
+        pstore_close(st);
+        freeProductList(&list);
+        *ops = 0;
+        return 0;
+    }
+
+    const size_t orders = 2000;
+    uint64_t acc = 0;
+    uint64_t t0 = timeutil_nowNs();
+    for (size_t i = 0; i < orders; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            Product* p = &list.data[bench_below(&rng, n)];
+            p->stock++;
+            pstore_noteStock(st, p->id, p->stock);
+        }
+        acc += (uint64_t)pstore_flush(st, &list);
+    }
+    uint64_t dt = timeutil_nowNs() - t0;
+
+    g_sink += acc;
+    pstore_close(st);
+    remove(BENCH_PRODUCTS_DAT);
+    freeProductList(&list);
+    *ops = orders;
+    return dt;
+}
+
+static uint64_t append_orders(size_t n, uint64_t* ops, OrderLogFormat fmt) {
+    BenchRng rng;
+    bench_seed(&rng, 6);
+    size_t count = n < 20000 ? n : 20000;
+    Product p;
+    memset(&p, 0, sizeof(p));
+    Order o;
+    initOrder(&o, 1);
+    for (int k = 0; k < 3; ++k) {
+        p.id = 1 + (int)bench_below(&rng, 1000);
+        p.price = 1000 + (Money)k * 100;
+        addOrderItem(&o, &p, 2);
+    }
+    remove(BENCH_APPEND_LOG);
+
+    uint64_t t0 = timeutil_nowNs();
+    for (size_t i = 0; i < count; ++i) {
+        o.orderId = (int)i + 1;
+        appendOrderToFileAs(BENCH_APPEND_LOG, &o, fmt);
+    }
+    uint64_t dt = timeutil_nowNs() - t0;
+
+    freeOrder(&o);
+    remove(BENCH_APPEND_LOG);
+    *ops = count;
+    return dt;
+}
+
+static uint64_t bm_append_order_to_file(size_t n, uint64_t* ops) {
+    return append_orders(n, ops, ORDER_LOG_TEXT);
+}
+
+static uint64_t bm_append_order_binary(size_t n, uint64_t* ops) {
+    return append_orders(n, ops, ORDER_LOG_BINARY);
+}
+
+/* report cases share one generated log per scale */
+static size_t g_logN = 0;
+
+static void ensure_orders_log(size_t n) {
+    if (g_logN == n) return;
+    BenchRng rng;
+    bench_seed(&rng, 7);
+    size_t productCount = n < 100000 ? n : 100000;
+    write_orders_log(BENCH_ORDERS_LOG, n, productCount, &rng);
+
+    ProductList list;
+    initProductList(&list);
+    build_products(&list, productCount, &rng);
+    saveProductsToCSV(BENCH_PRODUCTS_CSV, &list);
+    freeProductList(&list);
+    g_logN = n;
+}
+
+/* the same orders as binary records */
+static size_t g_binN = 0;
+
+static void ensure_orders_bin(size_t n) {
+    ensure_orders_log(n);
+    if (g_binN == n) return;
+    OrderLogConvertStats st;
+    orderlog_convert(BENCH_ORDERS_LOG, BENCH_ORDERS_BIN, ORDER_LOG_BINARY, &st);
+    g_binN = n;
+}
+
+static uint64_t bm_report_sales_summary(size_t n, uint64_t* ops) {
+    ensure_orders_log(n);
+    bench_silenceStdout();
+    uint64_t t0 = timeutil_nowNs();
+    report_salesSummaryFromLog(BENCH_ORDERS_LOG);
+    uint64_t dt = timeutil_nowNs() - t0;
+    bench_restoreStdout();
+    *ops = n;
+    return dt;
+}
+
+static uint64_t bm_report_monthly_sales(size_t n, uint64_t* ops) {
+    ensure_orders_log(n);
+    bench_silenceStdout();
+    uint64_t t0 = timeutil_nowNs();
+    report_monthlySalesFromLog(BENCH_ORDERS_LOG);
+    uint64_t dt = timeutil_nowNs() - t0;
+    bench_restoreStdout();
+    *ops = n;
+    return dt;
+}
+
+static uint64_t bm_report_top_products(size_t n, uint64_t* ops) {
+    ensure_orders_log(n);
+    bench_silenceStdout();
+    uint64_t t0 = timeutil_nowNs();
+    report_topProductsFromLog(BENCH_ORDERS_LOG, BENCH_PRODUCTS_CSV, 10);
+    uint64_t dt = timeutil_nowNs() - t0;
+    bench_restoreStdout();
+    *ops = n;
+    return dt;
+}
+
+static uint64_t bm_purchase_summary(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 8);
+    PurchaseList list;
+    initPurchaseList(&list);
+    size_t productCount = n / 10 + 1;
+    for (size_t i = 0; i < n; ++i) {
+        addPurchase(&list, (int)i + 1, 1 + (int)bench_below(&rng, productCount),
+            1 + (int)bench_below(&rng, 50), 100 + (Money)bench_below(&rng, 5000),
+            1700000000LL + (long long)i);
+    }
+    bench_silenceStdout();
+    uint64_t t0 = timeutil_nowNs();
+    purchase_printSummaryByProduct(&list);
+    uint64_t dt = timeutil_nowNs() - t0;
+    bench_restoreStdout();
+    freePurchaseList(&list);
+    *ops = n;
+    return dt;
+}
+
+static void build_reorder(ReorderTable* t, size_t n, BenchRng* rng) {
+    /* explicit thresholds for every 10th product */
+    for (size_t id = 1; id <= n; id += 10) {
+        reorder_setLevel(t, (int)id, 20 + (int)bench_below(rng, 100));
+    }
+}
+
+/* the startup scan through the vectorized kernel, then the alert report */
+static uint64_t bm_reorder_low_stock(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 9);
+    ProductList list;
+    initProductList(&list);
+    build_products(&list, n, &rng);
+    ReorderTable t;
+    reorder_init(&t);
+    build_reorder(&t, n, &rng);
+    LowStockSet s;
+    lowstock_init(&s, &list, &t, 10);
+
+    bench_silenceStdout();
+    uint64_t t0 = timeutil_nowNs();
+    lowstock_rebuild(&s);
+    lowstock_printAlert(&s);
+    uint64_t dt = timeutil_nowNs() - t0;
+    bench_restoreStdout();
+
+    lowstock_free(&s);
+    reorder_free(&t);
+    freeProductList(&list);
+    *ops = n;
+    return dt;
+}
+
+static uint64_t bm_reorder_replenish(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 10);
+    ProductList list;
+    initProductList(&list);
+    build_products(&list, n, &rng);
+    ReorderTable t;
+    reorder_init(&t);
+    build_reorder(&t, n, &rng);
+    LowStockSet s;
+    lowstock_init(&s, &list, &t, 10);
+
+    bench_silenceStdout();
+    uint64_t t0 = timeutil_nowNs();
+    lowstock_rebuild(&s);
+    lowstock_printReplenish(&s);
+    uint64_t dt = timeutil_nowNs() - t0;
+    bench_restoreStdout();
+
+    lowstock_free(&s);
+    reorder_free(&t);
+    freeProductList(&list);
+    *ops = n;
+    return dt;
+}
+
+/* repeated scans with the aligned level array already built, no printing */
+static uint64_t bm_reorder_find_low_stock(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 11);
+    ProductList list;
+    initProductList(&list);
+    build_products(&list, n, &rng);
+    ReorderTable t;
+    reorder_init(&t);
+    build_reorder(&t, n, &rng);
+    size_t* idx = (size_t*)malloc(n * sizeof(size_t));
+
+    size_t hits = reorder_findLowStock(&t, &list, 10, idx);
+    const int passes = 10;
+    uint64_t t0 = timeutil_nowNs();
+    for (int k = 0; k < passes; ++k) {
+        hits += reorder_findLowStock(&t, &list, 10, idx);
+    }
+    uint64_t dt = timeutil_nowNs() - t0;
+
+    g_sink += hits;
+    free(idx);
+    reorder_free(&t);
+    freeProductList(&list);
+    *ops = (uint64_t)passes * n;
+    return dt;
+}
+
+/* stock changes applied to the incrementally maintained low-stock set */
+static uint64_t bm_lowstock_update(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 12);
+    ProductList list;
+    initProductList(&list);
+    build_products(&list, n, &rng);
+    ReorderTable t;
+    reorder_init(&t);
+    build_reorder(&t, n, &rng);
+    LowStockSet s;
+    lowstock_init(&s, &list, &t, 10);
+    lowstock_rebuild(&s);
+
+    const size_t changes = 20000;
+    uint64_t t0 = timeutil_nowNs();
+    for (size_t i = 0; i < changes; ++i) {
+        Product* p = findProductById(&list, 1 + (int)bench_below(&rng, n));
+        p->stock = (int)bench_below(&rng, 200);
+        lowstock_update(&s, p);
+    }
+    uint64_t dt = timeutil_nowNs() - t0;
+
+    g_sink += lowstock_count(&s);
+    lowstock_free(&s);
+    reorder_free(&t);
+    freeProductList(&list);
+    *ops = changes;
+    return dt;
+}
+
+/* n receipts and n sales against the running weighted-average cost */
+static uint64_t bm_valuation_update(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 13);
+    Valuation v;
+    valuation_init(&v);
+    size_t productCount = n / 10 + 1;
+    uint64_t t0 = timeutil_nowNs();
+    for (size_t i = 0; i < n; ++i) {
+        int id = 1 + (int)bench_below(&rng, productCount);
+        valuation_receive(&v, id, 1 + (int)bench_below(&rng, 50), 100 + (Money)bench_below(&rng, 5000));
+        valuation_sell(&v, 1 + (int)bench_below(&rng, productCount), 1 + (int)bench_below(&rng, 20), NULL);
+    }
+    uint64_t dt = timeutil_nowNs() - t0;
+    g_sink += (uint64_t)v.totalCogs;
+    valuation_free(&v);
+    *ops = 2 * (uint64_t)n;
+    return dt;
+}
+
+/* one pass over an n-order log, PAID records folded into the velocities */
+static uint64_t forecast_load(const char* path, size_t n, uint64_t* ops) {
+    Forecast f;
+    forecast_init(&f);
+    uint64_t t0 = timeutil_nowNs();
+    forecast_loadOrderLog(&f, path);
+    uint64_t dt = timeutil_nowNs() - t0;
+    g_sink += f.size;
+    forecast_free(&f);
+    *ops = n;
+    return dt;
+}
+
+static uint64_t bm_forecast_load(size_t n, uint64_t* ops) {
+    ensure_orders_log(n);
+    return forecast_load(BENCH_ORDERS_LOG, n, ops);
+}
+
+static uint64_t bm_forecast_load_binary(size_t n, uint64_t* ops) {
+    ensure_orders_bin(n);
+    return forecast_load(BENCH_ORDERS_BIN, n, ops);
+}
+
+/* forecast levels for every product of an n-product catalog (about 4 sales
+ * per product over 90 days), rendered into a silenced stdout */
+static uint64_t bm_forecast_replenish(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 14);
+    ProductList list;
+    initProductList(&list);
+    build_products(&list, n, &rng);
+    Forecast f;
+    forecast_init(&f);
+    time_t now = (time_t)1700000000;
+    for (size_t i = 0; i < 4 * n; ++i) {
+        time_t when = now - (time_t)bench_below(&rng, 90u * 86400u);
+        forecast_recordSale(&f, 1 + (int)bench_below(&rng, n), 1 + (int)bench_below(&rng, 10), when);
+    }
+
+    bench_silenceStdout();
+    uint64_t t0 = timeutil_nowNs();
+    forecast_printReplenish(&f, &list, now);
+    uint64_t dt = timeutil_nowNs() - t0;
+    bench_restoreStdout();
+
+    forecast_free(&f);
+    freeProductList(&list);
+    *ops = n;
+    return dt;
+}
+
+/* a coordinator merging 8 node partials built from an n-order log; the
+ * cost follows the keys in the files, not the log lines behind them */
+static uint64_t bm_partial_merge(size_t n, uint64_t* ops) {
+    ensure_orders_log(n);
+    SalesPartial node;
+    partial_init(&node);
+    partial_addOrderLog(&node, BENCH_ORDERS_LOG);
+    partial_write(&node, BENCH_PARTIAL_FILE);
+    size_t keys = node.months.size + node.products.size + node.purchases.size + 1;
+    partial_free(&node);
+
+    const int nodes = 8;
+    SalesPartial total;
+    partial_init(&total);
+    uint64_t t0 = timeutil_nowNs();
+    for (int i = 0; i < nodes; ++i) partial_read(&total, BENCH_PARTIAL_FILE);
+    uint64_t dt = timeutil_nowNs() - t0;
+    g_sink += (uint64_t)total.ordersPaid;
+    partial_free(&total);
+    *ops = (uint64_t)nodes * keys;
+    return dt;
+}
+
+/* a follower catching up on an n-order log from offset 0 */
+static uint64_t bm_replica_catch_up(size_t n, uint64_t* ops) {
+    ensure_orders_log(n);
+    Replica r;
+    replica_init(&r, BENCH_ORDERS_LOG, "bench_no_purchases.csv");
+    uint64_t t0 = timeutil_nowNs();
+    long applied = replica_poll(&r);
+    uint64_t dt = timeutil_nowNs() - t0;
+    g_sink += (uint64_t)applied;
+    replica_free(&r);
+    *ops = n;
+    return dt;
+}
+
+/* an n-line shipment over n/4 products: validate, then apply in one pass */
+static uint64_t bm_manifest_receive(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 16);
+    size_t np = n / 4 > 0 ? n / 4 : 1;
+    ProductList list;
+    initProductList(&list);
+    build_products(&list, np, &rng);
+    FILE* fp = fopen(BENCH_MANIFEST, "w");
+    if (!fp) return 0;
+    fprintf(fp, "productId,quantity,unitCost\n");
+    for (size_t i = 0; i < n; ++i) {
+        fprintf(fp, "%d,%d,%d.%02d\n", 1 + (int)bench_below(&rng, np), 1 + (int)bench_below(&rng, 50),
+            (int)bench_below(&rng, 100), (int)bench_below(&rng, 100));
+    }
+    fclose(fp);
+    PurchaseList purchases;
+    initPurchaseList(&purchases);
+    purchase_setLimit(&purchases, 256);
+    Valuation val;
+    valuation_init(&val);
+
+    Manifest m;
+    manifest_init(&m);
+    ReceiveResult r;
+    uint64_t t0 = timeutil_nowNs();
+    manifest_load(&m, BENCH_MANIFEST, &list);
+    manifest_receive(&m, &list, &purchases, &val, 1, 1700000000, &r);
+    uint64_t dt = timeutil_nowNs() - t0;
+    g_sink += r.purchaseLogLen + r.costLogLen;
+
+    receive_freeResult(&r);
+    manifest_free(&m);
+    remove(BENCH_MANIFEST);
+    valuation_free(&val);
+    freePurchaseList(&purchases);
+    freeProductList(&list);
+    *ops = n;
+    return dt;
+}
+
+/* margin join over an n-order log and n/4 purchases on the same products;
+ * ops counts both logs' records */
+static uint64_t bm_margin_report(size_t n, uint64_t* ops) {
+    ensure_orders_log(n);
+    BenchRng rng;
+    bench_seed(&rng, 19);
+    size_t productCount = n < 100000 ? n : 100000;
+    size_t np = n / 4 > 0 ? n / 4 : 1;
+    FILE* fp = fopen(BENCH_PURCHASE_LOG, "w");
+    if (!fp) return 0;
+    char line[128];
+    for (size_t i = 0; i < np; ++i) {
+        Purchase p = { (int)i + 1, 1 + (int)bench_below(&rng, productCount), 1 + (int)bench_below(&rng, 50),
+            100 + (Money)bench_below(&rng, 5000), 1700000000LL + (long long)i };
+        int len = formatPurchaseRecord(&p, line, sizeof(line));
+        fwrite(line, 1, (size_t)len, fp);
+    }
+    fclose(fp);
+
+    MarginReport m;
+    margin_init(&m);
+    uint64_t t0 = timeutil_nowNs();
+    margin_build(&m, BENCH_PURCHASE_LOG, BENCH_ORDERS_LOG);
+    bench_silenceStdout();
+    margin_print(&m, NULL, 10);
+    bench_restoreStdout();
+    uint64_t dt = timeutil_nowNs() - t0;
+    g_sink += (uint64_t)m.cogs;
+    margin_free(&m);
+    remove(BENCH_PURCHASE_LOG);
+    *ops = n + np;
+    return dt;
+}
+
+/* pair counting over an n-order log (up to 5 lines per order), all threads;
+ * min support 2 so that the sparse pair table actually fills */
+static uint64_t bm_basket_pairs(size_t n, uint64_t* ops) {
+    ensure_orders_log(n);
+    BasketOptions opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.minSupport = 2;
+    BasketReport r;
+    uint64_t t0 = timeutil_nowNs();
+    basket_build(&r, BENCH_ORDERS_LOG, &opt);
+    uint64_t dt = timeutil_nowNs() - t0;
+    g_sink += r.pairCount;
+    basket_free(&r);
+    *ops = n;
+    return dt;
+}
+
+/* n movements over a year on n/10 products, written by the ledger itself
+ * through the persistence queue: a baseline level of 1000 for every
+ * product, then the movements, with the checkpoints and chain links the
+ * ledger adds on its own */
+static size_t g_ledgerN = 0;
+
+static void ensure_ledger(size_t n) {
+    if (g_ledgerN == n) return;
+    BenchRng rng;
+    bench_seed(&rng, 17);
+    size_t np = n / 10 > 0 ? n / 10 : 1;
+    int* level = malloc(np * sizeof(int));
+    if (!level) exit(1);
+    remove(BENCH_LEDGER);
+    remove(BENCH_LEDGER LEDGER_INDEX_SUFFIX);
+    int target = pq_registerFile(BENCH_LEDGER);
+    int indexTarget = pq_registerFile(BENCH_LEDGER LEDGER_INDEX_SUFFIX);
+    if (target < 0 || indexTarget < 0 || pq_start((size_t)1 << 22, PQ_FULL_BLOCK) != 0) exit(1);
+    StockLedger l;
+    ledger_init(&l);
+    ledger_attach(&l, BENCH_LEDGER, target, indexTarget);
+    for (size_t k = 0; k < np; ++k) {
+        level[k] = 1000;
+        ledger_note(&l, (int)k + 1, 1000, BENCH_LEDGER_BASE);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        size_t k = (size_t)bench_below(&rng, np);
+        int delta = (int)bench_below(&rng, 20) - 10;
+        if (level[k] + delta < 0) delta = -delta;
+        level[k] += delta;
+        long long t = BENCH_LEDGER_BASE + 1 + (long long)((double)BENCH_LEDGER_SPAN * (double)i / (double)n);
+        ledger_note(&l, (int)k + 1, level[k], t);
+    }
+    ledger_free(&l);
+    pq_stop();
+    free(level);
+    g_ledgerN = n;
+}
+
+/* startup: the last indexed checkpoint and the movements after it */
+static uint64_t bm_ledger_load(size_t n, uint64_t* ops) {
+    ensure_ledger(n);
+    StockLedger l;
+    ledger_init(&l);
+    uint64_t t0 = timeutil_nowNs();
+    ledger_load(&l, BENCH_LEDGER);
+    uint64_t dt = timeutil_nowNs() - t0;
+    g_sink += l.movements;
+    ledger_free(&l);
+    *ops = n;
+    return dt;
+}
+
+/* single-product as-of queries at random times of the year: most fall
+ * before the product's last change and follow its chain down the file */
+static uint64_t bm_ledger_stock_at_history(size_t n, uint64_t* ops) {
+    ensure_ledger(n);
+    StockLedger l;
+    ledger_init(&l);
+    ledger_load(&l, BENCH_LEDGER);
+    BenchRng rng;
+    bench_seed(&rng, 18);
+    size_t np = n / 10 > 0 ? n / 10 : 1;
+    const size_t queries = 10000;
+    uint64_t t0 = timeutil_nowNs();
+    for (size_t i = 0; i < queries; ++i) {
+        int stock = 0;
+        long long t = BENCH_LEDGER_BASE + (long long)bench_below(&rng, (uint32_t)BENCH_LEDGER_SPAN);
+        if (ledger_stockAt(&l, 1 + (int)bench_below(&rng, np), t, &stock, NULL) > 0) g_sink += (uint64_t)stock;
+    }
+    uint64_t dt = timeutil_nowNs() - t0;
+    ledger_free(&l);
+    *ops = queries;
+    return dt;
+}
+
+/* the same queries at the end of the year: answered from memory */
+static uint64_t bm_ledger_stock_at(size_t n, uint64_t* ops) {
+    ensure_ledger(n);
+    StockLedger l;
+    ledger_init(&l);
+    ledger_load(&l, BENCH_LEDGER);
+    BenchRng rng;
+    bench_seed(&rng, 18);
+    size_t np = n / 10 > 0 ? n / 10 : 1;
+    const size_t queries = 100000;
+    long long t = BENCH_LEDGER_BASE + BENCH_LEDGER_SPAN + 1;
+    uint64_t t0 = timeutil_nowNs();
+    for (size_t i = 0; i < queries; ++i) {
+        int stock = 0;
+        if (ledger_stockAt(&l, 1 + (int)bench_below(&rng, np), t, &stock, NULL) > 0) g_sink += (uint64_t)stock;
+    }
+    uint64_t dt = timeutil_nowNs() - t0;
+    ledger_free(&l);
+    *ops = queries;
+    return dt;
+}
+
+/* whole catalog at mid-year: nearest checkpoint, then one sequential pass */
+static uint64_t bm_ledger_catalog_at(size_t n, uint64_t* ops) {
+    ensure_ledger(n);
+    StockLedger l;
+    ledger_init(&l);
+    ledger_load(&l, BENCH_LEDGER);
+    long long units = 0;
+    uint64_t t0 = timeutil_nowNs();
+    long rows = ledger_catalogAt(&l, BENCH_LEDGER_BASE + BENCH_LEDGER_SPAN / 2, BENCH_LEDGER_OUT, &units);
+    uint64_t dt = timeutil_nowNs() - t0;
+    g_sink += (uint64_t)rows + (uint64_t)units;
+    ledger_free(&l);
+    remove(BENCH_LEDGER_OUT);
+    *ops = n;
+    return dt;
+}
+
+/* the pause the caller sees when exporting an n-product catalog: with
+ * fork() that is the page-table copy, not the export itself */
+static uint64_t bm_snapshot_start(size_t n, uint64_t* ops) {
+    static const char* const files[] = {
+        "products.csv", "users.csv", "reorder_levels.csv", "valuation.csv",
+        "orders.log", "purchase_log.csv", "MANIFEST"
+    };
+    BenchRng rng;
+    bench_seed(&rng, 15);
+    ProductList list;
+    initProductList(&list);
+    build_products(&list, n, &rng);
+    UserList users;
+    initUserList(&users);
+    ReorderTable reorder;
+    reorder_init(&reorder);
+    Valuation val;
+    valuation_init(&val);
+    SnapshotSource src = { &list, &users, &reorder, &val, "bench_no_orders.log", "bench_no_purchases.csv" };
+    SnapshotJob job;
+    memset(&job, 0, sizeof(job));
+
+    uint64_t t0 = timeutil_nowNs();
+    snapshot_start(&job, &src, BENCH_SNAPSHOT_DIR);
+    uint64_t dt = timeutil_nowNs() - t0;
+    g_sink += (uint64_t)snapshot_wait(&job);
+
+    char path[64];
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); ++i) {
+        snprintf(path, sizeof(path), "%s/%s", BENCH_SNAPSHOT_DIR, files[i]);
+        remove(path);
+    }
+    remove(BENCH_SNAPSHOT_DIR);
+    valuation_free(&val);
+    reorder_free(&reorder);
+    freeUserList(&users);
+    freeProductList(&list);
+    *ops = n;
+    return dt;
+}
+
+static uint64_t bm_name_index_build(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 11);
+    ProductList list;
+    initProductList(&list);
+    build_products(&list, n, &rng);
+    uint64_t t0 = timeutil_nowNs();
+    rebuildProductNameIndex(&list);
+    uint64_t dt = timeutil_nowNs() - t0;
+    freeProductList(&list);
+    *ops = n;
+    return dt;
+}
+
+/* queries are digit runs of random SKUs, e.g. "0012345" inside "SKU-00123456" */
+static uint64_t bm_name_search(size_t n, uint64_t* ops, int prefix) {
+    BenchRng rng;
+    bench_seed(&rng, 12);
+    ProductList list;
+    initProductList(&list);
+    build_products(&list, n, &rng);
+    rebuildProductNameIndex(&list);
+
+    const size_t queries = 1000;
+    char (*q)[32] = malloc(queries * sizeof(*q));
+    for (size_t i = 0; i < queries; ++i) {
+        char full[32];
+        snprintf(full, sizeof(full), "sku-%08zu", 1 + (size_t)bench_below(&rng, n));
+        if (prefix) snprintf(q[i], sizeof(q[i]), "%.9s", full);
+        else snprintf(q[i], sizeof(q[i]), "%s", full + 5);
+    }
+
+    int ids[64];
+    uint64_t acc = 0;
+    /* the first prefix query sorts the index; keep that out of the timing */
+    acc += findProductsByNamePrefix(&list, "", ids, 1);
+    uint64_t t0 = timeutil_nowNs();
+    for (size_t i = 0; i < queries; ++i) {
+        acc += prefix ? findProductsByNamePrefix(&list, q[i], ids, 64)
+            : searchProductsByName(&list, q[i], ids, 64);
+    }
+    uint64_t dt = timeutil_nowNs() - t0;
+
+    g_sink += acc;
+    free(q);
+    freeProductList(&list);
+    *ops = queries;
+    return dt;
+}
+
+static uint64_t bm_name_search_prefix(size_t n, uint64_t* ops) {
+    return bm_name_search(n, ops, 1);
+}
+
+static uint64_t bm_name_search_substring(size_t n, uint64_t* ops) {
+    return bm_name_search(n, ops, 0);
+}
+
+/* 20-row pages sorted by name from the cached permutation, rendered into
+ * a discarding buffer; the first (sorting) call is not timed */
+static uint64_t bm_product_list_page(size_t n, uint64_t* ops) {
+    BenchRng rng;
+    bench_seed(&rng, 13);
+    ProductList list;
+    initProductList(&list);
+    build_products(&list, n, &rng);
+    OutBuf out;
+    outbuf_init(&out, NULL, OUTBUF_DEFAULT_CAP);
+    listProductsPage(&list, PRODUCT_SORT_NAME, 0, 0, 20, &out);
+
+    const size_t pages = 1000;
+    uint64_t acc = 0;
+    uint64_t t0 = timeutil_nowNs();
+    for (size_t i = 0; i < pages; ++i) {
+        acc += listProductsPage(&list, PRODUCT_SORT_NAME, (int)(i & 1),
+            (size_t)bench_below(&rng, n), 20, &out);
+        outbuf_flush(&out);
+    }
+    uint64_t dt = timeutil_nowNs() - t0;
+
+    g_sink += acc;
+    outbuf_free(&out);
+    freeProductList(&list);
+    *ops = pages;
+    return dt;
+}
+
+static const BenchCase g_cases[] = {
+    { "find_product_by_id",      0,      bm_find_product_by_id },
+    { "catalog_stock_scan",      0,      bm_catalog_stock_scan },
+    { "add_product",             0,      bm_add_product },
+    { "delete_product",          0,      bm_delete_product },
+    { "add_order_item",          0,      bm_add_order_item },
+    { "load_products_csv",       0,      bm_load_products_csv },
+    { "save_products_csv",       0,      bm_save_products_csv },
+    { "pstore_order_flush",      0,      bm_pstore_order_flush },
+    { "append_order_to_file",    0,      bm_append_order_to_file },
+    { "append_order_binary",     0,      bm_append_order_binary },
+    { "report_sales_summary",    0,      bm_report_sales_summary },
+    { "report_monthly_sales",    0,      bm_report_monthly_sales },
+    { "report_top_products",     0,      bm_report_top_products },
+    { "purchase_summary",        0,      bm_purchase_summary },
+    { "purchase_load_tail",      0,      bm_purchase_load_tail },
+    { "reorder_low_stock",       0,      bm_reorder_low_stock },
+    { "reorder_replenish",       0,      bm_reorder_replenish },
+    { "reorder_find_low_stock",  0,      bm_reorder_find_low_stock },
+    { "lowstock_update",         0,      bm_lowstock_update },
+    { "valuation_update",        0,      bm_valuation_update },
+    { "forecast_load",           0,      bm_forecast_load },
+    { "forecast_load_binary",    0,      bm_forecast_load_binary },
+    { "forecast_replenish",      0,      bm_forecast_replenish },
+    { "partial_merge",           0,      bm_partial_merge },
+    { "replica_catch_up",        0,      bm_replica_catch_up },
+    { "manifest_receive",        0,      bm_manifest_receive },
+    { "margin_report",           0,      bm_margin_report },
+    { "basket_pairs",            0,      bm_basket_pairs },
+    { "ledger_load",             0,      bm_ledger_load },
+    { "ledger_stock_at",         0,      bm_ledger_stock_at },
+    { "ledger_stock_at_history", 0,      bm_ledger_stock_at_history },
+    { "ledger_catalog_at",       0,      bm_ledger_catalog_at },
+    { "snapshot_start",          0,      bm_snapshot_start },
+    { "name_index_build",        0,      bm_name_index_build },
+    { "name_search_prefix",      0,      bm_name_search_prefix },
+    { "name_search_substring",   0,      bm_name_search_substring },
+    { "product_list_page",       0,      bm_product_list_page },
+};
+
+static int cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char** argv) {
+    size_t minScale = (size_t)bench_argU64(argc, argv, "--min-scale", 1000);
+    size_t maxScale = (size_t)bench_argU64(argc, argv, "--max-scale", 100000);
+    int repeats = (int)bench_argU64(argc, argv, "--repeats", 3);
+    const char* filter = bench_argStr(argc, argv, "--filter", NULL);
+    const char* outPath = bench_argStr(argc, argv, "--out", NULL);
+    if (repeats < 1) repeats = 1;
+    /* built-in instrumentation off unless asked for, so numbers stay comparable */
+    metrics_setEnabled((int)bench_argU64(argc, argv, "--metrics", 0));
+    if (repeats > 32) repeats = 32;
+    if (minScale < 1) minScale = 1;
+
+    FILE* out = stdout;
+    if (outPath) {
+        out = fopen(outPath, "w");
+        if (!out) {
+            fprintf(stderr, "cannot open %s\n", outPath);
+            return 1;
+        }
+    }
+
+    BenchJson json;
+    bench_jsonBegin(&json, out, "sales_bench");
+
+    for (size_t c = 0; c < sizeof(g_cases) / sizeof(g_cases[0]); ++c) {
+        const BenchCase* bc = &g_cases[c];
+        if (filter && !strstr(bc->name, filter)) continue;
+        for (size_t n = minScale; n <= maxScale; n *= 10) {
+            if (bc->maxN && n > bc->maxN) {
+                fprintf(stderr, "%-24s n=%-9zu skipped (limit %zu)\n", bc->name, n, bc->maxN);
+                continue;
+            }
+            uint64_t samples[32];
+            uint64_t ops = 0;
+            for (int r = 0; r < repeats; ++r) samples[r] = bc->run(n, &ops);
+            qsort(samples, (size_t)repeats, sizeof(uint64_t), cmp_u64);
+            bench_jsonResult(&json, bc->name, n, ops, samples[0], samples[repeats / 2], repeats);
+            fprintf(stderr, "%-24s n=%-9zu %12.1f ns/op\n", bc->name, n,
+                ops ? (double)samples[0] / (double)ops : 0.0);
+        }
+    }
+
+    bench_jsonEnd(&json);
+    if (out != stdout) fclose(out);
+    remove(BENCH_ORDERS_LOG);
+    remove(BENCH_ORDERS_BIN);
+    remove(BENCH_PRODUCTS_CSV);
+    remove(BENCH_PARTIAL_FILE);
+    remove(BENCH_LEDGER);
+    remove(BENCH_LEDGER LEDGER_INDEX_SUFFIX);
+    return 0;
+}
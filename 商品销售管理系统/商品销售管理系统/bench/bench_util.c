@@ -0,0 +1,147 @@
+#include "bench_util.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#define NULL_DEVICE "NUL"
+#define dup_fd  _dup
+#define dup2_fd _dup2
+#define open_fd _open
+#define close_fd _close
+#define WRONLY_FLAG _O_WRONLY
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#define NULL_DEVICE "/dev/null"
+#define dup_fd  dup
+#define dup2_fd dup2
+#define open_fd open
+#define close_fd close
+#define WRONLY_FLAG O_WRONLY
+#endif
+
+void bench_seed(BenchRng* r, uint64_t seed) {
+    r->s = seed ? seed : 0x9E3779B97F4A7C15ull;
+}
+
+uint64_t bench_next(BenchRng* r) {
+    uint64_t x = r->s;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    r->s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+size_t bench_below(BenchRng* r, size_t n) {
+    return n ? (size_t)(bench_next(r) % n) : 0;
+}
+
+double bench_unit(BenchRng* r) {
+    return (double)(bench_next(r) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int g_savedStdout = -1;
+
+void bench_silenceStdout(void) {
+    if (g_savedStdout >= 0) return;
+    fflush(stdout);
+    int nul = open_fd(NULL_DEVICE, WRONLY_FLAG);
+    if (nul < 0) return;
+    g_savedStdout = dup_fd(1);
+    dup2_fd(nul, 1);
+    close_fd(nul);
+}
+
+void bench_restoreStdout(void) {
+    if (g_savedStdout < 0) return;
+    fflush(stdout);
+    dup2_fd(g_savedStdout, 1);
+    close_fd(g_savedStdout);
+    g_savedStdout = -1;
+}
+
+void bench_jsonBegin(BenchJson* j, FILE* fp, const char* suite) {
+    j->fp = fp;
+    j->count = 0;
+    fprintf(fp, "{\n  \"suite\": \"%s\",\n  \"version\": 1,\n  \"results\": [", suite);
+}
+
+void bench_jsonResult(BenchJson* j, const char* name, size_t n,
+    uint64_t ops, uint64_t bestNs, uint64_t medianNs, int repeats) {
+    double perOp = ops ? (double)bestNs / (double)ops : 0.0;
+    fprintf(j->fp, "%s\n    {\"name\": \"%s\", \"n\": %zu, \"ops\": %llu, \"repeats\": %d, "
+        "\"best_ns\": %llu, \"median_ns\": %llu, \"ns_per_op\": %.3f}",
+        j->count ? "," : "", name, n, (unsigned long long)ops, repeats,
+        (unsigned long long)bestNs, (unsigned long long)medianNs, perOp);
+    j->count++;
+    fflush(j->fp);
+}
+
+void bench_jsonEnd(BenchJson* j) {
+    fprintf(j->fp, "\n  ]\n}\n");
+    fflush(j->fp);
+}
+
+void bench_latInit(BenchLatency* l) {
+    l->ns = NULL;
+    l->size = 0;
+    l->capacity = 0;
+    l->totalNs = 0;
+    l->sorted = 1;
+}
+
+void bench_latFree(BenchLatency* l) {
+    free(l->ns);
+    bench_latInit(l);
+}
+
+void bench_latAdd(BenchLatency* l, uint64_t ns) {
+    if (l->size >= l->capacity) {
+        size_t newCap = l->capacity == 0 ? 1024 : l->capacity * 2;
+        uint32_t* nd = (uint32_t*)realloc(l->ns, newCap * sizeof(uint32_t));
+        if (!nd) return;
+        l->ns = nd;
+        l->capacity = newCap;
+    }
+    l->ns[l->size++] = ns > 0xFFFFFFFFull ? 0xFFFFFFFFu : (uint32_t)ns;
+    l->totalNs += ns;
+    l->sorted = 0;
+}
+
+static int cmp_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+uint64_t bench_latPercentile(BenchLatency* l, double pct) {
+    if (l->size == 0) return 0;
+    if (!l->sorted) {
+        qsort(l->ns, l->size, sizeof(uint32_t), cmp_u32);
+        l->sorted = 1;
+    }
+    double rank = pct / 100.0 * (double)(l->size - 1);
+    size_t idx = (size_t)(rank + 0.5);
+    if (idx >= l->size) idx = l->size - 1;
+    return l->ns[idx];
+}
+
+const char* bench_argStr(int argc, char** argv, const char* flag, const char* def) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], flag) == 0) return argv[i + 1];
+    }
+    return def;
+}
+
+unsigned long long bench_argU64(int argc, char** argv, const char* flag, unsigned long long def) {
+    const char* s = bench_argStr(argc, argv, flag, NULL);
+    return s ? strtoull(s, NULL, 10) : def;
+}
+
+double bench_argDouble(int argc, char** argv, const char* flag, double def) {
+    const char* s = bench_argStr(argc, argv, flag, NULL);
+    return s ? strtod(s, NULL) : def;
+}
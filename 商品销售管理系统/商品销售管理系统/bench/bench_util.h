@@ -0,0 +1,61 @@
+#pragma once
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* deterministic xorshift64* generator, so every run sees the same data */
+    typedef struct {
+        uint64_t s;
+    } BenchRng;
+
+    void     bench_seed(BenchRng* r, uint64_t seed);
+    uint64_t bench_next(BenchRng* r);
+    size_t   bench_below(BenchRng* r, size_t n);   /* uniform in [0, n) */
+    double   bench_unit(BenchRng* r);              /* uniform in [0, 1) */
+
+    /* route stdout to the null device while report functions print */
+    void bench_silenceStdout(void);
+    void bench_restoreStdout(void);
+
+    /* ---- stable JSON output: one object per (benchmark, n) ---- */
+    typedef struct {
+        FILE* fp;
+        int   count;
+    } BenchJson;
+
+    void bench_jsonBegin(BenchJson* j, FILE* fp, const char* suite);
+    void bench_jsonResult(BenchJson* j, const char* name, size_t n,
+        uint64_t ops, uint64_t bestNs, uint64_t medianNs, int repeats);
+    void bench_jsonEnd(BenchJson* j);
+
+    /* latency samples with exact percentiles (sorts on query) */
+    typedef struct {
+        uint32_t* ns;
+        size_t    size;
+        size_t    capacity;
+        uint64_t  totalNs;
+        int       sorted;
+    } BenchLatency;
+
+    void     bench_latInit(BenchLatency* l);
+    void     bench_latFree(BenchLatency* l);
+    void     bench_latAdd(BenchLatency* l, uint64_t ns);
+    uint64_t bench_latPercentile(BenchLatency* l, double pct); /* pct in [0, 100] */
+
+    /* "--flag value" helpers for the small CLIs under bench/ */
+    const char* bench_argStr(int argc, char** argv, const char* flag, const char* def);
+    unsigned long long bench_argU64(int argc, char** argv, const char* flag, unsigned long long def);
+    double bench_argDouble(int argc, char** argv, const char* flag, double def);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
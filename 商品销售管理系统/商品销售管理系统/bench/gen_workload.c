@@ -0,0 +1,200 @@
+/* Synthetic workload generator.
+ *
+ *   sales_gen [--out-dir .] [--products 10000] [--users 1000]
+ *             [--orders 100000] [--purchases 20000] [--max-items 5]
+ *             [--zipf 1.1] [--start 1700000000] [--days 365]
+ *             [--paid 0.7] [--cancelled 0.1] [--seed 1]
+ *
+ * Writes products.csv, users.csv, purchase_log.csv and orders.log in the
+ * formats the application reads. Product popularity (order lines and
+ * purchases) follows a Zipf(s) law over a shuffled rank -> id mapping.
+ * Each order gets a CREATED record and, depending on the status mix, a
+ * later PAID or CANCELLED record, exactly like the interactive flow.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "bench_util.h"
+#include "order.h"
+#include "persistence.h"
+#include "purchase.h"
+
+typedef struct {
+    double* cdf;     /* cdf[r] = P(rank <= r) */
+    int*    idOfRank;
+    size_t  n;
+} Zipf;
+
+static int zipf_init(Zipf* z, size_t n, double s, BenchRng* rng) {
+    z->n = n;
+    z->cdf = (double*)malloc(n * sizeof(double));
+    z->idOfRank = (int*)malloc(n * sizeof(int));
+    if (!z->cdf || !z->idOfRank) return -1;
+    double sum = 0.0;
+    for (size_t r = 0; r < n; ++r) {
+        sum += 1.0 / pow((double)(r + 1), s);
+        z->cdf[r] = sum;
+    }
+    for (size_t r = 0; r < n; ++r) z->cdf[r] /= sum;
+    for (size_t r = 0; r < n; ++r) z->idOfRank[r] = (int)r + 1;
+    for (size_t r = n; r > 1; --r) {
+        size_t k = bench_below(rng, r);
+        int tmp = z->idOfRank[r - 1];
+        z->idOfRank[r - 1] = z->idOfRank[k];
+        z->idOfRank[k] = tmp;
+    }
+    return 0;
+}
+
+static int zipf_sample(const Zipf* z, BenchRng* rng) {
+    double u = bench_unit(rng);
+    size_t lo = 0, hi = z->n - 1;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (z->cdf[mid] < u) lo = mid + 1;
+        else hi = mid;
+    }
+    return z->idOfRank[lo];
+}
+
+static void zipf_free(Zipf* z) {
+    free(z->cdf);
+    free(z->idOfRank);
+}
+
+static FILE* open_out(const char* dir, const char* name) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE* fp = fopen(path, "w");
+    if (!fp) fprintf(stderr, "cannot write %s\n", path);
+    return fp;
+}
+
+int main(int argc, char** argv) {
+    const char* dir = bench_argStr(argc, argv, "--out-dir", ".");
+    size_t nProducts = (size_t)bench_argU64(argc, argv, "--products", 10000);
+    size_t nUsers = (size_t)bench_argU64(argc, argv, "--users", 1000);
+    size_t nOrders = (size_t)bench_argU64(argc, argv, "--orders", 100000);
+    size_t nPurchases = (size_t)bench_argU64(argc, argv, "--purchases", 20000);
+    size_t maxItems = (size_t)bench_argU64(argc, argv, "--max-items", 5);
+    double zipfS = bench_argDouble(argc, argv, "--zipf", 1.1);
+    long long start = (long long)bench_argU64(argc, argv, "--start", 1700000000ull);
+    double days = bench_argDouble(argc, argv, "--days", 365.0);
+    double paidRatio = bench_argDouble(argc, argv, "--paid", 0.7);
+    double cancelRatio = bench_argDouble(argc, argv, "--cancelled", 0.1);
+    uint64_t seed = bench_argU64(argc, argv, "--seed", 1);
+
+    if (nProducts == 0) nProducts = 1;
+    if (maxItems == 0) maxItems = 1;
+    long long span = (long long)(days * 86400.0);
+    if (span < 1) span = 1;
+
+    BenchRng rng;
+    bench_seed(&rng, seed);
+
+    Zipf zipf;
+    if (zipf_init(&zipf, nProducts, zipfS, &rng) != 0) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    /* ---- products.csv: prices log-uniform 1..10000, stock sized to demand ---- */
+    FILE* fp = open_out(dir, "products.csv");
+    if (!fp) return 1;
+    Money* price = (Money*)malloc((nProducts + 1) * sizeof(Money));
+    double* demand = (double*)malloc((nProducts + 1) * sizeof(double));
+    if (!price || !demand) return 1;
+    /* expected units per product: orders * E[lines] * E[qty] * P(product) */
+    double units = (double)nOrders * (1.0 + (double)(maxItems - 1) / 2.0) * 2.0;
+    for (size_t r = 0; r < nProducts; ++r) {
+        double pr = zipf.cdf[r] - (r ? zipf.cdf[r - 1] : 0.0);
+        demand[zipf.idOfRank[r]] = units * pr;
+    }
+    fprintf(fp, "#id,name,price,stock\n");
+    char priceStr[MONEY_STR_MAX];
+    for (size_t id = 1; id <= nProducts; ++id) {
+        price[id] = (Money)floor(pow(10.0, 4.0 * bench_unit(&rng)) * 100.0 + 100.0);
+        double want = demand[id] * (0.9 + 0.4 * bench_unit(&rng)) + 20.0;
+        int stock = want > 2e9 ? 2000000000 : (int)want;
+        fprintf(fp, "%zu,Item-%06zu,%s,%d\n", id, id, money_str(price[id], priceStr), stock);
+    }
+    fclose(fp);
+    free(demand);
+
+    /* ---- users.csv ---- */
+    fp = open_out(dir, "users.csv");
+    if (!fp) return 1;
+    fprintf(fp, "#id,username,password\n");
+    for (size_t id = 1; id <= nUsers; ++id) {
+        fprintf(fp, "%zu,user%zu,pw%06zu\n", id, id, (size_t)bench_below(&rng, 1000000));
+    }
+    fclose(fp);
+
+    /* ---- purchase_log.csv: cost 50-90% of price ---- */
+    fp = open_out(dir, "purchase_log.csv");
+    if (!fp) return 1;
+    char line[128];
+    for (size_t i = 0; i < nPurchases; ++i) {
+        Purchase p;
+        p.purchaseId = (int)i + 1;
+        p.productId = zipf_sample(&zipf, &rng);
+        p.quantity = 10 * (1 + (int)bench_below(&rng, 20));
+        p.unitCost = (Money)floor((double)price[p.productId] * (0.5 + 0.4 * bench_unit(&rng)));
+        p.createdAt = start + (long long)((double)span * (double)i / (double)(nPurchases ? nPurchases : 1));
+        int len = formatPurchaseRecord(&p, line, sizeof(line));
+        if (len > 0 && (size_t)len < sizeof(line)) fwrite(line, 1, (size_t)len, fp);
+    }
+    fclose(fp);
+
+    /* ---- orders.log ---- */
+    fp = open_out(dir, "orders.log");
+    if (!fp) return 1;
+    size_t bufCap = 256 + maxItems * 80;
+    char* buf = (char*)malloc(bufCap);
+    Product prod;
+    memset(&prod, 0, sizeof(prod));
+    size_t paid = 0, cancelled = 0, lines = 0;
+    for (size_t i = 0; i < nOrders; ++i) {
+        Order o;
+        initOrder(&o, (int)i + 1);
+        o.createdAt = (time_t)(start + (long long)((double)span * (double)i / (double)nOrders));
+        size_t items = 1 + bench_below(&rng, maxItems);
+        for (size_t k = 0; k < items; ++k) {
+            prod.id = zipf_sample(&zipf, &rng);
+            prod.price = price[prod.id];
+            addOrderItem(&o, &prod, 1 + (int)bench_below(&rng, 3));
+        }
+        size_t len = formatOrderRecord(&o, buf, bufCap);
+        fwrite(buf, 1, len, fp);
+        lines += 1 + items;
+
+        double u = bench_unit(&rng);
+        if (u < paidRatio) {
+            o.status = ORDER_PAID;
+            o.paidAt = o.createdAt + 30 + (time_t)bench_below(&rng, 1800);
+            paid++;
+        }
+        else if (u < paidRatio + cancelRatio) {
+            o.status = ORDER_CANCELLED;
+            cancelled++;
+        }
+        if (o.status != ORDER_CREATED) {
+            len = formatOrderRecord(&o, buf, bufCap);
+            fwrite(buf, 1, len, fp);
+            lines += 1 + items;
+        }
+        freeOrder(&o);
+    }
+    fclose(fp);
+
+    fprintf(stderr, "generated %zu products, %zu users, %zu purchases, %zu orders "
+        "(%zu paid, %zu cancelled, %zu log lines) in %s\n",
+        nProducts, nUsers, nPurchases, nOrders, paid, cancelled, lines, dir);
+
+    free(buf);
+    free(price);
+    zipf_free(&zipf);
+    return 0;
+}
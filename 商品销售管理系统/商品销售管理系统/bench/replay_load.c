@@ -0,0 +1,234 @@
+/* End-to-end replay load test.
+ *
+ *   sales_replay [--dir .] [--out replay_orders.log] [--async 1]
+ *                [--json replay.json] [--metrics 0|1] [--trace trace.json]
+ *
+ * Loads <dir>/products.csv, then replays <dir>/orders.log (as written by
+ * the app or by sales_gen) through the real order / inventory code:
+ * CREATED records become findProductById + deductStock + addOrderItem +
+ * log append, PAID records markOrderPaid + append, CANCELLED records
+ * cancelOrder + stock restore + append. Every operation is timed and the
+ * result is throughput plus p50/p99/p999 latency per operation as JSON.
+ * With --async 1 the log appends go through the persistence queue.
+ * --trace writes Chrome trace-event spans (load, replay, writer batches).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "timeutil.h"
+#include "metrics.h"
+#include "trace.h"
+#include "product.h"
+#include "inventory.h"
+#include "order.h"
+#include "persistence.h"
+#include "persist_queue.h"
+#include "orderlog.h"
+
+enum {
+    OP_FIND_PRODUCT = 0,
+    OP_DEDUCT_STOCK,
+    OP_ADD_ORDER_ITEM,
+    OP_APPEND_ORDER,
+    OP_CREATE_ORDER,
+    OP_PAY_ORDER,
+    OP_CANCEL_ORDER,
+    OP_COUNT
+};
+
+static const char* g_opNames[OP_COUNT] = {
+    "find_product_by_id", "deduct_stock", "add_order_item", "append_order",
+    "create_order", "pay_order", "cancel_order"
+};
+
+static BenchLatency g_lat[OP_COUNT];
+static const char* g_outLog = "replay_orders.log";
+static int g_outTarget = -1;
+
+/* live orders indexed by orderId - 1 */
+typedef struct {
+    Order* data;
+    char*  live;
+    size_t capacity;
+} ReplayOrders;
+
+static Order* replay_slot(ReplayOrders* ro, int orderId) {
+    if (orderId <= 0) return NULL;
+    size_t idx = (size_t)orderId - 1;
+    if (idx >= ro->capacity) {
+        size_t newCap = ro->capacity == 0 ? 1024 : ro->capacity;
+        while (newCap <= idx) newCap *= 2;
+        Order* nd = (Order*)realloc(ro->data, newCap * sizeof(Order));
+        char* nl = (char*)realloc(ro->live, newCap);
+        if (!nd || !nl) {
+            fprintf(stderr, "out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        memset(nl + ro->capacity, 0, newCap - ro->capacity);
+        ro->data = nd;
+        ro->live = nl;
+        ro->capacity = newCap;
+    }
+    return &ro->data[idx];
+}
+
+static void timed_append(const Order* o) {
+    uint64_t t0 = timeutil_nowNs();
+    if (g_outTarget >= 0) {
+        char buf[4096];
+        size_t len = formatOrderRecord(o, buf, sizeof(buf));
+        if (len < sizeof(buf)) pq_append(g_outTarget, buf, len);
+        else appendOrderToFile(g_outLog, o);
+    }
+    else {
+        appendOrderToFile(g_outLog, o);
+    }
+    bench_latAdd(&g_lat[OP_APPEND_ORDER], timeutil_nowNs() - t0);
+}
+
+static unsigned long long g_insufficient = 0;
+static unsigned long long g_missing = 0;
+
+static void replay_create(ProductList* products, ReplayOrders* ro, int orderId,
+    const OrderItem* items, size_t n) {
+    uint64_t start = timeutil_nowNs();
+    Order* o = replay_slot(ro, orderId);
+    if (ro->live[orderId - 1]) freeOrder(o);
+    initOrder(o, orderId);
+    ro->live[orderId - 1] = 1;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t t0 = timeutil_nowNs();
+        Product* p = findProductById(products, items[i].productId);
+        uint64_t t1 = timeutil_nowNs();
+        bench_latAdd(&g_lat[OP_FIND_PRODUCT], t1 - t0);
+        if (!p) {
+            g_missing++;
+            continue;
+        }
+        int rc = deductStock(p, items[i].quantity);
+        uint64_t t2 = timeutil_nowNs();
+        bench_latAdd(&g_lat[OP_DEDUCT_STOCK], t2 - t1);
+        if (rc != 0) {
+            g_insufficient++;
+            continue;
+        }
+        addOrderItem(o, p, items[i].quantity);
+        bench_latAdd(&g_lat[OP_ADD_ORDER_ITEM], timeutil_nowNs() - t2);
+    }
+    timed_append(o);
+    bench_latAdd(&g_lat[OP_CREATE_ORDER], timeutil_nowNs() - start);
+}
+
+static void replay_finish(ProductList* products, ReplayOrders* ro, int orderId, int paid) {
+    if (orderId <= 0 || (size_t)orderId > ro->capacity || !ro->live[orderId - 1]) return;
+    uint64_t start = timeutil_nowNs();
+    Order* o = &ro->data[orderId - 1];
+    if (o->status != ORDER_CREATED) return;
+    if (paid) {
+        markOrderPaid(o);
+    }
+    else {
+        cancelOrder(o);
+        for (size_t i = 0; i < o->size; ++i) {
+            Product* p = findProductById(products, o->items[i].productId);
+            if (p) increaseStock(p, o->items[i].quantity);
+        }
+    }
+    timed_append(o);
+    bench_latAdd(&g_lat[paid ? OP_PAY_ORDER : OP_CANCEL_ORDER], timeutil_nowNs() - start);
+    freeOrder(o);
+    ro->live[orderId - 1] = 0;
+}
+
+int main(int argc, char** argv) {
+    const char* dir = bench_argStr(argc, argv, "--dir", ".");
+    const char* jsonPath = bench_argStr(argc, argv, "--json", NULL);
+    int useAsync = (int)bench_argU64(argc, argv, "--async", 0);
+    g_outLog = bench_argStr(argc, argv, "--out", g_outLog);
+    /* built-in instrumentation off unless asked for, so numbers stay comparable */
+    metrics_setEnabled((int)bench_argU64(argc, argv, "--metrics", 0));
+    const char* tracePath = bench_argStr(argc, argv, "--trace", NULL);
+    if (tracePath) trace_start(tracePath);
+
+    char path[512];
+    ProductList products;
+    initProductList(&products);
+    snprintf(path, sizeof(path), "%s/products.csv", dir);
+    uint64_t tl = timeutil_nowNs();
+    int loaded = loadProductsFromCSV(path, &products);
+    tl = timeutil_nowNs() - tl;
+    if (loaded < 0) {
+        fprintf(stderr, "cannot load %s\n", path);
+        return 1;
+    }
+
+    snprintf(path, sizeof(path), "%s/orders.log", dir);
+    OrderLogReader reader;
+    if (orderlog_open(&reader, path) != 0) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+    }
+
+    for (int k = 0; k < OP_COUNT; ++k) bench_latInit(&g_lat[k]);
+    remove(g_outLog);
+    if (useAsync) {
+        g_outTarget = pq_registerFile(g_outLog);
+        if (pq_start(1u << 22, PQ_FULL_BLOCK) != 0) g_outTarget = -1;
+    }
+
+    ReplayOrders ro = { NULL, NULL, 0 };
+    unsigned long long events = 0;
+
+    OrderLogRecord rec;
+    uint64_t wall = timeutil_nowNs();
+    TRACE_BEGIN("replay");
+    while (orderlog_next(&reader, &rec)) {
+        if (rec.orderId <= 0) continue;
+        if (rec.status == ORDER_CREATED) replay_create(&products, &ro, rec.orderId, rec.items, rec.itemCount);
+        else replay_finish(&products, &ro, rec.orderId, rec.status == ORDER_PAID);
+        events++;
+    }
+    if (useAsync) pq_stop();
+    TRACE_END();
+    wall = timeutil_nowNs() - wall;
+    if (TRACE_ON()) trace_stop();
+    orderlog_close(&reader);
+
+    FILE* out = stdout;
+    if (jsonPath) {
+        out = fopen(jsonPath, "w");
+        if (!out) out = stdout;
+    }
+    double secs = (double)wall / 1e9;
+    fprintf(out, "{\n  \"suite\": \"sales_replay\",\n  \"version\": 1,\n");
+    fprintf(out, "  \"products\": %d,\n  \"load_products_ns\": %llu,\n", loaded, (unsigned long long)tl);
+    fprintf(out, "  \"events\": %llu,\n  \"wall_ns\": %llu,\n  \"events_per_sec\": %.1f,\n",
+        events, (unsigned long long)wall, secs > 0 ? (double)events / secs : 0.0);
+    fprintf(out, "  \"async_log\": %s,\n  \"insufficient_stock\": %llu,\n  \"missing_product\": %llu,\n",
+        g_outTarget >= 0 ? "true" : "false", g_insufficient, g_missing);
+    fprintf(out, "  \"ops\": [");
+    for (int k = 0; k < OP_COUNT; ++k) {
+        BenchLatency* l = &g_lat[k];
+        fprintf(out, "%s\n    {\"name\": \"%s\", \"count\": %zu, \"mean_ns\": %.1f, "
+            "\"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu}",
+            k ? "," : "", g_opNames[k], l->size,
+            l->size ? (double)l->totalNs / (double)l->size : 0.0,
+            (unsigned long long)bench_latPercentile(l, 50.0),
+            (unsigned long long)bench_latPercentile(l, 99.0),
+            (unsigned long long)bench_latPercentile(l, 99.9),
+            (unsigned long long)bench_latPercentile(l, 100.0));
+        bench_latFree(l);
+    }
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout) fclose(out);
+
+    for (size_t i = 0; i < ro.capacity; ++i) {
+        if (ro.live[i]) freeOrder(&ro.data[i]);
+    }
+    free(ro.data);
+    free(ro.live);
+    freeProductList(&products);
+    return 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef COMPAT_H
+#define COMPAT_H
+
+/* Portability shims for the MSVC secure CRT functions used in this project.
+ * On MSVC this header only defines SCANF_BUFSZ; elsewhere it maps
+ * strncpy_s / strtok_s / sscanf_s / _countof onto standard C/POSIX.
+ *
+ * sscanf_s needs a buffer size after every %s / %[ argument, plain sscanf
+ * must not get one, so call sites write:
+ *     sscanf_s(line, "%31[^,]", buf SCANF_BUFSZ(buf));
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+
+#define SCANF_BUFSZ(buf) , (unsigned)_countof(buf)
+
+#else
+
+#ifndef _TRUNCATE
+#define _TRUNCATE ((size_t)-1)
+#endif
+
+#ifndef _countof
+#define _countof(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+
+/* subset of strncpy_s semantics: always terminates, truncates silently */
+static inline int compat_strncpy_s(char* dst, size_t dstSize, const char* src, size_t count) {
+    if (!dst || dstSize == 0) return -1;
+    if (!src) {
+        dst[0] = '\0';
+        return -1;
+    }
+    size_t n = strlen(src);
+    if (count != _TRUNCATE && n > count) n = count;
+    if (n >= dstSize) n = dstSize - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+    return 0;
+}
+
+#define strncpy_s compat_strncpy_s
+#define strtok_s  strtok_r
+#define sscanf_s  sscanf
+#define SCANF_BUFSZ(buf)
+
+#endif
+
+#endif
@@ -0,0 +1,208 @@
+#include "forecast.h"
+#include "orderlog.h"
+#include "outbuf.h"
+#include "metrics.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#define SECONDS_PER_DAY 86400
+
+/* below one unit per 100 days a product counts as not selling */
+#define FORECAST_MIN_VELOCITY 0.01
+
+void forecast_init(Forecast* f) {
+    f->data = NULL;
+    f->size = 0;
+    f->capacity = 0;
+    idmap_init(&f->indexOf);
+    f->alpha = FORECAST_DEFAULT_ALPHA;
+    f->leadDays = FORECAST_DEFAULT_LEAD;
+    f->safetyDays = FORECAST_DEFAULT_SAFETY;
+    f->coverDays = FORECAST_DEFAULT_COVER;
+}
+
+void forecast_free(Forecast* f) {
+    free(f->data);
+    idmap_free(&f->indexOf);
+    forecast_init(f);
+}
+
+int forecast_day(time_t t) {
+    /* floor division, so times before 1970 land on the right day */
+    long long s = (long long)t;
+    return (int)(s >= 0 ? s / SECONDS_PER_DAY : -((-s + SECONDS_PER_DAY - 1) / SECONDS_PER_DAY));
+}
+
+/* b^n by squaring */
+static double pow_days(double b, long n) {
+    double r = 1.0;
+    while (n > 0) {
+        if (n & 1) r *= b;
+        b *= b;
+        n >>= 1;
+    }
+    return r;
+}
+
+const Velocity* forecast_find(const Forecast* f, int productId) {
+    long i = idmap_find(&f->indexOf, productId);
+    return i >= 0 ? &f->data[i] : NULL;
+}
+
+static Velocity* entry_for(Forecast* f, int productId, int day) {
+    long i = idmap_find(&f->indexOf, productId);
+    if (i >= 0) return &f->data[i];
+    if (productId <= 0) return NULL;
+    if (f->size >= f->capacity) {
+        size_t newCap = f->capacity == 0 ? 64 : f->capacity * 2;
+        Velocity* nd = (Velocity*)realloc(f->data, newCap * sizeof(Velocity));
+        if (!nd) return NULL;
+        f->data = nd;
+        f->capacity = newCap;
+    }
+    if (idmap_put(&f->indexOf, productId, f->size) != 0) return NULL;
+    Velocity* e = &f->data[f->size++];
+    e->productId = productId;
+    e->firstDay = day;
+    e->lastDay = day;
+    e->dayUnits = 0;
+    e->rate = 0.0;
+    return e;
+}
+
+int forecast_recordSale(Forecast* f, int productId, int qty, time_t when) {
+    if (qty <= 0) return -1;
+    int day = forecast_day(when);
+    Velocity* e = entry_for(f, productId, day);
+    if (!e) return -1;
+    if (day > e->lastDay) {
+        /* close the open bucket, then decay over the days without sales */
+        double keep = 1.0 - f->alpha;
+        e->rate = (f->alpha * (double)e->dayUnits + keep * e->rate) * pow_days(keep, (long)day - e->lastDay - 1);
+        e->lastDay = day;
+        e->dayUnits = 0;
+    }
+    else if (day < e->firstDay) {
+        e->firstDay = day;
+    }
+    e->dayUnits += qty;
+    return 0;
+}
+
+static double velocity_of(const Forecast* f, const Velocity* e, int today) {
+    if (today < e->lastDay) today = e->lastDay;
+    double keep = 1.0 - f->alpha;
+    /* the open bucket counts as a full day */
+    double raw = (f->alpha * (double)e->dayUnits + keep * e->rate) * pow_days(keep, (long)today - e->lastDay);
+    double norm = 1.0 - pow_days(keep, (long)today - e->firstDay + 1);
+    return norm > 0.0 ? raw / norm : 0.0;
+}
+
+double forecast_velocity(const Forecast* f, int productId, int today) {
+    const Velocity* e = forecast_find(f, productId);
+    return e ? velocity_of(f, e, today) : 0.0;
+}
+
+static int ceil_units(double x) {
+    x -= 1e-9;   /* 2.0000000001 from rounding is still 2 */
+    if (x <= 0.0) return 0;
+    if (x >= (double)INT_MAX) return INT_MAX;
+    int i = (int)x;
+    return (double)i < x ? i + 1 : i;
+}
+
+int forecast_plan(const Forecast* f, int productId, int today, ForecastPlan* out) {
+    memset(out, 0, sizeof(*out));
+    double v = forecast_velocity(f, productId, today);
+    if (v < FORECAST_MIN_VELOCITY) return 0;
+    out->velocity = v;
+    out->level = ceil_units(v * (double)(f->leadDays + f->safetyDays));
+    out->target = ceil_units(v * (double)(f->leadDays + f->safetyDays + f->coverDays));
+    if (out->target < out->level) out->target = out->level;
+    return 1;
+}
+
+static int load_impl(Forecast* f, const char* path) {
+    OrderLogReader r;
+    if (orderlog_open(&r, path) != 0) return -1;
+    OrderLogRecord rec;
+    int count = 0;
+    while (orderlog_next(&r, &rec)) {
+        if (rec.status != ORDER_PAID) continue;
+        time_t when = rec.paidAt ? rec.paidAt : rec.createdAt;
+        for (size_t i = 0; i < rec.itemCount; ++i) {
+            forecast_recordSale(f, rec.items[i].productId, rec.items[i].quantity, when);
+        }
+        count++;
+    }
+    orderlog_close(&r);
+    return count;
+}
+
+int forecast_loadOrderLog(Forecast* f, const char* path) {
+    TRACE_BEGIN("forecast_load");
+    int rc;
+    if (!METRICS_ON()) {
+        rc = load_impl(f, path);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        rc = load_impl(f, path);
+        metrics_record(MET_LOAD_FORECAST, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+    return rc;
+}
+
+static void print_replenish_impl(const Forecast* f, ProductList* products, time_t now) {
+    int today = forecast_day(now);
+    OutBuf out;
+    outbuf_init(&out, stdout, OUTBUF_DEFAULT_CAP);
+    outbuf_printf(&out, "\n=== Forecast Replenishment (lead %d + safety %d days, cover %d days) ===\n",
+        f->leadDays, f->safetyDays, f->coverDays);
+    outbuf_printf(&out, "%-6s %-20s %-8s %-10s %-8s %-8s %-10s\n",
+        "ID", "Name", "Stock", "PerDay", "Level", "Target", "Suggest");
+    size_t shown = 0;
+    long long units = 0;
+    for (size_t i = 0; i < products->size; ++i) {
+        const Product* p = &products->data[i];
+        ForecastPlan plan;
+        if (!forecast_plan(f, p->id, today, &plan) || p->stock >= plan.level) continue;
+        int suggest = plan.target - p->stock;
+        outbuf_printf(&out, "%-6d %-20s %-8d %-10.2f %-8d %-8d %-10d\n", p->id, productNameAt(products, i),
+            p->stock, plan.velocity, plan.level, plan.target, suggest);
+        shown++;
+        units += suggest;
+    }
+    if (shown == 0) outbuf_printf(&out, "No replenishment needed at current demand.\n");
+    else outbuf_printf(&out, "%zu products, %lld units suggested.\n", shown, units);
+    outbuf_free(&out);
+}
+
+void forecast_printReplenish(const Forecast* f, ProductList* products, time_t now) {
+    if (!METRICS_ON()) {
+        print_replenish_impl(f, products, now);
+        return;
+    }
+    uint64_t t0 = timeutil_nowNs();
+    print_replenish_impl(f, products, now);
+    metrics_record(MET_REPORT_FORECAST, timeutil_nowNs() - t0);
+}
+
+size_t forecast_applyLevels(const Forecast* f, const ProductList* products,
+    ReorderTable* t, time_t now) {
+    int today = forecast_day(now);
+    size_t changed = 0;
+    for (size_t i = 0; i < products->size; ++i) {
+        int id = products->data[i].id;
+        ForecastPlan plan;
+        if (!forecast_plan(f, id, today, &plan)) continue;
+        if (reorder_getLevel(t, id, -1) == plan.level) continue;
+        reorder_setLevel(t, id, plan.level);
+        changed++;
+    }
+    return changed;
+}
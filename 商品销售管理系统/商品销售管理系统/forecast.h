@@ -0,0 +1,94 @@
+#pragma once
+#ifndef FORECAST_H
+#define FORECAST_H
+
+#include <stddef.h>
+#include <time.h>
+#include "idmap.h"
+#include "product.h"
+#include "reorder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Per-product sales velocity and demand-driven replenishment.
+     *
+     * Paid units are bucketed by UTC day. When a product's day closes its
+     * total is folded into an exponentially weighted moving average,
+     *   rate = alpha * dayUnits + (1 - alpha) * rate,
+     * and days without sales decay the rate by (1 - alpha) each. Averages
+     * start from zero, so the velocity divides out that start-up bias
+     * (1 - (1 - alpha)^days since the first sale). Every update and query
+     * is O(1); sales recorded for a day before the open bucket are counted
+     * in the open bucket.
+     *
+     * From velocity v (units/day):
+     *   level  = ceil(v * (leadDays + safetyDays))               reorder point
+     *   target = ceil(v * (leadDays + safetyDays + coverDays))   order up to
+     * and a product below its level is suggested target - stock units.
+     * Velocities under 0.01 units/day count as no demand.
+     * Nothing is persisted: forecast_loadOrderLog() rebuilds the state from
+     * orders.log in one pass, forecast_recordSale() keeps it current.
+     */
+
+#define FORECAST_DEFAULT_ALPHA   0.1   /* half-life about a week */
+#define FORECAST_DEFAULT_LEAD    7
+#define FORECAST_DEFAULT_SAFETY  3
+#define FORECAST_DEFAULT_COVER   14
+
+    typedef struct {
+        int       productId;
+        int       firstDay;     /* day of the first recorded sale */
+        int       lastDay;      /* the open bucket */
+        long long dayUnits;     /* units sold in the open bucket */
+        double    rate;         /* EWMA through the day before lastDay */
+    } Velocity;
+
+    typedef struct {
+        Velocity* data;
+        size_t    size;
+        size_t    capacity;
+        IdMap     indexOf;      /* productId -> index in data */
+        double    alpha;
+        int       leadDays;
+        int       safetyDays;
+        int       coverDays;
+    } Forecast;
+
+    typedef struct {
+        double velocity;        /* units per day */
+        int    level;
+        int    target;
+    } ForecastPlan;
+
+    /* default parameters; the fields may be changed before use */
+    void forecast_init(Forecast* f);
+    void forecast_free(Forecast* f);
+
+    int  forecast_day(time_t t);
+
+    /* 0 ok, -1 when out of memory or the arguments are invalid */
+    int  forecast_recordSale(Forecast* f, int productId, int qty, time_t when);
+    /* applies every PAID record (at its payment time). Returns the records
+     * applied, -1 if the log cannot be opened. */
+    int  forecast_loadOrderLog(Forecast* f, const char* path);
+
+    const Velocity* forecast_find(const Forecast* f, int productId);
+    /* units per day as of day today, 0 without sales */
+    double forecast_velocity(const Forecast* f, int productId, int today);
+    /* level/target for the product; 0 when it has no demand (plan zeroed) */
+    int  forecast_plan(const Forecast* f, int productId, int today, ForecastPlan* out);
+
+    /* products below their forecast level with the suggested quantities */
+    void forecast_printReplenish(const Forecast* f, ProductList* products, time_t now);
+    /* writes the forecast levels of products with demand into t; returns
+     * how many levels changed */
+    size_t forecast_applyLevels(const Forecast* f, const ProductList* products,
+        ReorderTable* t, time_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,95 @@
+#include "idmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define IDMAP_MIN_CAP 64
+
+static size_t home(const IdMap* m, int32_t id) {
+    return (size_t)(((uint32_t)id * 2654435761u) & (uint32_t)(m->cap - 1));
+}
+
+void idmap_init(IdMap* m) {
+    m->keys = NULL;
+    m->vals = NULL;
+    m->cap = 0;
+    m->size = 0;
+}
+
+void idmap_free(IdMap* m) {
+    free(m->keys);
+    free(m->vals);
+    idmap_init(m);
+}
+
+void idmap_clear(IdMap* m) {
+    if (m->keys) memset(m->keys, 0, m->cap * sizeof(int32_t));
+    m->size = 0;
+}
+
+long idmap_find(const IdMap* m, int id) {
+    if (m->cap == 0 || id <= 0) return -1;
+    for (size_t i = home(m, id);; i = (i + 1) & (m->cap - 1)) {
+        if (m->keys[i] == id) return (long)m->vals[i];
+        if (m->keys[i] == 0) return -1;
+    }
+}
+
+static int grow(IdMap* m) {
+    size_t newCap = m->cap == 0 ? IDMAP_MIN_CAP : m->cap * 2;
+    int32_t* nk = (int32_t*)calloc(newCap, sizeof(int32_t));
+    size_t* nv = (size_t*)malloc(newCap * sizeof(size_t));
+    if (!nk || !nv) {
+        free(nk);
+        free(nv);
+        return -1;
+    }
+    int32_t* oldKeys = m->keys;
+    size_t* oldVals = m->vals;
+    size_t oldCap = m->cap;
+    m->keys = nk;
+    m->vals = nv;
+    m->cap = newCap;
+    for (size_t i = 0; i < oldCap; ++i) {
+        if (oldKeys[i] == 0) continue;
+        size_t j = home(m, oldKeys[i]);
+        while (nk[j] != 0) j = (j + 1) & (newCap - 1);
+        nk[j] = oldKeys[i];
+        nv[j] = oldVals[i];
+    }
+    free(oldKeys);
+    free(oldVals);
+    return 0;
+}
+
+int idmap_put(IdMap* m, int id, size_t val) {
+    if (id <= 0) return -1;
+    if ((m->size + 1) * 4 > m->cap * 3 && grow(m) != 0) return -1;
+    size_t i = home(m, id);
+    while (m->keys[i] != 0 && m->keys[i] != id) i = (i + 1) & (m->cap - 1);
+    if (m->keys[i] == 0) m->size++;
+    m->keys[i] = id;
+    m->vals[i] = val;
+    return 0;
+}
+
+/* backward-shift deletion keeps probe chains intact without tombstones */
+void idmap_del(IdMap* m, int id) {
+    if (m->cap == 0 || id <= 0) return;
+    size_t mask = m->cap - 1;
+    size_t i = home(m, id);
+    while (m->keys[i] != id) {
+        if (m->keys[i] == 0) return;
+        i = (i + 1) & mask;
+    }
+    m->size--;
+    for (size_t j = (i + 1) & mask; m->keys[j] != 0; j = (j + 1) & mask) {
+        size_t h = home(m, m->keys[j]);
+        /* move j back into the hole unless its home lies in (i, j] */
+        if (((j - h) & mask) >= ((j - i) & mask)) {
+            m->keys[i] = m->keys[j];
+            m->vals[i] = m->vals[j];
+            i = j;
+        }
+    }
+    m->keys[i] = 0;
+}
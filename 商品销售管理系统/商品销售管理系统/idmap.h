@@ -0,0 +1,39 @@
+#pragma once
+#ifndef IDMAP_H
+#define IDMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Positive int id -> size_t value, open addressing with linear probing.
+     * Key 0 marks an empty slot, so ids <= 0 are never stored; lookups for
+     * them simply miss. Deletion shifts entries back instead of leaving
+     * tombstones, so probe chains stay short under churn.
+     */
+
+    typedef struct {
+        int32_t* keys;
+        size_t*  vals;
+        size_t   cap;   /* power of two, 0 before the first put */
+        size_t   size;
+    } IdMap;
+
+    void idmap_init(IdMap* m);
+    void idmap_free(IdMap* m);
+    void idmap_clear(IdMap* m);
+
+    /* value for id, -1 when absent */
+    long idmap_find(const IdMap* m, int id);
+    /* insert or overwrite; 0 ok, -1 out of memory or id <= 0 */
+    int  idmap_put(IdMap* m, int id, size_t val);
+    void idmap_del(IdMap* m, int id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
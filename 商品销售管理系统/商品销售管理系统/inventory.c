@@ -1,16 +1,49 @@
 #include "inventory.h"
+#include "metrics.h"
 
+static unsigned long stockVersion = 0;
+static StockListener stockListener = NULL;
+static void* stockListenerCtx = NULL;
 
+unsigned long inventory_stockVersion(void) {
+    return stockVersion;
+}
 
-int deductStock(Product* p, int qty) {
+void inventory_setStockListener(StockListener fn, void* ctx) {
+    stockListener = fn;
+    stockListenerCtx = ctx;
+}
+
+static int deductStockImpl(Product* p, int qty) {
     if (!p || qty <= 0) return -1;
     if (p->stock < qty) return -1;
     p->stock -= qty;
+    stockVersion++;
+    if (stockListener) stockListener(p, stockListenerCtx);
     return 0;
 }
 
-int increaseStock(Product* p, int qty) {
+static int increaseStockImpl(Product* p, int qty) {
     if (!p || qty <= 0) return -1;
     p->stock += qty;
+    stockVersion++;
+    if (stockListener) stockListener(p, stockListenerCtx);
     return 0;
+}
+
+int deductStock(Product* p, int qty) {
+    if (!METRICS_ON()) return deductStockImpl(p, qty);
+    uint64_t t0 = timeutil_nowNs();
+    int rc = deductStockImpl(p, qty);
+    metrics_record(MET_DEDUCT_STOCK, timeutil_nowNs() - t0);
+    if (rc != 0 && p && qty > 0) metrics_count(CTR_STOCK_INSUFFICIENT, 1);
+    return rc;
+}
+
+int increaseStock(Product* p, int qty) {
+    if (!METRICS_ON()) return increaseStockImpl(p, qty);
+    uint64_t t0 = timeutil_nowNs();
+    int rc = increaseStockImpl(p, qty);
+    metrics_record(MET_INCREASE_STOCK, timeutil_nowNs() - t0);
+    return rc;
 }
\ No newline at end of file
@@ -5,4 +5,11 @@
 
 int deductStock(Product* p, int qty);     // 成功返回0，库存不足返回-1
 int increaseStock(Product* p, int qty);   // 成功返回0
+
+// 每次库存变动递增，供按库存排序的缓存判断是否失效
+unsigned long inventory_stockVersion(void);
+
+// 库存变动回调：每次成功扣减/增加后调用（如记录到商品存储的脏数据中）；fn 为 NULL 时取消
+typedef void (*StockListener)(const Product* p, void* ctx);
+void inventory_setStockListener(StockListener fn, void* ctx);
 #endif
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "journal.h"
+#include "persist_queue.h"
+#include "compat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* small tables are never worth compacting */
+#define JOURNAL_COMPACT_SLACK 64
+
+void journal_init(Journal* j, const char* path, int target, size_t records) {
+    strncpy_s(j->path, sizeof(j->path), path, _TRUNCATE);
+    j->target = target;
+    j->records = records;
+}
+
+int journal_appendRecords(Journal* j, const char* recs, size_t len, size_t records) {
+    int rc;
+    if (j->target >= 0 && pq_isRunning()) {
+        rc = pq_append(j->target, recs, len);
+    }
+    else {
+        FILE* fp = fopen(j->path, "a");
+        if (!fp) return -1;
+        size_t ok = fwrite(recs, 1, len, fp);
+        rc = (fclose(fp) == 0 && ok == len) ? 0 : -1;
+    }
+    if (rc == 0) j->records += records;
+    return rc;
+}
+
+int journal_append(Journal* j, const char* rec, size_t len) {
+    return journal_appendRecords(j, rec, len, 1);
+}
+
+int journal_shouldCompact(const Journal* j, size_t live) {
+    return j->records >= 2 * live + JOURNAL_COMPACT_SLACK;
+}
+
+static int replace_now(const char* path, const char* data, size_t len) {
+    char tmp[JOURNAL_PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* fp = fopen(tmp, "wb");
+    if (!fp) return -1;
+    size_t ok = fwrite(data, 1, len, fp);
+    if (fclose(fp) != 0 || ok != len) {
+        remove(tmp);
+        return -1;
+    }
+#if defined(_WIN32)
+    remove(path);   /* rename does not replace on Windows */
+#endif
+    return rename(tmp, path) == 0 ? 0 : -1;
+}
+
+int journal_compact(Journal* j, char* snapshot, size_t len, size_t records) {
+    int rc;
+    if (j->target >= 0 && pq_isRunning()) {
+        rc = pq_replace(j->target, snapshot, len);
+    }
+    else {
+        rc = replace_now(j->path, snapshot, len);
+        free(snapshot);
+    }
+    if (rc == 0) j->records = records;
+    return rc;
+}
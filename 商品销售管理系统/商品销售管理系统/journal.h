@@ -0,0 +1,47 @@
+#pragma once
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Append-only change journal for a small text table (users.csv,
+     * reorder_levels.csv). Every mutation appends one record line whose
+     * replay on load gives the current table, so a change costs one append
+     * instead of a rewrite. Once superseded lines dominate, the owner hands
+     * in a snapshot of the live rows and the file is replaced in the
+     * background by the persistence writer (synchronously when it is not
+     * running).
+     */
+
+#define JOURNAL_PATH_MAX 260
+
+    typedef struct {
+        char   path[JOURNAL_PATH_MAX];
+        int    target;      /* persist-queue target, -1 = write synchronously */
+        size_t records;     /* record lines in the file */
+    } Journal;
+
+    /* records = lines replayed when the table was loaded */
+    void journal_init(Journal* j, const char* path, int target, size_t records);
+
+    /* rec is one complete line including '\n' */
+    int  journal_append(Journal* j, const char* rec, size_t len);
+    /* several complete lines in one write */
+    int  journal_appendRecords(Journal* j, const char* recs, size_t len, size_t records);
+
+    /* true once the file holds at least twice the live rows (plus slack) */
+    int  journal_shouldCompact(const Journal* j, size_t live);
+
+    /* replace the file with snapshot (records lines). Takes ownership of
+     * snapshot, which must come from malloc. */
+    int  journal_compact(Journal* j, char* snapshot, size_t len, size_t records);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
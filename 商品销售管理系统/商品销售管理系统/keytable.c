@@ -0,0 +1,41 @@
+#include "keytable.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define KEYTABLE_MIN_CAP 64
+
+void keytable_init(KeyTable* t, size_t rowSize) {
+    t->data = NULL;
+    t->size = 0;
+    t->capacity = 0;
+    t->rowSize = rowSize;
+    idmap_init(&t->indexOf);
+}
+
+void keytable_free(KeyTable* t) {
+    free(t->data);
+    idmap_free(&t->indexOf);
+    keytable_init(t, t->rowSize);
+}
+
+int keytable_row(KeyTable* t, int key, void** out) {
+    long i = idmap_find(&t->indexOf, key);
+    if (i >= 0) {
+        *out = (char*)t->data + (size_t)i * t->rowSize;
+        return 0;
+    }
+    if (key <= 0) return -1;
+    if (t->size >= t->capacity) {
+        size_t newCap = t->capacity == 0 ? KEYTABLE_MIN_CAP : t->capacity * 2;
+        void* nd = realloc(t->data, newCap * t->rowSize);
+        if (!nd) return -2;
+        t->data = nd;
+        t->capacity = newCap;
+    }
+    if (idmap_put(&t->indexOf, key, t->size) != 0) return -2;
+    char* r = (char*)t->data + t->size++ * t->rowSize;
+    memset(r, 0, t->rowSize);
+    memcpy(r, &key, sizeof(key));
+    *out = r;
+    return 0;
+}
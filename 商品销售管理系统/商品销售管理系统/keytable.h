@@ -0,0 +1,37 @@
+#pragma once
+#ifndef KEYTABLE_H
+#define KEYTABLE_H
+
+#include <stddef.h>
+#include "idmap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Rows keyed by a positive int (a product id, a yyyymm month), kept
+     * contiguous in insertion order with an IdMap from key to row. Every
+     * row type starts with its int key, which keytable_row() sets; the
+     * caller casts data to its row type.
+     */
+
+    typedef struct {
+        void*  data;      /* size rows of rowSize bytes */
+        size_t size;
+        size_t capacity;
+        size_t rowSize;
+        IdMap  indexOf;   /* key -> index in data */
+    } KeyTable;
+
+    void keytable_init(KeyTable* t, size_t rowSize);
+    void keytable_free(KeyTable* t);   /* empty again, same row size */
+
+    /* the row for key, appended zeroed when new. 0 ok, -1 for a key that
+     * cannot be stored (<= 0), -2 when out of memory */
+    int  keytable_row(KeyTable* t, int key, void** out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,844 @@
+#include "ledger.h"
+#include "metrics.h"
+#include "timeutil.h"
+#include "trace.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LEDGER_LINE_MAX    1024
+#define LEDGER_FIELDS_MAX  40                  /* an S line with 32 heads */
+#define LEDGER_BATCH_BYTES (32 * 1024)
+
+void ledger_init(StockLedger* l) {
+    memset(l, 0, sizeof(*l));
+    l->loadBase = LLONG_MIN;
+    idmap_init(&l->indexOf);
+    journal_init(&l->journal, "", -1, 0);
+    journal_init(&l->index, "", -1, 0);
+}
+
+void ledger_free(StockLedger* l) {
+    free(l->levels);
+    free(l->heads);
+    free(l->checkpoints);
+    idmap_free(&l->indexOf);
+    memset(l, 0, sizeof(*l));
+}
+
+/* ---------- in-memory levels ---------- */
+
+static LedgerLevel* level_find(const StockLedger* l, int productId) {
+    long idx = idmap_find(&l->indexOf, productId);
+    return idx < 0 ? NULL : &l->levels[idx];
+}
+
+static LedgerLevel* level_get(StockLedger* l, int productId) {
+    LedgerLevel* s = level_find(l, productId);
+    if (s) return s;
+    if (l->size >= l->capacity) {
+        size_t newCap = l->capacity == 0 ? 64 : l->capacity * 2;
+        LedgerLevel* nd = (LedgerLevel*)realloc(l->levels, newCap * sizeof(LedgerLevel));
+        if (!nd) return NULL;
+        l->levels = nd;
+        l->capacity = newCap;
+    }
+    if (idmap_put(&l->indexOf, productId, l->size) != 0) return NULL;
+    s = &l->levels[l->size++];
+    s->productId = productId;
+    s->stock = LEDGER_REMOVED;
+    s->since = 0;
+    s->chainFrom = 0;
+    s->count = 0;
+    s->heads = 0;
+    return s;
+}
+
+static int last_level(const LedgerLevel* s) {
+    return s ? s->stock : LEDGER_REMOVED;
+}
+
+/* sets a level taken at t and the delta from the previous one; NULL
+ * when out of memory */
+static LedgerLevel* apply_level(StockLedger* l, int productId, int stock, long long t, int* delta) {
+    LedgerLevel* s = level_get(l, productId);
+    if (!s) return NULL;
+    int prev = s->stock;
+    if (prev == LEDGER_REMOVED && stock != LEDGER_REMOVED) l->live++;
+    else if (prev != LEDGER_REMOVED && stock == LEDGER_REMOVED) l->live--;
+    if (delta) *delta = (stock == LEDGER_REMOVED ? 0 : stock) - (prev == LEDGER_REMOVED ? 0 : prev);
+    s->stock = stock;
+    s->since = t;
+    return s;
+}
+
+/* a checkpoint lists every live product, so whatever it leaves out is gone */
+static void clear_levels(StockLedger* l) {
+    idmap_clear(&l->indexOf);
+    l->size = 0;
+    l->live = 0;
+    l->headCount = 0;
+}
+
+/* ---------- chains ---------- */
+
+static uint32_t bit_length(uint32_t v) {
+    uint32_t n = 0;
+    for (; v; v >>= 1) n++;
+    return n;
+}
+
+/* heads set aside for a chain of count lines: bit_length(count) rounded
+ * up to a power of two, so a chain moves only a handful of times */
+static uint32_t head_slots(uint32_t count) {
+    uint32_t need = bit_length(count), slots = 1;
+    if (need == 0) return 0;
+    while (slots < need) slots <<= 1;
+    return slots;
+}
+
+/* slots at the end of the heads pool, from *at on; -1 when out of memory */
+static int heads_alloc(StockLedger* l, uint32_t slots, uint32_t* at) {
+    if (l->headCount + slots > l->headCap) {
+        size_t newCap = l->headCap == 0 ? 256 : l->headCap * 2;
+        while (newCap < l->headCount + slots) newCap *= 2;
+        if (newCap > UINT32_MAX) return -1;
+        uint64_t* nd = (uint64_t*)realloc(l->heads, newCap * sizeof(uint64_t));
+        if (!nd) return -1;
+        l->heads = nd;
+        l->headCap = newCap;
+    }
+    *at = (uint32_t)l->headCount;
+    l->headCount += slots;
+    return 0;
+}
+
+/* room for one more line in s's chain; -1 when out of memory */
+static int chain_reserve(StockLedger* l, LedgerLevel* s) {
+    if (s->count == UINT32_MAX) return -1;
+    uint32_t slots = head_slots(s->count + 1);
+    if (slots == head_slots(s->count)) return 0;
+    uint32_t at;
+    if (heads_alloc(l, slots, &at) != 0) return -1;
+    /* the old slots are left behind until the next load */
+    if (s->count > 0) memcpy(l->heads + at, l->heads + s->heads, bit_length(s->count) * sizeof(uint64_t));
+    s->heads = at;
+    return 0;
+}
+
+/* the line at offset becomes line count + 1 of the chain (reserved):
+ * the last of every 2^i dividing it */
+static void chain_link(StockLedger* l, LedgerLevel* s, uint64_t offset) {
+    uint32_t k = s->count + 1;
+    uint64_t* h = l->heads + s->heads;
+    for (uint32_t i = 0;; ++i) {
+        h[i] = offset;
+        if ((k >> i) & 1) break;
+    }
+    s->count = k;
+}
+
+/* the chain fields (k, then chainFrom or the links) of a line read back
+ * at offset: line k must follow the chain in memory, line 1 starts a new
+ * one; anything else, like a line without them, ends the chain */
+static void chain_load(StockLedger* l, LedgerLevel* s, const long long* f, int n, uint64_t offset) {
+    long long k = n >= 2 ? f[0] : 0;
+    if (k == 1) {
+        s->count = 0;
+        s->chainFrom = f[1];
+    }
+    else if (s->count == 0 || k != (long long)s->count + 1) {
+        s->count = 0;
+        return;
+    }
+    if (chain_reserve(l, s) != 0) {
+        s->count = 0;
+        return;
+    }
+    chain_link(l, s, offset);
+}
+
+/* the chain fields of an S line: chainFrom, count, bit_length(count) heads */
+static void chain_restore(StockLedger* l, LedgerLevel* s, const long long* f, int n) {
+    s->count = 0;
+    if (n < 3 || f[1] < 1 || f[1] > (long long)UINT32_MAX) return;
+    uint32_t count = (uint32_t)f[1];
+    if ((uint32_t)n != 2 + bit_length(count)) return;
+    uint32_t at;
+    if (heads_alloc(l, head_slots(count), &at) != 0) return;
+    for (uint32_t i = 0; i < bit_length(count); ++i) l->heads[at + i] = (uint64_t)f[2 + i];
+    s->heads = at;
+    s->chainFrom = f[0];
+    s->count = count;
+}
+
+static int add_checkpoint(StockLedger* l, long long t, uint64_t offset, unsigned long long movements) {
+    if (l->checkpointCount >= l->checkpointCap) {
+        size_t newCap = l->checkpointCap == 0 ? 16 : l->checkpointCap * 2;
+        LedgerCheckpoint* nd = (LedgerCheckpoint*)realloc(l->checkpoints, newCap * sizeof(LedgerCheckpoint));
+        if (!nd) return -1;
+        l->checkpoints = nd;
+        l->checkpointCap = newCap;
+    }
+    l->checkpoints[l->checkpointCount].time = t;
+    l->checkpoints[l->checkpointCount].offset = offset;
+    l->checkpoints[l->checkpointCount].movements = movements;
+    l->checkpointCount++;
+    return 0;
+}
+
+/* local midnight on the 1st of the month after t */
+static long long month_after(long long t) {
+    time_t tt = (time_t)t;
+    struct tm* lt = localtime(&tt);
+    if (!lt) return t + 86400;
+    struct tm m = *lt;
+    m.tm_mday = 1;
+    m.tm_mon += 1;
+    m.tm_hour = 0;
+    m.tm_min = 0;
+    m.tm_sec = 0;
+    m.tm_isdst = -1;
+    time_t r = mktime(&m);
+    return r == (time_t)-1 ? t + 86400 : (long long)r;
+}
+
+/* ---------- parsing ---------- */
+
+/* "<tag>" then up to max comma-separated integers; how many, 0 when the
+ * line has another tag, more fields or one that is not a number */
+static int parse_numbers(const char* line, const char* tag, long long* out, int max) {
+    size_t tl = strlen(tag);
+    if (strncmp(line, tag, tl) != 0) return 0;
+    const char* s = line + tl;
+    int n = 0;
+    while (*s == ',') {
+        if (n == max) return 0;
+        char* end;
+        out[n] = strtoll(++s, &end, 10);
+        if (end == s) return 0;
+        s = end;
+        n++;
+    }
+    return *s == '\n' || *s == '\r' || *s == '\0' ? n : 0;
+}
+
+/* "<tag>" then exactly count integers */
+static int parse_fields(const char* line, const char* tag, long long* out, int count) {
+    return parse_numbers(line, tag, out, count) == count;
+}
+
+/* "M,time,productId,delta,stock" and the chain fields, if any */
+static int parse_movement(const char* line, long long* f) {
+    int n = parse_numbers(line, "M", f, LEDGER_FIELDS_MAX);
+    return n >= 4 ? n : 0;
+}
+
+/* "R,time,productId" and the chain fields, if any */
+static int parse_removal(const char* line, long long* f) {
+    int n = parse_numbers(line, "R", f, LEDGER_FIELDS_MAX);
+    return n >= 2 ? n : 0;
+}
+
+static int fits_int(long long v) {
+    return v >= -0x7fffffffLL && v <= 0x7fffffffLL;
+}
+
+/* "S,productId,stock,since" and the chain fields, if any; in older
+ * files without since the checkpoint's own time stands in for it */
+static int parse_level(const char* line, long long cpTime, long long* f) {
+    int n = parse_numbers(line, "S", f, LEDGER_FIELDS_MAX);
+    if (n == 2) f[n++] = cpTime;
+    return n >= 3 && fits_int(f[0]) && fits_int(f[1]) ? n : 0;
+}
+
+static int seek_to(FILE* fp, uint64_t off) {
+#if defined(_MSC_VER)
+    return _fseeki64(fp, (long long)off, SEEK_SET);
+#else
+    return fseeko(fp, (off_t)off, SEEK_SET);
+#endif
+}
+
+static uint64_t file_size(FILE* fp) {
+#if defined(_MSC_VER)
+    long long n = _fseeki64(fp, 0, SEEK_END) == 0 ? _ftelli64(fp) : 0;
+#else
+    off_t n = fseeko(fp, 0, SEEK_END) == 0 ? ftello(fp) : 0;
+#endif
+    return n > 0 ? (uint64_t)n : 0;
+}
+
+static void index_path(const char* path, char* out, size_t cap) {
+    snprintf(out, cap, "%s" LEDGER_INDEX_SUFFIX, path);
+}
+
+/* ---------- load ---------- */
+
+/* the checkpoint index as far as it agrees with the ledger file: offsets
+ * ascend and stay inside it, and the last one is a CHECKPOINT line of
+ * the indexed time. Anything dropped marks the index for a rewrite. */
+static void load_index(StockLedger* l, FILE* fp) {
+    char path[JOURNAL_PATH_MAX + 8];
+    index_path(l->path, path, sizeof(path));
+    FILE* ip = fopen(path, "r");
+    if (!ip) {
+        l->indexStale = 1;
+        return;
+    }
+    uint64_t size = file_size(fp);
+    char line[LEDGER_LINE_MAX];
+    long long f[3];
+    while (fgets(line, sizeof(line), ip)) {
+        int ok = parse_fields(line, "C", f, 3) && f[1] >= 0 && (uint64_t)f[1] < size && f[2] >= 0;
+        if (ok && l->checkpointCount > 0) ok = (uint64_t)f[1] > l->checkpoints[l->checkpointCount - 1].offset;
+        if (!ok || add_checkpoint(l, f[0], (uint64_t)f[1], (unsigned long long)f[2]) != 0) {
+            l->indexStale = 1;
+            break;
+        }
+    }
+    fclose(ip);
+    while (l->checkpointCount > 0) {
+        const LedgerCheckpoint* cp = &l->checkpoints[l->checkpointCount - 1];
+        long long g[2];
+        if (seek_to(fp, cp->offset) == 0 && fgets(line, sizeof(line), fp) &&
+            parse_fields(line, "CHECKPOINT", g, 2) && g[0] == cp->time) break;
+        l->checkpointCount--;
+        l->indexStale = 1;
+    }
+}
+
+static int load_impl(StockLedger* l, const char* path) {
+    snprintf(l->path, sizeof(l->path), "%s", path);
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        l->indexStale = 1;   /* an index left without its ledger is void */
+        return -1;
+    }
+    load_index(l, fp);
+    /* the state is the last checkpoint plus what follows it */
+    uint64_t off = 0;
+    if (l->checkpointCount > 0) {
+        off = l->checkpoints[l->checkpointCount - 1].offset;
+        l->movements = l->checkpoints[l->checkpointCount - 1].movements;
+    }
+    if (seek_to(fp, off) != 0) {
+        fclose(fp);
+        return -1;
+    }
+    char line[LEDGER_LINE_MAX];
+    long long cpTime = 0;
+    int lines = 0;
+    long long f[LEDGER_FIELDS_MAX];
+    int n;
+    LedgerLevel* s;
+    while (fgets(line, sizeof(line), fp)) {
+        uint64_t lineOff = off;
+        off += strlen(line);
+        lines++;
+        if ((n = parse_movement(line, f)) && fits_int(f[1]) && fits_int(f[3])) {
+            s = apply_level(l, (int)f[1], (int)f[3], f[0], NULL);
+            if (s) chain_load(l, s, f + 4, n - 4, lineOff);
+            l->movements++;
+            l->sinceCheckpoint++;
+        }
+        else if ((n = parse_level(line, cpTime, f))) {
+            s = apply_level(l, (int)f[0], (int)f[1], f[2], NULL);
+            if (s) chain_restore(l, s, f + 3, n - 3);
+        }
+        else if (parse_fields(line, "CHECKPOINT", f, 2)) {
+            cpTime = f[0];
+            l->loadBase = cpTime;
+            clear_levels(l);
+            l->sinceCheckpoint = 0;
+            /* past the one loading started from: the index missed it */
+            if (l->checkpointCount == 0 || lineOff > l->checkpoints[l->checkpointCount - 1].offset) {
+                add_checkpoint(l, cpTime, lineOff, l->movements);
+                l->indexStale = 1;
+            }
+        }
+        else if ((n = parse_removal(line, f)) && fits_int(f[1])) {
+            s = apply_level(l, (int)f[1], LEDGER_REMOVED, f[0], NULL);
+            if (s) chain_load(l, s, f + 2, n - 2, lineOff);
+        }
+    }
+    fclose(fp);
+    l->fileBytes = off;
+    if (l->checkpointCount > 0) {
+        l->nextMonthStart = month_after(l->checkpoints[l->checkpointCount - 1].time);
+    }
+    return lines;
+}
+
+int ledger_load(StockLedger* l, const char* path) {
+    TRACE_BEGIN("ledger_load");
+    int rc;
+    if (!METRICS_ON()) {
+        rc = load_impl(l, path);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        rc = load_impl(l, path);
+        metrics_record(MET_LOAD_LEDGER, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+    return rc;
+}
+
+static int format_index_entry(const LedgerCheckpoint* cp, char* buf, size_t cap) {
+    return snprintf(buf, cap, "C,%lld,%llu,%llu\n", cp->time, (unsigned long long)cp->offset, cp->movements);
+}
+
+static int write_index(StockLedger* l) {
+    size_t cap = l->checkpointCount * LEDGER_LINE_MAX + 1;
+    char* buf = (char*)malloc(cap);
+    if (!buf) return -1;
+    size_t len = 0;
+    for (size_t i = 0; i < l->checkpointCount; ++i) {
+        len += (size_t)format_index_entry(&l->checkpoints[i], buf + len, cap - len);
+    }
+    return journal_compact(&l->index, buf, len, l->checkpointCount);
+}
+
+void ledger_attach(StockLedger* l, const char* path, int target, int indexTarget) {
+    char ipath[JOURNAL_PATH_MAX + 8];
+    snprintf(l->path, sizeof(l->path), "%s", path);
+    index_path(path, ipath, sizeof(ipath));
+    journal_init(&l->journal, path, target, 0);
+    journal_init(&l->index, ipath, indexTarget, l->checkpointCount);
+    if (l->indexStale && write_index(l) == 0) l->indexStale = 0;
+}
+
+/* ---------- writing ---------- */
+
+static int append(StockLedger* l, const char* data, size_t len, size_t records) {
+    if (journal_appendRecords(&l->journal, data, len, records) != 0) return -1;
+    l->fileBytes += len;
+    return 0;
+}
+
+/* every live level with its chain, as the ledger knows it */
+static int write_checkpoint(StockLedger* l, long long now) {
+    size_t cap = 48;
+    for (size_t i = 0; i < l->size; ++i) {
+        if (l->levels[i].stock != LEDGER_REMOVED) cap += 96 + 21 * (size_t)bit_length(l->levels[i].count);
+    }
+    char* buf = (char*)malloc(cap);
+    if (!buf) return -1;
+    size_t len = (size_t)snprintf(buf, cap, "CHECKPOINT,%lld,%zu\n", now, l->live);
+    for (size_t i = 0; i < l->size; ++i) {
+        const LedgerLevel* s = &l->levels[i];
+        if (s->stock == LEDGER_REMOVED) continue;
+        len += (size_t)snprintf(buf + len, cap - len, "S,%d,%d,%lld", s->productId, s->stock, s->since);
+        if (s->count > 0) {
+            len += (size_t)snprintf(buf + len, cap - len, ",%lld,%u", s->chainFrom, s->count);
+            for (uint32_t h = 0; h < bit_length(s->count); ++h) {
+                len += (size_t)snprintf(buf + len, cap - len, ",%llu", (unsigned long long)l->heads[s->heads + h]);
+            }
+        }
+        buf[len++] = '\n';
+    }
+    uint64_t offset = l->fileBytes;
+    int rc = append(l, buf, len, l->live + 1);
+    free(buf);
+    if (rc != 0) return -1;
+    /* an index entry that is lost is found again by the next load */
+    if (add_checkpoint(l, now, offset, l->movements) == 0) {
+        char line[LEDGER_LINE_MAX];
+        int n = format_index_entry(&l->checkpoints[l->checkpointCount - 1], line, sizeof(line));
+        journal_append(&l->index, line, (size_t)n);
+    }
+    l->sinceCheckpoint = 0;
+    l->nextMonthStart = month_after(now);
+    return 0;
+}
+
+/* sets the product's level to stock at now and formats the line that
+ * records it (M, or R for a removal) into buf, at least LEDGER_LINE_MAX
+ * bytes, as the next line of its chain, to be written at offset. Its
+ * length, -1 when out of memory. Without room for the chain the line
+ * has no chain fields and the chain starts over at the next change. */
+static int format_change(StockLedger* l, int productId, int stock, long long now, uint64_t offset, char* buf) {
+    LedgerLevel* s = level_find(l, productId);
+    /* a product memory does not know was absent since the load */
+    long long chainFrom = s ? now : l->loadBase;
+    int delta;
+    s = apply_level(l, productId, stock, now, &delta);
+    if (!s) return -1;
+    int len = stock == LEDGER_REMOVED
+        ? snprintf(buf, LEDGER_LINE_MAX, "R,%lld,%d", now, productId)
+        : snprintf(buf, LEDGER_LINE_MAX, "M,%lld,%d,%d,%d", now, productId, delta, stock);
+    if (chain_reserve(l, s) != 0) {
+        s->count = 0;
+    }
+    else {
+        uint32_t k = s->count + 1;
+        len += snprintf(buf + len, LEDGER_LINE_MAX - (size_t)len, ",%u", k);
+        if (k == 1) {
+            s->chainFrom = chainFrom;
+            len += snprintf(buf + len, LEDGER_LINE_MAX - (size_t)len, ",%lld", chainFrom);
+        }
+        /* line k - 2^i for every 2^i dividing k */
+        for (uint32_t i = 0; k > (1u << i); ++i) {
+            len += snprintf(buf + len, LEDGER_LINE_MAX - (size_t)len, ",%llu",
+                (unsigned long long)l->heads[s->heads + i]);
+            if ((k >> i) & 1) break;
+        }
+        chain_link(l, s, offset);
+    }
+    buf[len++] = '\n';
+    return len;
+}
+
+typedef struct {
+    char*  data;      /* LEDGER_BATCH_BYTES */
+    size_t len;
+    size_t lines;
+} LedgerBatch;
+
+/* one change into the batch, which is written out first when full */
+static int batch_change(StockLedger* l, LedgerBatch* b, int productId, int stock, long long now) {
+    if (b->len + LEDGER_LINE_MAX > LEDGER_BATCH_BYTES) {
+        if (append(l, b->data, b->len, b->lines) != 0) return -1;
+        b->len = 0;
+        b->lines = 0;
+    }
+    int n = format_change(l, productId, stock, now, l->fileBytes + b->len, b->data + b->len);
+    if (n < 0) return -1;
+    b->len += (size_t)n;
+    b->lines++;
+    return 0;
+}
+
+size_t ledger_reconcile(StockLedger* l, ProductList* products, long long now) {
+    /* on first use every product differs: a few large appends */
+    LedgerBatch b = { (char*)malloc(LEDGER_BATCH_BYTES), 0, 0 };
+    if (!b.data) return 0;
+    size_t differ = 0;
+    size_t matchedLive = 0;
+    size_t liveBefore = l->live;
+    int ok = 1;
+    for (size_t i = 0; ok && i < products->size; ++i) {
+        const Product* p = &products->data[i];
+        int level = last_level(level_find(l, p->id));
+        if (level != LEDGER_REMOVED) matchedLive++;
+        if (level == p->stock) continue;
+        ok = batch_change(l, &b, p->id, p->stock, now) == 0;
+        if (ok) {
+            l->movements++;
+            differ++;
+        }
+    }
+    if (ok && matchedLive < liveBefore) {
+        /* products the ledger has but the catalog lost */
+        for (size_t i = 0; ok && i < l->size; ++i) {
+            const LedgerLevel* s = &l->levels[i];
+            if (s->stock == LEDGER_REMOVED || findProductById(products, s->productId)) continue;
+            ok = batch_change(l, &b, s->productId, LEDGER_REMOVED, now) == 0;
+            if (ok) differ++;
+        }
+    }
+    if (b.len > 0) append(l, b.data, b.len, b.lines);
+    free(b.data);
+    if (differ > 0) write_checkpoint(l, now);
+    return differ;
+}
+
+int ledger_note(StockLedger* l, int productId, int stock, long long now) {
+    if (last_level(level_find(l, productId)) == stock) return 0;
+    /* the first movement of a month starts from a checkpoint of the month before */
+    if (now >= l->nextMonthStart && write_checkpoint(l, now) != 0) return -1;
+    char line[LEDGER_LINE_MAX];
+    int len = format_change(l, productId, stock, now, l->fileBytes, line);
+    if (len < 0 || append(l, line, (size_t)len, 1) != 0) return -1;
+    l->movements++;
+    size_t every = l->live > LEDGER_CHECKPOINT_MIN ? l->live : LEDGER_CHECKPOINT_MIN;
+    if (++l->sinceCheckpoint >= every) return write_checkpoint(l, now);
+    return 0;
+}
+
+int ledger_noteRemoved(StockLedger* l, int productId, long long now) {
+    if (last_level(level_find(l, productId)) == LEDGER_REMOVED) return 0;
+    char line[LEDGER_LINE_MAX];
+    int len = format_change(l, productId, LEDGER_REMOVED, now, l->fileBytes, line);
+    if (len < 0) return -1;
+    return append(l, line, (size_t)len, 1);
+}
+
+/* ---------- queries ---------- */
+
+/* offset of the last checkpoint at or before t, 0 when there is none */
+static uint64_t checkpoint_before(const StockLedger* l, long long t) {
+    size_t lo = 0, hi = l->checkpointCount;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (l->checkpoints[mid].time <= t) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo > 0 ? l->checkpoints[lo - 1].offset : 0;
+}
+
+/* one product's level at t, read from the last checkpoint at or before t */
+static int stock_from_file(const StockLedger* l, int productId, long long t, int* stock, long long* since) {
+    FILE* fp = fopen(l->path, "rb");
+    if (!fp) return -1;
+    if (seek_to(fp, checkpoint_before(l, t)) != 0) {
+        fclose(fp);
+        return -1;
+    }
+    char line[LEDGER_LINE_MAX];
+    long long f[LEDGER_FIELDS_MAX];
+    long long cpTime = 0, when = 0;
+    int found = 0, level = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (parse_movement(line, f)) {
+            if (f[0] > t) break;
+            if (f[1] != productId) continue;
+            level = (int)f[3];
+            when = f[0];
+            found = 1;
+        }
+        else if (parse_level(line, cpTime, f)) {
+            if (f[0] != productId) continue;
+            level = (int)f[1];
+            when = f[2];
+            found = 1;
+        }
+        else if (parse_removal(line, f)) {
+            if (f[0] > t) break;
+            if (f[1] == productId) found = 0;
+        }
+        else if (parse_fields(line, "CHECKPOINT", f, 2)) {
+            if (f[0] > t) break;
+            cpTime = f[0];
+            found = 0;
+        }
+    }
+    fclose(fp);
+    if (found) {
+        *stock = level;
+        if (since) *since = when;
+    }
+    return found;
+}
+
+typedef struct {
+    long long time;
+    int       stock;      /* LEDGER_REMOVED for an R line */
+    uint32_t  k;
+    int       links;
+    uint64_t  link[32];   /* offset of line k - 2^i */
+} ChainLine;
+
+/* line k of the product's chain at offset: 0, -1 on I/O error, -2 when
+ * the file holds something else there */
+static int read_chain_line(FILE* fp, uint64_t offset, int productId, uint32_t k, ChainLine* c) {
+    char line[LEDGER_LINE_MAX];
+    long long f[LEDGER_FIELDS_MAX];
+    if (seek_to(fp, offset) != 0) return -1;
+    if (!fgets(line, sizeof(line), fp)) return ferror(fp) ? -1 : -2;
+    int n, fixed;
+    if ((n = parse_movement(line, f))) {
+        fixed = 4;
+        c->stock = (int)f[3];
+    }
+    else if ((n = parse_removal(line, f))) {
+        fixed = 2;
+        c->stock = LEDGER_REMOVED;
+    }
+    else {
+        return -2;
+    }
+    if (f[1] != productId || n <= fixed || f[fixed] != (long long)k) return -2;
+    c->time = f[0];
+    c->k = k;
+    c->links = k == 1 ? 0 : n - fixed - 1;
+    if (c->links > 32) return -2;
+    for (int i = 0; i < c->links; ++i) c->link[i] = (uint64_t)f[fixed + 1 + i];
+    return 0;
+}
+
+/* the last line of the chain at or before t, for chainFrom <= t < since.
+ * Down the lines whose k is count with its low bits cleared (the heads)
+ * to the first one at or before t, which leaves a gap of 2^j lines below
+ * the one before it; that line links to the middle of the gap, and so
+ * on: about 2 log2(count) lines read. Returns as ledger_stockAt, -2 when
+ * the chain does not match the file. */
+static int stock_from_chain(const StockLedger* l, const LedgerLevel* s, long long t, int* stock, long long* since) {
+    FILE* fp = fopen(l->path, "rb");
+    if (!fp) return -1;
+    const uint64_t* h = l->heads + s->heads;
+    ChainLine upper, probe;
+    int haveLower = 0, level = -1;
+    int lowStock = LEDGER_REMOVED;   /* of the last line known at or before t */
+    long long lowTime = 0;
+    uint32_t k = s->count;
+    int rc = read_chain_line(fp, h[0], s->productId, k, &upper);
+    if (rc == 0 && upper.time <= t) {
+        lowStock = upper.stock;
+        lowTime = upper.time;
+        haveLower = 1;
+    }
+    while (rc == 0 && !haveLower) {
+        int j = 0;
+        while (!((k >> j) & 1)) j++;
+        level = j - 1;
+        uint32_t below = k - (1u << j);
+        if (below == 0) break;   /* the product had no line yet at t */
+        rc = read_chain_line(fp, h[j + 1], s->productId, below, &probe);
+        if (rc != 0) break;
+        if (probe.time <= t) {
+            lowStock = probe.stock;
+            lowTime = probe.time;
+            haveLower = 1;
+        }
+        else {
+            upper = probe;
+            k = below;
+        }
+    }
+    for (; rc == 0 && level >= 0; --level) {
+        if (level >= upper.links) {
+            rc = -2;
+            break;
+        }
+        rc = read_chain_line(fp, upper.link[level], s->productId, upper.k - (1u << level), &probe);
+        if (rc != 0) break;
+        if (probe.time <= t) {
+            lowStock = probe.stock;
+            lowTime = probe.time;
+            haveLower = 1;
+        }
+        else {
+            upper = probe;
+        }
+    }
+    fclose(fp);
+    if (rc != 0) return rc;
+    if (!haveLower || lowStock == LEDGER_REMOVED) return 0;
+    *stock = lowStock;
+    if (since) *since = lowTime;
+    return 1;
+}
+
+int ledger_stockAt(const StockLedger* l, int productId, long long t, int* stock, long long* since) {
+    const LedgerLevel* s = level_find(l, productId);
+    /* a product memory does not know was absent since the load */
+    if (!s) return t >= l->loadBase ? 0 : stock_from_file(l, productId, t, stock, since);
+    if (t < s->since) {
+        if (s->count > 0 && t >= s->chainFrom) {
+            int rc = stock_from_chain(l, s, t, stock, since);
+            if (rc != -2) return rc;
+        }
+        return stock_from_file(l, productId, t, stock, since);
+    }
+    if (s->stock == LEDGER_REMOVED) return 0;
+    *stock = s->stock;
+    if (since) *since = s->since;
+    return 1;
+}
+
+typedef struct {
+    int productId;
+    int stock;
+} LevelRow;
+
+typedef struct {
+    LevelRow* data;
+    size_t    size;
+    size_t    capacity;
+    IdMap     indexOf;
+} LevelTable;
+
+static int level_set(LevelTable* t, int productId, int stock) {
+    long idx = idmap_find(&t->indexOf, productId);
+    if (idx >= 0) {
+        t->data[idx].stock = stock;
+        return 0;
+    }
+    if (t->size >= t->capacity) {
+        size_t newCap = t->capacity == 0 ? 1024 : t->capacity * 2;
+        LevelRow* nd = (LevelRow*)realloc(t->data, newCap * sizeof(LevelRow));
+        if (!nd) return -1;
+        t->data = nd;
+        t->capacity = newCap;
+    }
+    if (idmap_put(&t->indexOf, productId, t->size) != 0) return -1;
+    t->data[t->size].productId = productId;
+    t->data[t->size].stock = stock;
+    t->size++;
+    return 0;
+}
+
+static long catalog_impl(const StockLedger* l, long long t, const char* outPath, long long* units) {
+    uint64_t start = checkpoint_before(l, t);
+    FILE* fp = fopen(l->path, "rb");
+    if (!fp) return -1;
+    if (seek_to(fp, start) != 0) {
+        fclose(fp);
+        return -1;
+    }
+    LevelTable levels;
+    memset(&levels, 0, sizeof(levels));
+    idmap_init(&levels.indexOf);
+    char line[LEDGER_LINE_MAX];
+    long long f[LEDGER_FIELDS_MAX];
+    long long cpTime = 0;
+    int ok = 1;
+    while (ok && fgets(line, sizeof(line), fp)) {
+        if (parse_movement(line, f)) {
+            if (f[0] > t) break;
+            ok = level_set(&levels, (int)f[1], (int)f[3]) == 0;
+        }
+        else if (parse_level(line, cpTime, f)) {
+            ok = level_set(&levels, (int)f[0], (int)f[1]) == 0;
+        }
+        else if (parse_removal(line, f)) {
+            if (f[0] > t) break;
+            ok = level_set(&levels, (int)f[1], LEDGER_REMOVED) == 0;
+        }
+        else if (parse_fields(line, "CHECKPOINT", f, 2)) {
+            if (f[0] > t) break;
+            /* every live product follows: what it leaves out is gone */
+            cpTime = f[0];
+            for (size_t i = 0; i < levels.size; ++i) levels.data[i].stock = LEDGER_REMOVED;
+        }
+    }
+    fclose(fp);
+
+    long written = -1;
+    FILE* out = ok ? fopen(outPath, "w") : NULL;
+    if (out) {
+        long long total = 0;
+        written = 0;
+        fprintf(out, "#productId,stock\n");
+        for (size_t i = 0; i < levels.size; ++i) {
+            if (levels.data[i].stock == LEDGER_REMOVED) continue;
+            fprintf(out, "%d,%d\n", levels.data[i].productId, levels.data[i].stock);
+            total += levels.data[i].stock;
+            written++;
+        }
+        if (fclose(out) != 0) written = -1;
+        if (units) *units = total;
+    }
+    free(levels.data);
+    idmap_free(&levels.indexOf);
+    return written;
+}
+
+long ledger_catalogAt(const StockLedger* l, long long t, const char* outPath, long long* units) {
+    TRACE_BEGIN("ledger_catalogAt");
+    long rc;
+    if (!METRICS_ON()) {
+        rc = catalog_impl(l, t, outPath, units);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        rc = catalog_impl(l, t, outPath, units);
+        metrics_record(MET_REPORT_STOCK_AS_OF, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+    return rc;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#ifndef LEDGER_H
+#define LEDGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "idmap.h"
+#include "journal.h"
+#include "product.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Stock movement ledger with point-in-time queries.
+     *
+     * Every stock level change (sales, cancellations, receipts, manual
+     * edits, new and deleted products, and the corrections a reconcile
+     * makes) is appended to one log:
+     *   M,time,productId,delta,stockAfter,k,links   movement
+     *   R,time,productId,k,links                    product deleted
+     *   CHECKPOINT,time,count                       followed by count lines of
+     *   S,productId,stock,since,chainFrom,count,heads   every live product
+     * A checkpoint is written when the ledger first sees the catalog (or
+     * finds it changed behind its back), at the first movement of each
+     * month, and after as many movements as there are live products, so
+     * checkpoints never cost more than the movements they summarise.
+     *
+     * The M and R lines of one product form its chain: line k carries the
+     * offsets of lines k - 2^i for every 2^i dividing k, and line 1 the
+     * time chainFrom from which the chain holds the product's whole
+     * history. heads[i] is the offset of the last line whose k is a
+     * multiple of 2^i, which is all a new line needs to link itself; S
+     * lines carry them so that a load starts from the checkpoint. Older
+     * files have lines without k, links or since; a product's chain then
+     * starts at its next change.
+     *
+     * <path>.idx indexes the checkpoints, one line each:
+     *   C,time,offset,movements               movements = those before it
+     * Loading reads the last indexed checkpoint and the movements
+     * after it; the file before it is never replayed. Without a usable
+     * index the whole file is read once and the index rewritten on attach.
+     *
+     * In memory each product keeps its current level, when it took it and
+     * its chain heads. A query at or after that time is answered from
+     * memory; an older one from chainFrom on is a binary search down the
+     * chain, about 2 log2(k) single-line reads. Anything older, or a chain
+     * that does not match the file, reads the file from the last
+     * checkpoint at or before t up to t.
+     */
+
+#define LEDGER_CHECKPOINT_MIN 4096   /* movements between count-based checkpoints */
+#define LEDGER_INDEX_SUFFIX   ".idx"
+
+#define LEDGER_REMOVED (-0x7fffffff - 1)
+
+    typedef struct {
+        int       productId;
+        int       stock;      /* LEDGER_REMOVED after a delete */
+        long long since;      /* time of the last change */
+        long long chainFrom;  /* the chain answers for times from here on */
+        uint32_t  count;      /* lines in the chain, 0 = none yet */
+        uint32_t  heads;      /* its heads in StockLedger.heads */
+    } LedgerLevel;
+
+    typedef struct {
+        long long          time;
+        uint64_t           offset;     /* of the CHECKPOINT line */
+        unsigned long long movements;  /* before it */
+    } LedgerCheckpoint;
+
+    typedef struct {
+        LedgerLevel*      levels;
+        size_t            size;
+        size_t            capacity;
+        IdMap             indexOf;          /* productId -> index in levels */
+        size_t            live;             /* levels that are not removed */
+        uint64_t*         heads;            /* chain heads of every level */
+        size_t            headCount;
+        size_t            headCap;
+        long long         loadBase;         /* memory knows every product from here on */
+
+        LedgerCheckpoint* checkpoints;
+        size_t            checkpointCount;
+        size_t            checkpointCap;
+        size_t            sinceCheckpoint;  /* movements */
+        long long         nextMonthStart;   /* first movement at or after this checkpoints */
+
+        char              path[JOURNAL_PATH_MAX];
+        Journal           journal;
+        Journal           index;
+        int               indexStale;       /* rewrite the index on attach */
+        uint64_t          fileBytes;
+        unsigned long long movements;
+    } StockLedger;
+
+    void ledger_init(StockLedger* l);
+    void ledger_free(StockLedger* l);
+
+    /* reads the last checkpoint and what follows it; lines read, -1 if
+     * the file cannot be opened */
+    int  ledger_load(StockLedger* l, const char* path);
+    /* appends go through persist-queue targets (-1 = synchronous writes),
+     * one for the ledger and one for its index */
+    void ledger_attach(StockLedger* l, const char* path, int target, int indexTarget);
+    /* writes a checkpoint when any product's level differs from the
+     * ledger's (first use, or files edited elsewhere); returns the products
+     * that differed */
+    size_t ledger_reconcile(StockLedger* l, ProductList* products, long long now);
+
+    /* records the product's new level if it changed; 0 ok, -1 on error */
+    int  ledger_note(StockLedger* l, int productId, int stock, long long now);
+    int  ledger_noteRemoved(StockLedger* l, int productId, long long now);
+
+    /* 1 when the product existed at t: *stock is its level then and
+     * *since (may be NULL) when it took that level; 0 otherwise, -1 on
+     * I/O error. Reads the ledger file for a t before the product's last
+     * change, so flush queued appends first. */
+    int  ledger_stockAt(const StockLedger* l, int productId, long long t, int* stock, long long* since);
+
+    /* every product's level at t as "productId,stock" lines into outPath.
+     * Reads the ledger file, so flush queued appends first. Returns the
+     * products written (*units their total), -1 on I/O error. */
+    long ledger_catalogAt(const StockLedger* l, long long t, const char* outPath, long long* units);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
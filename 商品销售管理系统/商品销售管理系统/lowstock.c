@@ -0,0 +1,185 @@
+#include "lowstock.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void on_level_changed(int productId, void* ctx) {
+    LowStockSet* s = (LowStockSet*)ctx;
+    Product* p = findProductById(s->products, productId);
+    if (p) lowstock_update(s, p);
+    else lowstock_remove(s, productId);
+}
+
+void lowstock_init(LowStockSet* s, ProductList* products, ReorderTable* levels, int defaultLevel) {
+    s->products = products;
+    s->levels = levels;
+    s->defaultLevel = defaultLevel;
+    s->ids = NULL;
+    s->size = 0;
+    s->capacity = 0;
+    idmap_init(&s->posOf);
+    s->hook = NULL;
+    s->hookCtx = NULL;
+    levels->onChange = on_level_changed;
+    levels->onChangeCtx = s;
+}
+
+void lowstock_free(LowStockSet* s) {
+    if (s->levels && s->levels->onChangeCtx == s) {
+        s->levels->onChange = NULL;
+        s->levels->onChangeCtx = NULL;
+    }
+    free(s->ids);
+    idmap_free(&s->posOf);
+    s->ids = NULL;
+    s->size = 0;
+    s->capacity = 0;
+}
+
+void lowstock_setHook(LowStockSet* s, LowStockHook fn, void* ctx) {
+    s->hook = fn;
+    s->hookCtx = ctx;
+}
+
+static int add_id(LowStockSet* s, int id) {
+    if (s->size >= s->capacity) {
+        size_t newCap = s->capacity == 0 ? 64 : s->capacity * 2;
+        int* nd = (int*)realloc(s->ids, newCap * sizeof(int));
+        if (!nd) return -1;
+        s->ids = nd;
+        s->capacity = newCap;
+    }
+    if (idmap_put(&s->posOf, id, s->size) != 0) return -1;
+    s->ids[s->size++] = id;
+    return 0;
+}
+
+/* swap the last id into the hole */
+static void remove_at(LowStockSet* s, size_t pos) {
+    idmap_del(&s->posOf, s->ids[pos]);
+    size_t last = s->size - 1;
+    if (pos != last) {
+        s->ids[pos] = s->ids[last];
+        idmap_put(&s->posOf, s->ids[pos], pos);   /* overwrite: cannot grow */
+    }
+    s->size--;
+}
+
+int lowstock_rebuild(LowStockSet* s) {
+    s->size = 0;
+    idmap_clear(&s->posOf);
+    size_t n = s->products->size;
+    if (n == 0) return 0;
+    size_t* idx = (size_t*)malloc(n * sizeof(size_t));
+    if (!idx) return -1;
+    size_t k = reorder_findLowStock(s->levels, s->products, s->defaultLevel, idx);
+    int rc = 0;
+    for (size_t i = 0; i < k; ++i) {
+        int id = s->products->data[idx[i]].id;
+        if (idmap_find(&s->posOf, id) >= 0) continue;   /* duplicate id in the catalog */
+        if (add_id(s, id) != 0) {
+            s->size = 0;
+            idmap_clear(&s->posOf);
+            rc = -1;
+            break;
+        }
+    }
+    free(idx);
+    return rc;
+}
+
+void lowstock_update(LowStockSet* s, const Product* p) {
+    if (!s->levels || !p) return;
+    int level = reorder_getLevel(s->levels, p->id, s->defaultLevel);
+    int low = p->stock < level;
+    long pos = idmap_find(&s->posOf, p->id);
+    if (low && pos < 0) {
+        if (add_id(s, p->id) != 0) return;
+        if (s->hook) s->hook(p, level, 1, s->hookCtx);
+    }
+    else if (!low && pos >= 0) {
+        remove_at(s, (size_t)pos);
+        if (s->hook) s->hook(p, level, 0, s->hookCtx);
+    }
+}
+
+void lowstock_remove(LowStockSet* s, int productId) {
+    long pos = idmap_find(&s->posOf, productId);
+    if (pos >= 0) remove_at(s, (size_t)pos);
+}
+
+size_t lowstock_count(const LowStockSet* s) {
+    return s->size;
+}
+
+int lowstock_contains(const LowStockSet* s, int productId) {
+    return idmap_find(&s->posOf, productId) >= 0;
+}
+
+static int cmp_int(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+/* alerted ids in ascending order (malloc'd), NULL when empty or out of memory */
+static int* sorted_ids(const LowStockSet* s) {
+    if (s->size == 0) return NULL;
+    int* ids = (int*)malloc(s->size * sizeof(int));
+    if (!ids) return NULL;
+    memcpy(ids, s->ids, s->size * sizeof(int));
+    qsort(ids, s->size, sizeof(int), cmp_int);
+    return ids;
+}
+
+static void print_alert_impl(LowStockSet* s) {
+    printf("\n=== Low Stock Alert ===\n");
+    printf("%-6s %-20s %-8s %-8s\n", "ID", "Name", "Stock", "Level");
+    int* ids = sorted_ids(s);
+    size_t shown = 0;
+    for (size_t i = 0; ids && i < s->size; ++i) {
+        const Product* p = findProductById(s->products, ids[i]);
+        if (!p) continue;
+        int lvl = reorder_getLevel(s->levels, p->id, s->defaultLevel);
+        printf("%-6d %-20s %-8d %-8d\n", p->id, productName(s->products, p), p->stock, lvl);
+        shown++;
+    }
+    if (shown == 0) printf("All stocks are above reorder levels.\n");
+    free(ids);
+}
+
+static void print_replenish_impl(LowStockSet* s) {
+    printf("\n=== Replenish Suggestion List ===\n");
+    printf("%-6s %-20s %-8s %-8s %-10s\n", "ID", "Name", "Stock", "Level", "Suggest");
+    int* ids = sorted_ids(s);
+    size_t shown = 0;
+    for (size_t i = 0; ids && i < s->size; ++i) {
+        const Product* p = findProductById(s->products, ids[i]);
+        if (!p) continue;
+        int lvl = reorder_getLevel(s->levels, p->id, s->defaultLevel);
+        printf("%-6d %-20s %-8d %-8d %-10d\n", p->id, productName(s->products, p), p->stock, lvl, lvl - p->stock);
+        shown++;
+    }
+    if (shown == 0) printf("No replenishment needed.\n");
+    free(ids);
+}
+
+void lowstock_printAlert(LowStockSet* s) {
+    if (!METRICS_ON()) {
+        print_alert_impl(s);
+        return;
+    }
+    uint64_t t0 = timeutil_nowNs();
+    print_alert_impl(s);
+    metrics_record(MET_REPORT_LOW_STOCK, timeutil_nowNs() - t0);
+}
+
+void lowstock_printReplenish(LowStockSet* s) {
+    if (!METRICS_ON()) {
+        print_replenish_impl(s);
+        return;
+    }
+    uint64_t t0 = timeutil_nowNs();
+    print_replenish_impl(s);
+    metrics_record(MET_REPORT_REPLENISH, timeutil_nowNs() - t0);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#ifndef LOWSTOCK_H
+#define LOWSTOCK_H
+
+#include <stddef.h>
+#include "product.h"
+#include "reorder.h"
+#include "idmap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Incrementally maintained set of products whose stock is below their
+     * reorder level.
+     *
+     * lowstock_rebuild() does one full scan (startup, after a reload); after
+     * that every change is applied as it happens: stock changes through
+     * lowstock_update() (wired to the inventory stock listener), level
+     * changes through the ReorderTable change callback installed by
+     * lowstock_init(), deletions through lowstock_remove(). The alert and
+     * replenish lists then cost O(alerted items), not O(catalog).
+     *
+     * The hook fires on every threshold crossing: becameLow = 1 when a
+     * product drops below its level, 0 when it recovers (or its level is
+     * lowered). It does not fire for the initial rebuild or removals.
+     */
+
+    typedef void (*LowStockHook)(const Product* p, int level, int becameLow, void* ctx);
+
+    typedef struct {
+        ProductList*  products;
+        ReorderTable* levels;
+        int           defaultLevel;
+        int*          ids;       /* alerted product ids, unordered */
+        size_t        size;
+        size_t        capacity;
+        IdMap         posOf;     /* id -> index in ids */
+        LowStockHook  hook;
+        void*         hookCtx;
+    } LowStockSet;
+
+    /* attaches to levels (replacing its change callback); call lowstock_rebuild next */
+    void   lowstock_init(LowStockSet* s, ProductList* products, ReorderTable* levels, int defaultLevel);
+    /* detaches from levels */
+    void   lowstock_free(LowStockSet* s);
+    /* 0 ok, -1 out of memory (the set is left empty) */
+    int    lowstock_rebuild(LowStockSet* s);
+
+    void   lowstock_update(LowStockSet* s, const Product* p);   /* stock, level or product changed */
+    void   lowstock_remove(LowStockSet* s, int productId);      /* product deleted */
+    void   lowstock_setHook(LowStockSet* s, LowStockHook fn, void* ctx);
+
+    size_t lowstock_count(const LowStockSet* s);
+    int    lowstock_contains(const LowStockSet* s, int productId);
+
+    /* menu reports, rows sorted by product id */
+    void   lowstock_printAlert(LowStockSet* s);
+    void   lowstock_printReplenish(LowStockSet* s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
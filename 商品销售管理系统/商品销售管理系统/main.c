@@ -2,6 +2,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#if !defined(_WIN32)
+#include <signal.h>
+#endif
 
 #include "product.h"
 #include "inventory.h"
@@ -13,15 +16,55 @@
 #include "report.h"     /* 你已添加报表 */
 #include "purchase.h"   /* 你已添加入库/进货 */
 #include "reorder.h"    /* NEW: 库存预警/补货清单 */
+#include "persist_queue.h"
+#include "metrics.h"
+#include "trace.h"
+#include "outbuf.h"
+#include "productstore.h"
+#include "journal.h"
+#include "lowstock.h"
+#include "valuation.h"
+#include "forecast.h"
+#include "partial.h"
+#include "replica.h"
+#include "snapshot.h"
+#include "receiving.h"
+#include "ledger.h"
+#include "margin.h"
+#include "basket.h"
+#include "seglog.h"
+#include "orderbin.h"
 
 #define PRODUCT_FILE  "products.csv"
 #define ORDER_FILE    "orders.log"
 #define USER_FILE     "users.csv"
 #define PURCHASE_FILE "purchase_log.csv"
+#define PURCHASE_TAIL_MAX 256   /* 内存中只保留最近的进货记录，完整历史按需从文件流式读取 */
+#define PURCHASE_ID_FILE "purchase_log.next"   /* 下一个进货编号，每次分配后追加一行 */
+
+/* 定长二进制商品存储：库存变动原位写入，启动时优先从这里加载 */
+#define PRODUCT_STORE_FILE "products.dat"
 
 /* NEW */
 #define REORDER_FILE "reorder_levels.csv"
 #define DEFAULT_REORDER_LEVEL 10
+#define VALUATION_FILE "valuation.csv"
+#define LEDGER_FILE "stock_ledger.log"
+
+/* 一致性快照导出目录前缀，后接时间戳 */
+#define SNAPSHOT_DIR_PREFIX "snapshot-"
+
+/* 退出时写出的性能指标 */
+#define METRICS_FILE "metrics.txt"
+
+/* 商品/订单列表每页行数 */
+#define LIST_PAGE_SIZE 20
+
+/* 名称搜索一次最多显示的结果数 */
+#define SEARCH_MAX_RESULTS 50
+
+/* 后台持久化队列容量（字节） */
+#define PERSIST_QUEUE_BYTES (1u << 20)
 
 /* -------- In-memory order list management -------- */
 typedef struct {
@@ -74,21 +117,75 @@ static Order* findOrderById(OrderList* olist, int id) {
     return NULL;
 }
 
-static void listAllOrders(const OrderList* olist) {
-    if (olist->size == 0) {
-        printf("No orders found.\n");
-        return;
+/* -------- Paged listing -------- */
+typedef size_t(*PageRenderFn)(void* ctx, size_t offset, size_t limit, OutBuf* out);
+
+/* 每页一次性写出；n/p 翻页，输入页码跳转，其它输入退出 */
+static void browsePages(const char* title, size_t total, PageRenderFn render, void* ctx) {
+    OutBuf out;
+    outbuf_init(&out, stdout, OUTBUF_DEFAULT_CAP);
+    size_t pages = (total + LIST_PAGE_SIZE - 1) / LIST_PAGE_SIZE;
+    size_t page = 0;
+    for (;;) {
+        size_t offset = page * LIST_PAGE_SIZE;
+        outbuf_printf(&out, "=== %s (page %zu/%zu, %zu rows) ===\n", title, page + 1, pages, total);
+        render(ctx, offset, LIST_PAGE_SIZE, &out);
+        outbuf_flush(&out);
+        if (pages <= 1) break;
+
+        char cmd[16];
+        readLine("[n]ext, [p]rev, page number, other = back: ", cmd, sizeof(cmd));
+        if (cmd[0] == 'n' || cmd[0] == 'N') {
+            if (page + 1 < pages) page++;
+        }
+        else if (cmd[0] == 'p' || cmd[0] == 'P') {
+            if (page > 0) page--;
+        }
+        else if (cmd[0] >= '1' && cmd[0] <= '9') {
+            size_t want = (size_t)strtoul(cmd, NULL, 10);
+            page = (want > pages ? pages : want) - 1;
+        }
+        else {
+            break;
+        }
     }
-    printf("=== Order List ===\n");
-    printf("%-6s %-10s %-12s %-10s\n", "ID", "Status", "ItemCount", "Total");
-    for (size_t i = 0; i < olist->size; ++i) {
-        const Order* o = &olist->data[i];
-        printf("%-6d %-10s %-12zu %-10.2f\n",
+    outbuf_free(&out);
+}
+
+typedef struct {
+    const OrderList* olist;
+    int newestFirst;
+} OrderPageCtx;
+
+static size_t renderOrderPage(void* ctx, size_t offset, size_t limit, OutBuf* out) {
+    const OrderPageCtx* c = (const OrderPageCtx*)ctx;
+    const OrderList* olist = c->olist;
+    outbuf_printf(out, "%-6s %-10s %-12s %-10s\n", "ID", "Status", "ItemCount", "Total");
+    if (offset >= olist->size) return 0;
+    size_t end = olist->size - offset < limit ? olist->size : offset + limit;
+    for (size_t i = offset; i < end; ++i) {
+        /* orders are appended with increasing ids */
+        const Order* o = &olist->data[c->newestFirst ? olist->size - 1 - i : i];
+        char total[MONEY_STR_MAX];
+        outbuf_printf(out, "%-6d %-10s %-12zu %-10s\n",
             o->orderId,
             orderStatusToStr(o->status),
             o->size,
-            o->totalAmount);
+            money_str(o->totalAmount, total));
     }
+    return end - offset;
+}
+
+typedef struct {
+    ProductList* list;
+    ProductSortKey key;
+    int descending;
+} ProductPageCtx;
+
+static size_t renderProductPage(void* ctx, size_t offset, size_t limit, OutBuf* out) {
+    ProductPageCtx* c = (ProductPageCtx*)ctx;
+    writeProductHeader(out);
+    return listProductsPage(c->list, c->key, c->descending, offset, limit, out);
 }
 
 /* -------- Globals -------- */
@@ -98,12 +195,153 @@ static OrderList   orders;
 static UserList    users;
 static User* currentUser = NULL;
 
-/* purchase */
+/* purchase：最近 PURCHASE_TAIL_MAX 条 */
 static PurchaseList purchases;
 static int nextPurchaseId = 1;
+static Journal purchaseIdJournal;
 
 /* NEW: reorder table */
 static ReorderTable reorderTable;
+/* 低于阈值的商品集合，随库存/阈值/商品变化增量维护 */
+static LowStockSet lowStock;
+
+/* async persistence targets (-1 = write synchronously) */
+static int orderLogTarget = -1;
+static int purchaseLogTarget = -1;
+
+/* users.csv / reorder_levels.csv 以追加日志方式持久化 */
+static Journal userJournal;
+static Journal reorderJournal;
+
+/* 加权平均成本：入库/付款时 O(1) 更新，每次变动追加到 valuation.csv */
+static Valuation valuation;
+static Journal valuationJournal;
+
+/* 库存变动台账：每次库存变化一条，定期整表检查点，支持按时间点查询 */
+static StockLedger ledger;
+
+/* 销售速度预测：启动时由 orders.log 一次扫描建立，付款时增量更新 */
+static Forecast forecast;
+
+/* 订单日志分段：orders.log 写满或跨度过长时封段改名，段清单供报表跳过无关段 */
+static SegmentLog orderLog;
+
+/* 后台快照导出，同一时间至多一个 */
+static SnapshotJob snapshotJob;
+
+/* products.dat (NULL = products.csv only) */
+static ProductStore* productStore = NULL;
+
+/* -------- Metrics dump (menu 22, SIGUSR1 on POSIX) -------- */
+#if !defined(_WIN32)
+static volatile sig_atomic_t metricsDumpRequested = 0;
+
+static void onMetricsSignal(int sig) {
+    (void)sig;
+    metricsDumpRequested = 1;
+}
+#endif
+
+static void handleDumpMetrics() {
+    seglog_countWriteErrors(&orderLog);
+    metrics_dump(stdout);
+    if (metrics_writeFile(METRICS_FILE) == 0) {
+        printf("Metrics written -> %s\n", METRICS_FILE);
+    }
+}
+
+/* -------- Log writers (async when the persistence thread is running) -------- */
+static int logOrder(const Order* o) {
+    return seglog_append(&orderLog, o);
+}
+
+static int logPurchase(const Purchase* rec) {
+    if (purchaseLogTarget < 0 || !pq_isRunning()) {
+        return appendPurchaseToCSV(PURCHASE_FILE, rec);
+    }
+    char line[128];
+    int len = formatPurchaseRecord(rec, line, sizeof(line));
+    if (len < 0 || (size_t)len >= sizeof(line)) return -2;
+    return pq_append(purchaseLogTarget, line, (size_t)len);
+}
+
+/* 排队中的写入落盘；有写失败时提示，读文件的结果可能缺记录。失败返回 -1 */
+static int flushLogs() {
+    if (pq_flush() == 0) return 0;
+    printf("Warning: some queued writes failed; the files on disk may be incomplete.\n");
+    return -1;
+}
+
+/* 分配过进货编号后记下下一个编号；排在进货记录之后写入，两者之间崩溃时由日志末尾补上 */
+static void persistNextPurchaseId() {
+    char rec[16];
+    int len = snprintf(rec, sizeof(rec), "%d\n", nextPurchaseId);
+    if (journal_append(&purchaseIdJournal, rec, (size_t)len) != 0) {
+        printf("Warning: failed to write %s.\n", PURCHASE_ID_FILE);
+    }
+    else if (journal_shouldCompact(&purchaseIdJournal, 1)) {
+        char* snap = (char*)malloc((size_t)len);
+        if (snap) {
+            memcpy(snap, rec, (size_t)len);
+            journal_compact(&purchaseIdJournal, snap, (size_t)len, 1);
+        }
+    }
+}
+
+/* 多条已格式化的进货记录，一次追加 */
+static int logPurchaseBlock(const char* data, size_t len) {
+    if (purchaseLogTarget >= 0 && pq_isRunning()) return pq_append(purchaseLogTarget, data, len);
+    FILE* fp = fopen(PURCHASE_FILE, "a");
+    if (!fp) return -1;
+    size_t ok = fwrite(data, 1, len, fp);
+    return (fclose(fp) == 0 && ok == len) ? 0 : -1;
+}
+
+/* -------- Product store: changes are noted as they happen, written after each operation -------- */
+static void onStockChanged(const Product* p, void* ctx) {
+    (void)ctx;
+    if (productStore) pstore_noteStock(productStore, p->id, p->stock);
+    lowstock_update(&lowStock, p);
+    ledger_note(&ledger, p->id, p->stock, (long long)time(NULL));
+}
+
+/* 新增/修改商品后：记入商品存储并重新判断是否低于阈值 */
+static void noteProductPut(const Product* p) {
+    if (!p) return;
+    pstore_notePut(productStore, p, productName(&products, p));
+    lowstock_update(&lowStock, p);
+    ledger_note(&ledger, p->id, p->stock, (long long)time(NULL));
+}
+
+/* 实时预警：库存跌破阈值时立即提示 */
+static void onLowStock(const Product* p, int level, int becameLow, void* ctx) {
+    (void)ctx;
+    if (becameLow) {
+        printf("[Reorder] %s (ID=%d) is below its reorder level: stock=%d level=%d\n",
+            productName(&products, p), p->id, p->stock, level);
+    }
+}
+
+static void persistProducts() {
+    if (productStore && pstore_flush(productStore, &products) < 0) {
+        printf("Warning: failed to update %s.\n", PRODUCT_STORE_FILE);
+    }
+}
+
+/* 成本变动追加到 valuation.csv，重复行过多时整表压缩 */
+static void journalCost(const CostEntry* e) {
+    if (!e) return;
+    char rec[160];
+    int len = valuation_formatRecord(e, rec, sizeof(rec));
+    if (len <= 0 || (size_t)len >= sizeof(rec) || journal_append(&valuationJournal, rec, (size_t)len) != 0) {
+        printf("Warning: failed to write %s.\n", VALUATION_FILE);
+    }
+    else if (journal_shouldCompact(&valuationJournal, valuation.size)) {
+        size_t snapLen = 0;
+        char* snap = valuation_formatSnapshot(&valuation, &snapLen);
+        if (snap) journal_compact(&valuationJournal, snap, snapLen, valuation.size);
+    }
+}
 
 /* -------- Auth check -------- */
 static int requireLogin() {
@@ -122,6 +360,7 @@ static void menu() {
     printf("2. Add product (login required)\n");
     printf("3. Modify product (login required)\n");
     printf("4. Delete product (login required)\n");
+    printf("23. Search products by name\n");
     printf("[Order]\n");
     printf("5. Create order (login required)\n");
     printf("6. List orders\n");
@@ -129,6 +368,8 @@ static void menu() {
     printf("8. Cancel order (login required)\n");
     printf("[Files]\n");
     printf("9. Save products to file\n");
+    printf("33. Order log segments\n");
+    printf("34. Archive order log segments before a date (login required)\n");
     printf("[User]\n");
     printf("10. Register\n");
     printf("11. Login\n");
@@ -140,12 +381,23 @@ static void menu() {
     printf("16. Inbound purchase (login required)\n");
     printf("17. List purchases\n");
     printf("18. Purchase summary by product\n");
+    printf("29. Bulk inbound from a shipment manifest (login required)\n");
+    printf("24. Inventory valuation and COGS\n");
+    printf("31. Gross margin by product and month\n");
 
     /* NEW: stock reorder */
     printf("\n[Stock]\n");
     printf("19. Low stock alert\n");
     printf("20. Replenish suggestion list\n");
     printf("21. Set reorder level for a product (login required)\n");
+    printf("25. Forecast replenishment by sales velocity\n");
+    printf("26. Apply forecast reorder levels (login required)\n");
+    printf("30. Stock as of a date\n");
+
+    printf("\n[Diagnostics]\n");
+    printf("22. Dump metrics\n");
+    printf("27. Export consistent snapshot in background (login required)\n");
+    printf("28. Snapshot export status\n");
 
     printf("0. Exit\n");
 }
@@ -166,7 +418,16 @@ static void handleRegister() {
     }
     User* u = registerUser(&users, uname, pwd);
     if (u) {
-        saveUsersToCSV(USER_FILE, &users);
+        char rec[128];
+        int len = formatUserRecord(u, rec, sizeof(rec));
+        if (len <= 0 || (size_t)len >= sizeof(rec) || journal_append(&userJournal, rec, (size_t)len) != 0) {
+            printf("Warning: failed to write %s.\n", USER_FILE);
+        }
+        else if (journal_shouldCompact(&userJournal, users.size)) {
+            size_t snapLen = 0;
+            char* snap = formatUsersSnapshot(&users, &snapLen);
+            if (snap) journal_compact(&userJournal, snap, snapLen, users.size);
+        }
         printf("Registration successful. UserID=%d\n", u->id);
     }
     else {
@@ -202,14 +463,30 @@ static void handleLogout() {
 }
 
 /* -------- Product handlers -------- */
+static void handleListProducts() {
+    if (products.size == 0) {
+        printf("No products.\n");
+        return;
+    }
+    int key = readInt("Sort by (1=ID 2=Name 3=Price 4=Stock, negative=descending): ");
+    ProductPageCtx ctx;
+    ctx.list = &products;
+    ctx.descending = key < 0;
+    if (key < 0) key = -key;
+    ctx.key = (key >= 1 && key <= PRODUCT_SORT_COUNT) ? (ProductSortKey)(key - 1) : PRODUCT_SORT_ID;
+    browsePages("Product List", products.size, renderProductPage, &ctx);
+}
+
 static void handleAddProduct() {
     if (!requireLogin()) return;
     char name[64];
     readLine("Product name: ", name, sizeof(name));
-    double price = readDouble("Product price: ");
+    Money price = readMoney("Product price: ");
     int stock = readInt("Initial stock: ");
     int id = addProduct(&products, name, price, stock);
     if (id > 0) {
+        noteProductPut(findProductById(&products, id));
+        persistProducts();
         printf("Added. ID=%d\n", id);
     }
     else {
@@ -225,17 +502,18 @@ static void handleModifyProduct() {
         printf("Product not found.\n");
         return;
     }
-    printf("Current: Name=%s Price=%.2f Stock=%d\n", p->name, p->price, p->stock);
+    char priceStr[MONEY_STR_MAX];
+    printf("Current: Name=%s Price=%s Stock=%d\n", productName(&products, p), money_str(p->price, priceStr), p->stock);
     char name[64];
     readLine("New name (leave empty to keep): ", name, sizeof(name));
-    double price;
+    Money price;
     char buf[64];
     printf("New price (negative to keep): ");
     if (!fgets(buf, sizeof(buf), stdin)) {
         printf("Input error.\n");
         return;
     }
-    price = atof(buf);
+    if (!money_parse(buf, &price)) price = -1;
     int stock;
     printf("New stock (negative to keep): ");
     if (!fgets(buf, sizeof(buf), stdin)) {
@@ -247,6 +525,8 @@ static void handleModifyProduct() {
         (*name ? name : NULL),
         price,
         stock) == 0) {
+        noteProductPut(p);
+        persistProducts();
         printf("Modify success.\n");
     }
     else {
@@ -280,6 +560,10 @@ static void handleDeleteProduct() {
         return;
     }
     if (deleteProduct(&products, id) == 0) {
+        pstore_noteRemove(productStore, id);
+        lowstock_remove(&lowStock, id);
+        ledger_noteRemoved(&ledger, id, (long long)time(NULL));
+        persistProducts();
         printf("Delete success.\n");
     }
     else {
@@ -287,6 +571,37 @@ static void handleDeleteProduct() {
     }
 }
 
+static void handleSearchProducts() {
+    char text[64];
+    readLine("Name to search: ", text, sizeof(text));
+    if (!*text) {
+        printf("Empty search text.\n");
+        return;
+    }
+    int mode = readInt("Match (1=exact, 2=prefix, 3=contains): ");
+    int ids[SEARCH_MAX_RESULTS];
+    size_t n;
+    switch (mode) {
+    case 1: n = findProductsByName(&products, text, ids, SEARCH_MAX_RESULTS); break;
+    case 2: n = findProductsByNamePrefix(&products, text, ids, SEARCH_MAX_RESULTS); break;
+    case 3: n = searchProductsByName(&products, text, ids, SEARCH_MAX_RESULTS); break;
+    default:
+        printf("Invalid match mode.\n");
+        return;
+    }
+    if (n == 0) {
+        printf("No matching products.\n");
+        return;
+    }
+    printf("%-5s %-20s %-10s %-10s\n", "ID", "Name", "Price", "Stock");
+    char price[MONEY_STR_MAX];
+    for (size_t i = 0; i < n; ++i) {
+        const Product* p = findProductById(&products, ids[i]);
+        if (p) printf("%-5d %-20s %-10s %-10d\n", p->id, productName(&products, p), money_str(p->price, price), p->stock);
+    }
+    if (n == SEARCH_MAX_RESULTS) printf("(showing the first %d matches)\n", SEARCH_MAX_RESULTS);
+}
+
 /* -------- Order handlers -------- */
 static void restoreStockOnCancel(Order* order) {
     for (size_t i = 0; i < order->size; ++i) {
@@ -310,7 +625,8 @@ static void handleCreateOrder() {
             printf("Product not found.\n");
             continue;
         }
-        printf("Product: %s Price: %.2f Stock: %d\n", p->name, p->price, p->stock);
+        char price[MONEY_STR_MAX];
+        printf("Product: %s Price: %s Stock: %d\n", productName(&products, p), money_str(p->price, price), p->stock);
         int qty = readInt("Quantity: ");
         if (qty <= 0) {
             printf("Invalid quantity.\n");
@@ -328,12 +644,23 @@ static void handleCreateOrder() {
         cancelOrder(o);
         restoreStockOnCancel(o);
     }
+    else {
+        METRICS_COUNT(CTR_ORDERS_CREATED);
+    }
     printOrder(o);
-    appendOrderToFile(ORDER_FILE, o);
+    logOrder(o);
+    persistProducts();
 }
 
 static void handleListOrders() {
-    listAllOrders(&orders);
+    if (orders.size == 0) {
+        printf("No orders found.\n");
+        return;
+    }
+    OrderPageCtx ctx;
+    ctx.olist = &orders;
+    ctx.newestFirst = readInt("Order (1=oldest first, 2=newest first): ") == 2;
+    browsePages("Order List", orders.size, renderOrderPage, &ctx);
     int detailId = readInt("Enter order ID to view details (0 to skip): ");
     if (detailId != 0) {
         Order* o = findOrderById(&orders, detailId);
@@ -358,8 +685,14 @@ static void handlePayOrder() {
         return;
     }
     markOrderPaid(o);
+    METRICS_COUNT(CTR_ORDERS_PAID);
+    /* 付款时结转销售成本，并计入销售速度 */
+    for (size_t i = 0; i < o->size; ++i) {
+        journalCost(valuation_sell(&valuation, o->items[i].productId, o->items[i].quantity, NULL));
+        forecast_recordSale(&forecast, o->items[i].productId, o->items[i].quantity, o->paidAt);
+    }
     printOrder(o);
-    appendOrderToFile(ORDER_FILE, o);
+    logOrder(o);
     printf("Payment simulated.\n");
 }
 
@@ -377,13 +710,16 @@ static void handleCancelOrder() {
     }
     cancelOrder(o);
     restoreStockOnCancel(o);
+    METRICS_COUNT(CTR_ORDERS_CANCELLED);
     printOrder(o);
-    appendOrderToFile(ORDER_FILE, o);
+    logOrder(o);
+    persistProducts();
     printf("Order cancelled and stock restored.\n");
 }
 
 /* -------- File save handler -------- */
 static void handleSaveProducts() {
+    persistProducts();
     if (saveProductsToCSV(PRODUCT_FILE, &products) == 0) {
         printf("Products saved -> %s\n", PRODUCT_FILE);
     }
@@ -409,17 +745,21 @@ static void handlePurchaseInbound() {
         return;
     }
 
-    double unitCost = readDouble("Unit cost: ");
+    Money unitCost = readMoney("Unit cost: ");
     if (unitCost < 0) {
         printf("Invalid unit cost.\n");
         return;
     }
 
     increaseStock(p, qty);
+    persistProducts();
 
     long long now = (long long)time(NULL);
     Purchase* rec = addPurchase(&purchases, nextPurchaseId++, productId, qty, unitCost, now);
-    if (appendPurchaseToCSV(PURCHASE_FILE, rec) == 0) {
+    journalCost(valuation_receive(&valuation, productId, qty, unitCost));
+    int logged = logPurchase(rec);
+    persistNextPurchaseId();
+    if (logged == 0) {
         printf("Inbound recorded. purchaseId=%d, stock now=%d\n", rec->purchaseId, p->stock);
     }
     else {
@@ -427,40 +767,494 @@ static void handlePurchaseInbound() {
     }
 }
 
+/* 按到货清单整批入库：先校验全部行，有错则整批拒收 */
+static void handleBulkInbound() {
+    if (!requireLogin()) return;
+    char path[260];
+    readLine("Manifest file (productId,quantity,unitCost per line): ", path, sizeof(path));
+    if (path[0] == '\0') return;
+
+    Manifest m;
+    manifest_init(&m);
+    int n = manifest_load(&m, path, &products);
+    if (n < 0) {
+        printf(n == -1 ? "Cannot open %s.\n" : "Out of memory reading %s.\n", path);
+    }
+    else if (m.errors > 0) {
+        printf("%zu problem(s) in %s, nothing received.\n", m.errors, path);
+    }
+    else if (n == 0) {
+        printf("%s has no lines to receive.\n", path);
+    }
+    else {
+        ReceiveResult r;
+        if (manifest_receive(&m, &products, &purchases, &valuation, nextPurchaseId,
+            (long long)time(NULL), &r) != 0) {
+            printf("Out of memory, nothing received.\n");
+        }
+        else {
+            nextPurchaseId = r.lastPurchaseId + 1;
+            persistProducts();
+            if (logPurchaseBlock(r.purchaseLog, r.purchaseLogLen) != 0) {
+                printf("Warning: failed to write %s.\n", PURCHASE_FILE);
+            }
+            persistNextPurchaseId();
+            if (journal_appendRecords(&valuationJournal, r.costLog, r.costLogLen, r.products) != 0) {
+                printf("Warning: failed to write %s.\n", VALUATION_FILE);
+            }
+            else if (journal_shouldCompact(&valuationJournal, valuation.size)) {
+                size_t snapLen = 0;
+                char* snap = valuation_formatSnapshot(&valuation, &snapLen);
+                if (snap) journal_compact(&valuationJournal, snap, snapLen, valuation.size);
+            }
+            char cost[MONEY_STR_MAX];
+            printf("Received %zu lines for %zu products: %lld units, cost %s. purchaseId %d-%d\n",
+                r.lines, r.products, r.units, money_str(r.cost, cost), r.firstPurchaseId, r.lastPurchaseId);
+            receive_freeResult(&r);
+        }
+    }
+    manifest_free(&m);
+}
+
 static void handleListPurchases() {
-    purchase_printLog(&purchases);
+    flushLogs();   /* 排队中的记录先落盘 */
+    if (purchase_printLogFile(PURCHASE_FILE) != 0) purchase_printLog(&purchases);
 }
 
 static void handlePurchaseSummary() {
-    purchase_printSummaryByProduct(&purchases);
+    valuation_printPurchaseSummary(&valuation);
+}
+
+/* 进货成本与销售收入按商品关联：各扫一遍日志，内存只与商品数、月份数相关 */
+static void handleMarginReport() {
+    flushLogs();
+    MarginReport m;
+    margin_init(&m);
+    int rc = margin_build(&m, PURCHASE_FILE, ORDER_FILE);
+    if (rc == -1) printf("%s not found, no sales.\n", ORDER_FILE);
+    else if (rc != 0) printf("Out of memory building the margin report.\n");
+    else margin_print(&m, &products, 10);
+    margin_free(&m);
+}
+
+/* 购物篮分析：按字节区间多线程扫描订单日志，先数单品支持度，再只对高频商品数商品对 */
+static void handleBasketReport() {
+    flushLogs();
+    BasketOptions opt;
+    memset(&opt, 0, sizeof(opt));
+    int minSupport = readInt("Minimum orders per pair (0 = auto): ");
+    opt.minSupport = minSupport > 0 ? (unsigned)minSupport : 0;
+    BasketReport r;
+    int rc = basket_build(&r, ORDER_FILE, &opt);
+    if (rc == -1) printf("%s not found, no sales.\n", ORDER_FILE);
+    else if (rc != 0) printf("Out of memory building the basket report.\n");
+    else basket_print(&r, &products, 20);
+    basket_free(&r);
+}
+
+static void handleValuation() {
+    valuation_printReport(&valuation, &products);
+}
+
+/* 读入 YYYY-MM-DD，给出当天本地时间的起止秒；格式不对时提示并返回 0 */
+static int readDay(const char* prompt, char* date, size_t cap, struct tm* day, time_t* start, time_t* end) {
+    readLine(prompt, date, cap);
+    struct tm tmv;
+    memset(&tmv, 0, sizeof(tmv));
+    if (sscanf(date, "%d-%d-%d", &tmv.tm_year, &tmv.tm_mon, &tmv.tm_mday) != 3) {
+        printf("Invalid date.\n");
+        return 0;
+    }
+    tmv.tm_year -= 1900;
+    tmv.tm_mon -= 1;
+    tmv.tm_isdst = -1;
+    *day = tmv;
+    *start = mktime(&tmv);
+    tmv = *day;
+    tmv.tm_hour = 23;
+    tmv.tm_min = 59;
+    tmv.tm_sec = 59;
+    *end = mktime(&tmv);
+    if (*start == (time_t)-1 || *end == (time_t)-1) {
+        printf("Invalid date.\n");
+        return 0;
+    }
+    return 1;
+}
+
+/* 某日结束时的库存：单个商品在最后一次变动之后的直接取内存，
+ * 更早的日期沿台账里该商品的变动链二分查找，全部商品仍从该日之前
+ * 最近的检查点顺序扫描台账 */
+static void handleStockAsOf() {
+    char date[32];
+    struct tm tmv;
+    time_t startOfDay, endOfDay;
+    if (!readDay("Date (YYYY-MM-DD): ", date, sizeof(date), &tmv, &startOfDay, &endOfDay)) return;
+
+    int id = readInt("Product ID (0 = whole catalog): ");
+    flushLogs();   /* 较早的日期要读台账文件 */
+    if (id != 0) {
+        int stock;
+        long long since;
+        int found = ledger_stockAt(&ledger, id, (long long)endOfDay, &stock, &since);
+        if (found < 0) {
+            printf("Cannot read %s.\n", LEDGER_FILE);
+            return;
+        }
+        if (!found) {
+            printf("Product %d was not in the catalog at the end of %s.\n", id, date);
+            return;
+        }
+        char when[32];
+        time_t sinceT = (time_t)since;
+        struct tm* lt = localtime(&sinceT);
+        if (!lt || strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", lt) == 0) snprintf(when, sizeof(when), "%lld", since);
+        printf("Stock of product %d at the end of %s: %d (since %s)\n", id, date, stock, when);
+        return;
+    }
+
+    char outPath[64];
+    snprintf(outPath, sizeof(outPath), "stock_asof_%04d%02d%02d.csv",
+        tmv.tm_year + 1900, tmv.tm_mon + 1, tmv.tm_mday);
+    long long units = 0;
+    long n = ledger_catalogAt(&ledger, (long long)endOfDay, outPath, &units);
+    if (n < 0) printf("Cannot read %s or write %s.\n", LEDGER_FILE, outPath);
+    else printf("%ld products, %lld units at the end of %s -> %s\n", n, units, date, outPath);
+}
+
+/* 按日期区间统计已付款订单：时间范围与区间不相交的已封段整段跳过 */
+static void handleSalesForPeriod() {
+    char fromDate[32], toDate[32];
+    struct tm day;
+    time_t from, to, unused;
+    if (!readDay("From (YYYY-MM-DD): ", fromDate, sizeof(fromDate), &day, &from, &unused)) return;
+    if (!readDay("To (YYYY-MM-DD): ", toDate, sizeof(toDate), &day, &unused, &to)) return;
+    flushLogs();
+    OrderLogReader r;
+    if (orderlog_openPeriod(&r, ORDER_FILE, (long long)from, (long long)to) != 0) {
+        printf("%s not found, no sales.\n", ORDER_FILE);
+        return;
+    }
+    size_t sealed = r.files.sealed, skipped = r.files.skipped;
+    long long paid = 0, units = 0;
+    Money revenue = 0;
+    OrderLogRecord rec;
+    while (orderlog_next(&r, &rec)) {
+        time_t when = rec.paidAt ? rec.paidAt : rec.createdAt;
+        if (rec.status != ORDER_PAID || when < from || when > to) continue;
+        paid++;
+        revenue += rec.total;
+        for (size_t i = 0; i < rec.itemCount; ++i) units += rec.items[i].quantity;
+    }
+    orderlog_close(&r);
+    char total[MONEY_STR_MAX], avg[MONEY_STR_MAX];
+    printf("\nPaid %s .. %s: %lld orders, %lld units, revenue %s, average order %s\n", fromDate, toDate,
+        paid, units, money_str(revenue, total), money_str(paid > 0 ? money_div(revenue, paid) : 0, avg));
+    printf("(read %zu of %zu sealed segments plus %s)\n", sealed - skipped, sealed, ORDER_FILE);
+}
+
+/* 归档：结束于该日之前的已封段移入 archive/，活动段不动 */
+static void handleArchiveSegments() {
+    if (!requireLogin()) return;
+    if (snapshotJob.state == SNAPSHOT_RUNNING && snapshot_poll(&snapshotJob) == SNAPSHOT_RUNNING) {
+        printf("A snapshot export is reading the segments; try again once it is done.\n");
+        return;
+    }
+    char date[32];
+    struct tm day;
+    time_t start, end;
+    if (!readDay("Archive segments that end before (YYYY-MM-DD): ", date, sizeof(date), &day, &start, &end)) return;
+    flushLogs();   /* 排队中的封段改名先完成 */
+    int moved = seglog_archive(&orderLog, (long long)start);
+    if (moved < 0) printf("Cannot create the %s directory.\n", SEGLOG_ARCHIVE_DIR);
+    else printf("%d segments moved to %s/.\n", moved, SEGLOG_ARCHIVE_DIR);
+}
+
+static void handleForecast() {
+    forecast_printReplenish(&forecast, &products, time(NULL));
+}
+
+/* 用预测阈值替换有销量商品的补货阈值，整表写回 reorder_levels.csv */
+static void handleApplyForecast() {
+    if (!requireLogin()) return;
+    size_t changed = forecast_applyLevels(&forecast, &products, &reorderTable, time(NULL));
+    if (changed == 0) {
+        printf("Reorder levels already match the forecast.\n");
+        return;
+    }
+    size_t snapLen = 0;
+    char* snap = reorder_formatSnapshot(&reorderTable, &snapLen);
+    if (!snap || journal_compact(&reorderJournal, snap, snapLen, reorderTable.size) != 0) {
+        printf("Warning: failed to write %s.\n", REORDER_FILE);
+    }
+    printf("%zu reorder levels updated from the forecast.\n", changed);
+}
+
+/* 子进程写出 fork 时刻的全部数据，主进程只停顿 fork 本身的时间 */
+static void handleSnapshotExport() {
+    if (!requireLogin()) return;
+    /* 日志先落盘，快照按当前长度截取；有写失败时不导出残缺的快照 */
+    if (flushLogs() != 0) {
+        printf("Snapshot export cancelled.\n");
+        return;
+    }
+    char dir[64];
+    time_t now = time(NULL);
+    struct tm* lt = localtime(&now);
+    if (!lt || strftime(dir, sizeof(dir), SNAPSHOT_DIR_PREFIX "%Y%m%d-%H%M%S", lt) == 0) {
+        snprintf(dir, sizeof(dir), SNAPSHOT_DIR_PREFIX "%lld", (long long)now);
+    }
+    SnapshotSource src = { &products, &users, &reorderTable, &valuation, ORDER_FILE, PURCHASE_FILE };
+    int rc = snapshot_start(&snapshotJob, &src, dir);
+    if (rc == -2) printf("A snapshot export is already running.\n");
+    else if (rc != 0) printf("Snapshot export to %s failed.\n", dir);
+    snapshot_printStatus(&snapshotJob);
+}
+
+/* -------- Multi-store reporting --------
+ * sales --partial <file>               本实例 orders.log + purchase_log.csv 的部分聚合
+ * sales --merge [-o <file>] <file>...  合并各实例的部分聚合并输出汇总报表
+ */
+static int runPartialExport(const char* outPath) {
+    SalesPartial part;
+    partial_init(&part);
+    int orc = partial_addOrderLog(&part, ORDER_FILE);
+    if (orc == -1) printf("%s not found, no sales.\n", ORDER_FILE);
+    int prc = orc == -2 ? 0 : partial_addPurchaseLog(&part, PURCHASE_FILE);
+    if (prc == -1) printf("%s not found, no purchases.\n", PURCHASE_FILE);
+    /* 缺行的部分聚合不写出，免得汇总时当作完整数据 */
+    if (orc == -2 || prc == -2) {
+        printf("Out of memory reading %s, nothing written.\n", orc == -2 ? ORDER_FILE : PURCHASE_FILE);
+        partial_free(&part);
+        return 1;
+    }
+    int rc = partial_write(&part, outPath);
+    if (rc == 0) {
+        printf("Partial aggregates written -> %s (%zu months, %zu products, %zu purchased products)\n",
+            outPath, part.months.size, part.products.size, part.purchases.size);
+    }
+    else {
+        printf("Cannot write %s\n", outPath);
+    }
+    partial_free(&part);
+    return rc == 0 ? 0 : 1;
+}
+
+static int runPartialMerge(int argc, char** argv) {
+    const char* outPath = NULL;
+    SalesPartial total;
+    partial_init(&total);
+    int inputs = 0;
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+            continue;
+        }
+        int keys = partial_read(&total, argv[i]);
+        if (keys == -3) {
+            printf("Out of memory merging %s, no report.\n", argv[i]);
+            partial_free(&total);
+            return 1;
+        }
+        if (keys < 0) {
+            printf("Skipping %s: %s\n", argv[i], keys == -1 ? "cannot open" : "not a partial aggregate file");
+            continue;
+        }
+        inputs++;
+    }
+    printf("Merged %d partial files.\n", inputs);
+
+    /* 有 products.csv 时显示商品名 */
+    ProductList names;
+    initProductList(&names);
+    int haveNames = loadProductsFromCSV(PRODUCT_FILE, &names) >= 0;
+    partial_printReport(&total, haveNames ? &names : NULL, 10);
+    freeProductList(&names);
+
+    int rc = 0;
+    if (outPath) {
+        if (partial_write(&total, outPath) == 0) printf("Merged aggregates written -> %s\n", outPath);
+        else {
+            printf("Cannot write %s\n", outPath);
+            rc = 1;
+        }
+    }
+    partial_free(&total);
+    return rc;
+}
+
+/* -------- Read replica --------
+ * sales --follow [dir] [--interval ms]
+ * 另一个进程（可在另一台机器上）跟踪 dir 下的 orders.log / purchase_log.csv，
+ * 报表在副本上计算，主进程除追加日志外没有额外工作
+ */
+#define REPLICA_DEFAULT_INTERVAL_MS 500
+#define REPLICA_EXPORT_FILE "replica.agg"
+
+static int runFollower(int argc, char** argv) {
+    const char* dir = ".";
+    unsigned intervalMs = REPLICA_DEFAULT_INTERVAL_MS;
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) intervalMs = (unsigned)atoi(argv[++i]);
+        else dir = argv[i];
+    }
+    char ordersPath[260], purchasesPath[260], productsPath[260];
+    snprintf(ordersPath, sizeof(ordersPath), "%s/%s", dir, ORDER_FILE);
+    snprintf(purchasesPath, sizeof(purchasesPath), "%s/%s", dir, PURCHASE_FILE);
+    snprintf(productsPath, sizeof(productsPath), "%s/%s", dir, PRODUCT_FILE);
+
+    Replica replica;
+    if (replica_init(&replica, ordersPath, purchasesPath) != 0) {
+        printf("Out of memory.\n");
+        return 1;
+    }
+    long applied = replica_poll(&replica);
+    printf("Replica caught up: %ld records from %s\n", applied, dir);
+    if (replica_start(&replica, intervalMs) != 0) {
+        printf("Background polling unavailable, logs are read when a report is requested.\n");
+    }
+
+    /* 商品名只用于显示，启动时读取一次 */
+    ProductList names;
+    initProductList(&names);
+    int haveNames = loadProductsFromCSV(productsPath, &names) >= 0;
+
+    while (1) {
+        printf("\n===== Read replica (%s) =====\n", dir);
+        printf("1. Sales reports (summary, monthly, top products, purchases)\n");
+        printf("2. Replication status\n");
+        printf("3. Export partial aggregates (%s)\n", REPLICA_EXPORT_FILE);
+        printf("0. Exit\n");
+        int choice = readInt("Select: ");
+        if (choice == 0) break;
+        switch (choice) {
+        case 1: replica_printReport(&replica, haveNames ? &names : NULL, 10); break;
+        case 2: replica_printStatus(&replica); break;
+        case 3:
+            if (replica_writePartial(&replica, REPLICA_EXPORT_FILE) == 0) printf("Aggregates written -> %s\n", REPLICA_EXPORT_FILE);
+            else printf("Cannot write %s\n", REPLICA_EXPORT_FILE);
+            break;
+        default: printf("Invalid option.\n");
+        }
+    }
+
+    replica_free(&replica);
+    freeProductList(&names);
+    return 0;
+}
+
+/* -------- Order log conversion --------
+ * sales --convert-log <in> <out> [binary|text]
+ * 在文本与二进制记录之间转换一个日志文件（只转换该文件本身，不含其他段），默认转为二进制
+ */
+static int runConvertLog(int argc, char** argv) {
+    const char* to = argc >= 3 ? argv[2] : "binary";
+    OrderLogFormat fmt;
+    if (strcmp(to, "binary") == 0) fmt = ORDER_LOG_BINARY;
+    else if (strcmp(to, "text") == 0) fmt = ORDER_LOG_TEXT;
+    else {
+        printf("Unknown format %s (binary or text).\n", to);
+        return 1;
+    }
+    if (strcmp(argv[0], argv[1]) == 0) {
+        printf("Write the converted log to another file.\n");
+        return 1;
+    }
+    OrderLogConvertStats st;
+    int rc = orderlog_convert(argv[0], argv[1], fmt, &st);
+    if (rc == -1) {
+        printf("Cannot open %s\n", argv[0]);
+        return 1;
+    }
+    if (rc == -2) {
+        printf("Cannot write %s\n", argv[1]);
+        return 1;
+    }
+    printf("%llu records converted to %s: %llu -> %llu bytes.\n", (unsigned long long)st.records, to,
+        (unsigned long long)st.bytesIn, (unsigned long long)st.bytesOut);
+    if (st.damaged > 0) printf("%llu damaged binary records skipped.\n", (unsigned long long)st.damaged);
+    return 0;
 }
 
 /* -------- Main -------- */
-int main() {
+int main(int argc, char** argv) {
+    if (argc >= 2 && strcmp(argv[1], "--follow") == 0) return runFollower(argc - 2, argv + 2);
+    if (argc >= 4 && strcmp(argv[1], "--convert-log") == 0) return runConvertLog(argc - 2, argv + 2);
+    if (argc >= 3 && strcmp(argv[1], "--partial") == 0) return runPartialExport(argv[2]);
+    if (argc >= 3 && strcmp(argv[1], "--merge") == 0) return runPartialMerge(argc - 2, argv + 2);
+
+    /* SALES_METRICS=0 turns instrumentation off at runtime */
+    const char* metricsEnv = getenv("SALES_METRICS");
+    if (metricsEnv && strcmp(metricsEnv, "0") == 0) metrics_setEnabled(0);
+    /* SALES_TRACE=<file> 记录 Chrome trace-event 格式的耗时分段，退出时写出 */
+    const char* traceEnv = getenv("SALES_TRACE");
+    if (traceEnv && *traceEnv && trace_start(traceEnv) == 0) {
+        printf("Tracing enabled -> %s\n", traceEnv);
+    }
+#if !defined(_WIN32)
+    signal(SIGUSR1, onMetricsSignal);
+#endif
+
     initProductList(&products);
     initOrderList(&orders);
     initUserList(&users);
 
     initPurchaseList(&purchases);
+    purchase_setLimit(&purchases, PURCHASE_TAIL_MAX);
+    valuation_init(&valuation);
+    forecast_init(&forecast);
     reorder_init(&reorderTable);
+    ledger_init(&ledger);
 
-    int loadedProd = loadProductsFromCSV(PRODUCT_FILE, &products);
-    if (loadedProd >= 0) printf("Loaded %d products.\n", loadedProd);
-    else printf("Product file not found. Starting with empty list.\n");
+    TRACE_BEGIN("startup");
+    /* SALES_PRODUCT_STORE=0 只使用 products.csv */
+    const char* storeEnv = getenv("SALES_PRODUCT_STORE");
+    if (!storeEnv || strcmp(storeEnv, "0") != 0) productStore = pstore_open(PRODUCT_STORE_FILE);
+    int loadedProd = productStore ? pstore_load(productStore, &products) : -1;
+    if (loadedProd > 0) {
+        printf("Loaded %d products from %s.\n", loadedProd, PRODUCT_STORE_FILE);
+    }
+    else {
+        if (loadedProd == -1) {
+            freeProductList(&products);
+            initProductList(&products);
+        }
+        loadedProd = loadProductsFromCSV(PRODUCT_FILE, &products);
+        if (loadedProd >= 0) printf("Loaded %d products.\n", loadedProd);
+        else printf("Product file not found. Starting with empty list.\n");
+        /* 首次使用或格式版本不符时整体写出一次 */
+        if (productStore && pstore_rewrite(productStore, &products) != 0) {
+            printf("Cannot write %s, stock changes are saved on exit only.\n", PRODUCT_STORE_FILE);
+            pstore_close(productStore);
+            productStore = NULL;
+        }
+    }
 
     int loadedUsers = loadUsersFromCSV(USER_FILE, &users);
     if (loadedUsers >= 0) printf("Loaded %d users.\n", loadedUsers);
     else printf("User file not found. Starting with empty user list.\n");
 
-    int loadedPurch = loadPurchasesFromCSV(PURCHASE_FILE, &purchases);
-    if (loadedPurch >= 0) {
-        printf("Loaded %d purchases.\n", loadedPurch);
-        nextPurchaseId = purchase_nextIdFromList(&purchases);
-    }
-    else {
-        printf("Purchase file not found. Starting with empty purchase log.\n");
-        nextPurchaseId = 1;
+    int lastPurchaseId = 0;
+    int loadedPurch = purchase_loadTail(PURCHASE_FILE, &purchases, PURCHASE_TAIL_MAX, &lastPurchaseId);
+    if (loadedPurch >= 0) printf("Loaded %d recent purchases.\n", loadedPurch);
+    else printf("Purchase file not found. Starting with empty purchase log.\n");
+    /* 编号以计数文件为准，不因日志截断或压缩而重复；计数落后于日志末尾时取后者。
+     * 计数文件不存在（首次启用）时整份日志扫描一次最大编号 */
+    size_t purchaseIdRecords = 0;
+    int storedNextId = purchase_loadNextId(PURCHASE_ID_FILE, &purchaseIdRecords);
+    if (storedNextId < 0 && loadedPurch > 0) {
+        int maxId = purchase_maxIdFromFile(PURCHASE_FILE);
+        if (maxId > lastPurchaseId) lastPurchaseId = maxId;
     }
+    nextPurchaseId = lastPurchaseId + 1;
+    if (storedNextId > nextPurchaseId) nextPurchaseId = storedNextId;
+
+    /* 首次启用时由现有进货记录建立成本，在库数量截到当前库存，之后只读 valuation.csv */
+    int loadedValuation = valuation_load(VALUATION_FILE, &valuation);
+    int seededPurchases = 0;
+    if (loadedValuation >= 0) printf("Loaded %d valuation records.\n", loadedValuation);
+    else if (loadedPurch > 0) seededPurchases = valuation_seedFromPurchaseLog(&valuation, PURCHASE_FILE, &products);
+    int seedValuation = seededPurchases > 0;
 
     int loadedReorder = reorder_loadCSV(REORDER_FILE, &reorderTable);
     if (loadedReorder >= 0) {
@@ -470,12 +1264,73 @@ int main() {
         printf("Reorder file not found. Using default reorder level=%d\n", DEFAULT_REORDER_LEVEL);
     }
 
+    /* 先读段清单并补完上次中断的封段，之后的日志读取才能看到完整的各段 */
+    seglog_init(&orderLog, ORDER_FILE);
+    /* SALES_ORDER_SEGMENT_BYTES / SALES_ORDER_SEGMENT_DAYS 调整封段界限，0 表示不按此封段 */
+    const char* segBytesEnv = getenv("SALES_ORDER_SEGMENT_BYTES");
+    if (segBytesEnv && *segBytesEnv) orderLog.maxBytes = strtoull(segBytesEnv, NULL, 10);
+    const char* segDaysEnv = getenv("SALES_ORDER_SEGMENT_DAYS");
+    if (segDaysEnv && *segDaysEnv) orderLog.maxAge = atoll(segDaysEnv) * 86400;
+    /* SALES_ORDER_LOG_FORMAT=binary 以带校验的二进制记录追加订单，已有的文本记录照常读取 */
+    const char* logFormatEnv = getenv("SALES_ORDER_LOG_FORMAT");
+    if (logFormatEnv && strcmp(logFormatEnv, "binary") == 0) orderLog.format = ORDER_LOG_BINARY;
+    int sealedSegments = seglog_load(&orderLog);
+    if (sealedSegments > 0) printf("Order log: %d earlier segments.\n", sealedSegments);
+    else if (sealedSegments < 0) printf("Warning: cannot read the order log manifest (out of memory).\n");
+
+    int forecastOrders = forecast_loadOrderLog(&forecast, ORDER_FILE);
+    if (forecastOrders > 0) printf("Sales velocity built from %d paid orders.\n", forecastOrders);
+
+    int loadedLedger = ledger_load(&ledger, LEDGER_FILE);
+    if (loadedLedger > 0) printf("Stock ledger: %llu movements.\n", ledger.movements);
+
+    lowstock_init(&lowStock, &products, &reorderTable, DEFAULT_REORDER_LEVEL);
+    if (lowstock_rebuild(&lowStock) != 0) printf("Warning: low stock tracking unavailable (out of memory).\n");
+    lowstock_setHook(&lowStock, onLowStock, NULL);
+    inventory_setStockListener(onStockChanged, NULL);
+    TRACE_END();
+
+    orderLogTarget = pq_registerFile(ORDER_FILE);
+    seglog_attach(&orderLog, orderLogTarget, pq_registerFile(orderLog.manifest.path));
+    purchaseLogTarget = pq_registerFile(PURCHASE_FILE);
+    journal_init(&userJournal, USER_FILE, pq_registerFile(USER_FILE),
+        loadedUsers > 0 ? (size_t)loadedUsers : 0);
+    journal_init(&reorderJournal, REORDER_FILE, pq_registerFile(REORDER_FILE),
+        loadedReorder > 0 ? (size_t)loadedReorder : 0);
+    journal_init(&valuationJournal, VALUATION_FILE, pq_registerFile(VALUATION_FILE),
+        loadedValuation > 0 ? (size_t)loadedValuation : 0);
+    ledger_attach(&ledger, LEDGER_FILE, pq_registerFile(LEDGER_FILE),
+        pq_registerFile(LEDGER_FILE LEDGER_INDEX_SUFFIX));
+    journal_init(&purchaseIdJournal, PURCHASE_ID_FILE, pq_registerFile(PURCHASE_ID_FILE), purchaseIdRecords);
+    if (storedNextId != nextPurchaseId) persistNextPurchaseId();
+    /* 首次启用或商品文件在别处被修改时，记一次整表检查点作为基线 */
+    size_t ledgerDrift = ledger_reconcile(&ledger, &products, (long long)time(NULL));
+    if (ledgerDrift > 0 && loadedLedger > 0) printf("Stock ledger: %zu products re-based.\n", ledgerDrift);
+    if (seedValuation) {
+        size_t snapLen = 0;
+        char* snap = valuation_formatSnapshot(&valuation, &snapLen);
+        if (snap) journal_compact(&valuationJournal, snap, snapLen, valuation.size);
+        printf("Valuation initialised from %d purchases.\n", seededPurchases);
+    }
+    if (pq_start(PERSIST_QUEUE_BYTES, PQ_FULL_BLOCK) != 0) {
+        printf("Background persistence unavailable, writing logs synchronously.\n");
+    }
+
     int choice;
     while (1) {
+#if !defined(_WIN32)
+        if (metricsDumpRequested) {
+            metricsDumpRequested = 0;
+            handleDumpMetrics();
+        }
+#endif
+        if (snapshotJob.state == SNAPSHOT_RUNNING && snapshot_poll(&snapshotJob) != SNAPSHOT_RUNNING) {
+            snapshot_printStatus(&snapshotJob);
+        }
         menu();
         choice = readInt("Select: ");
         switch (choice) {
-        case 1: listProducts(&products); break;
+        case 1: handleListProducts(); break;
         case 2: handleAddProduct(); break;
         case 3: handleModifyProduct(); break;
         case 4: handleDeleteProduct(); break;
@@ -488,26 +1343,41 @@ int main() {
         case 11: handleLogin(); break;
         case 12: handleLogout(); break;
 
-        case 13: report_salesSummaryFromLog(ORDER_FILE); break;
-        case 14: report_monthlySalesFromLog(ORDER_FILE); break;
-        case 15: report_topProductsFromLog(ORDER_FILE, PRODUCT_FILE, 10); break;
+        case 13: flushLogs(); report_salesSummaryFromLog(ORDER_FILE); break;
+        case 14: flushLogs(); report_monthlySalesFromLog(ORDER_FILE); break;
+        case 15: flushLogs(); report_topProductsFromLog(ORDER_FILE, PRODUCT_FILE, 10); break;
 
         case 16: handlePurchaseInbound(); break;
+        case 29: handleBulkInbound(); break;
         case 17: handleListPurchases(); break;
         case 18: handlePurchaseSummary(); break;
 
             /* NEW: reorder */
         case 19:
-            reorder_printLowStock(&products, &reorderTable, DEFAULT_REORDER_LEVEL);
+            lowstock_printAlert(&lowStock);
             break;
         case 20:
-            reorder_printReplenishList(&products, &reorderTable, DEFAULT_REORDER_LEVEL);
+            lowstock_printReplenish(&lowStock);
             break;
         case 21:
             if (!requireLogin()) break;
-            reorder_interactiveSetLevel(REORDER_FILE, &reorderTable, &products, DEFAULT_REORDER_LEVEL);
+            reorder_interactiveSetLevel(&reorderJournal, &reorderTable, &products, DEFAULT_REORDER_LEVEL);
             break;
 
+        case 22: handleDumpMetrics(); break;
+        case 23: handleSearchProducts(); break;
+        case 24: handleValuation(); break;
+        case 31: handleMarginReport(); break;
+        case 32: handleBasketReport(); break;
+        case 33: seglog_print(&orderLog); break;
+        case 34: handleArchiveSegments(); break;
+        case 35: handleSalesForPeriod(); break;
+        case 25: handleForecast(); break;
+        case 26: handleApplyForecast(); break;
+        case 30: handleStockAsOf(); break;
+        case 27: handleSnapshotExport(); break;
+        case 28: snapshot_poll(&snapshotJob); snapshot_printStatus(&snapshotJob); break;
+
         case 0:
             goto EXIT;
         default:
@@ -516,20 +1386,38 @@ int main() {
     }
 
 EXIT:
+    /* 先落盘所有排队中的日志记录 */
+    flushLogs();
+    pq_stop();
+    if (snapshotJob.state == SNAPSHOT_RUNNING) {
+        printf("Waiting for the snapshot export to finish...\n");
+        snapshot_wait(&snapshotJob);
+        snapshot_printStatus(&snapshotJob);
+    }
+
     /* 保存并释放 */
+    persistProducts();
+    inventory_setStockListener(NULL, NULL);
+    pstore_close(productStore);
+    productStore = NULL;
     if (saveProductsToCSV(PRODUCT_FILE, &products) == 0)
         printf("Products saved on exit.\n");
-    if (saveUsersToCSV(USER_FILE, &users) == 0)
-        printf("Users saved on exit.\n");
+    /* users.csv 与 reorder_levels.csv 已在每次修改时追加写入，无需整表重写 */
 
-    /* 可选：退出时保存一次阈值表（即使没改也无所谓） */
-    reorder_saveCSV(REORDER_FILE, &reorderTable);
+    seglog_countWriteErrors(&orderLog);
+    if (METRICS_ON()) metrics_writeFile(METRICS_FILE);
+    if (TRACE_ON()) trace_stop();
 
     freeProductList(&products);
     freeOrderList(&orders);
     freeUserList(&users);
 
     freePurchaseList(&purchases);
+    valuation_free(&valuation);
+    forecast_free(&forecast);
+    ledger_free(&ledger);
+    seglog_free(&orderLog);
+    lowstock_free(&lowStock);
     reorder_free(&reorderTable);
 
     return 0;
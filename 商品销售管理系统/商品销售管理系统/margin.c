@@ -0,0 +1,210 @@
+#include "margin.h"
+#include "orderlog.h"
+#include "purchase.h"
+#include "outbuf.h"
+#include "metrics.h"
+#include "timeutil.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void margin_init(MarginReport* m) {
+    memset(m, 0, sizeof(*m));
+    keytable_init(&m->products, sizeof(MarginProduct));
+    keytable_init(&m->months, sizeof(MarginMonth));
+    timeutil_monthCacheInit(&m->monthCache);
+}
+
+void margin_free(MarginReport* m) {
+    keytable_free(&m->products);
+    keytable_free(&m->months);
+    margin_init(m);
+}
+
+/* same codes as keytable_row; *out is NULL unless it returns 0 */
+static int product_row(MarginReport* m, int productId, MarginProduct** out) {
+    void* row = NULL;
+    int rc = keytable_row(&m->products, productId, &row);
+    *out = (MarginProduct*)row;
+    return rc;
+}
+
+static int month_row(MarginReport* m, int month, MarginMonth** out) {
+    void* row = NULL;
+    int rc = keytable_row(&m->months, month, &row);
+    *out = (MarginMonth*)row;
+    return rc;
+}
+
+/* probe side: one paid order, each line costed at its product's average.
+ * An order without a time (or a line without a valid product) still
+ * counts in the totals, just in no month (or product) row; only running
+ * out of memory fails. */
+static int add_paid_order(MarginReport* m, const OrderLogRecord* rec) {
+    time_t when = rec->paidAt ? rec->paidAt : rec->createdAt;
+    MarginMonth* mon = NULL;
+    if (when > 0 && month_row(m, timeutil_monthKey(&m->monthCache, when), &mon) == -2) return -2;
+    m->paidOrders++;
+    for (size_t i = 0; i < rec->itemCount; ++i) {
+        const OrderItem* it = &rec->items[i];
+        MarginProduct* p = NULL;
+        if (product_row(m, it->productId, &p) == -2) return -2;
+        Money cost = 0;
+        int costed = p && p->purchasedUnits > 0;
+        if (costed) cost = money_div(money_mul(p->purchaseCost, it->quantity), p->purchasedUnits);
+        if (p) {
+            p->soldUnits += it->quantity;
+            p->revenue += it->lineTotal;
+            p->cogs += cost;
+        }
+        if (mon) {
+            mon->units += it->quantity;
+            mon->revenue += it->lineTotal;
+            mon->cogs += cost;
+            if (!costed) mon->uncostedRevenue += it->lineTotal;
+        }
+        m->revenue += it->lineTotal;
+        m->cogs += cost;
+        if (!costed) m->uncostedRevenue += it->lineTotal;
+    }
+    return 0;
+}
+
+static int build_impl(MarginReport* m, const char* purchasePath, const char* orderPath) {
+    PurchaseReader pr;
+    if (purchase_openReader(&pr, purchasePath) == 0) {
+        Purchase rec;
+        while (purchase_next(&pr, &rec)) {
+            MarginProduct* p = NULL;
+            int prc = product_row(m, rec.productId, &p);
+            if (prc == -2) {
+                purchase_closeReader(&pr);
+                return -2;
+            }
+            if (prc != 0) continue;   /* no product to cost */
+            p->purchasedUnits += rec.quantity;
+            p->purchaseCost += money_mul(rec.unitCost, rec.quantity);
+            m->purchases++;
+        }
+        purchase_closeReader(&pr);
+    }
+
+    OrderLogReader r;
+    if (orderlog_open(&r, orderPath) != 0) return -1;
+    OrderLogRecord rec;
+    int rc = 0;
+    while (rc == 0 && orderlog_next(&r, &rec)) {
+        if (rec.status == ORDER_PAID) rc = add_paid_order(m, &rec);
+    }
+    orderlog_close(&r);
+    return rc;
+}
+
+int margin_build(MarginReport* m, const char* purchasePath, const char* orderPath) {
+    TRACE_BEGIN("margin_build");
+    int rc;
+    if (!METRICS_ON()) {
+        rc = build_impl(m, purchasePath, orderPath);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        rc = build_impl(m, purchasePath, orderPath);
+        metrics_record(MET_REPORT_MARGIN, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+    return rc;
+}
+
+/* ---------- report ---------- */
+
+static void format_pct(Money part, Money whole, char* buf, size_t cap) {
+    if (whole == 0) snprintf(buf, cap, "-");
+    else snprintf(buf, cap, "%.1f%%", 100.0 * (double)part / (double)whole);
+}
+
+static int cmp_month(const void* a, const void* b) {
+    const MarginMonth* x = (const MarginMonth*)a;
+    const MarginMonth* y = (const MarginMonth*)b;
+    return (x->month > y->month) - (x->month < y->month);
+}
+
+static int cmp_margin_desc(const void* a, const void* b) {
+    const MarginProduct* x = *(const MarginProduct* const*)a;
+    const MarginProduct* y = *(const MarginProduct* const*)b;
+    Money mx = x->revenue - x->cogs, my = y->revenue - y->cogs;
+    if (mx != my) return (mx < my) - (mx > my);
+    return (x->productId > y->productId) - (x->productId < y->productId);
+}
+
+static void print_product(OutBuf* out, const MarginProduct* p, ProductList* products) {
+    char rev[MONEY_STR_MAX], avg[MONEY_STR_MAX], cogs[MONEY_STR_MAX], mar[MONEY_STR_MAX], pct[16];
+    const Product* prod = products ? findProductById(products, p->productId) : NULL;
+    format_pct(p->revenue - p->cogs, p->revenue, pct, sizeof(pct));
+    outbuf_printf(out, "%-6d %-20s %-8lld %-12s %-10s %-12s %-12s %-8s\n", p->productId,
+        prod ? productName(products, prod) : "(unknown)", p->soldUnits, money_str(p->revenue, rev),
+        money_str(money_div(p->purchaseCost, p->purchasedUnits), avg), money_str(p->cogs, cogs),
+        money_str(p->revenue - p->cogs, mar), pct);
+}
+
+void margin_print(const MarginReport* m, ProductList* products, int topN) {
+    char a[MONEY_STR_MAX], b[MONEY_STR_MAX], c[MONEY_STR_MAX], pct[16];
+    OutBuf out;
+    outbuf_init(&out, stdout, OUTBUF_DEFAULT_CAP);
+    if (topN <= 0) topN = 10;
+
+    outbuf_printf(&out, "\n=== Gross Margin By Month (paid orders at average purchase cost) ===\n");
+    outbuf_printf(&out, "%-7s %-10s %-14s %-14s %-14s %-8s\n", "Month", "Units", "Revenue", "COGS", "Margin", "Margin%");
+    size_t monthCount = m->months.size;
+    MarginMonth* months = monthCount ? (MarginMonth*)malloc(monthCount * sizeof(MarginMonth)) : NULL;
+    if (months) {
+        memcpy(months, m->months.data, monthCount * sizeof(MarginMonth));
+        qsort(months, monthCount, sizeof(MarginMonth), cmp_month);
+        for (size_t i = 0; i < monthCount; ++i) {
+            const MarginMonth* mo = &months[i];
+            Money costed = mo->revenue - mo->uncostedRevenue;
+            format_pct(costed - mo->cogs, costed, pct, sizeof(pct));
+            outbuf_printf(&out, "%04d-%02d %-10lld %-14s %-14s %-14s %-8s\n", mo->month / 100, mo->month % 100,
+                mo->units, money_str(mo->revenue, a), money_str(mo->cogs, b),
+                money_str(costed - mo->cogs, c), pct);
+        }
+        free(months);
+    }
+    Money costed = m->revenue - m->uncostedRevenue;
+    format_pct(costed - m->cogs, costed, pct, sizeof(pct));
+    outbuf_printf(&out, "%-7s %-10s %-14s %-14s %-14s %-8s\n", "Total", "", money_str(m->revenue, a),
+        money_str(m->cogs, b), money_str(costed - m->cogs, c), pct);
+
+    /* costed products with sales, by margin */
+    size_t n = 0;
+    const MarginProduct** rows = m->products.size
+        ? (const MarginProduct**)malloc(m->products.size * sizeof(MarginProduct*)) : NULL;
+    size_t uncosted = 0;
+    for (size_t i = 0; rows && i < m->products.size; ++i) {
+        const MarginProduct* p = (const MarginProduct*)m->products.data + i;
+        if (p->soldUnits == 0) continue;
+        if (p->purchasedUnits <= 0) uncosted++;
+        else rows[n++] = p;
+    }
+    if (n > 0) qsort(rows, n, sizeof(MarginProduct*), cmp_margin_desc);
+
+    const char* header = "%-6s %-20s %-8s %-12s %-10s %-12s %-12s %-8s\n";
+    outbuf_printf(&out, "\n=== Highest Gross Margin Products ===\n");
+    outbuf_printf(&out, header, "ID", "Name", "Units", "Revenue", "AvgCost", "COGS", "Margin", "Margin%");
+    for (size_t i = 0; i < n && i < (size_t)topN; ++i) print_product(&out, rows[i], products);
+
+    if (n > (size_t)topN) {
+        outbuf_printf(&out, "\n=== Lowest Gross Margin Products ===\n");
+        outbuf_printf(&out, header, "ID", "Name", "Units", "Revenue", "AvgCost", "COGS", "Margin", "Margin%");
+        size_t from = n - (size_t)topN < (size_t)topN ? (size_t)topN : n - (size_t)topN;
+        for (size_t i = n; i-- > from;) print_product(&out, rows[i], products);
+    }
+    free(rows);
+
+    if (uncosted > 0) {
+        outbuf_printf(&out, "\n%zu products sold without any purchase record: revenue %s left out of the margin.\n",
+            uncosted, money_str(m->uncostedRevenue, a));
+    }
+    outbuf_printf(&out, "(%lld paid orders, %lld purchases)\n", m->paidOrders, m->purchases);
+    outbuf_free(&out);
+}
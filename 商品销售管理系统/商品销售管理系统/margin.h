@@ -0,0 +1,77 @@
+#pragma once
+#ifndef MARGIN_H
+#define MARGIN_H
+
+#include <stddef.h>
+#include <time.h>
+#include "money.h"
+#include "keytable.h"
+#include "timeutil.h"
+#include "product.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Gross margin per product and per month from the two logs.
+     *
+     * A hash join of purchase_log.csv (build side) with the paid order
+     * lines in orders.log (probe side). Pass one streams the purchases
+     * into one row per product: units and cost, hence the average
+     * purchase cost. Pass two streams the order log once; each paid line
+     * is costed at its product's average and added to both its product row
+     * and its month row. Memory is one row per distinct product plus one
+     * per month, whatever the length of the logs.
+     *
+     * Sales of products that were never purchased have no cost. They count
+     * towards revenue, but their margin is left out and reported apart.
+     */
+
+    /* the rows of MarginReport.products and .months, each led by its key */
+    typedef struct {
+        int       productId;
+        long long purchasedUnits;
+        Money     purchaseCost;
+        long long soldUnits;
+        Money     revenue;
+        Money     cogs;           /* sold units at the average purchase cost */
+    } MarginProduct;
+
+    typedef struct {
+        int       month;          /* yyyymm, local time of payment */
+        long long units;
+        Money     revenue;
+        Money     cogs;
+        Money     uncostedRevenue;
+    } MarginMonth;
+
+    typedef struct {
+        KeyTable       products;
+        KeyTable       months;
+
+        long long      purchases;
+        long long      paidOrders;
+        Money          revenue;
+        Money          cogs;
+        Money          uncostedRevenue;
+
+        MonthCache     monthCache;
+    } MarginReport;
+
+    void margin_init(MarginReport* m);
+    void margin_free(MarginReport* m);
+
+    /* one pass over each log. 0 ok, -1 if the order log cannot be opened
+     * (a missing purchase log leaves every sale uncosted), -2 when out of
+     * memory. Orders without a time count in the totals but in no month. */
+    int  margin_build(MarginReport* m, const char* purchasePath, const char* orderPath);
+
+    /* months, then the topN products with the highest and the lowest
+     * margin; names are taken from products when it is not NULL */
+    void margin_print(const MarginReport* m, ProductList* products, int topN);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,164 @@
+#include "metrics.h"
+#include <string.h>
+
+#define SUB_BITS    4
+#define SUB_COUNT   (1 << SUB_BITS)
+#define BUCKETS     ((64 - SUB_BITS + 1) * SUB_COUNT)
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[BUCKETS];
+} Histogram;
+
+int g_metricsEnabled = 1;
+
+static Histogram g_hist[MET_COUNT];
+static uint64_t  g_counters[CTR_COUNT];
+
+static const char* g_metricNames[MET_COUNT] = {
+    "findProductById",
+    "deductStock",
+    "increaseStock",
+    "addOrderItem",
+    "appendOrderToFile",
+    "seglog_seal",
+    "orderlog_convert",
+    "loadProductsFromCSV",
+    "saveProductsToCSV",
+    "loadUsersFromCSV",
+    "saveUsersToCSV",
+    "loadPurchasesFromCSV",
+    "reorder_loadCSV",
+    "reorder_saveCSV",
+    "pstore_load",
+    "pstore_flush",
+    "valuation_load",
+    "forecast_load",
+    "receiving_apply",
+    "ledger_load",
+    "report_salesSummary",
+    "report_monthlySales",
+    "report_topProducts",
+    "purchase_summaryByProduct",
+    "reorder_lowStock",
+    "reorder_replenishList",
+    "valuation_report",
+    "forecast_report",
+    "ledger_catalogAt",
+    "margin_report",
+    "basket_report",
+};
+
+static const char* g_counterNames[CTR_COUNT] = {
+    "product_lookup_miss",
+    "stock_insufficient",
+    "orders_created",
+    "orders_paid",
+    "orders_cancelled",
+    "order_log_errors",
+    "order_log_damaged",
+};
+
+static int msb64(uint64_t v) {
+    int n = 0;
+    while (v >>= 1) n++;
+    return n;
+}
+
+/* values < 16 map 1:1, above that 16 sub-buckets per power of two */
+static int bucket_of(uint64_t v) {
+    if (v < SUB_COUNT) return (int)v;
+    int m = msb64(v);
+    int sub = (int)((v >> (m - SUB_BITS)) & (SUB_COUNT - 1));
+    return (m - SUB_BITS + 1) * SUB_COUNT + sub;
+}
+
+/* upper bound of a bucket, used as the percentile estimate */
+static uint64_t bucket_high(int idx) {
+    if (idx < SUB_COUNT) return (uint64_t)idx;
+    int m = idx / SUB_COUNT + SUB_BITS - 1;
+    uint64_t sub = (uint64_t)(idx % SUB_COUNT);
+    uint64_t base = (uint64_t)1 << m;
+    uint64_t step = (uint64_t)1 << (m - SUB_BITS);
+    return base + (sub + 1) * step - 1;
+}
+
+void metrics_setEnabled(int on) {
+    g_metricsEnabled = on ? 1 : 0;
+}
+
+void metrics_reset(void) {
+    memset(g_hist, 0, sizeof(g_hist));
+    memset(g_counters, 0, sizeof(g_counters));
+}
+
+void metrics_record(MetricId id, uint64_t ns) {
+    if ((unsigned)id >= MET_COUNT) return;
+    Histogram* h = &g_hist[id];
+    if (h->count == 0 || ns < h->min) h->min = ns;
+    if (ns > h->max) h->max = ns;
+    h->count++;
+    h->sum += ns;
+    h->buckets[bucket_of(ns)]++;
+}
+
+void metrics_count(CounterId id, uint64_t delta) {
+    if ((unsigned)id >= CTR_COUNT) return;
+    g_counters[id] += delta;
+}
+
+uint64_t metrics_samples(MetricId id) {
+    return (unsigned)id < MET_COUNT ? g_hist[id].count : 0;
+}
+
+uint64_t metrics_percentile(MetricId id, double pct) {
+    if ((unsigned)id >= MET_COUNT) return 0;
+    const Histogram* h = &g_hist[id];
+    if (h->count == 0) return 0;
+    uint64_t rank = (uint64_t)(pct / 100.0 * (double)h->count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > h->count) rank = h->count;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint64_t hi = bucket_high(i);
+            return hi > h->max ? h->max : hi;
+        }
+    }
+    return h->max;
+}
+
+void metrics_dump(FILE* out) {
+    fprintf(out, "=== Metrics (latency in ns) ===\n");
+    fprintf(out, "%-26s %10s %10s %10s %10s %10s %10s %12s\n",
+        "Operation", "Count", "Mean", "P50", "P99", "P999", "Min", "Max");
+    for (int i = 0; i < MET_COUNT; ++i) {
+        const Histogram* h = &g_hist[i];
+        if (h->count == 0) continue;
+        fprintf(out, "%-26s %10llu %10llu %10llu %10llu %10llu %10llu %12llu\n",
+            g_metricNames[i],
+            (unsigned long long)h->count,
+            (unsigned long long)(h->sum / h->count),
+            (unsigned long long)metrics_percentile((MetricId)i, 50.0),
+            (unsigned long long)metrics_percentile((MetricId)i, 99.0),
+            (unsigned long long)metrics_percentile((MetricId)i, 99.9),
+            (unsigned long long)h->min,
+            (unsigned long long)h->max);
+    }
+    fprintf(out, "--- Counters ---\n");
+    for (int i = 0; i < CTR_COUNT; ++i) {
+        fprintf(out, "%-26s %10llu\n", g_counterNames[i], (unsigned long long)g_counters[i]);
+    }
+}
+
+int metrics_writeFile(const char* path) {
+    FILE* fp = fopen(path, "w");
+    if (!fp) return -1;
+    metrics_dump(fp);
+    fclose(fp);
+    return 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "timeutil.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Per-operation latency histograms and counters.
+     *
+     * Histograms are log-linear: 16 linear sub-buckets per power of two, so
+     * any recorded value is reported within ~6% of its true value. Recording
+     * is O(1) and allocation-free; all state is owned by the main thread.
+     *
+     * Build with -DSALES_METRICS=0 to compile everything out. At runtime
+     * instrumented functions test METRICS_ON() once and call the plain
+     * implementation when it is false.
+     */
+
+#ifndef SALES_METRICS
+#define SALES_METRICS 1
+#endif
+
+    typedef enum {
+        MET_FIND_PRODUCT = 0,
+        MET_DEDUCT_STOCK,
+        MET_INCREASE_STOCK,
+        MET_ADD_ORDER_ITEM,
+        MET_APPEND_ORDER,
+        MET_SEAL_ORDER_SEGMENT,
+        MET_CONVERT_ORDER_LOG,
+        MET_LOAD_PRODUCTS,
+        MET_SAVE_PRODUCTS,
+        MET_LOAD_USERS,
+        MET_SAVE_USERS,
+        MET_LOAD_PURCHASES,
+        MET_LOAD_REORDER,
+        MET_SAVE_REORDER,
+        MET_LOAD_PRODUCT_STORE,
+        MET_FLUSH_PRODUCT_STORE,
+        MET_LOAD_VALUATION,
+        MET_LOAD_FORECAST,
+        MET_RECEIVE_MANIFEST,
+        MET_LOAD_LEDGER,
+        MET_REPORT_SALES_SUMMARY,
+        MET_REPORT_MONTHLY_SALES,
+        MET_REPORT_TOP_PRODUCTS,
+        MET_REPORT_PURCHASE_SUMMARY,
+        MET_REPORT_LOW_STOCK,
+        MET_REPORT_REPLENISH,
+        MET_REPORT_VALUATION,
+        MET_REPORT_FORECAST,
+        MET_REPORT_STOCK_AS_OF,
+        MET_REPORT_MARGIN,
+        MET_REPORT_BASKET,
+        MET_COUNT
+    } MetricId;
+
+    typedef enum {
+        CTR_PRODUCT_LOOKUP_MISS = 0,
+        CTR_STOCK_INSUFFICIENT,
+        CTR_ORDERS_CREATED,
+        CTR_ORDERS_PAID,
+        CTR_ORDERS_CANCELLED,
+        CTR_ORDER_LOG_ERRORS,
+        CTR_ORDER_LOG_DAMAGED,
+        CTR_COUNT
+    } CounterId;
+
+    extern int g_metricsEnabled;
+
+#if SALES_METRICS
+#define METRICS_ON() (g_metricsEnabled)
+#else
+#define METRICS_ON() 0
+#endif
+
+#define METRICS_COUNT(id) do { if (METRICS_ON()) metrics_count((id), 1); } while (0)
+
+    void metrics_setEnabled(int on);
+    void metrics_reset(void);
+
+    void metrics_record(MetricId id, uint64_t ns);
+    void metrics_count(CounterId id, uint64_t delta);
+
+    /* percentile estimate in ns (pct in [0, 100]) */
+    uint64_t metrics_percentile(MetricId id, double pct);
+    uint64_t metrics_samples(MetricId id);
+
+    /* human readable table */
+    void metrics_dump(FILE* out);
+    int  metrics_writeFile(const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
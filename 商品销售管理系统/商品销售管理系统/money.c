@@ -0,0 +1,92 @@
+#include "money.h"
+
+#define MONEY_MAX INT64_MAX
+
+Money money_fromDouble(double v) {
+    double scaled = v * MONEY_SCALE;
+    if (scaled >= 9.2e18) return MONEY_MAX;
+    if (scaled <= -9.2e18) return -MONEY_MAX;
+    return (Money)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+}
+
+double money_toDouble(Money m) {
+    return (double)m / MONEY_SCALE;
+}
+
+Money money_mul(Money unit, long long qty) {
+    if (unit == 0 || qty == 0) return 0;
+    Money au = unit < 0 ? -unit : unit;
+    long long aq = qty < 0 ? -qty : qty;
+    int neg = (unit < 0) != (qty < 0);
+    if (au > MONEY_MAX / aq) return neg ? -MONEY_MAX : MONEY_MAX;
+    return neg ? -(au * aq) : au * aq;
+}
+
+Money money_div(Money total, long long count) {
+    if (count <= 0) return 0;
+    Money half = count / 2;
+    return total < 0 ? -((-total + half) / count) : (total + half) / count;
+}
+
+size_t money_format(Money m, char* buf, size_t cap) {
+    char tmp[MONEY_STR_MAX];
+    size_t n = 0;
+    /* work in uint64 so INT64_MIN negates cleanly */
+    uint64_t v = m < 0 ? (uint64_t)0 - (uint64_t)m : (uint64_t)m;
+    unsigned frac = (unsigned)(v % MONEY_SCALE);
+    v /= MONEY_SCALE;
+
+    tmp[n++] = (char)('0' + frac % 10);
+    tmp[n++] = (char)('0' + frac / 10);
+    tmp[n++] = '.';
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    if (m < 0) tmp[n++] = '-';
+
+    if (!buf || cap <= n) {
+        if (buf && cap) buf[0] = '\0';
+        return 0;
+    }
+    for (size_t i = 0; i < n; ++i) buf[i] = tmp[n - 1 - i];
+    buf[n] = '\0';
+    return n;
+}
+
+const char* money_str(Money m, char* buf) {
+    money_format(m, buf, MONEY_STR_MAX);
+    return buf;
+}
+
+const char* money_parse(const char* s, Money* out) {
+    if (!s) return NULL;
+    while (*s == ' ' || *s == '\t') ++s;
+    int neg = 0;
+    if (*s == '+' || *s == '-') neg = (*s++ == '-');
+
+    uint64_t whole = 0;
+    int digits = 0;
+    for (; *s >= '0' && *s <= '9'; ++s, ++digits) {
+        if (whole > (uint64_t)(MONEY_MAX / MONEY_SCALE) / 10) return NULL;
+        whole = whole * 10 + (uint64_t)(*s - '0');
+    }
+
+    unsigned frac = 0;
+    int fracDigits = 0, roundUp = 0;
+    if (*s == '.') {
+        for (++s; *s >= '0' && *s <= '9'; ++s, ++digits) {
+            if (fracDigits < 2) frac = frac * 10 + (unsigned)(*s - '0');
+            else if (fracDigits == 2) roundUp = *s >= '5';
+            fracDigits++;
+        }
+    }
+    if (digits == 0) return NULL;
+    if (fracDigits == 1) frac *= 10;
+    else if (fracDigits == 0) frac = 0;
+
+    uint64_t v = whole * MONEY_SCALE + frac + (unsigned)roundUp;
+    if (v > (uint64_t)MONEY_MAX) return NULL;
+    if (out) *out = neg ? -(Money)v : (Money)v;
+    return s;
+}
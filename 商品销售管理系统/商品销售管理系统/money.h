@@ -0,0 +1,49 @@
+#pragma once
+#ifndef MONEY_H
+#define MONEY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Fixed-point money: an int64 count of minor units (cents).
+     *
+     * Prices, order lines, totals and purchase costs are Money end to end,
+     * so sums are exact and need no floating point. The text form used in
+     * products.csv, orders.log and purchase_log.csv is unchanged ("12.34");
+     * money_format / money_parse convert it with integer arithmetic only.
+     */
+
+    typedef int64_t Money;
+
+#define MONEY_SCALE   100
+#define MONEY_STR_MAX 24    /* "-92233720368547758.08" plus NUL */
+
+    Money  money_fromDouble(double v);   /* rounds half away from zero */
+    double money_toDouble(Money m);
+
+    /* qty * unit, saturating instead of overflowing */
+    Money  money_mul(Money unit, long long qty);
+    /* total / count rounded half away from zero; 0 when count <= 0 */
+    Money  money_div(Money total, long long count);
+
+    /* writes "-12.34" style text; returns its length (0 if cap is too small) */
+    size_t money_format(Money m, char* buf, size_t cap);
+    /* money_format into buf[MONEY_STR_MAX] and return buf, for printf "%s" */
+    const char* money_str(Money m, char* buf);
+
+    /* parses [spaces][+|-]digits[.digits]; digits past the second decimal
+     * round half up ("1.005" -> 1.01), so older six-decimal files still load.
+     * Returns the first unparsed character, or NULL if there are no digits
+     * or the value does not fit.
+     */
+    const char* money_parse(const char* s, Money* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
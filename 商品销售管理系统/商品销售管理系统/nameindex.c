@@ -0,0 +1,478 @@
+#include "nameindex.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define NIL              0xFFFFFFFFu
+#define ARENA_BLOCK      (64 * 1024)
+#define COMPACT_MIN_DEAD 4096
+#define INTERSECT_STOP   64     /* candidates few enough to verify directly */
+
+typedef struct {
+    int         id;
+    uint32_t    hash;        /* of the exact name */
+    uint32_t    nextById;    /* bucket chains, NIL terminated */
+    uint32_t    nextByName;
+    const char* name;
+    const char* lower;       /* ASCII-folded copy */
+    int         alive;
+} NameDoc;
+
+/* posting list of one trigram; doc indices are ascending because docs
+ * are only ever appended (removal marks the doc dead) */
+typedef struct {
+    uint32_t  key;           /* 0 = empty slot */
+    uint32_t  size;
+    uint32_t  capacity;
+    uint32_t* docs;
+} Posting;
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t size;
+    size_t used;
+} ArenaBlock;
+
+struct NameIndex {
+    NameDoc*  docs;
+    size_t    docN;
+    size_t    docCap;
+    size_t    live;
+
+    uint32_t* idBuckets;
+    uint32_t* nameBuckets;
+    size_t    nBuckets;      /* power of two */
+
+    Posting*  grams;
+    size_t    gramN;
+    size_t    gramCap;       /* power of two */
+
+    uint32_t* sorted;        /* doc indices ordered by folded name */
+    size_t    sortedN;
+    size_t    sortedUpTo;    /* docs below this index are merged into sorted */
+
+    ArenaBlock* arena;
+};
+
+/* ---------- helpers ---------- */
+
+static uint32_t hash_name(const char* s) {
+    uint32_t h = 2166136261u;
+    for (; *s; ++s) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t hash_u32(uint32_t v) {
+    return v * 2654435761u;
+}
+
+static char fold(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+static char* fold_copy(const char* s) {
+    size_t len = strlen(s);
+    char* out = (char*)malloc(len + 1);
+    if (!out) return NULL;
+    for (size_t i = 0; i <= len; ++i) out[i] = fold(s[i]);
+    return out;
+}
+
+static uint32_t trigram_at(const char* s) {
+    return ((uint32_t)(unsigned char)s[0] << 16) |
+        ((uint32_t)(unsigned char)s[1] << 8) |
+        (uint32_t)(unsigned char)s[2];
+}
+
+static char* arena_alloc(NameIndex* idx, size_t n) {
+    ArenaBlock* b = idx->arena;
+    if (!b || b->size - b->used < n) {
+        size_t size = n > ARENA_BLOCK ? n : ARENA_BLOCK;
+        b = (ArenaBlock*)malloc(sizeof(ArenaBlock) + size);
+        if (!b) return NULL;
+        b->next = idx->arena;
+        b->size = size;
+        b->used = 0;
+        idx->arena = b;
+    }
+    char* p = (char*)(b + 1) + b->used;
+    b->used += n;
+    return p;
+}
+
+static int rehash_buckets(NameIndex* idx, size_t newCount) {
+    uint32_t* ib = (uint32_t*)malloc(newCount * sizeof(uint32_t));
+    uint32_t* nb = (uint32_t*)malloc(newCount * sizeof(uint32_t));
+    if (!ib || !nb) {
+        free(ib);
+        free(nb);
+        return -1;
+    }
+    memset(ib, 0xFF, newCount * sizeof(uint32_t));
+    memset(nb, 0xFF, newCount * sizeof(uint32_t));
+    size_t mask = newCount - 1;
+    for (size_t d = 0; d < idx->docN; ++d) {
+        NameDoc* doc = &idx->docs[d];
+        if (!doc->alive) continue;
+        size_t bi = hash_u32((uint32_t)doc->id) & mask;
+        size_t bn = doc->hash & mask;
+        doc->nextById = ib[bi];
+        ib[bi] = (uint32_t)d;
+        doc->nextByName = nb[bn];
+        nb[bn] = (uint32_t)d;
+    }
+    free(idx->idBuckets);
+    free(idx->nameBuckets);
+    idx->idBuckets = ib;
+    idx->nameBuckets = nb;
+    idx->nBuckets = newCount;
+    return 0;
+}
+
+static int grow_grams(NameIndex* idx) {
+    size_t newCap = idx->gramCap == 0 ? 1024 : idx->gramCap * 2;
+    Posting* ng = (Posting*)calloc(newCap, sizeof(Posting));
+    if (!ng) return -1;
+    size_t mask = newCap - 1;
+    for (size_t i = 0; i < idx->gramCap; ++i) {
+        if (!idx->grams[i].key) continue;
+        size_t s = hash_u32(idx->grams[i].key) & mask;
+        while (ng[s].key) s = (s + 1) & mask;
+        ng[s] = idx->grams[i];
+    }
+    free(idx->grams);
+    idx->grams = ng;
+    idx->gramCap = newCap;
+    return 0;
+}
+
+static Posting* gram_find(const NameIndex* idx, uint32_t key) {
+    if (idx->gramCap == 0) return NULL;
+    size_t mask = idx->gramCap - 1;
+    size_t s = hash_u32(key) & mask;
+    while (idx->grams[s].key) {
+        if (idx->grams[s].key == key) return &idx->grams[s];
+        s = (s + 1) & mask;
+    }
+    return NULL;
+}
+
+static Posting* gram_get(NameIndex* idx, uint32_t key) {
+    Posting* p = gram_find(idx, key);
+    if (p) return p;
+    if ((idx->gramN + 1) * 2 > idx->gramCap && grow_grams(idx) != 0) return NULL;
+    size_t mask = idx->gramCap - 1;
+    size_t s = hash_u32(key) & mask;
+    while (idx->grams[s].key) s = (s + 1) & mask;
+    idx->grams[s].key = key;
+    idx->gramN++;
+    return &idx->grams[s];
+}
+
+static int posting_push(Posting* p, uint32_t doc) {
+    if (p->size > 0 && p->docs[p->size - 1] == doc) return 0;   /* repeated trigram */
+    if (p->size >= p->capacity) {
+        uint32_t newCap = p->capacity == 0 ? 4 : p->capacity * 2;
+        uint32_t* nd = (uint32_t*)realloc(p->docs, newCap * sizeof(uint32_t));
+        if (!nd) return -1;
+        p->docs = nd;
+        p->capacity = newCap;
+    }
+    p->docs[p->size++] = doc;
+    return 0;
+}
+
+static uint32_t find_doc(const NameIndex* idx, int id) {
+    if (idx->nBuckets == 0) return NIL;
+    uint32_t d = idx->idBuckets[hash_u32((uint32_t)id) & (idx->nBuckets - 1)];
+    while (d != NIL && idx->docs[d].id != id) d = idx->docs[d].nextById;
+    return d;
+}
+
+static void unlink_doc(NameIndex* idx, uint32_t d) {
+    NameDoc* doc = &idx->docs[d];
+    size_t mask = idx->nBuckets - 1;
+    uint32_t* link = &idx->idBuckets[hash_u32((uint32_t)doc->id) & mask];
+    while (*link != d) link = &idx->docs[*link].nextById;
+    *link = doc->nextById;
+    link = &idx->nameBuckets[doc->hash & mask];
+    while (*link != d) link = &idx->docs[*link].nextByName;
+    *link = doc->nextByName;
+}
+
+/* ---------- sorted order for prefix queries ---------- */
+
+typedef struct {
+    const char* lower;
+    uint32_t    doc;
+} SortKey;
+
+static int cmp_sort_key(const void* a, const void* b) {
+    const SortKey* ka = (const SortKey*)a;
+    const SortKey* kb = (const SortKey*)b;
+    int c = strcmp(ka->lower, kb->lower);
+    if (c != 0) return c;
+    return (ka->doc > kb->doc) - (ka->doc < kb->doc);
+}
+
+/* merges docs added since the last prefix query into the sorted order,
+ * dropping dead entries on the way */
+static int ensure_sorted(NameIndex* idx) {
+    if (idx->sortedUpTo == idx->docN) return 0;
+    size_t pendingN = 0;
+    SortKey* pending = (SortKey*)malloc((idx->docN - idx->sortedUpTo) * sizeof(SortKey));
+    uint32_t* merged = (uint32_t*)malloc((idx->sortedN + idx->docN - idx->sortedUpTo) * sizeof(uint32_t));
+    if (!pending || !merged) {
+        free(pending);
+        free(merged);
+        return -1;
+    }
+    for (size_t d = idx->sortedUpTo; d < idx->docN; ++d) {
+        if (!idx->docs[d].alive) continue;
+        pending[pendingN].lower = idx->docs[d].lower;
+        pending[pendingN].doc = (uint32_t)d;
+        pendingN++;
+    }
+    qsort(pending, pendingN, sizeof(SortKey), cmp_sort_key);
+
+    size_t i = 0, j = 0, n = 0;
+    while (i < idx->sortedN || j < pendingN) {
+        if (i < idx->sortedN && !idx->docs[idx->sorted[i]].alive) {
+            i++;
+            continue;
+        }
+        if (j >= pendingN || (i < idx->sortedN &&
+            strcmp(idx->docs[idx->sorted[i]].lower, pending[j].lower) <= 0)) {
+            merged[n++] = idx->sorted[i++];
+        }
+        else {
+            merged[n++] = pending[j++].doc;
+        }
+    }
+    free(pending);
+    free(idx->sorted);
+    idx->sorted = merged;
+    idx->sortedN = n;
+    idx->sortedUpTo = idx->docN;
+    return 0;
+}
+
+/* ---------- public APIs ---------- */
+
+NameIndex* nameindex_create(void) {
+    return (NameIndex*)calloc(1, sizeof(NameIndex));
+}
+
+static void release(NameIndex* idx) {
+    for (size_t i = 0; i < idx->gramCap; ++i) free(idx->grams[i].docs);
+    free(idx->grams);
+    free(idx->docs);
+    free(idx->idBuckets);
+    free(idx->nameBuckets);
+    free(idx->sorted);
+    while (idx->arena) {
+        ArenaBlock* next = idx->arena->next;
+        free(idx->arena);
+        idx->arena = next;
+    }
+    memset(idx, 0, sizeof(*idx));
+}
+
+void nameindex_free(NameIndex* idx) {
+    if (!idx) return;
+    release(idx);
+    free(idx);
+}
+
+void nameindex_clear(NameIndex* idx) {
+    if (idx) release(idx);
+}
+
+size_t nameindex_count(const NameIndex* idx) {
+    return idx ? idx->live : 0;
+}
+
+int nameindex_add(NameIndex* idx, int id, const char* name) {
+    if (!idx) return -1;
+    if (!name) name = "";
+    uint32_t old = find_doc(idx, id);
+    if (old != NIL) nameindex_remove(idx, id);
+
+    if (idx->docN >= idx->docCap) {
+        size_t newCap = idx->docCap == 0 ? 64 : idx->docCap * 2;
+        if (newCap >= NIL) return -1;
+        NameDoc* nd = (NameDoc*)realloc(idx->docs, newCap * sizeof(NameDoc));
+        if (!nd) return -1;
+        idx->docs = nd;
+        idx->docCap = newCap;
+    }
+    if (idx->docN + 1 > idx->nBuckets &&
+        rehash_buckets(idx, idx->nBuckets == 0 ? 64 : idx->nBuckets * 2) != 0) {
+        return -1;
+    }
+
+    size_t len = strlen(name);
+    char* mem = arena_alloc(idx, 2 * (len + 1));
+    if (!mem) return -1;
+    char* lower = mem + len + 1;
+    memcpy(mem, name, len + 1);
+    for (size_t i = 0; i <= len; ++i) lower[i] = fold(name[i]);
+
+    uint32_t d = (uint32_t)idx->docN++;
+    NameDoc* doc = &idx->docs[d];
+    size_t mask = idx->nBuckets - 1;
+    doc->id = id;
+    doc->hash = hash_name(name);
+    doc->name = mem;
+    doc->lower = lower;
+    doc->alive = 1;
+    doc->nextById = idx->idBuckets[hash_u32((uint32_t)id) & mask];
+    idx->idBuckets[hash_u32((uint32_t)id) & mask] = d;
+    doc->nextByName = idx->nameBuckets[doc->hash & mask];
+    idx->nameBuckets[doc->hash & mask] = d;
+    idx->live++;
+
+    for (size_t i = 0; i + 3 <= len; ++i) {
+        Posting* p = gram_get(idx, trigram_at(lower + i));
+        if (!p || posting_push(p, d) != 0) return -1;
+    }
+    return 0;
+}
+
+/* rebuilds from live docs once most entries are dead */
+static void compact(NameIndex* idx) {
+    NameIndex fresh;
+    memset(&fresh, 0, sizeof(fresh));
+    for (size_t d = 0; d < idx->docN; ++d) {
+        const NameDoc* doc = &idx->docs[d];
+        if (doc->alive && nameindex_add(&fresh, doc->id, doc->name) != 0) {
+            release(&fresh);
+            return;   /* keep the old (still correct) index */
+        }
+    }
+    release(idx);
+    *idx = fresh;
+}
+
+int nameindex_remove(NameIndex* idx, int id) {
+    if (!idx) return -1;
+    uint32_t d = find_doc(idx, id);
+    if (d == NIL) return -1;
+    unlink_doc(idx, d);
+    idx->docs[d].alive = 0;
+    idx->live--;
+    size_t dead = idx->docN - idx->live;
+    if (dead >= COMPACT_MIN_DEAD && dead > idx->live) compact(idx);
+    return 0;
+}
+
+size_t nameindex_findExact(NameIndex* idx, const char* name, int* outIds, size_t maxOut) {
+    if (!idx || !name || idx->nBuckets == 0) return 0;
+    uint32_t h = hash_name(name);
+    size_t n = 0;
+    uint32_t d = idx->nameBuckets[h & (idx->nBuckets - 1)];
+    while (d != NIL && n < maxOut) {
+        const NameDoc* doc = &idx->docs[d];
+        if (doc->hash == h && strcmp(doc->name, name) == 0) outIds[n++] = doc->id;
+        d = doc->nextByName;
+    }
+    return n;
+}
+
+size_t nameindex_findPrefix(NameIndex* idx, const char* prefix, int* outIds, size_t maxOut) {
+    if (!idx || !prefix || ensure_sorted(idx) != 0) return 0;
+    char* p = fold_copy(prefix);
+    if (!p) return 0;
+    size_t plen = strlen(p);
+
+    size_t lo = 0, hi = idx->sortedN;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(idx->docs[idx->sorted[mid]].lower, p) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    size_t n = 0;
+    for (size_t i = lo; i < idx->sortedN && n < maxOut; ++i) {
+        const NameDoc* doc = &idx->docs[idx->sorted[i]];
+        if (strncmp(doc->lower, p, plen) != 0) break;
+        if (doc->alive) outIds[n++] = doc->id;
+    }
+    free(p);
+    return n;
+}
+
+size_t nameindex_findSubstring(NameIndex* idx, const char* text, int* outIds, size_t maxOut) {
+    if (!idx || !text) return 0;
+    char* q = fold_copy(text);
+    if (!q) return 0;
+    size_t qlen = strlen(q);
+    size_t n = 0;
+
+    if (qlen < 3) {
+        /* too short for a trigram: scan the folded names */
+        for (size_t d = 0; d < idx->docN && n < maxOut; ++d) {
+            const NameDoc* doc = &idx->docs[d];
+            if (doc->alive && strstr(doc->lower, q)) outIds[n++] = doc->id;
+        }
+        free(q);
+        return n;
+    }
+
+    /* posting lists of the query trigrams, rarest first */
+    size_t gramN = 0;
+    const Posting** lists = (const Posting**)malloc((qlen - 2) * sizeof(const Posting*));
+    if (!lists) {
+        free(q);
+        return 0;
+    }
+    for (size_t i = 0; i + 3 <= qlen; ++i) {
+        const Posting* p = gram_find(idx, trigram_at(q + i));
+        if (!p) {
+            free(lists);
+            free(q);
+            return 0;
+        }
+        size_t k = gramN++;
+        while (k > 0 && lists[k - 1]->size > p->size) {
+            lists[k] = lists[k - 1];
+            k--;
+        }
+        lists[k] = p;
+    }
+
+    /* intersect the sorted lists until few candidates remain */
+    size_t candN = lists[0]->size;
+    uint32_t* cand = (uint32_t*)malloc((candN ? candN : 1) * sizeof(uint32_t));
+    if (!cand) {
+        free(lists);
+        free(q);
+        return 0;
+    }
+    memcpy(cand, lists[0]->docs, candN * sizeof(uint32_t));
+    for (size_t g = 1; g < gramN && candN > INTERSECT_STOP; ++g) {
+        const Posting* p = lists[g];
+        size_t i = 0, j = 0, m = 0;
+        while (i < candN && j < p->size) {
+            if (cand[i] < p->docs[j]) i++;
+            else if (cand[i] > p->docs[j]) j++;
+            else {
+                cand[m++] = cand[i++];
+                j++;
+            }
+        }
+        candN = m;
+    }
+
+    /* matching every trigram does not imply the order; verify */
+    for (size_t k = 0; k < candN && n < maxOut; ++k) {
+        const NameDoc* doc = &idx->docs[cand[k]];
+        if (doc->alive && (qlen == 3 || strstr(doc->lower, q))) outIds[n++] = doc->id;
+    }
+    free(cand);
+    free(lists);
+    free(q);
+    return n;
+}
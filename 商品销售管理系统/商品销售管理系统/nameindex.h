@@ -0,0 +1,39 @@
+#pragma once
+#ifndef NAMEINDEX_H
+#define NAMEINDEX_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Product name index: id -> name entries searchable by
+     *  - exact name (case-sensitive, hash lookup)
+     *  - prefix (case-insensitive, binary search over a sorted order)
+     *  - substring (case-insensitive, trigram posting lists + verification)
+     *
+     * Case folding is ASCII only; other bytes (GBK / UTF-8 names) match
+     * byte for byte. Queries write at most maxOut product ids to outIds
+     * and return how many were written.
+     */
+
+    typedef struct NameIndex NameIndex;
+
+    NameIndex* nameindex_create(void);
+    void       nameindex_free(NameIndex* idx);
+    void       nameindex_clear(NameIndex* idx);
+
+    int    nameindex_add(NameIndex* idx, int id, const char* name);   /* 0 ok, -1 out of memory */
+    int    nameindex_remove(NameIndex* idx, int id);                  /* -1 if id is not indexed */
+    size_t nameindex_count(const NameIndex* idx);
+
+    size_t nameindex_findExact(NameIndex* idx, const char* name, int* outIds, size_t maxOut);
+    size_t nameindex_findPrefix(NameIndex* idx, const char* prefix, int* outIds, size_t maxOut);
+    size_t nameindex_findSubstring(NameIndex* idx, const char* text, int* outIds, size_t maxOut);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
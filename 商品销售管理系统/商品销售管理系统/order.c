@@ -2,13 +2,14 @@
 #include <stdlib.h>
 #include <time.h>
 #include "order.h"
+#include "metrics.h"
 
 void initOrder(Order* order, int orderId) {
     order->orderId = orderId;
     order->items = NULL;
     order->size = 0;
     order->capacity = 0;
-    order->totalAmount = 0.0;
+    order->totalAmount = 0;
     order->status = ORDER_CREATED;
     order->createdAt = time(NULL);
     order->paidAt = 0;
@@ -19,7 +20,7 @@ void freeOrder(Order* order) {
     order->items = NULL;
     order->size = 0;
     order->capacity = 0;
-    order->totalAmount = 0.0;
+    order->totalAmount = 0;
     order->status = ORDER_CANCELLED; // 释放后不再使用
     order->createdAt = 0;
     order->paidAt = 0;
@@ -38,18 +39,26 @@ static void ensureItemCapacity(Order* order) {
     }
 }
 
-int addOrderItem(Order* order, const Product* p, int quantity) {
+static int addOrderItemImpl(Order* order, const Product* p, int quantity) {
     if (!order || !p || quantity <= 0) return -1;
     ensureItemCapacity(order);
     OrderItem* item = &order->items[order->size++];
     item->productId = p->id;
     item->quantity = quantity;
     item->unitPrice = p->price;
-    item->lineTotal = p->price * quantity;
+    item->lineTotal = money_mul(p->price, quantity);
     order->totalAmount += item->lineTotal;
     return 0;
 }
 
+int addOrderItem(Order* order, const Product* p, int quantity) {
+    if (!METRICS_ON()) return addOrderItemImpl(order, p, quantity);
+    uint64_t t0 = timeutil_nowNs();
+    int rc = addOrderItemImpl(order, p, quantity);
+    metrics_record(MET_ADD_ORDER_ITEM, timeutil_nowNs() - t0);
+    return rc;
+}
+
 const char* orderStatusToStr(OrderStatus st) {
     switch (st) {
     case ORDER_CREATED: return "CREATED";
@@ -94,10 +103,11 @@ void printOrder(const Order* order) {
     printf("Creation time: "); printTime(order->createdAt); printf("\n");
     printf("Payment time: "); printTime(order->paidAt); printf("\n");
     printf("%-8s %-8s %-10s %-10s\n", "ProdID", "Quantity", "Unit price", "subtotal");
+    char unit[MONEY_STR_MAX], line[MONEY_STR_MAX];
     for (size_t i = 0; i < order->size; ++i) {
         const OrderItem* item = &order->items[i];
-        printf("%-8d %-8d %-10.2f %-10.2f\n",
-            item->productId, item->quantity, item->unitPrice, item->lineTotal);
+        printf("%-8d %-8d %-10s %-10s\n", item->productId, item->quantity,
+            money_str(item->unitPrice, unit), money_str(item->lineTotal, line));
     }
-    printf("Total amount: %.2f\n", order->totalAmount);
+    printf("Total amount: %s\n", money_str(order->totalAmount, line));
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <time.h>
 #include "product.h"
+#include "money.h"
 
 typedef enum {
     ORDER_CREATED = 0,
@@ -13,8 +14,8 @@ typedef enum {
 typedef struct {
     int productId;
     int quantity;
-    double unitPrice;
-    double lineTotal;
+    Money  unitPrice;
+    Money  lineTotal;
 } OrderItem;
 
 typedef struct {
@@ -22,7 +23,7 @@ typedef struct {
     OrderItem* items;
     size_t     size;
     size_t     capacity;
-    double     totalAmount;
+    Money      totalAmount;
     OrderStatus status;
     time_t     createdAt;
     time_t     paidAt;      // 0 if not paid
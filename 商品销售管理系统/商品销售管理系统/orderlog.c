@@ -0,0 +1,285 @@
+#include "orderlog.h"
+#include "orderbin.h"
+#include "metrics.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* moves past tag, NULL if s does not start with it */
+static const char* expect(const char* s, const char* tag, size_t len) {
+    return (s && strncmp(s, tag, len) == 0) ? s + len : NULL;
+}
+
+#define EXPECT(s, tag) expect((s), (tag), sizeof(tag) - 1)
+
+static const char* parse_ll(const char* s, long long* out) {
+    if (!s) return NULL;
+    char* end;
+    *out = strtoll(s, &end, 10);
+    return end == s ? NULL : end;
+}
+
+static const char* parse_int(const char* s, int* out) {
+    long long v;
+    s = parse_ll(s, &v);
+    if (!s || v < -0x7fffffffLL - 1 || v > 0x7fffffffLL) return NULL;
+    *out = (int)v;
+    return s;
+}
+
+static const char* parse_money(const char* s, Money* out) {
+    return s ? money_parse(s, out) : NULL;
+}
+
+/* the fields after STATUS are optional so older logs still read */
+int orderlog_parseHeader(const char* line, OrderLogRecord* rec, size_t* itemsDeclared) {
+    memset(rec, 0, sizeof(*rec));
+    if (itemsDeclared) *itemsDeclared = (size_t)-1;
+    const char* s = parse_int(EXPECT(line, "ORDER,"), &rec->orderId);
+    if (!(s = EXPECT(s, ",STATUS,"))) return 0;
+    const char* t;
+    if ((t = EXPECT(s, "CREATED")) != NULL) rec->status = ORDER_CREATED;
+    else if ((t = EXPECT(s, "PAID")) != NULL) rec->status = ORDER_PAID;
+    else if ((t = EXPECT(s, "CANCELLED")) != NULL) rec->status = ORDER_CANCELLED;
+    else return 0;
+    long long v;
+    if (!(s = parse_ll(EXPECT(t, ",ITEMS,"), &v))) return 1;
+    if (itemsDeclared && v >= 0) *itemsDeclared = (size_t)v;
+    if (!(s = parse_money(EXPECT(s, ",TOTAL,"), &rec->total))) return 1;
+    if (!(s = parse_ll(EXPECT(s, ",CREATED,"), &v))) return 1;
+    rec->createdAt = (time_t)v;
+    if (parse_ll(EXPECT(s, ",PAID,"), &v)) rec->paidAt = (time_t)v;
+    return 1;
+}
+
+/* product id and quantity are required, the amounts are not */
+int orderlog_parseItem(const char* line, OrderItem* it) {
+    memset(it, 0, sizeof(*it));
+    while (*line == ' ' || *line == '\t') line++;
+    const char* s = parse_int(EXPECT(line, "ITEM,"), &it->productId);
+    if (!(s = parse_int(EXPECT(s, ",QTY,"), &it->quantity))) return 0;
+    if ((s = parse_money(EXPECT(s, ",UNIT,"), &it->unitPrice)) != NULL) {
+        parse_money(EXPECT(s, ",LINE,"), &it->lineTotal);
+    }
+    return 1;
+}
+
+/* moves on to the next segment that opens, 0 when there is none left */
+static int next_file(OrderLogReader* r) {
+    while (r->nextFile < r->files.count) {
+        FILE* fp = fopen(r->files.paths[r->nextFile++], "rb");
+        if (!fp) continue;   /* sealed but not renamed yet, or archived since */
+        if (r->fp) fclose(r->fp);
+        r->fp = fp;
+        r->pos = 0;
+        r->head = 0;
+        r->len = 0;
+        r->eof = 0;
+        return 1;
+    }
+    return 0;
+}
+
+static int alloc_buf(OrderLogReader* r) {
+    r->buf = (char*)malloc(ORDERLOG_BUF_BYTES + 1);
+    r->bufCap = ORDERLOG_BUF_BYTES;
+    return r->buf != NULL;
+}
+
+int orderlog_openPeriod(OrderLogReader* r, const char* path, long long from, long long to) {
+    memset(r, 0, sizeof(*r));
+    r->end = UINT64_MAX;
+    if (!alloc_buf(r) || seglog_select(path, from, to, &r->files) != 0 || !next_file(r)) {
+        orderlog_close(r);
+        return -1;
+    }
+    return 0;
+}
+
+int orderlog_open(OrderLogReader* r, const char* path) {
+    return orderlog_openPeriod(r, path, 0, 0);
+}
+
+static int seek_to(FILE* fp, uint64_t off) {
+#if defined(_MSC_VER)
+    return _fseeki64(fp, (long long)off, SEEK_SET);
+#else
+    return fseeko(fp, (off_t)off, SEEK_SET);
+#endif
+}
+
+/* at least need unread bytes in buf; fewer only at end of file */
+static int fill(OrderLogReader* r, size_t need) {
+    if (r->len - r->head >= need) return 1;
+    if (r->head > 0) {
+        memmove(r->buf, r->buf + r->head, r->len - r->head);
+        r->len -= r->head;
+        r->head = 0;
+    }
+    if (need > r->bufCap) {
+        char* nb = (char*)realloc(r->buf, need + 1);
+        if (!nb) return 0;
+        r->buf = nb;
+        r->bufCap = need;
+    }
+    while (r->len < need && !r->eof) {
+        size_t got = fread(r->buf + r->len, 1, r->bufCap - r->len, r->fp);
+        if (got == 0) r->eof = 1;
+        r->len += got;
+    }
+    return r->len >= need;
+}
+
+static void consume(OrderLogReader* r, size_t n) {
+    r->head += n;
+    r->pos += n;
+}
+
+enum { UNIT_END = 0, UNIT_LINE, UNIT_RECORD, UNIT_DAMAGED };
+
+/* what starts at head, without consuming it; *len receives its length
+ * (1 for a damaged record, whose lead byte is skipped to resynchronise) */
+static int peek_unit(OrderLogReader* r, size_t* len) {
+    if (!fill(r, 1)) return UNIT_END;
+    long n;
+    while ((n = orderbin_check(r->buf + r->head, r->len - r->head)) == ORDERBIN_SHORT) {
+        size_t avail = r->len - r->head;
+        size_t want = avail < ORDERBIN_HEADER_BYTES ? ORDERBIN_HEADER_BYTES
+            : ORDERBIN_RECORD_BYTES(orderbin_itemCount(r->buf + r->head));
+        if (!fill(r, want)) break;   /* torn at the end of the file */
+    }
+    if (n > 0) {
+        *len = (size_t)n;
+        return UNIT_RECORD;
+    }
+    if (n != 0) {
+        *len = 1;
+        return UNIT_DAMAGED;
+    }
+    size_t l;
+    while ((l = orderbin_lineLength(r->buf + r->head, r->len - r->head)) == 0) {
+        size_t avail = r->len - r->head;
+        if (avail >= r->bufCap || !fill(r, avail + 1)) {
+            l = r->len - r->head;   /* last line without '\n', or longer than the buffer */
+            break;
+        }
+    }
+    *len = l;
+    return UNIT_LINE;
+}
+
+/* the next line, terminated in place at r->line, or binary record, left
+ * at head for take_record(); *start receives its offset */
+static int next_unit(OrderLogReader* r, uint64_t* start) {
+    for (;;) {
+        if (r->recLen > 0) {
+            *start = r->pos;
+            return UNIT_RECORD;
+        }
+        size_t len;
+        int kind = peek_unit(r, &len);
+        if (kind == UNIT_END) {
+            if (!next_file(r)) return UNIT_END;
+            continue;
+        }
+        *start = r->pos;
+        if (kind == UNIT_RECORD) {
+            r->recLen = len;
+            return UNIT_RECORD;
+        }
+        char* p = r->buf + r->head;
+        consume(r, len);
+        if (kind == UNIT_DAMAGED) {
+            r->damaged++;
+            continue;
+        }
+        if (p[len - 1] == '\n') p[len - 1] = '\0';
+        else if (r->head < r->len) continue;   /* cut off by a binary record: the write was torn */
+        else p[len] = '\0';                    /* the spare byte after the data */
+        r->line = p;
+        return UNIT_LINE;
+    }
+}
+
+static int reserve_items(OrderLogReader* r, size_t n) {
+    if (n <= r->itemCap) return 1;
+    size_t newCap = r->itemCap == 0 ? 16 : r->itemCap;
+    while (newCap < n) newCap *= 2;
+    OrderItem* nd = (OrderItem*)realloc(r->items, newCap * sizeof(OrderItem));
+    if (!nd) return 0;
+    r->items = nd;
+    r->itemCap = newCap;
+    return 1;
+}
+
+static void take_record(OrderLogReader* r, OrderLogRecord* rec) {
+    const char* p = r->buf + r->head;
+    /* without room the record comes back with the items that fit */
+    reserve_items(r, orderbin_itemCount(p));
+    orderbin_decode(p, rec, r->items, r->itemCap);
+    consume(r, r->recLen);
+    r->recLen = 0;
+}
+
+int orderlog_openRange(OrderLogReader* r, const char* path, uint64_t begin, uint64_t end) {
+    memset(r, 0, sizeof(*r));
+    r->fp = fopen(path, "rb");
+    if (!r->fp || !alloc_buf(r)) {
+        orderlog_close(r);
+        return -1;
+    }
+    r->end = end;
+    if (begin > 0) {
+        /* the rest of the line or record at byte begin-1 belongs to the
+         * previous range */
+        size_t len;
+        r->pos = begin - 1;
+        if (seek_to(r->fp, begin - 1) != 0) r->done = 1;
+        else if (peek_unit(r, &len) != UNIT_END) consume(r, len);
+    }
+    return 0;
+}
+
+void orderlog_close(OrderLogReader* r) {
+    if (r->fp) fclose(r->fp);
+    if (r->damaged > 0 && METRICS_ON()) metrics_count(CTR_ORDER_LOG_DAMAGED, r->damaged);
+    free(r->buf);
+    free(r->items);
+    seglog_freeFiles(&r->files);
+    memset(r, 0, sizeof(*r));
+}
+
+int orderlog_next(OrderLogReader* r, OrderLogRecord* rec) {
+    if (!r->fp || r->done) return 0;
+    uint64_t start;
+    while (!r->havePending) {
+        int kind = next_unit(r, &start);
+        if (kind == UNIT_END || start >= r->end) {
+            r->done = 1;
+            return 0;
+        }
+        if (kind == UNIT_RECORD) {
+            take_record(r, rec);
+            return 1;
+        }
+        r->havePending = orderlog_parseHeader(r->line, &r->pending, NULL);
+    }
+    *rec = r->pending;
+    r->havePending = 0;
+
+    /* item lines up to the next header, binary record or end of file */
+    size_t n = 0;
+    while (next_unit(r, &start) == UNIT_LINE) {
+        if (orderlog_parseHeader(r->line, &r->pending, NULL)) {
+            r->havePending = start < r->end;
+            r->done = !r->havePending;
+            break;
+        }
+        OrderItem it;
+        if (!orderlog_parseItem(r->line, &it)) continue;
+        if (!reserve_items(r, n + 1)) continue;   /* the record comes back without the rest of its items */
+        r->items[n++] = it;
+    }
+    rec->items = r->items;
+    rec->itemCount = n;
+    return 1;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#ifndef ORDERLOG_H
+#define ORDERLOG_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "order.h"
+#include "money.h"
+#include "seglog.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Streaming reader for orders.log.
+     *
+     * Every order state change appends one record: a header line
+     *   ORDER,id,STATUS,CREATED|PAID|CANCELLED,ITEMS,n,TOTAL,x,CREATED,t,PAID,t
+     * followed by its "  ITEM,productId,QTY,q,UNIT,x,LINE,x" lines, or one
+     * checksummed binary record (orderbin.h). The reader yields one record
+     * per header or binary record, in file order, without keeping the log
+     * in memory. Lines it does not recognise are skipped, and so are binary
+     * records that fail their CRC (counted in damaged).
+     *
+     * orderlog_open() and orderlog_openPeriod() read a segmented log
+     * (seglog.h) as one stream: the live sealed segments oldest first,
+     * then the active file. orderlog_openRange() reads the one file.
+     */
+
+    typedef struct {
+        int         orderId;
+        OrderStatus status;
+        Money       total;
+        time_t      createdAt;
+        time_t      paidAt;       /* 0 unless PAID */
+        const OrderItem* items;   /* valid until the next orderlog_next() */
+        size_t      itemCount;
+    } OrderLogRecord;
+
+#define ORDERLOG_BUF_BYTES (64 * 1024)
+
+    typedef struct {
+        FILE*      fp;
+        char*      buf;           /* read buffer, grown for a larger binary record */
+        size_t     bufCap;        /* plus one byte to terminate the last line */
+        size_t     head;          /* next unread byte in buf */
+        size_t     len;           /* bytes held in buf */
+        int        eof;           /* fp has nothing more */
+        size_t     recLen;        /* a checked binary record waits at head */
+        const char* line;         /* the current line, terminated inside buf */
+        int        havePending;   /* pending holds a header read ahead */
+        OrderLogRecord pending;
+        OrderItem* items;
+        size_t     itemCap;
+        uint64_t   pos;           /* offset of buf[head] */
+        uint64_t   end;           /* records starting at or past this end the scan */
+        int        done;
+        uint64_t   damaged;       /* binary records skipped */
+        SegmentFiles files;       /* segments still to read after fp */
+        size_t     nextFile;
+    } OrderLogReader;
+
+    /* 0 ok, -1 if no segment of the log can be opened */
+    int  orderlog_open(OrderLogReader* r, const char* path);
+    /* only the segments that can hold records created or paid in
+     * [from, to] (0 = unbounded); callers still filter the records */
+    int  orderlog_openPeriod(OrderLogReader* r, const char* path, long long from, long long to);
+    /* only the records whose header line or binary record starts in
+     * [begin, end), so that adjacent ranges split a log between readers
+     * without overlap */
+    int  orderlog_openRange(OrderLogReader* r, const char* path, uint64_t begin, uint64_t end);
+    /* 1 with the next record, 0 at end of file */
+    int  orderlog_next(OrderLogReader* r, OrderLogRecord* rec);
+    /* adds r->damaged to the metrics, which belong to the main thread: a
+     * reader on another thread takes the count and zeroes it first */
+    void orderlog_close(OrderLogReader* r);
+
+    /* single-line parsers for callers that read the log themselves (1 ok).
+     * itemsDeclared (may be NULL) receives the header's ITEMS count,
+     * (size_t)-1 when the header has none. */
+    int  orderlog_parseHeader(const char* line, OrderLogRecord* rec, size_t* itemsDeclared);
+    int  orderlog_parseItem(const char* line, OrderItem* it);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
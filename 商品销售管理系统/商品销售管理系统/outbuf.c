@@ -0,0 +1,79 @@
+#include "outbuf.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+int outbuf_init(OutBuf* ob, FILE* fp, size_t capacity) {
+    ob->fp = fp;
+    ob->len = 0;
+    ob->cap = capacity ? capacity : OUTBUF_DEFAULT_CAP;
+    ob->data = (char*)malloc(ob->cap);
+    if (!ob->data) {
+        ob->cap = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void outbuf_free(OutBuf* ob) {
+    outbuf_flush(ob);
+    free(ob->data);
+    ob->data = NULL;
+    ob->cap = 0;
+}
+
+int outbuf_flush(OutBuf* ob) {
+    int rc = 0;
+    if (ob->len > 0 && ob->fp) {
+        if (fwrite(ob->data, 1, ob->len, ob->fp) != ob->len) rc = -1;
+        fflush(ob->fp);
+    }
+    ob->len = 0;
+    return rc;
+}
+
+void outbuf_write(OutBuf* ob, const char* s, size_t len) {
+    if (ob->len + len > ob->cap) {
+        outbuf_flush(ob);
+        if (len > ob->cap) {
+            /* larger than the whole buffer (or no buffer at all) */
+            if (ob->fp) fwrite(s, 1, len, ob->fp);
+            return;
+        }
+    }
+    memcpy(ob->data + ob->len, s, len);
+    ob->len += len;
+}
+
+void outbuf_puts(OutBuf* ob, const char* s) {
+    outbuf_write(ob, s, strlen(s));
+}
+
+void outbuf_printf(OutBuf* ob, const char* fmt, ...) {
+    va_list ap;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        size_t room = ob->cap - ob->len;
+        va_start(ap, fmt);
+        int n = vsnprintf(ob->data ? ob->data + ob->len : NULL, room, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if ((size_t)n < room) {
+            ob->len += (size_t)n;
+            return;
+        }
+        /* did not fit: flush and retry once with the whole buffer */
+        if (attempt == 0 && ob->len > 0) {
+            outbuf_flush(ob);
+            continue;
+        }
+        /* longer than the buffer: format into a temporary */
+        char* tmp = (char*)malloc((size_t)n + 1);
+        if (!tmp) return;
+        va_start(ap, fmt);
+        vsnprintf(tmp, (size_t)n + 1, fmt, ap);
+        va_end(ap);
+        outbuf_write(ob, tmp, (size_t)n);
+        free(tmp);
+        return;
+    }
+}
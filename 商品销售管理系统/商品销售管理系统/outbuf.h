@@ -0,0 +1,39 @@
+#pragma once
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Large append buffer in front of a FILE*: rows are formatted into
+     * memory and reach the stream in one fwrite per flush instead of one
+     * printf per row. With fp == NULL flushed output is discarded, which
+     * benchmarks use to time rendering alone.
+     */
+
+#define OUTBUF_DEFAULT_CAP (64 * 1024)
+
+    typedef struct OutBuf {
+        FILE*  fp;
+        char*  data;
+        size_t len;
+        size_t cap;
+    } OutBuf;
+
+    int  outbuf_init(OutBuf* ob, FILE* fp, size_t capacity);  /* -1: no buffer, writes go straight to fp */
+    void outbuf_free(OutBuf* ob);                              /* flushes first */
+
+    void outbuf_write(OutBuf* ob, const char* s, size_t len);
+    void outbuf_puts(OutBuf* ob, const char* s);
+    void outbuf_printf(OutBuf* ob, const char* fmt, ...);
+    int  outbuf_flush(OutBuf* ob);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,286 @@
+#include "partial.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PARTIAL_MAGIC "SALESPARTIAL,1"
+
+/* ---------- keyed sums ---------- */
+
+/* same codes as keytable_row */
+static int table_add(KeyTable* t, int key, long long count, long long units, Money amount) {
+    void* row;
+    int rc = keytable_row(t, key, &row);
+    if (rc != 0) return rc;
+    PartialRow* r = (PartialRow*)row;
+    r->count += count;
+    r->units += units;
+    r->amount += amount;
+    return 0;
+}
+
+static int table_merge(KeyTable* dst, const KeyTable* src) {
+    for (size_t i = 0; i < src->size; ++i) {
+        const PartialRow* r = (const PartialRow*)src->data + i;
+        if (table_add(dst, r->key, r->count, r->units, r->amount) == -2) return -1;
+    }
+    return 0;
+}
+
+void partial_init(SalesPartial* p) {
+    p->ordersCreated = 0;
+    p->ordersPaid = 0;
+    p->ordersCancelled = 0;
+    p->revenue = 0;
+    keytable_init(&p->months, sizeof(PartialRow));
+    keytable_init(&p->products, sizeof(PartialRow));
+    keytable_init(&p->purchases, sizeof(PartialRow));
+    timeutil_monthCacheInit(&p->monthCache);
+}
+
+void partial_free(SalesPartial* p) {
+    keytable_free(&p->months);
+    keytable_free(&p->products);
+    keytable_free(&p->purchases);
+    partial_init(p);
+}
+
+int partial_merge(SalesPartial* dst, const SalesPartial* src) {
+    dst->ordersCreated += src->ordersCreated;
+    dst->ordersPaid += src->ordersPaid;
+    dst->ordersCancelled += src->ordersCancelled;
+    dst->revenue += src->revenue;
+    if (table_merge(&dst->months, &src->months) != 0) return -1;
+    if (table_merge(&dst->products, &src->products) != 0) return -1;
+    return table_merge(&dst->purchases, &src->purchases);
+}
+
+/* ---------- building from the logs ---------- */
+
+int partial_addOrder(SalesPartial* p, const OrderLogRecord* rec) {
+    if (rec->status == ORDER_CREATED) {
+        p->ordersCreated++;
+        return 0;
+    }
+    if (rec->status == ORDER_CANCELLED) {
+        p->ordersCancelled++;
+        return 0;
+    }
+    p->ordersPaid++;
+    p->revenue += rec->total;
+    time_t when = rec->paidAt ? rec->paidAt : rec->createdAt;
+    /* rows with keys that cannot be stored (no month, product id <= 0) are
+     * left out, as before; only running out of memory fails */
+    if (when > 0 && table_add(&p->months, timeutil_monthKey(&p->monthCache, when), 1, 0, rec->total) == -2) return -1;
+    for (size_t i = 0; i < rec->itemCount; ++i) {
+        const OrderItem* it = &rec->items[i];
+        if (table_add(&p->products, it->productId, 1, it->quantity, it->lineTotal) == -2) return -1;
+    }
+    return 0;
+}
+
+int partial_addPurchase(SalesPartial* p, const Purchase* rec) {
+    int rc = table_add(&p->purchases, rec->productId, 1, rec->quantity, money_mul(rec->unitCost, rec->quantity));
+    return rc == -2 ? -1 : 0;
+}
+
+int partial_addOrderLog(SalesPartial* p, const char* path) {
+    OrderLogReader r;
+    if (orderlog_open(&r, path) != 0) return -1;
+    TRACE_BEGIN("partial_orders");
+    OrderLogRecord rec;
+    int rc = 0;
+    while (rc == 0 && orderlog_next(&r, &rec)) {
+        if (partial_addOrder(p, &rec) != 0) rc = -2;
+    }
+    TRACE_END();
+    orderlog_close(&r);
+    return rc;
+}
+
+int partial_addPurchaseLog(SalesPartial* p, const char* path) {
+    PurchaseReader r;
+    if (purchase_openReader(&r, path) != 0) return -1;
+    Purchase rec;
+    int rc = 0;
+    while (rc == 0 && purchase_next(&r, &rec)) {
+        if (partial_addPurchase(p, &rec) != 0) rc = -2;
+    }
+    purchase_closeReader(&r);
+    return rc;
+}
+
+/* ---------- file form ---------- */
+
+static void write_table(FILE* fp, const char* tag, const KeyTable* t, int withUnits) {
+    char amount[MONEY_STR_MAX];
+    for (size_t i = 0; i < t->size; ++i) {
+        const PartialRow* r = (const PartialRow*)t->data + i;
+        if (withUnits) {
+            fprintf(fp, "%s,%d,%lld,%lld,%s\n", tag, r->key, r->count, r->units, money_str(r->amount, amount));
+        }
+        else {
+            fprintf(fp, "%s,%d,%lld,%s\n", tag, r->key, r->count, money_str(r->amount, amount));
+        }
+    }
+}
+
+int partial_write(const SalesPartial* p, const char* path) {
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* fp = fopen(tmp, "w");
+    if (!fp) return -1;
+    char revenue[MONEY_STR_MAX];
+    fprintf(fp, "%s\n", PARTIAL_MAGIC);
+    fprintf(fp, "SUMMARY,%lld,%lld,%lld,%s\n", p->ordersCreated, p->ordersPaid, p->ordersCancelled,
+        money_str(p->revenue, revenue));
+    write_table(fp, "MONTH", &p->months, 0);
+    write_table(fp, "PRODUCT", &p->products, 1);
+    write_table(fp, "PURCHASE", &p->purchases, 1);
+    int rc = ferror(fp) ? -1 : 0;
+    if (fclose(fp) != 0) rc = -1;
+    if (rc == 0) {
+        remove(path);   /* rename does not replace on Windows */
+        if (rename(tmp, path) != 0) rc = -1;
+    }
+    if (rc != 0) remove(tmp);
+    return rc;
+}
+
+static const char* parse_ll(const char* s, long long* out) {
+    if (!s) return NULL;
+    char* end;
+    *out = strtoll(s, &end, 10);
+    return end == s ? NULL : end;
+}
+
+/* expects a ',' and moves past it */
+static const char* next_field(const char* s) {
+    return (s && *s == ',') ? s + 1 : NULL;
+}
+
+static const char* parse_amount(const char* s, Money* out) {
+    return s ? money_parse(s, out) : NULL;
+}
+
+/* key,count[,units],amount after the tag */
+static int parse_row(const char* s, int withUnits, PartialRow* r) {
+    long long key;
+    memset(r, 0, sizeof(*r));
+    if (!(s = parse_ll(s, &key)) || key <= 0 || key > 0x7fffffff) return 0;
+    r->key = (int)key;
+    if (!(s = parse_ll(next_field(s), &r->count))) return 0;
+    if (withUnits && !(s = parse_ll(next_field(s), &r->units))) return 0;
+    return parse_amount(next_field(s), &r->amount) != NULL;
+}
+
+int partial_read(SalesPartial* p, const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return -1;
+    char line[256];
+    if (!fgets(line, sizeof(line), fp) || strncmp(line, PARTIAL_MAGIC, sizeof(PARTIAL_MAGIC) - 1) != 0) {
+        fclose(fp);
+        return -2;
+    }
+    int keys = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        PartialRow r;
+        KeyTable* t = NULL;
+        if (strncmp(line, "MONTH,", 6) == 0) {
+            if (parse_row(line + 6, 0, &r)) t = &p->months;
+        }
+        else if (strncmp(line, "PRODUCT,", 8) == 0) {
+            if (parse_row(line + 8, 1, &r)) t = &p->products;
+        }
+        else if (strncmp(line, "PURCHASE,", 9) == 0) {
+            if (parse_row(line + 9, 1, &r)) t = &p->purchases;
+        }
+        else if (strncmp(line, "SUMMARY,", 8) == 0) {
+            long long created, paid, cancelled;
+            Money revenue;
+            const char* s = parse_ll(line + 8, &created);
+            s = parse_ll(next_field(s), &paid);
+            s = parse_ll(next_field(s), &cancelled);
+            if (parse_amount(next_field(s), &revenue)) {
+                p->ordersCreated += created;
+                p->ordersPaid += paid;
+                p->ordersCancelled += cancelled;
+                p->revenue += revenue;
+            }
+        }
+        if (!t) continue;
+        if (table_add(t, r.key, r.count, r.units, r.amount) != 0) {
+            keys = -3;   /* parse_row only passes keys > 0 */
+            break;
+        }
+        keys++;
+    }
+    fclose(fp);
+    return keys;
+}
+
+/* ---------- report ---------- */
+
+static int cmp_key_asc(const void* a, const void* b) {
+    const PartialRow* x = *(const PartialRow* const*)a;
+    const PartialRow* y = *(const PartialRow* const*)b;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+static int cmp_units_desc(const void* a, const void* b) {
+    const PartialRow* x = *(const PartialRow* const*)a;
+    const PartialRow* y = *(const PartialRow* const*)b;
+    if (x->units != y->units) return (x->units < y->units) - (x->units > y->units);
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+/* row pointers in order (malloc'd), NULL when empty or out of memory */
+static const PartialRow** sorted_rows(const KeyTable* t, int (*cmp)(const void*, const void*)) {
+    if (t->size == 0) return NULL;
+    const PartialRow** rows = (const PartialRow**)malloc(t->size * sizeof(PartialRow*));
+    if (!rows) return NULL;
+    for (size_t i = 0; i < t->size; ++i) rows[i] = (const PartialRow*)t->data + i;
+    qsort(rows, t->size, sizeof(PartialRow*), cmp);
+    return rows;
+}
+
+void partial_printReport(const SalesPartial* p, ProductList* products, int topN) {
+    char a[MONEY_STR_MAX], b[MONEY_STR_MAX];
+    printf("\n=== Sales Summary (consolidated) ===\n");
+    printf("Orders created: %lld\n", p->ordersCreated);
+    printf("Paid orders: %lld\n", p->ordersPaid);
+    printf("Cancelled orders: %lld\n", p->ordersCancelled);
+    printf("Total revenue (paid): %s\n", money_str(p->revenue, a));
+    if (p->ordersPaid > 0) printf("Average per paid order: %s\n", money_str(money_div(p->revenue, p->ordersPaid), a));
+
+    printf("\n=== Monthly Sales (paid only) ===\n");
+    printf("%-7s %-10s %-10s\n", "Month", "PaidCount", "Revenue");
+    const PartialRow** rows = sorted_rows(&p->months, cmp_key_asc);
+    for (size_t i = 0; rows && i < p->months.size; ++i) {
+        printf("%04d-%02d %-10lld %-10s\n", rows[i]->key / 100, rows[i]->key % 100, rows[i]->count,
+            money_str(rows[i]->amount, a));
+    }
+    free(rows);
+
+    printf("\n=== Top Products (paid only) ===\n");
+    printf("%-6s %-20s %-10s %-12s\n", "ID", "Name", "Qty", "Revenue");
+    if (topN <= 0) topN = 10;
+    rows = sorted_rows(&p->products, cmp_units_desc);
+    for (size_t i = 0; rows && i < p->products.size && i < (size_t)topN; ++i) {
+        const Product* prod = products ? findProductById(products, rows[i]->key) : NULL;
+        printf("%-6d %-20s %-10lld %-12s\n", rows[i]->key, prod ? productName(products, prod) : "(unknown)",
+            rows[i]->units, money_str(rows[i]->amount, a));
+    }
+    free(rows);
+
+    printf("\n=== Purchase Summary By Product ===\n");
+    printf("%-8s %-10s %-12s %-12s\n", "ProdID", "TotalQty", "TotalCost", "AvgCost");
+    rows = sorted_rows(&p->purchases, cmp_units_desc);
+    for (size_t i = 0; rows && i < p->purchases.size; ++i) {
+        printf("%-8d %-10lld %-12s %-12s\n", rows[i]->key, rows[i]->units, money_str(rows[i]->amount, a),
+            money_str(rows[i]->units > 0 ? money_div(rows[i]->amount, rows[i]->units) : 0, b));
+    }
+    free(rows);
+}
@@ -0,0 +1,86 @@
+#pragma once
+#ifndef PARTIAL_H
+#define PARTIAL_H
+
+#include <stddef.h>
+#include <time.h>
+#include "money.h"
+#include "keytable.h"
+#include "timeutil.h"
+#include "product.h"
+#include "orderlog.h"
+#include "purchase.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Mergeable partial aggregates for consolidated reporting.
+     *
+     * Each instance folds its own orders.log and purchase_log.csv into a
+     * SalesPartial and writes it out; a coordinator reads any number of
+     * partial files into one SalesPartial and prints the combined reports.
+     * Every field is a sum keyed by month or product id, so merging is
+     * associative and commutative and costs O(keys), not O(log lines):
+     * merged partials can themselves be merged again.
+     *
+     * File format (text, one line per key):
+     *   SALESPARTIAL,1
+     *   SUMMARY,created,paid,cancelled,revenue
+     *   MONTH,yyyymm,paidOrders,revenue
+     *   PRODUCT,productId,paidLines,units,revenue
+     *   PURCHASE,productId,receipts,units,cost
+     * Months are local time of the payment, like the monthly report.
+     */
+
+    /* the rows of each KeyTable below */
+    typedef struct {
+        int       key;        /* yyyymm or product id */
+        long long count;
+        long long units;
+        Money     amount;
+    } PartialRow;
+
+    typedef struct {
+        long long    ordersCreated;
+        long long    ordersPaid;
+        long long    ordersCancelled;
+        Money        revenue;
+        KeyTable     months;
+        KeyTable     products;
+        KeyTable     purchases;
+        MonthCache   monthCache;
+    } SalesPartial;
+
+    void partial_init(SalesPartial* p);
+    void partial_free(SalesPartial* p);
+
+    /* one record at a time (a follower tailing the logs); 0 ok, -1 when
+     * out of memory, in which case some of its rows are missing */
+    int  partial_addOrder(SalesPartial* p, const OrderLogRecord* rec);
+    int  partial_addPurchase(SalesPartial* p, const Purchase* rec);
+
+    /* fold a whole log in; -1 if it cannot be opened, -2 when out of
+     * memory (p is then incomplete) */
+    int  partial_addOrderLog(SalesPartial* p, const char* path);
+    int  partial_addPurchaseLog(SalesPartial* p, const char* path);
+
+    /* dst += src; -1 when out of memory */
+    int  partial_merge(SalesPartial* dst, const SalesPartial* src);
+
+    /* 0 ok, -1 on I/O error (written to a temp file, then renamed) */
+    int  partial_write(const SalesPartial* p, const char* path);
+    /* merges the file into p. Returns the keys read, -1 if it cannot be
+     * opened, -2 if it is not a partial file of this version, -3 when out
+     * of memory (p then holds part of the file). */
+    int  partial_read(SalesPartial* p, const char* path);
+
+    /* summary, monthly sales, top products and purchases; names are taken
+     * from products when it is not NULL */
+    void partial_printReport(const SalesPartial* p, ProductList* products, int topN);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
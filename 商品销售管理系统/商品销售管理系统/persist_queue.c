@@ -0,0 +1,430 @@
+#include "persist_queue.h"
+#include "thread_util.h"
+#include "compat.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define PQ_MAX_TARGETS 16
+#define PQ_PATH_MAX    260
+#define PQ_HDR_SIZE    8   /* uint32 len + uint32 target */
+#define PQ_OP_REPLACE  0x80000000u   /* target flag: payload is a ReplaceOp */
+#define PQ_OP_RENAME   0x40000000u   /* target flag: payload is the new path */
+
+typedef struct {
+    char*    data;
+    uint64_t len;
+} ReplaceOp;
+
+typedef struct {
+    char*  buf;
+    size_t cap;             /* power of two */
+    size_t mask;
+
+    volatile uint64_t head; /* written by producer only */
+    volatile uint64_t tail; /* written by writer only: consumed AND flushed */
+    volatile uint64_t sleeping;
+    volatile uint64_t stopping;
+
+    Mutex   mu;
+    CondVar wake;           /* producer -> writer: data available / stop */
+    CondVar drained;        /* writer -> producer: tail advanced */
+
+    ThreadHandle th;
+    int          running;
+    int          paused;    /* producer holds mu until pq_resume */
+    PqFullPolicy policy;
+
+    char  paths[PQ_MAX_TARGETS][PQ_PATH_MAX];
+    FILE* files[PQ_MAX_TARGETS];
+    int   nTargets;
+
+    /* under mu; the producer's own counters are kept apart so that it
+     * never takes the lock just to count */
+    PqStats stats;
+    int     failed;             /* a write failed since the last pq_flush */
+    /* failed writes per target, stored under mu and loaded without it;
+     * taken[] is how many of them the producer has collected */
+    volatile uint64_t targetErrors[PQ_MAX_TARGETS];
+    uint64_t          taken[PQ_MAX_TARGETS];
+    unsigned long long fullStalls;  /* producer only */
+    size_t             highWater;   /* producer only */
+} PersistQueue;
+
+static PersistQueue g_pq;
+
+/* ---------- ring helpers ---------- */
+
+static void ring_put(uint64_t pos, const void* src, size_t len) {
+    size_t off = (size_t)(pos & g_pq.mask);
+    size_t first = g_pq.cap - off;
+    if (first > len) first = len;
+    memcpy(g_pq.buf + off, src, first);
+    if (len > first) memcpy(g_pq.buf, (const char*)src + first, len - first);
+}
+
+static void ring_get(uint64_t pos, void* dst, size_t len) {
+    size_t off = (size_t)(pos & g_pq.mask);
+    size_t first = g_pq.cap - off;
+    if (first > len) first = len;
+    memcpy(dst, g_pq.buf + off, first);
+    if (len > first) memcpy((char*)dst + first, g_pq.buf, len - first);
+}
+
+/* ---------- writer thread ---------- */
+
+static FILE* target_file(int target) {
+    if (target < 0 || target >= g_pq.nTargets) return NULL;
+    if (!g_pq.files[target]) {
+        /* byte for byte: orders.log may hold binary records */
+        g_pq.files[target] = fopen(g_pq.paths[target], "ab");
+    }
+    return g_pq.files[target];
+}
+
+static void write_record(uint64_t pos, size_t len, int target,
+    unsigned long long* written, unsigned long long* errors) {
+    FILE* fp = target_file(target);
+    if (!fp) {
+        errors[target]++;
+        return;
+    }
+    size_t off = (size_t)(pos & g_pq.mask);
+    size_t first = g_pq.cap - off;
+    if (first > len) first = len;
+    size_t ok = fwrite(g_pq.buf + off, 1, first, fp);
+    if (len > first) ok += fwrite(g_pq.buf, 1, len - first, fp);
+    if (ok != len) errors[target]++;
+    *written += len;
+}
+
+static int replace_file(int target, const ReplaceOp* op) {
+    if (target < 0 || target >= g_pq.nTargets) return -1;
+    /* later appends reopen the new file */
+    if (g_pq.files[target]) {
+        fclose(g_pq.files[target]);
+        g_pq.files[target] = NULL;
+    }
+    char tmp[PQ_PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", g_pq.paths[target]);
+    FILE* fp = fopen(tmp, "wb");
+    if (!fp) return -1;
+    size_t ok = fwrite(op->data, 1, (size_t)op->len, fp);
+    if (fclose(fp) != 0 || ok != op->len) {
+        remove(tmp);
+        return -1;
+    }
+#if defined(_WIN32)
+    remove(g_pq.paths[target]);   /* rename does not replace on Windows */
+#endif
+    return rename(tmp, g_pq.paths[target]) == 0 ? 0 : -1;
+}
+
+static int rename_file(int target, const char* newPath) {
+    if (target < 0 || target >= g_pq.nTargets) return -1;
+    if (g_pq.files[target]) {
+        fclose(g_pq.files[target]);
+        g_pq.files[target] = NULL;
+    }
+    return rename(g_pq.paths[target], newPath) == 0 ? 0 : -1;
+}
+
+static void writer_main(void* arg) {
+    (void)arg;
+    trace_setThreadName("persist-writer");
+    uint64_t t = g_pq.tail;
+    for (;;) {
+        uint64_t h = atomic_loadU64(&g_pq.head);
+        if (h == t) {
+            if (atomic_loadU64(&g_pq.stopping)) break;
+            mutex_lock(&g_pq.mu);
+            atomic_storeU64(&g_pq.sleeping, 1);
+            cond_broadcast(&g_pq.drained);   /* pq_pause waits for this */
+            while (atomic_loadU64(&g_pq.head) == t && !atomic_loadU64(&g_pq.stopping)) {
+                cond_wait(&g_pq.wake, &g_pq.mu);
+            }
+            atomic_storeU64(&g_pq.sleeping, 0);
+            mutex_unlock(&g_pq.mu);
+            continue;
+        }
+
+        /* drain everything published so far */
+        TRACE_BEGIN("pq_drain");
+        unsigned long long recs = 0, bytes = 0, replaces = 0, renames = 0;
+        unsigned long long errors[PQ_MAX_TARGETS + 1] = { 0 };   /* the last: bad targets */
+        int dirty[PQ_MAX_TARGETS] = { 0 };
+        while (t < h) {
+            unsigned char hdr[PQ_HDR_SIZE];
+            uint32_t len, target;
+            ring_get(t, hdr, PQ_HDR_SIZE);
+            memcpy(&len, hdr, 4);
+            memcpy(&target, hdr + 4, 4);
+            if (target & PQ_OP_REPLACE) {
+                ReplaceOp op;
+                ring_get(t + PQ_HDR_SIZE, &op, sizeof(op));
+                target &= ~PQ_OP_REPLACE;
+                if (replace_file((int)target, &op) != 0) errors[target < PQ_MAX_TARGETS ? target : PQ_MAX_TARGETS]++;
+                free(op.data);
+                replaces++;
+                if (target < PQ_MAX_TARGETS) dirty[target] = 0;
+            }
+            else if (target & PQ_OP_RENAME) {
+                char newPath[PQ_PATH_MAX];
+                ring_get(t + PQ_HDR_SIZE, newPath, len);
+                newPath[len] = '\0';
+                target &= ~PQ_OP_RENAME;
+                if (rename_file((int)target, newPath) != 0) errors[target < PQ_MAX_TARGETS ? target : PQ_MAX_TARGETS]++;
+                renames++;
+                if (target < PQ_MAX_TARGETS) dirty[target] = 0;
+            }
+            else {
+                write_record(t + PQ_HDR_SIZE, len, target < PQ_MAX_TARGETS ? (int)target : PQ_MAX_TARGETS,
+                    &bytes, errors);
+                if (target < PQ_MAX_TARGETS) dirty[target] = 1;
+            }
+            t += PQ_HDR_SIZE + len;
+            recs++;
+        }
+        for (int i = 0; i < g_pq.nTargets; ++i) {
+            if (dirty[i] && g_pq.files[i] && fflush(g_pq.files[i]) != 0) errors[i]++;
+        }
+        TRACE_END();
+
+        mutex_lock(&g_pq.mu);
+        atomic_storeU64(&g_pq.tail, t);
+        g_pq.stats.records += recs;
+        g_pq.stats.bytes += bytes;
+        g_pq.stats.replaces += replaces;
+        g_pq.stats.renames += renames;
+        for (int i = 0; i <= PQ_MAX_TARGETS; ++i) {
+            if (!errors[i]) continue;
+            g_pq.stats.writeErrors += errors[i];
+            g_pq.failed = 1;
+            if (i < PQ_MAX_TARGETS) atomic_storeU64(&g_pq.targetErrors[i], g_pq.targetErrors[i] + errors[i]);
+        }
+        cond_broadcast(&g_pq.drained);
+        mutex_unlock(&g_pq.mu);
+    }
+}
+
+/* ---------- public APIs ---------- */
+
+int pq_registerFile(const char* path) {
+    if (!path || g_pq.running || g_pq.nTargets >= PQ_MAX_TARGETS) return -1;
+    for (int i = 0; i < g_pq.nTargets; ++i) {
+        if (strcmp(g_pq.paths[i], path) == 0) return i;
+    }
+    strncpy_s(g_pq.paths[g_pq.nTargets], PQ_PATH_MAX, path, _TRUNCATE);
+    g_pq.files[g_pq.nTargets] = NULL;
+    return g_pq.nTargets++;
+}
+
+int pq_start(size_t capacityBytes, PqFullPolicy policy) {
+    if (g_pq.running) return 0;
+    size_t cap = 4096;
+    while (cap < capacityBytes) cap <<= 1;
+
+    g_pq.buf = (char*)malloc(cap);
+    if (!g_pq.buf) return -1;
+    g_pq.cap = cap;
+    g_pq.mask = cap - 1;
+    g_pq.head = 0;
+    g_pq.tail = 0;
+    g_pq.sleeping = 0;
+    g_pq.stopping = 0;
+    g_pq.policy = policy;
+    memset(&g_pq.stats, 0, sizeof(g_pq.stats));
+    g_pq.failed = 0;
+    memset((void*)g_pq.targetErrors, 0, sizeof(g_pq.targetErrors));
+    memset(g_pq.taken, 0, sizeof(g_pq.taken));
+    g_pq.fullStalls = 0;
+    g_pq.highWater = 0;
+
+    mutex_init(&g_pq.mu);
+    cond_init(&g_pq.wake);
+    cond_init(&g_pq.drained);
+
+    if (thread_start(&g_pq.th, writer_main, NULL) != 0) {
+        cond_destroy(&g_pq.drained);
+        cond_destroy(&g_pq.wake);
+        mutex_destroy(&g_pq.mu);
+        free(g_pq.buf);
+        g_pq.buf = NULL;
+        return -1;
+    }
+    g_pq.running = 1;
+    return 0;
+}
+
+int pq_isRunning(void) {
+    return g_pq.running;
+}
+
+/* waits until the writer has consumed everything queued so far */
+static void drain(void) {
+    uint64_t target = g_pq.head;
+    if (atomic_loadU64(&g_pq.tail) >= target) return;
+    mutex_lock(&g_pq.mu);
+    while (atomic_loadU64(&g_pq.tail) < target) {
+        cond_signal(&g_pq.wake);
+        cond_wait(&g_pq.drained, &g_pq.mu);
+    }
+    mutex_unlock(&g_pq.mu);
+}
+
+/* record larger than the ring: drain first, then write inline */
+static int append_oversize(int target, const char* data, size_t len) {
+    drain();
+    FILE* fp = fopen(g_pq.paths[target], "ab");
+    size_t ok = fp ? fwrite(data, 1, len, fp) : 0;
+    int rc = (fp && fclose(fp) == 0 && ok == len) ? 0 : -1;
+    mutex_lock(&g_pq.mu);
+    if (rc == 0) {
+        g_pq.stats.records++;
+        g_pq.stats.bytes += len;
+    }
+    else {
+        g_pq.stats.writeErrors++;
+        g_pq.failed = 1;
+        atomic_storeU64(&g_pq.targetErrors[target], g_pq.targetErrors[target] + 1);
+    }
+    mutex_unlock(&g_pq.mu);
+    return rc;
+}
+
+static int enqueue(uint32_t tag, const void* data, size_t len) {
+    size_t need = PQ_HDR_SIZE + len;
+    uint64_t h = g_pq.head;
+    if (g_pq.cap - (size_t)(h - atomic_loadU64(&g_pq.tail)) < need) {
+        g_pq.fullStalls++;
+        if (g_pq.policy == PQ_FULL_FAIL) return -1;
+        mutex_lock(&g_pq.mu);
+        while (g_pq.cap - (size_t)(h - atomic_loadU64(&g_pq.tail)) < need) {
+            cond_signal(&g_pq.wake);
+            cond_wait(&g_pq.drained, &g_pq.mu);
+        }
+        mutex_unlock(&g_pq.mu);
+    }
+
+    unsigned char hdr[PQ_HDR_SIZE];
+    uint32_t len32 = (uint32_t)len;
+    memcpy(hdr, &len32, 4);
+    memcpy(hdr + 4, &tag, 4);
+    ring_put(h, hdr, PQ_HDR_SIZE);
+    ring_put(h + PQ_HDR_SIZE, data, len);
+    atomic_storeU64(&g_pq.head, h + need);
+
+    size_t queued = (size_t)(h + need - atomic_loadU64(&g_pq.tail));
+    if (queued > g_pq.highWater) g_pq.highWater = queued;
+
+    if (atomic_loadU64(&g_pq.sleeping)) {
+        mutex_lock(&g_pq.mu);
+        cond_signal(&g_pq.wake);
+        mutex_unlock(&g_pq.mu);
+    }
+    return 0;
+}
+
+int pq_append(int target, const char* data, size_t len) {
+    if (!g_pq.running || target < 0 || target >= g_pq.nTargets) return -1;
+    if (PQ_HDR_SIZE + len > g_pq.cap / 2) return append_oversize(target, data, len);
+    return enqueue((uint32_t)target, data, len);
+}
+
+int pq_replace(int target, char* data, size_t len) {
+    if (!g_pq.running || target < 0 || target >= g_pq.nTargets) {
+        free(data);
+        return -1;
+    }
+    ReplaceOp op;
+    op.data = data;
+    op.len = len;
+    if (enqueue((uint32_t)target | PQ_OP_REPLACE, &op, sizeof(op)) != 0) {
+        free(data);
+        return -1;
+    }
+    return 0;
+}
+
+int pq_rename(int target, const char* newPath) {
+    if (!g_pq.running || target < 0 || target >= g_pq.nTargets) return -1;
+    size_t len = strlen(newPath);
+    if (len >= PQ_PATH_MAX) return -1;
+    return enqueue((uint32_t)target | PQ_OP_RENAME, newPath, len);
+}
+
+int pq_flush(void) {
+    if (!g_pq.running) return 0;
+    drain();
+    mutex_lock(&g_pq.mu);
+    int rc = g_pq.failed ? -1 : 0;
+    g_pq.failed = 0;
+    mutex_unlock(&g_pq.mu);
+    return rc;
+}
+
+void pq_pause(void) {
+    if (!g_pq.running || g_pq.paused) return;
+    drain();
+    mutex_lock(&g_pq.mu);
+    /* sleeping is set under mu, so once it reads 1 here the writer is in
+     * cond_wait and cannot get past it while we hold the lock */
+    while (!atomic_loadU64(&g_pq.sleeping)) {
+        cond_wait(&g_pq.drained, &g_pq.mu);
+    }
+    g_pq.paused = 1;
+}
+
+void pq_resume(void) {
+    if (!g_pq.paused) return;
+    g_pq.paused = 0;
+    mutex_unlock(&g_pq.mu);
+}
+
+void pq_stop(void) {
+    if (!g_pq.running) return;
+    drain();
+
+    mutex_lock(&g_pq.mu);
+    atomic_storeU64(&g_pq.stopping, 1);
+    cond_signal(&g_pq.wake);
+    mutex_unlock(&g_pq.mu);
+    thread_join(g_pq.th);
+
+    for (int i = 0; i < g_pq.nTargets; ++i) {
+        if (g_pq.files[i]) {
+            fclose(g_pq.files[i]);
+            g_pq.files[i] = NULL;
+        }
+    }
+    cond_destroy(&g_pq.drained);
+    cond_destroy(&g_pq.wake);
+    mutex_destroy(&g_pq.mu);
+    free(g_pq.buf);
+    g_pq.buf = NULL;
+    g_pq.running = 0;
+}
+
+unsigned long long pq_takeErrors(int target) {
+    if (target < 0 || target >= PQ_MAX_TARGETS) return 0;
+    uint64_t n = atomic_loadU64(&g_pq.targetErrors[target]);
+    uint64_t fresh = n - g_pq.taken[target];
+    g_pq.taken[target] = n;
+    return (unsigned long long)fresh;
+}
+
+void pq_getStats(PqStats* out) {
+    if (!out) return;
+    if (!g_pq.running) {
+        *out = g_pq.stats;
+    }
+    else {
+        mutex_lock(&g_pq.mu);
+        *out = g_pq.stats;
+        mutex_unlock(&g_pq.mu);
+    }
+    out->fullStalls = g_pq.fullStalls;
+    out->highWater = g_pq.highWater;
+}
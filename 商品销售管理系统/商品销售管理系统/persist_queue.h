@@ -0,0 +1,79 @@
+#pragma once
+#ifndef PERSIST_QUEUE_H
+#define PERSIST_QUEUE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Background persistence thread fed by a single-producer ring buffer.
+     * The producer (main loop) enqueues already-serialized records; the
+     * writer thread appends them to their target files in order.
+     *
+     * Usage: pq_registerFile() for each target, then pq_start().
+     * pq_append() and the other calls below must only be made from that
+     * one thread.
+     */
+
+    typedef enum {
+        PQ_FULL_BLOCK = 0,   /* wait until the writer frees space */
+        PQ_FULL_FAIL         /* return -1 immediately, caller decides */
+    } PqFullPolicy;
+
+    typedef struct {
+        unsigned long long records;      /* records written */
+        unsigned long long bytes;        /* payload bytes written */
+        unsigned long long fullStalls;   /* appends that hit a full ring */
+        unsigned long long writeErrors;  /* fopen/fwrite failures in the writer */
+        unsigned long long replaces;     /* whole-file replacements (pq_replace) */
+        unsigned long long renames;      /* files moved aside (pq_rename) */
+        size_t             highWater;    /* max bytes queued at once */
+    } PqStats;
+
+    int  pq_registerFile(const char* path);  /* target id >= 0, -1 if table full */
+    int  pq_start(size_t capacityBytes, PqFullPolicy policy);
+    int  pq_isRunning(void);
+
+    /* 0 = queued, -1 = full (PQ_FULL_FAIL) or not running */
+    int  pq_append(int target, const char* data, size_t len);
+
+    /* replace the target file with data, in order with the appends queued
+     * before and after it (written to <path>.tmp, then renamed over the
+     * file). Takes ownership of data, which must come from malloc; it is
+     * freed even on failure. 0 = queued, -1 = full (PQ_FULL_FAIL) or not
+     * running. */
+    int  pq_replace(int target, char* data, size_t len);
+
+    /* rename the target file to newPath, in order with the queued appends;
+     * the appends queued after it start a new file at the target's path.
+     * 0 = queued, -1 = full (PQ_FULL_FAIL), not running or path too long */
+    int  pq_rename(int target, const char* newPath);
+
+    /* barrier: returns once everything queued so far is on disk (fflush'ed).
+     * -1 when a write, replace or rename failed since the previous
+     * pq_flush(), so that data is missing from its file; 0 otherwise */
+    int  pq_flush(void);
+
+    /* parks the writer: drains the queue and returns with the writer
+     * blocked on the queue lock, so every target file holds whole records
+     * and none is renamed until pq_resume(). Keep the section short; no
+     * other pq call in between. No-op when not running. */
+    void pq_pause(void);
+    void pq_resume(void);
+
+    /* flush, stop the writer thread and close target files */
+    void pq_stop(void);
+
+    void pq_getStats(PqStats* out);
+
+    /* failed writes, replaces and renames of one target since the previous
+     * call; cheap enough to call after every append */
+    unsigned long long pq_takeErrors(int target);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
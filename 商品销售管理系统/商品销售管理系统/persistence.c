@@ -3,8 +3,30 @@
 #include <string.h>
 #include <limits.h>
 #include "persistence.h"
+#include "compat.h"
+#include "metrics.h"
+#include "trace.h"
 
-int loadProductsFromCSV(const char* filename, ProductList* list) {
+typedef struct {
+    Product p;
+    char    name[PRODUCT_NAME_MAX];
+} ProductLine;
+
+/* id,name,price,stock; the price is parsed straight into integer cents */
+static int parseProductLine(const char* line, ProductLine* row) {
+    Product* p = &row->p;
+    int off = 0;
+    if (sscanf_s(line, "%d,%63[^,],%n", &p->id, row->name SCANF_BUFSZ(row->name), &off) != 2 || off == 0) return 0;
+    const char* rest = money_parse(line + off, &p->price);
+    if (!rest || *rest != ',') return 0;
+    char* end;
+    long stock = strtol(rest + 1, &end, 10);
+    if (end == rest + 1 || stock < INT_MIN || stock > INT_MAX) return 0;
+    p->stock = (int)stock;
+    return 1;
+}
+
+static int loadProductsFromCSVImpl(const char* filename, ProductList* list) {
     FILE* fp = fopen(filename, "r");
     if (!fp) return -1;
     char line[256];
@@ -12,71 +34,86 @@ int loadProductsFromCSV(const char* filename, ProductList* list) {
     int maxId = 0;
     while (fgets(line, sizeof(line), fp)) {
         if (line[0] == '#' || line[0] == '\n') continue;
-        Product p;
-        char nameBuf[64];
-        // Replace unsafe sscanf with sscanf_s for safer parsing
-        if (sscanf_s(line, "%d,%63[^,],%lf,%d", &p.id, nameBuf, (unsigned)_countof(nameBuf), &p.price, &p.stock) == 4) 
+        ProductLine row;
+        if (parseProductLine(line, &row))
         {
-            if (list->size >= list->capacity) {
-                size_t newCap = list->capacity == 0 ? 8 : list->capacity * 2;
-                Product* newData = (Product*)realloc(list->data, newCap * sizeof(Product));
-                if (!newData) {
-                    fclose(fp);
-                    return -2;
-                }
-                list->data = newData;
-                list->capacity = newCap;
+            const Product* p = &row.p;
+            if (!appendLoadedProduct(list, p->id, row.name, p->price, p->stock)) {
+                fclose(fp);
+                return -2;
             }
-            Product* dst = &list->data[list->size++];
-            dst->id = p.id;
-            // Replace unsafe strncpy with safer strncpy_s
-
-strncpy_s(dst->name, sizeof(dst->name), nameBuf, _TRUNCATE);
-            dst->name[sizeof(dst->name) - 1] = '\0';
-            dst->price = p.price;
-            dst->stock = p.stock;
-            if (p.id > maxId) maxId = p.id;
+            if (p->id > maxId) maxId = p->id;
             count++;
         }
     }
     fclose(fp);
     list->nextId = maxId + 1;
+    list->version++;
+    if (list->nameIndex) rebuildProductNameIndex(list);
     return count;
 }
 
-int saveProductsToCSV(const char* filename, const ProductList* list) {
+static int saveProductsToCSVImpl(const char* filename, const ProductList* list) {
     FILE* fp = fopen(filename, "w");
     if (!fp) return -1;
     fprintf(fp, "#id,name,price,stock\n");
+    char price[MONEY_STR_MAX];
     for (size_t i = 0; i < list->size; ++i) {
         const Product* p = &list->data[i];
-        fprintf(fp, "%d,%s,%.2f,%d\n", p->id, p->name, p->price, p->stock);
+        fprintf(fp, "%d,%s,%s,%d\n", p->id, productNameAt(list, i), money_str(p->price, price), p->stock);
     }
     fclose(fp);
     return 0;
 }
 
-int appendOrderToFile(const char* filename, const Order* order) {
-    FILE* fp = fopen(filename, "a");
-    if (!fp) return -1;
-    fprintf(fp,
-        "ORDER,%d,STATUS,%s,ITEMS,%zu,TOTAL,%.2f,CREATED,%ld,PAID,%ld\n",
+size_t formatOrderRecord(const Order* order, char* buf, size_t cap) {
+    size_t used = 0;
+    char total[MONEY_STR_MAX], unit[MONEY_STR_MAX], line[MONEY_STR_MAX];
+    int n = snprintf(buf, cap,
+        "ORDER,%d,STATUS,%s,ITEMS,%zu,TOTAL,%s,CREATED,%ld,PAID,%ld\n",
         order->orderId,
         orderStatusToStr(order->status),
         order->size,
-        order->totalAmount,
+        money_str(order->totalAmount, total),
         (long)order->createdAt,
         (long)order->paidAt);
+    if (n > 0) used += (size_t)n;
     for (size_t i = 0; i < order->size; ++i) {
         const OrderItem* it = &order->items[i];
-        fprintf(fp, "  ITEM,%d,QTY,%d,UNIT,%.2f,LINE,%.2f\n",
-            it->productId, it->quantity, it->unitPrice, it->lineTotal);
+        n = snprintf(used < cap ? buf + used : NULL, used < cap ? cap - used : 0,
+            "  ITEM,%d,QTY,%d,UNIT,%s,LINE,%s\n",
+            it->productId, it->quantity, money_str(it->unitPrice, unit), money_str(it->lineTotal, line));
+        if (n > 0) used += (size_t)n;
+    }
+    return used;
+}
+
+size_t formatOrderRecordAs(const Order* order, OrderLogFormat fmt, char* buf, size_t cap) {
+    size_t len = fmt == ORDER_LOG_BINARY ? orderbin_encode(order, buf, cap) : 0;
+    return len > 0 ? len : formatOrderRecord(order, buf, cap);
+}
+
+static int appendOrderToFileImpl(const char* filename, const Order* order, OrderLogFormat fmt) {
+    char stackBuf[1024];
+    char* buf = stackBuf;
+    size_t len = formatOrderRecordAs(order, fmt, stackBuf, sizeof(stackBuf));
+    if (len >= sizeof(stackBuf)) {
+        buf = (char*)malloc(len + 1);
+        if (!buf) return -2;
+        formatOrderRecordAs(order, fmt, buf, len + 1);
     }
+    FILE* fp = fopen(filename, "ab");
+    if (!fp) {
+        if (buf != stackBuf) free(buf);
+        return -1;
+    }
+    fwrite(buf, 1, len, fp);
     fclose(fp);
+    if (buf != stackBuf) free(buf);
     return 0;
 }
 
-int loadUsersFromCSV(const char* filename, UserList* ulist) {
+static int loadUsersFromCSVImpl(const char* filename, UserList* ulist) {
     FILE* fp = fopen(filename, "r");
     if (!fp) return -1;
     char line[256];
@@ -88,7 +125,7 @@ int loadUsersFromCSV(const char* filename, UserList* ulist) {
         char uname[32];
         char pwd[64];
         // Replace unsafe sscanf with sscanf_s for safer parsing
-        if (sscanf_s(line, "%d,%31[^,],%63[^\n]", &id, uname, (unsigned)_countof(uname), pwd, (unsigned)_countof(pwd)) == 3)
+        if (sscanf_s(line, "%d,%31[^,],%63[^\n]", &id, uname SCANF_BUFSZ(uname), pwd SCANF_BUFSZ(pwd)) == 3)
         {
             if (ulist->size >= ulist->capacity) {
                 size_t newCap = ulist->capacity == 0 ? 8 : ulist->capacity * 2;
@@ -115,14 +152,100 @@ int loadUsersFromCSV(const char* filename, UserList* ulist) {
     return count;
 }
 
-int saveUsersToCSV(const char* filename, const UserList* ulist) {
+#define USERS_CSV_HEADER "#id,username,password\n"
+
+int formatUserRecord(const User* u, char* buf, size_t cap) {
+    return snprintf(buf, cap, "%d,%s,%s\n", u->id, u->username, u->password);
+}
+
+char* formatUsersSnapshot(const UserList* ulist, size_t* outLen) {
+    /* id + separators + newline, plus the two fixed-size strings */
+    size_t cap = sizeof(USERS_CSV_HEADER) + ulist->size * (16 + sizeof(User));
+    char* buf = (char*)malloc(cap);
+    if (!buf) return NULL;
+    size_t len = strlen(USERS_CSV_HEADER);
+    memcpy(buf, USERS_CSV_HEADER, len);
+    for (size_t i = 0; i < ulist->size; ++i) {
+        int n = formatUserRecord(&ulist->data[i], buf + len, cap - len);
+        if (n < 0 || (size_t)n >= cap - len) {
+            free(buf);
+            return NULL;
+        }
+        len += (size_t)n;
+    }
+    *outLen = len;
+    return buf;
+}
+
+static int saveUsersToCSVImpl(const char* filename, const UserList* ulist) {
     FILE* fp = fopen(filename, "w");
     if (!fp) return -1;
-    fprintf(fp, "#id,username,password\n");
+    fputs(USERS_CSV_HEADER, fp);
     for (size_t i = 0; i < ulist->size; ++i) {
         const User* u = &ulist->data[i];
         fprintf(fp, "%d,%s,%s\n", u->id, u->username, u->password);
     }
     fclose(fp);
     return 0;
-}
\ No newline at end of file
+}
+
+/* ---------- instrumented entry points ---------- */
+
+int loadProductsFromCSV(const char* filename, ProductList* list) {
+    TRACE_BEGIN("loadProductsFromCSV");
+    int rc;
+    if (!METRICS_ON()) {
+        rc = loadProductsFromCSVImpl(filename, list);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        rc = loadProductsFromCSVImpl(filename, list);
+        metrics_record(MET_LOAD_PRODUCTS, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+    return rc;
+}
+
+int saveProductsToCSV(const char* filename, const ProductList* list) {
+    if (!METRICS_ON()) return saveProductsToCSVImpl(filename, list);
+    uint64_t t0 = timeutil_nowNs();
+    int rc = saveProductsToCSVImpl(filename, list);
+    metrics_record(MET_SAVE_PRODUCTS, timeutil_nowNs() - t0);
+    return rc;
+}
+
+int appendOrderToFile(const char* filename, const Order* order) {
+    return appendOrderToFileAs(filename, order, ORDER_LOG_TEXT);
+}
+
+int appendOrderToFileAs(const char* filename, const Order* order, OrderLogFormat fmt) {
+    if (!METRICS_ON()) return appendOrderToFileImpl(filename, order, fmt);
+    uint64_t t0 = timeutil_nowNs();
+    int rc = appendOrderToFileImpl(filename, order, fmt);
+    metrics_record(MET_APPEND_ORDER, timeutil_nowNs() - t0);
+    if (rc != 0) metrics_count(CTR_ORDER_LOG_ERRORS, 1);
+    return rc;
+}
+
+int loadUsersFromCSV(const char* filename, UserList* ulist) {
+    TRACE_BEGIN("loadUsersFromCSV");
+    int rc;
+    if (!METRICS_ON()) {
+        rc = loadUsersFromCSVImpl(filename, ulist);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        rc = loadUsersFromCSVImpl(filename, ulist);
+        metrics_record(MET_LOAD_USERS, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+    return rc;
+}
+
+int saveUsersToCSV(const char* filename, const UserList* ulist) {
+    if (!METRICS_ON()) return saveUsersToCSVImpl(filename, ulist);
+    uint64_t t0 = timeutil_nowNs();
+    int rc = saveUsersToCSVImpl(filename, ulist);
+    metrics_record(MET_SAVE_USERS, timeutil_nowNs() - t0);
+    return rc;
+}
@@ -5,13 +5,23 @@
 #include "product.h"
 #include "order.h"
 #include "user.h"
+#include "orderbin.h"
 
 int loadProductsFromCSV(const char* filename, ProductList* list);
 int saveProductsToCSV(const char* filename, const ProductList* list);
 
 int appendOrderToFile(const char* filename, const Order* order);
+int appendOrderToFileAs(const char* filename, const Order* order, OrderLogFormat fmt);
+/* Serialize one order in the appendOrderToFile format; returns the full length like snprintf */
+size_t formatOrderRecord(const Order* order, char* buf, size_t cap);
+/* Either orders.log format; an order too large for a binary record is written as text */
+size_t formatOrderRecordAs(const Order* order, OrderLogFormat fmt, char* buf, size_t cap);
 
 int loadUsersFromCSV(const char* filename, UserList* ulist);
 int saveUsersToCSV(const char* filename, const UserList* ulist);
+/* One users.csv line (the users journal record); returns the length like snprintf */
+int formatUserRecord(const User* u, char* buf, size_t cap);
+/* Whole users.csv (header + one line per user) in a malloc'd buffer, NULL on failure */
+char* formatUsersSnapshot(const UserList* ulist, size_t* outLen);
 
 #endif
\ No newline at end of file
@@ -2,85 +2,349 @@
 #include <stdlib.h>
 #include <string.h>
 #include "product.h"
+#include "compat.h"
+#include "metrics.h"
+#include "nameindex.h"
+#include "strpool.h"
+#include "inventory.h"
 
 void initProductList(ProductList* list) {
     list->data = NULL;
+    list->nameRef = NULL;
+    list->names = NULL;
     list->size = 0;
     list->capacity = 0;
     list->nextId = 1;
+    idmap_init(&list->idIndex);
+    list->idIndexValid = 1;   // 空表：之后的新增逐个登记
+    list->nameIndex = NULL;
+    list->version = 0;
+    list->sortCache = NULL;
 }
 
+static void freeSortCache(ProductList* list);
+
 void freeProductList(ProductList* list) {
+    nameindex_free(list->nameIndex);
+    list->nameIndex = NULL;
+    freeSortCache(list);
+    list->version++;
     free(list->data);
+    free(list->nameRef);
+    strpool_free(list->names);
+    idmap_free(&list->idIndex);
+    list->idIndexValid = 0;
     list->data = NULL;
+    list->nameRef = NULL;
+    list->names = NULL;
     list->size = 0;
     list->capacity = 0;
     list->nextId = 1;
 }
 
+static int growStorage(ProductList* list) {
+    if (list->size < list->capacity) return 0;
+    size_t newCap = list->capacity == 0 ? 8 : list->capacity * 2;
+    Product* newData = (Product*)realloc(list->data, newCap * sizeof(Product));
+    if (!newData) return -1;
+    list->data = newData;
+    uint32_t* newRefs = (uint32_t*)realloc(list->nameRef, newCap * sizeof(uint32_t));
+    if (!newRefs) return -1;
+    list->nameRef = newRefs;
+    list->capacity = newCap;
+    return 0;
+}
+
 static void ensureCapacity(ProductList* list) {
-    if (list->size >= list->capacity) {
-        size_t newCap = list->capacity == 0 ? 8 : list->capacity * 2;
-        Product* newData = (Product*)realloc(list->data, newCap * sizeof(Product));
-        if (!newData) {
-            fprintf(stderr, "Memory expansion failed\n");
-            exit(EXIT_FAILURE);
-        }
-        list->data = newData;
-        list->capacity = newCap;
+    if (growStorage(list) != 0) {
+        fprintf(stderr, "Memory expansion failed\n");
+        exit(EXIT_FAILURE);
     }
 }
 
-int addProduct(ProductList* list, const char* name, double price, int stock) {
+static int setName(ProductList* list, size_t index, const char* name) {
+    if (!list->names) {
+        list->names = strpool_create();
+        if (!list->names) return -1;
+    }
+    uint32_t ref = strpool_intern(list->names, name, PRODUCT_NAME_MAX - 1);
+    if (ref == STRPOOL_NONE) return -1;
+    list->nameRef[index] = ref;
+    return 0;
+}
+
+/* 新元素登记到 id 索引；重复 id 保留第一个，与线性查找一致 */
+static void indexId(ProductList* list, size_t index) {
+    if (!list->idIndexValid) return;
+    int id = list->data[index].id;
+    if (id <= 0 || idmap_find(&list->idIndex, id) >= 0) return;
+    if (idmap_put(&list->idIndex, id, index) != 0) list->idIndexValid = 0;
+}
+
+/* 名称登记到已建立的名称索引；内存不足时丢弃整个索引，下次按名称查询时重建，
+ * 不会留下查不到的商品 */
+static void indexName(ProductList* list, size_t index) {
+    if (!list->nameIndex) return;
+    if (nameindex_add(list->nameIndex, list->data[index].id, productNameAt(list, index)) != 0) {
+        nameindex_free(list->nameIndex);
+        list->nameIndex = NULL;
+    }
+}
+
+static int rebuildIdIndex(ProductList* list) {
+    idmap_clear(&list->idIndex);
+    list->idIndexValid = 1;
+    for (size_t i = 0; i < list->size && list->idIndexValid; ++i) indexId(list, i);
+    return list->idIndexValid ? 0 : -1;
+}
+
+const char* productNameAt(const ProductList* list, size_t index) {
+    if (!list->names || index >= list->size) return "";
+    return strpool_get(list->names, list->nameRef[index]);
+}
+
+const char* productName(const ProductList* list, const Product* p) {
+    if (!p || p < list->data) return "";
+    return productNameAt(list, (size_t)(p - list->data));
+}
+
+Product* appendLoadedProduct(ProductList* list, int id, const char* name, Money price, int stock) {
+    if (growStorage(list) != 0) return NULL;
+    size_t index = list->size;
+    if (setName(list, index, name) != 0) return NULL;
+    Product* p = &list->data[index];
+    p->id = id;
+    p->stock = stock;
+    p->price = price;
+    list->size++;
+    indexId(list, index);
+    return p;
+}
+
+int addProduct(ProductList* list, const char* name, Money price, int stock) {
     if (!name || price < 0 || stock < 0) return -1;
     ensureCapacity(list);
+    size_t index = list->size;
+    if (setName(list, index, name) != 0) return -1;
     Product* p = &list->data[list->size++];
     p->id = list->nextId++;
-    strncpy_s(p->name, sizeof(p->name), name, _TRUNCATE);
-    p->name[sizeof(p->name) - 1] = '\0';
     p->price = price;
     p->stock = stock;
+    indexId(list, index);
+    indexName(list, index);
+    list->version++;
     return p->id;
 }
 
-Product* findProductById(ProductList* list, int id) {
+static Product* findProductByIdImpl(ProductList* list, int id) {
+    if (id > 0 && (list->idIndexValid || rebuildIdIndex(list) == 0)) {
+        long index = idmap_find(&list->idIndex, id);
+        return index >= 0 ? &list->data[index] : NULL;
+    }
     for (size_t i = 0; i < list->size; ++i) {
         if (list->data[i].id == id) return &list->data[i];
     }
     return NULL;
 }
 
+Product* findProductById(ProductList* list, int id) {
+    if (!METRICS_ON()) return findProductByIdImpl(list, id);
+    uint64_t t0 = timeutil_nowNs();
+    Product* p = findProductByIdImpl(list, id);
+    metrics_record(MET_FIND_PRODUCT, timeutil_nowNs() - t0);
+    if (!p) metrics_count(CTR_PRODUCT_LOOKUP_MISS, 1);
+    return p;
+}
+
+static void writeProductRow(OutBuf* out, const ProductList* list, size_t index) {
+    const Product* p = &list->data[index];
+    char price[MONEY_STR_MAX];
+    outbuf_printf(out, "%-5d %-20s %-10s %-10d\n",
+        p->id, productNameAt(list, index), money_str(p->price, price), p->stock);
+}
+
+void writeProductHeader(OutBuf* out) {
+    outbuf_printf(out, "%-5s %-20s %-10s %-10s\n", "ID", "Name", "Price", "Stock");
+}
+
 void listProducts(const ProductList* list) {
-    printf("=== Product List ===\n");
-    printf("%-5s %-20s %-10s %-10s\n", "ID", "Name", "Price", "Stock");
+    fflush(stdout);
+    OutBuf out;
+    outbuf_init(&out, stdout, OUTBUF_DEFAULT_CAP);
+    outbuf_puts(&out, "=== Product List ===\n");
+    writeProductHeader(&out);
     for (size_t i = 0; i < list->size; ++i) {
-        const Product* p = &list->data[i];
-        printf("%-5d %-20s %-10.2f %-10d\n", p->id, p->name, p->price, p->stock);
+        writeProductRow(&out, list, i);
     }
+    outbuf_free(&out);
 }
 
-int modifyProduct(ProductList* list, int id, const char* name, double price, int stock) {
+int modifyProduct(ProductList* list, int id, const char* name, Money price, int stock) {
     Product* p = findProductById(list, id);
     if (!p) return -1;
     if (name && *name) 
     {
-        strncpy_s(p->name, sizeof(p->name), name, _TRUNCATE);
-        p->name[sizeof(p->name) - 1] = '\0';
+        size_t index = (size_t)(p - list->data);
+        if (setName(list, index, name) != 0) return -1;
+        indexName(list, index);
     }
     if (price >= 0) p->price = price;
     if (stock >= 0) p->stock = stock;
+    list->version++;
     return 0;
 }
 
 int deleteProduct(ProductList* list, int id) {
     for (size_t i = 0; i < list->size; ++i) {
         if (list->data[i].id == id) {
-            for (size_t j = i + 1; j < list->size; ++j) {
-                list->data[j - 1] = list->data[j];
-            }
+            memmove(&list->data[i], &list->data[i + 1], (list->size - i - 1) * sizeof(Product));
+            memmove(&list->nameRef[i], &list->nameRef[i + 1], (list->size - i - 1) * sizeof(uint32_t));
             list->size--;
+            list->idIndexValid = 0;   // 后续下标整体前移
+            if (list->nameIndex) nameindex_remove(list->nameIndex, id);
+            list->version++;
             return 0;
         }
     }
     return -1;
-}
\ No newline at end of file
+}
+
+/* ---------- name lookup ---------- */
+
+int rebuildProductNameIndex(ProductList* list) {
+    if (!list->nameIndex) {
+        list->nameIndex = nameindex_create();
+        if (!list->nameIndex) return -1;
+    }
+    else {
+        nameindex_clear(list->nameIndex);
+    }
+    for (size_t i = 0; i < list->size; ++i) {
+        if (nameindex_add(list->nameIndex, list->data[i].id, productNameAt(list, i)) != 0) {
+            nameindex_free(list->nameIndex);
+            list->nameIndex = NULL;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int ensureNameIndex(ProductList* list) {
+    return list->nameIndex ? 0 : rebuildProductNameIndex(list);
+}
+
+size_t findProductsByName(ProductList* list, const char* name, int* outIds, size_t maxOut) {
+    if (!name || ensureNameIndex(list) != 0) return 0;
+    return nameindex_findExact(list->nameIndex, name, outIds, maxOut);
+}
+
+size_t findProductsByNamePrefix(ProductList* list, const char* prefix, int* outIds, size_t maxOut) {
+    if (!prefix || ensureNameIndex(list) != 0) return 0;
+    return nameindex_findPrefix(list->nameIndex, prefix, outIds, maxOut);
+}
+
+size_t searchProductsByName(ProductList* list, const char* text, int* outIds, size_t maxOut) {
+    if (!text || ensureNameIndex(list) != 0) return 0;
+    return nameindex_findSubstring(list->nameIndex, text, outIds, maxOut);
+}
+
+/* ---------- sorted pages ---------- */
+
+/* one permutation of list->data per sort key, valid while the list
+ * version (and, for stock, the inventory stock version) is unchanged */
+struct ProductSortCache {
+    size_t*       perm[PRODUCT_SORT_COUNT];
+    size_t        size[PRODUCT_SORT_COUNT];
+    unsigned long version[PRODUCT_SORT_COUNT];
+    unsigned long stockVersion;
+    int           valid[PRODUCT_SORT_COUNT];
+};
+
+typedef struct {
+    long long   num;
+    const char* str;
+    int         id;
+    size_t      idx;
+} SortEntry;
+
+static int cmpEntryId(const void* a, const void* b) {
+    const SortEntry* x = (const SortEntry*)a;
+    const SortEntry* y = (const SortEntry*)b;
+    return (x->id > y->id) - (x->id < y->id);
+}
+
+static int cmpEntryName(const void* a, const void* b) {
+    const SortEntry* x = (const SortEntry*)a;
+    const SortEntry* y = (const SortEntry*)b;
+    int c = strcmp(x->str, y->str);
+    return c != 0 ? c : cmpEntryId(a, b);
+}
+
+static int cmpEntryNum(const void* a, const void* b) {
+    const SortEntry* x = (const SortEntry*)a;
+    const SortEntry* y = (const SortEntry*)b;
+    if (x->num < y->num) return -1;
+    if (x->num > y->num) return 1;
+    return cmpEntryId(a, b);
+}
+
+static void freeSortCache(ProductList* list) {
+    if (!list->sortCache) return;
+    for (int k = 0; k < PRODUCT_SORT_COUNT; ++k) free(list->sortCache->perm[k]);
+    free(list->sortCache);
+    list->sortCache = NULL;
+}
+
+static const size_t* sortedPermutation(ProductList* list, ProductSortKey key) {
+    if (!list->sortCache) {
+        list->sortCache = (struct ProductSortCache*)calloc(1, sizeof(struct ProductSortCache));
+        if (!list->sortCache) return NULL;
+    }
+    struct ProductSortCache* c = list->sortCache;
+    unsigned long stockVer = inventory_stockVersion();
+    if (c->valid[key] && c->version[key] == list->version && c->size[key] == list->size &&
+        (key != PRODUCT_SORT_STOCK || c->stockVersion == stockVer)) {
+        return c->perm[key];
+    }
+
+    size_t n = list->size;
+    SortEntry* tmp = (SortEntry*)malloc((n ? n : 1) * sizeof(SortEntry));
+    size_t* perm = (size_t*)realloc(c->perm[key], (n ? n : 1) * sizeof(size_t));
+    if (!tmp || !perm) {
+        free(tmp);
+        if (perm) c->perm[key] = perm;
+        c->valid[key] = 0;
+        return NULL;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        const Product* p = &list->data[i];
+        tmp[i].id = p->id;
+        tmp[i].idx = i;
+        tmp[i].str = productNameAt(list, i);
+        tmp[i].num = key == PRODUCT_SORT_PRICE ? p->price : (long long)p->stock;
+    }
+    qsort(tmp, n, sizeof(SortEntry),
+        key == PRODUCT_SORT_ID ? cmpEntryId : key == PRODUCT_SORT_NAME ? cmpEntryName : cmpEntryNum);
+    for (size_t i = 0; i < n; ++i) perm[i] = tmp[i].idx;
+    free(tmp);
+
+    c->perm[key] = perm;
+    c->size[key] = n;
+    c->version[key] = list->version;
+    if (key == PRODUCT_SORT_STOCK) c->stockVersion = stockVer;
+    c->valid[key] = 1;
+    return perm;
+}
+
+size_t listProductsPage(ProductList* list, ProductSortKey key, int descending,
+    size_t offset, size_t limit, OutBuf* out) {
+    if ((unsigned)key >= PRODUCT_SORT_COUNT || offset >= list->size) return 0;
+    const size_t* perm = sortedPermutation(list, key);
+    if (!perm) return 0;
+    size_t end = list->size - offset < limit ? list->size : offset + limit;
+    for (size_t i = offset; i < end; ++i) {
+        size_t k = descending ? list->size - 1 - i : i;
+        writeProductRow(out, list, perm[k]);
+    }
+    return end - offset;
+}
@@ -3,29 +3,72 @@
 #define PRODUCT_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include "outbuf.h"
+#include "money.h"
+#include "idmap.h"
 
+// 名称最大字节数（含结尾 0）
+#define PRODUCT_NAME_MAX 64
+
+// 热数据（16 字节）：库存/价格扫描只读这部分；名称存放在 ProductList 的字符串池中，用 productName() 读取
 typedef struct {
     int    id;
-    char   name[64];
-    double price;
     int    stock;
+    Money  price;   // 以分为单位
 } Product;
 
+struct NameIndex;
+struct ProductSortCache;
+struct StrPool;
+
 typedef struct {
     Product* data;
+    uint32_t* nameRef;             // 与 data 一一对应：名称在 names 池中的引用
+    struct StrPool* names;         // 去重的名称字符串池
     size_t   size;
     size_t   capacity;
     int      nextId;   // 新增：保证ID单调递增
+    IdMap    idIndex;              // id -> data 下标；删除商品后失效，下次按 id 查找时重建
+    int      idIndexValid;
+    struct NameIndex* nameIndex;   // 名称索引，首次按名称查询时建立，之后随增删改维护
+    unsigned long version;         // 增删改及加载时递增，排序缓存据此失效
+    struct ProductSortCache* sortCache;
 } ProductList;
 
+typedef enum {
+    PRODUCT_SORT_ID = 0,
+    PRODUCT_SORT_NAME,
+    PRODUCT_SORT_PRICE,
+    PRODUCT_SORT_STOCK,
+    PRODUCT_SORT_COUNT
+} ProductSortKey;
+
 void initProductList(ProductList* list);
 void freeProductList(ProductList* list);
-int  addProduct(ProductList* list, const char* name, double price, int stock);
+int  addProduct(ProductList* list, const char* name, Money price, int stock);
 Product* findProductById(ProductList* list, int id);
 void listProducts(const ProductList* list);
 
+// 名称读取：p 必须指向 list->data 中的元素；返回的指针在下一次新增/改名前有效
+const char* productName(const ProductList* list, const Product* p);
+const char* productNameAt(const ProductList* list, size_t index);
+// 加载用：按给定 id 追加（不改 nextId/version/名称索引），内存不足返回 NULL
+Product* appendLoadedProduct(ProductList* list, int id, const char* name, Money price, int stock);
+
 // 新增功能
-int modifyProduct(ProductList* list, int id, const char* name, double price, int stock);
+int modifyProduct(ProductList* list, int id, const char* name, Money price, int stock);
 int deleteProduct(ProductList* list, int id); // 成功返回0，失败返回-1
 
+// 按名称查找：结果为商品ID，最多写入 maxOut 个，返回写入数量
+size_t findProductsByName(ProductList* list, const char* name, int* outIds, size_t maxOut);         // 完全匹配
+size_t findProductsByNamePrefix(ProductList* list, const char* prefix, int* outIds, size_t maxOut); // 前缀，忽略大小写
+size_t searchProductsByName(ProductList* list, const char* text, int* outIds, size_t maxOut);       // 包含，忽略大小写
+int    rebuildProductNameIndex(ProductList* list);   // 直接改动 data 后（如从文件加载）调用
+
+// 分页列表：按 key 排序（排序结果缓存到下次修改），跳过 offset 行后最多输出 limit 行，返回本页行数
+size_t listProductsPage(ProductList* list, ProductSortKey key, int descending,
+    size_t offset, size_t limit, OutBuf* out);
+void   writeProductHeader(OutBuf* out);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,377 @@
+#include "productstore.h"
+#include "idmap.h"
+#include "compat.h"
+#include "metrics.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define PSTORE_MAGIC        "SPDB"
+#define PSTORE_VERSION      1u
+#define PSTORE_PATH_MAX     260
+#define PSTORE_COMPACT_MIN  1024    /* free slots before compaction is considered */
+#define PSTORE_IO_RECORDS   4096    /* records per fread / fwrite chunk */
+
+typedef struct {
+    char     magic[4];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t nameSize;
+} StoreHeader;
+
+typedef struct {
+    int32_t id;         /* 0 = free slot */
+    int32_t stock;
+    int64_t price;      /* cents */
+    char    name[PRODUCT_NAME_MAX];
+} StoreRecord;
+
+/* the layout is the file format: keep it at 16 + 80 bytes */
+typedef char pstore_header_size_check[sizeof(StoreHeader) == 16 ? 1 : -1];
+typedef char pstore_record_size_check[sizeof(StoreRecord) == 80 ? 1 : -1];
+
+enum { PW_STOCK = 1, PW_RECORD, PW_FREE };
+
+typedef struct {
+    size_t      slot;
+    int         kind;
+    StoreRecord rec;
+} PendingWrite;
+
+struct ProductStore {
+    FILE*  fp;
+    char   path[PSTORE_PATH_MAX];
+    int    schemaOk;    /* header verified by load or written by rewrite */
+    int    needRewrite; /* a positioned write failed; the file may be stale */
+
+    IdMap    slotOf;    /* id -> slot */
+
+    size_t   slots;     /* records in the file, including pending appends */
+    size_t   freeSlots;
+
+    long*         pendingOf;    /* per slot: index into pending, -1 if clean */
+    size_t        pendingOfCap;
+    PendingWrite* pending;
+    size_t        pendingN;
+    size_t        pendingCap;
+};
+
+static int seek_to(FILE* fp, uint64_t off) {
+#if defined(_MSC_VER)
+    return _fseeki64(fp, (long long)off, SEEK_SET);
+#else
+    return fseeko(fp, (off_t)off, SEEK_SET);
+#endif
+}
+
+static uint64_t slot_offset(size_t slot) {
+    return sizeof(StoreHeader) + (uint64_t)slot * sizeof(StoreRecord);
+}
+
+static void fill_header(StoreHeader* h) {
+    memcpy(h->magic, PSTORE_MAGIC, 4);
+    h->version = PSTORE_VERSION;
+    h->recordSize = (uint32_t)sizeof(StoreRecord);
+    h->nameSize = (uint32_t)PRODUCT_NAME_MAX;
+}
+
+static void fill_record(StoreRecord* r, const Product* p, const char* name) {
+    memset(r, 0, sizeof(*r));
+    r->id = p->id;
+    r->stock = p->stock;
+    r->price = p->price;
+    strncpy_s(r->name, sizeof(r->name), name, _TRUNCATE);
+}
+
+/* ---------- pending writes ---------- */
+
+static void pending_reset(ProductStore* st) {
+    for (size_t i = 0; i < st->pendingN; ++i) {
+        size_t slot = st->pending[i].slot;
+        if (slot < st->pendingOfCap) st->pendingOf[slot] = -1;
+    }
+    st->pendingN = 0;
+}
+
+static PendingWrite* pending_for(ProductStore* st, size_t slot, int kind) {
+    if (slot >= st->pendingOfCap) {
+        size_t newCap = st->pendingOfCap == 0 ? 1024 : st->pendingOfCap;
+        while (newCap <= slot) newCap *= 2;
+        long* nd = (long*)realloc(st->pendingOf, newCap * sizeof(long));
+        if (!nd) return NULL;
+        for (size_t i = st->pendingOfCap; i < newCap; ++i) nd[i] = -1;
+        st->pendingOf = nd;
+        st->pendingOfCap = newCap;
+    }
+    if (st->pendingOf[slot] >= 0) {
+        PendingWrite* pw = &st->pending[st->pendingOf[slot]];
+        if (kind > pw->kind) pw->kind = kind;
+        return pw;
+    }
+    if (st->pendingN >= st->pendingCap) {
+        size_t newCap = st->pendingCap == 0 ? 64 : st->pendingCap * 2;
+        PendingWrite* nd = (PendingWrite*)realloc(st->pending, newCap * sizeof(PendingWrite));
+        if (!nd) return NULL;
+        st->pending = nd;
+        st->pendingCap = newCap;
+    }
+    PendingWrite* pw = &st->pending[st->pendingN];
+    st->pendingOf[slot] = (long)st->pendingN++;
+    memset(pw, 0, sizeof(*pw));
+    pw->slot = slot;
+    pw->kind = kind;
+    return pw;
+}
+
+/* ---------- public API ---------- */
+
+ProductStore* pstore_open(const char* path) {
+    if (!path || !*path) return NULL;
+    ProductStore* st = (ProductStore*)calloc(1, sizeof(ProductStore));
+    if (!st) return NULL;
+    strncpy_s(st->path, sizeof(st->path), path, _TRUNCATE);
+    st->fp = fopen(path, "r+b");
+    if (!st->fp) st->fp = fopen(path, "w+b");
+    if (!st->fp) {
+        free(st);
+        return NULL;
+    }
+    return st;
+}
+
+void pstore_close(ProductStore* st) {
+    if (!st) return;
+    if (st->pendingN > 0) pstore_flush(st, NULL);
+    if (st->fp) fclose(st->fp);
+    idmap_free(&st->slotOf);
+    free(st->pendingOf);
+    free(st->pending);
+    free(st);
+}
+
+size_t pstore_pending(const ProductStore* st) {
+    return st ? st->pendingN : 0;
+}
+
+static int appendLoaded(ProductList* list, const StoreRecord* r) {
+    /* the name field is not guaranteed to be terminated on disk */
+    char name[PRODUCT_NAME_MAX];
+    memcpy(name, r->name, sizeof(name));
+    name[sizeof(name) - 1] = '\0';
+    return appendLoadedProduct(list, r->id, name, r->price, r->stock) ? 0 : -1;
+}
+
+static int load_impl(ProductStore* st, ProductList* list) {
+    StoreHeader h, want;
+    fill_header(&want);
+    idmap_clear(&st->slotOf);
+    pending_reset(st);
+    st->slots = 0;
+    st->freeSlots = 0;
+    st->schemaOk = 0;
+
+    seek_to(st->fp, 0);
+    size_t got = fread(&h, 1, sizeof(h), st->fp);
+    if (got == 0) {
+        /* new file: stamp the header */
+        seek_to(st->fp, 0);
+        if (fwrite(&want, sizeof(want), 1, st->fp) != 1 || fflush(st->fp) != 0) return -1;
+        st->schemaOk = 1;
+        return 0;
+    }
+    if (got != sizeof(h) || memcmp(&h, &want, sizeof(h)) != 0) return -2;
+
+    StoreRecord* buf = (StoreRecord*)malloc(PSTORE_IO_RECORDS * sizeof(StoreRecord));
+    if (!buf) return -1;
+    int count = 0;
+    int maxId = 0;
+    size_t n;
+    /* a torn record at the end is ignored and overwritten by the next append */
+    while ((n = fread(buf, sizeof(StoreRecord), PSTORE_IO_RECORDS, st->fp)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            const StoreRecord* r = &buf[i];
+            size_t slot = st->slots++;
+            if (r->id <= 0 || idmap_find(&st->slotOf, r->id) >= 0) {
+                st->freeSlots++;
+                continue;
+            }
+            if (appendLoaded(list, r) != 0 || idmap_put(&st->slotOf, r->id, slot) != 0) {
+                free(buf);
+                return -1;
+            }
+            if (r->id > maxId) maxId = r->id;
+            count++;
+        }
+    }
+    free(buf);
+
+    if (maxId + 1 > list->nextId) list->nextId = maxId + 1;
+    list->version++;
+    if (list->nameIndex) rebuildProductNameIndex(list);
+    st->schemaOk = 1;
+    return count;
+}
+
+int pstore_load(ProductStore* st, ProductList* list) {
+    if (!st || !list) return -1;
+    TRACE_BEGIN("pstore_load");
+    int rc;
+    if (!METRICS_ON()) {
+        rc = load_impl(st, list);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        rc = load_impl(st, list);
+        metrics_record(MET_LOAD_PRODUCT_STORE, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+    return rc;
+}
+
+static int write_all(FILE* fp, const ProductList* list) {
+    StoreHeader h;
+    fill_header(&h);
+    if (fwrite(&h, sizeof(h), 1, fp) != 1) return -1;
+    StoreRecord* buf = (StoreRecord*)malloc(PSTORE_IO_RECORDS * sizeof(StoreRecord));
+    if (!buf) return -1;
+    size_t n = 0;
+    int rc = 0;
+    for (size_t i = 0; i < list->size && rc == 0; ++i) {
+        if (list->data[i].id <= 0) continue;
+        fill_record(&buf[n++], &list->data[i], productNameAt(list, i));
+        if (n == PSTORE_IO_RECORDS) {
+            if (fwrite(buf, sizeof(StoreRecord), n, fp) != n) rc = -1;
+            n = 0;
+        }
+    }
+    if (rc == 0 && n > 0 && fwrite(buf, sizeof(StoreRecord), n, fp) != n) rc = -1;
+    free(buf);
+    return rc;
+}
+
+int pstore_rewrite(ProductStore* st, const ProductList* list) {
+    if (!st || !list) return -1;
+    TRACE_BEGIN("pstore_rewrite");
+    char tmp[PSTORE_PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", st->path);
+    FILE* fp = fopen(tmp, "wb");
+    int rc = fp ? write_all(fp, list) : -1;
+    if (fp && fclose(fp) != 0) rc = -1;
+    if (rc == 0) {
+        fclose(st->fp);
+#if defined(_WIN32)
+        remove(st->path);   /* rename does not replace on Windows */
+#endif
+        if (rename(tmp, st->path) != 0) rc = -1;
+        st->fp = fopen(st->path, "r+b");
+        if (!st->fp) st->fp = fopen(st->path, "w+b");
+        if (!st->fp) rc = -1;
+    }
+    else {
+        remove(tmp);
+    }
+
+    if (rc == 0) {
+        idmap_clear(&st->slotOf);
+        pending_reset(st);
+        st->slots = 0;
+        st->freeSlots = 0;
+        for (size_t i = 0; i < list->size; ++i) {
+            if (list->data[i].id <= 0) continue;
+            if (idmap_put(&st->slotOf, list->data[i].id, st->slots++) != 0) {
+                rc = -1;
+                break;
+            }
+        }
+        st->schemaOk = rc == 0;
+        st->needRewrite = rc != 0;
+    }
+    TRACE_END();
+    return rc;
+}
+
+void pstore_noteStock(ProductStore* st, int id, int stock) {
+    if (!st) return;
+    long slot = idmap_find(&st->slotOf, id);
+    if (slot < 0) return;
+    PendingWrite* pw = pending_for(st, (size_t)slot, PW_STOCK);
+    if (pw) pw->rec.stock = stock;
+}
+
+void pstore_notePut(ProductStore* st, const Product* p, const char* name) {
+    if (!st || !p || p->id <= 0) return;
+    long slot = idmap_find(&st->slotOf, p->id);
+    if (slot < 0) {
+        slot = (long)st->slots;
+        if (idmap_put(&st->slotOf, p->id, (size_t)slot) != 0) return;
+        st->slots++;
+    }
+    PendingWrite* pw = pending_for(st, (size_t)slot, PW_RECORD);
+    if (pw) fill_record(&pw->rec, p, name ? name : "");
+}
+
+void pstore_noteRemove(ProductStore* st, int id) {
+    if (!st) return;
+    long slot = idmap_find(&st->slotOf, id);
+    if (slot < 0) return;
+    idmap_del(&st->slotOf, id);
+    st->freeSlots++;
+    PendingWrite* pw = pending_for(st, (size_t)slot, PW_FREE);
+    if (pw) memset(&pw->rec, 0, sizeof(pw->rec));
+}
+
+static int cmp_pending_slot(const void* a, const void* b) {
+    const PendingWrite* x = (const PendingWrite*)a;
+    const PendingWrite* y = (const PendingWrite*)b;
+    return (x->slot > y->slot) - (x->slot < y->slot);
+}
+
+static int flush_impl(ProductStore* st, const ProductList* list) {
+    if (!st->schemaOk) return -1;
+    if (list && (st->needRewrite ||
+        (st->freeSlots >= PSTORE_COMPACT_MIN && st->freeSlots > st->slotOf.size))) {
+        return pstore_rewrite(st, list) == 0 ? 1 : -1;
+    }
+    if (st->pendingN == 0) return 0;
+
+    /* ascending offsets: appends extend the file in order */
+    size_t n = st->pendingN;
+    pending_reset(st);
+    qsort(st->pending, n, sizeof(PendingWrite), cmp_pending_slot);
+    int rc = 0;
+    for (size_t i = 0; i < n && rc == 0; ++i) {
+        const PendingWrite* pw = &st->pending[i];
+        uint64_t off = slot_offset(pw->slot);
+        if (pw->kind == PW_STOCK) {
+            if (seek_to(st->fp, off + offsetof(StoreRecord, stock)) != 0 ||
+                fwrite(&pw->rec.stock, sizeof(pw->rec.stock), 1, st->fp) != 1) rc = -1;
+        }
+        else {
+            if (seek_to(st->fp, off) != 0 ||
+                fwrite(&pw->rec, sizeof(StoreRecord), 1, st->fp) != 1) rc = -1;
+        }
+    }
+    if (fflush(st->fp) != 0) rc = -1;
+    /* the dropped writes are recovered by a rewrite on the next flush */
+    if (rc != 0) st->needRewrite = 1;
+    return rc == 0 ? (int)n : -1;
+}
+
+int pstore_flush(ProductStore* st, const ProductList* list) {
+    if (!st) return -1;
+    TRACE_BEGIN("pstore_flush");
+    int rc;
+    if (!METRICS_ON()) {
+        rc = flush_impl(st, list);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        rc = flush_impl(st, list);
+        metrics_record(MET_FLUSH_PRODUCT_STORE, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+    return rc;
+}
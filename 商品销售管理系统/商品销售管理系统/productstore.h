@@ -0,0 +1,53 @@
+#pragma once
+#ifndef PRODUCTSTORE_H
+#define PRODUCTSTORE_H
+
+#include "product.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Fixed-width binary product store (products.dat).
+     *
+     * A 16-byte header is followed by one 80-byte record per slot
+     * (id, stock, price in cents, name[64]) in host byte order. Records are
+     * appended in insertion order; a deleted product becomes a free slot
+     * (id 0) until the next compaction.
+     *
+     * Changes are noted against the store and written by pstore_flush():
+     * a stock change is one 4-byte positioned write, a modified product one
+     * record, a new product one append. The file is only rewritten as a
+     * whole by pstore_rewrite(): on first use, when the on-disk schema does
+     * not match, or when free slots outnumber live ones.
+     */
+
+    typedef struct ProductStore ProductStore;
+
+    /* open (or create) the file; NULL if it cannot be opened */
+    ProductStore* pstore_open(const char* path);
+    /* writes pending changes, then closes */
+    void pstore_close(ProductStore* st);
+
+    /* appends the stored products to list and indexes their slots.
+     * Returns the count, 0 for a new empty file, -2 when the header does not
+     * match this build's schema (call pstore_rewrite with the data from
+     * another source). */
+    int  pstore_load(ProductStore* st, ProductList* list);
+    /* replace the whole file with list (temp file + rename); clears pending changes */
+    int  pstore_rewrite(ProductStore* st, const ProductList* list);
+
+    void pstore_noteStock(ProductStore* st, int id, int stock);   /* stock field only */
+    void pstore_notePut(ProductStore* st, const Product* p, const char* name);   /* new or modified product */
+    void pstore_noteRemove(ProductStore* st, int id);
+
+    /* writes pending changes in slot order. list is only read when the store
+     * decides to compact. Returns the number of writes, -1 on I/O error. */
+    int  pstore_flush(ProductStore* st, const ProductList* list);
+    size_t pstore_pending(const ProductStore* st);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,7 +1,14 @@
 #include "purchase.h"
+#include "compat.h"
+#include "idmap.h"
+#include "metrics.h"
+#include "trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+
+#define TAIL_CHUNK 4096
 
 static void ensureCap(PurchaseList* list) {
     if (list->size >= list->capacity) {
@@ -20,6 +27,34 @@ void initPurchaseList(PurchaseList* list) {
     list->data = NULL;
     list->size = 0;
     list->capacity = 0;
+    list->limit = 0;
+    list->head = 0;
+}
+
+static void reverse(Purchase* a, size_t n) {
+    for (size_t i = 0, j = n; i + 1 < j; ++i, --j) {
+        Purchase t = a[i];
+        a[i] = a[j - 1];
+        a[j - 1] = t;
+    }
+}
+
+/* rotates a full ring back so the oldest record is data[0] */
+static void unwrap(PurchaseList* list) {
+    if (list->head == 0) return;
+    reverse(list->data, list->head);
+    reverse(list->data + list->head, list->size - list->head);
+    reverse(list->data, list->size);
+    list->head = 0;
+}
+
+void purchase_setLimit(PurchaseList* list, size_t limit) {
+    unwrap(list);
+    list->limit = limit;
+    if (limit > 0 && list->size > limit) {
+        memmove(list->data, list->data + (list->size - limit), limit * sizeof(Purchase));
+        list->size = limit;
+    }
 }
 
 void freePurchaseList(PurchaseList* list) {
@@ -28,16 +63,31 @@ void freePurchaseList(PurchaseList* list) {
     list->data = NULL;
     list->size = 0;
     list->capacity = 0;
+    list->head = 0;
+}
+
+const Purchase* purchase_at(const PurchaseList* list, size_t i) {
+    size_t k = list->head + i;
+    if (k >= list->size) k -= list->size;
+    return &list->data[k];
 }
 
 Purchase* addPurchase(PurchaseList* list,
     int purchaseId,
     int productId,
     int quantity,
-    double unitCost,
+    Money unitCost,
     long long createdAt) {
-    ensureCap(list);
-    Purchase* p = &list->data[list->size++];
+    Purchase* p;
+    if (list->limit > 0 && list->size >= list->limit) {
+        /* bounded tail: the newest record takes the oldest one's slot */
+        p = &list->data[list->head];
+        if (++list->head == list->size) list->head = 0;
+    }
+    else {
+        ensureCap(list);
+        p = &list->data[list->size++];
+    }
     p->purchaseId = purchaseId;
     p->productId = productId;
     p->quantity = quantity;
@@ -46,11 +96,19 @@ Purchase* addPurchase(PurchaseList* list,
     return p;
 }
 
+int formatPurchaseRecord(const Purchase* p, char* buf, size_t cap) {
+    char cost[MONEY_STR_MAX];
+    return snprintf(buf, cap, "%d,%d,%d,%s,%lld\n",
+        p->purchaseId, p->productId, p->quantity, money_str(p->unitCost, cost), p->createdAt);
+}
+
 int appendPurchaseToCSV(const char* path, const Purchase* p) {
+    char line[128];
+    int len = formatPurchaseRecord(p, line, sizeof(line));
+    if (len < 0 || (size_t)len >= sizeof(line)) return -2;
     FILE* fp = fopen(path, "a");
     if (!fp) return -1;
-    fprintf(fp, "%d,%d,%d,%.6f,%lld\n",
-        p->purchaseId, p->productId, p->quantity, p->unitCost, p->createdAt);
+    fwrite(line, 1, (size_t)len, fp);
     fclose(fp);
     return 0;
 }
@@ -82,7 +140,7 @@ static int parse_line(const char* line, Purchase* out) {
 
     tok = strtok_s(NULL, ",", &context);
     if (!tok) return 0;
-    out->unitCost = atof(tok);
+    if (!money_parse(tok, &out->unitCost)) return 0;
 
     tok = strtok_s(NULL, ",", &context);
     if (!tok) return 0;
@@ -91,7 +149,7 @@ static int parse_line(const char* line, Purchase* out) {
     return 1;
 }
 
-int loadPurchasesFromCSV(const char* path, PurchaseList* out) {
+static int load_purchases_impl(const char* path, PurchaseList* out) {
     FILE* fp = fopen(path, "r");
     if (!fp) return -1;
 
@@ -108,6 +166,139 @@ int loadPurchasesFromCSV(const char* path, PurchaseList* out) {
     return count;
 }
 
+int loadPurchasesFromCSV(const char* path, PurchaseList* out) {
+    TRACE_BEGIN("loadPurchasesFromCSV");
+    int rc;
+    if (!METRICS_ON()) {
+        rc = load_purchases_impl(path, out);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        rc = load_purchases_impl(path, out);
+        metrics_record(MET_LOAD_PURCHASES, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+    return rc;
+}
+
+int purchase_openReader(PurchaseReader* r, const char* path) {
+    r->fp = fopen(path, "r");
+    return r->fp ? 0 : -1;
+}
+
+int purchase_parseLine(const char* line, Purchase* out) {
+    return parse_line(line, out);
+}
+
+int purchase_next(PurchaseReader* r, Purchase* out) {
+    if (!r->fp) return 0;
+    while (fgets(r->line, sizeof(r->line), r->fp)) {
+        if (parse_line(r->line, out)) return 1;
+    }
+    return 0;
+}
+
+void purchase_closeReader(PurchaseReader* r) {
+    if (r->fp) fclose(r->fp);
+    r->fp = NULL;
+}
+
+static int seek_to(FILE* fp, uint64_t off) {
+#if defined(_MSC_VER)
+    return _fseeki64(fp, (long long)off, SEEK_SET);
+#else
+    return fseeko(fp, (off_t)off, SEEK_SET);
+#endif
+}
+
+static uint64_t file_size(FILE* fp) {
+#if defined(_MSC_VER)
+    if (_fseeki64(fp, 0, SEEK_END) != 0) return 0;
+    long long n = _ftelli64(fp);
+#else
+    if (fseeko(fp, 0, SEEK_END) != 0) return 0;
+    off_t n = ftello(fp);
+#endif
+    return n > 0 ? (uint64_t)n : 0;
+}
+
+/* reads whole chunks backwards from the end until the buffer holds more
+ * than maxRecords line breaks or the start of the file */
+static int load_tail_impl(const char* path, PurchaseList* out, size_t maxRecords, int* outLastId) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return -1;
+    uint64_t size = file_size(fp);
+    uint64_t start = size;
+    char* buf = NULL;
+    size_t len = 0;
+    size_t breaks = 0;
+    while (start > 0 && breaks <= maxRecords) {
+        size_t chunk = start > TAIL_CHUNK ? TAIL_CHUNK : (size_t)start;
+        char* nb = (char*)malloc(len + chunk + 1);
+        if (!nb || seek_to(fp, start - chunk) != 0 || fread(nb, 1, chunk, fp) != chunk) {
+            free(nb);
+            break;
+        }
+        if (len) memcpy(nb + chunk, buf, len);
+        free(buf);
+        buf = nb;
+        len += chunk;
+        start -= chunk;
+        for (size_t i = 0; i < chunk; ++i) breaks += buf[i] == '\n';
+    }
+    fclose(fp);
+
+    int count = 0;
+    int lastId = 0;
+    if (buf) {
+        buf[len] = '\0';
+        char* s = buf;
+        /* a line cut by the window is skipped, unless the window starts the file */
+        if (start > 0) {
+            char* nl = strchr(s, '\n');
+            s = nl ? nl + 1 : buf + len;
+        }
+        /* only the last maxRecords lines */
+        size_t lines = 0;
+        for (char* q = s; *q; ++q) lines += *q == '\n';
+        if (len > 0 && buf[len - 1] != '\n') lines++;   /* unterminated last line */
+        while (lines > maxRecords) {
+            s = strchr(s, '\n') + 1;
+            lines--;
+        }
+        while (*s) {
+            char* nl = strchr(s, '\n');
+            if (nl) *nl = '\0';
+            Purchase p;
+            if (parse_line(s, &p)) {
+                addPurchase(out, p.purchaseId, p.productId, p.quantity, p.unitCost, p.createdAt);
+                if (p.purchaseId > lastId) lastId = p.purchaseId;
+                count++;
+            }
+            if (!nl) break;
+            s = nl + 1;
+        }
+        free(buf);
+    }
+    if (outLastId) *outLastId = lastId;
+    return count;
+}
+
+int purchase_loadTail(const char* path, PurchaseList* out, size_t maxRecords, int* outLastId) {
+    TRACE_BEGIN("purchase_loadTail");
+    int rc;
+    if (!METRICS_ON()) {
+        rc = load_tail_impl(path, out, maxRecords, outLastId);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        rc = load_tail_impl(path, out, maxRecords, outLastId);
+        metrics_record(MET_LOAD_PURCHASES, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+    return rc;
+}
+
 int purchase_nextIdFromList(const PurchaseList* list) {
     int maxId = 0;
     if (!list) return 1;
@@ -117,45 +308,118 @@ int purchase_nextIdFromList(const PurchaseList* list) {
     return maxId + 1;
 }
 
+int purchase_maxIdFromFile(const char* path) {
+    PurchaseReader r;
+    if (purchase_openReader(&r, path) != 0) return -1;
+    Purchase p;
+    int maxId = 0;
+    while (purchase_next(&r, &p)) {
+        if (p.purchaseId > maxId) maxId = p.purchaseId;
+    }
+    purchase_closeReader(&r);
+    return maxId;
+}
+
+int purchase_loadNextId(const char* path, size_t* outRecords) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return -1;
+    char line[32];
+    int next = 0;
+    size_t records = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        char* end;
+        long v = strtol(line, &end, 10);
+        if (end == line || (*end != '\n' && *end != '\r' && *end != '\0')) continue;
+        records++;
+        /* the counter only moves forward; a stray lower line cannot rewind it */
+        if (v > next && v <= INT32_MAX) next = (int)v;
+    }
+    fclose(fp);
+    if (outRecords) *outRecords = records;
+    return next;
+}
+
+static void print_log_header(void) {
+    printf("=== Purchase Log ===\n");
+    printf("%-6s %-8s %-8s %-10s %-12s\n", "PID", "ProdID", "Qty", "UnitCost", "CreatedAt");
+}
+
+static void print_log_row(const Purchase* p) {
+    char cost[MONEY_STR_MAX];
+    printf("%-6d %-8d %-8d %-10s %-12lld\n",
+        p->purchaseId, p->productId, p->quantity, money_str(p->unitCost, cost), p->createdAt);
+}
+
 void purchase_printLog(const PurchaseList* list) {
     if (!list || list->size == 0) {
         printf("No purchases.\n");
         return;
     }
-    printf("=== Purchase Log ===\n");
-    printf("%-6s %-8s %-8s %-10s %-12s\n", "PID", "ProdID", "Qty", "UnitCost", "CreatedAt");
+    print_log_header();
     for (size_t i = 0; i < list->size; ++i) {
-        const Purchase* p = &list->data[i];
-        printf("%-6d %-8d %-8d %-10.2f %-12lld\n",
-            p->purchaseId, p->productId, p->quantity, p->unitCost, p->createdAt);
+        print_log_row(purchase_at(list, i));
+    }
+}
+
+int purchase_printLogFile(const char* path) {
+    PurchaseReader r;
+    if (purchase_openReader(&r, path) != 0) return -1;
+    Purchase p;
+    size_t n = 0;
+    while (purchase_next(&r, &p)) {
+        if (n++ == 0) print_log_header();
+        print_log_row(&p);
     }
+    purchase_closeReader(&r);
+    if (n == 0) printf("No purchases.\n");
+    return 0;
 }
 
 typedef struct {
     int productId;
     long long totalQty;
-    double totalCost;
+    Money totalCost;
 } Agg;
 
-static void agg_add(Agg** arr, size_t* n, size_t* cap, int productId, int qty, double unitCost) {
-    for (size_t i = 0; i < *n; ++i) {
-        if ((*arr)[i].productId == productId) {
-            (*arr)[i].totalQty += qty;
-            (*arr)[i].totalCost += (double)qty * unitCost;
-            return;
+/* per-product totals, one IdMap probe per record */
+typedef struct {
+    Agg*   rows;
+    size_t n;
+    size_t cap;
+    IdMap  indexOf;
+} AggTable;
+
+static void agg_init(AggTable* t) {
+    t->rows = NULL;
+    t->n = 0;
+    t->cap = 0;
+    idmap_init(&t->indexOf);
+}
+
+static void agg_free(AggTable* t) {
+    free(t->rows);
+    idmap_free(&t->indexOf);
+}
+
+static void agg_add(AggTable* t, int productId, int qty, Money unitCost) {
+    long i = idmap_find(&t->indexOf, productId);
+    if (i < 0) {
+        if (t->n >= t->cap) {
+            size_t newCap = (t->cap == 0) ? 16 : (t->cap * 2);
+            Agg* nd = (Agg*)realloc(t->rows, newCap * sizeof(Agg));
+            if (!nd) return;
+            t->rows = nd;
+            t->cap = newCap;
         }
+        /* ids <= 0 are not indexed and get a row per record, as a fallback */
+        if (productId > 0 && idmap_put(&t->indexOf, productId, t->n) != 0) return;
+        i = (long)t->n++;
+        t->rows[i].productId = productId;
+        t->rows[i].totalQty = 0;
+        t->rows[i].totalCost = 0;
     }
-    if (*n >= *cap) {
-        size_t newCap = (*cap == 0) ? 16 : (*cap * 2);
-        Agg* nd = (Agg*)realloc(*arr, newCap * sizeof(Agg));
-        if (!nd) return;
-        *arr = nd;
-        *cap = newCap;
-    }
-    (*arr)[*n].productId = productId;
-    (*arr)[*n].totalQty = qty;
-    (*arr)[*n].totalCost = (double)qty * unitCost;
-    (*n)++;
+    t->rows[i].totalQty += qty;
+    t->rows[i].totalCost += money_mul(unitCost, qty);
 }
 
 static int cmp_qty_desc(const void* a, const void* b) {
@@ -166,26 +430,40 @@ static int cmp_qty_desc(const void* a, const void* b) {
     return 0;
 }
 
-void purchase_printSummaryByProduct(const PurchaseList* list) {
-    if (!list || list->size == 0) {
+static void print_agg(AggTable* t) {
+    if (t->n == 0) {
         printf("No purchases.\n");
         return;
     }
-
-    Agg* ag = NULL;
-    size_t n = 0, cap = 0;
-    for (size_t i = 0; i < list->size; ++i) {
-        const Purchase* p = &list->data[i];
-        agg_add(&ag, &n, &cap, p->productId, p->quantity, p->unitCost);
-    }
-    qsort(ag, n, sizeof(Agg), cmp_qty_desc);
+    qsort(t->rows, t->n, sizeof(Agg), cmp_qty_desc);
 
     printf("=== Purchase Summary By Product ===\n");
     printf("%-8s %-10s %-12s %-12s\n", "ProdID", "TotalQty", "TotalCost", "AvgCost");
-    for (size_t i = 0; i < n; ++i) {
-        double avg = (ag[i].totalQty > 0) ? (ag[i].totalCost / (double)ag[i].totalQty) : 0.0;
-        printf("%-8d %-10lld %-12.2f %-12.2f\n",
-            ag[i].productId, ag[i].totalQty, ag[i].totalCost, avg);
+    char total[MONEY_STR_MAX], avg[MONEY_STR_MAX];
+    for (size_t i = 0; i < t->n; ++i) {
+        const Agg* g = &t->rows[i];
+        printf("%-8d %-10lld %-12s %-12s\n", g->productId, g->totalQty,
+            money_str(g->totalCost, total), money_str(money_div(g->totalCost, g->totalQty), avg));
+    }
+}
+
+static void print_summary_impl(const PurchaseList* list) {
+    AggTable t;
+    agg_init(&t);
+    for (size_t i = 0; list && i < list->size; ++i) {
+        const Purchase* p = purchase_at(list, i);
+        agg_add(&t, p->productId, p->quantity, p->unitCost);
     }
-    free(ag);
-}
\ No newline at end of file
+    print_agg(&t);
+    agg_free(&t);
+}
+
+void purchase_printSummaryByProduct(const PurchaseList* list) {
+    if (!METRICS_ON()) {
+        print_summary_impl(list);
+        return;
+    }
+    uint64_t t0 = timeutil_nowNs();
+    print_summary_impl(list);
+    metrics_record(MET_REPORT_PURCHASE_SUMMARY, timeutil_nowNs() - t0);
+}
@@ -3,7 +3,9 @@
 #ifndef PURCHASE_H
 #define PURCHASE_H
 
+#include <stdio.h>
 #include <stddef.h>
+#include "money.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -13,7 +15,7 @@ extern "C" {
         int purchaseId;
         int productId;
         int quantity;
-        double unitCost;
+        Money unitCost;     /* cents */
         long long createdAt; /* epoch seconds */
     } Purchase;
 
@@ -21,27 +23,59 @@ extern "C" {
         Purchase* data;
         size_t size;
         size_t capacity;
+        size_t limit;       /* >0ֻ limit ʱɵ */
+        size_t head;        /* Σ limit һ±꣬Ϊ 0 */
     } PurchaseList;
 
     void initPurchaseList(PurchaseList* list);
     void freePurchaseList(PurchaseList* list);
+    void purchase_setLimit(PurchaseList* list, size_t limit);
+
+    /* ʱ˳ĵ i 0 ΪɣҪֱӰ± data */
+    const Purchase* purchase_at(const PurchaseList* list, size_t i);
 
     Purchase* addPurchase(PurchaseList* list,
         int purchaseId,
         int productId,
         int quantity,
-        double unitCost,
+        Money unitCost,
         long long createdAt);
 
     /* CSV schema: purchaseId,productId,quantity,unitCost,createdAt */
     int appendPurchaseToCSV(const char* path, const Purchase* p);
+    /* one CSV line incl. '\n'; returns length like snprintf */
+    int formatPurchaseRecord(const Purchase* p, char* buf, size_t cap);
     int loadPurchasesFromCSV(const char* path, PurchaseList* out);
 
+    /* ˳ȡ־ڴ */
+    typedef struct {
+        FILE* fp;
+        char  line[256];
+    } PurchaseReader;
+
+    int  purchase_openReader(PurchaseReader* r, const char* path);   /* -1ļ */
+    int  purchase_next(PurchaseReader* r, Purchase* out);            /* 1һ0 */
+    void purchase_closeReader(PurchaseReader* r);
+    /* һ־1ɹ */
+    int  purchase_parseLine(const char* line, Purchase* out);
+
+    /* ֻļĩβȡ maxRecords  out*outLastId Ϊ purchaseId
+     * Ű׷˳־ţضļڷ -1 */
+    int purchase_loadTail(const char* path, PurchaseList* out, size_t maxRecords, int* outLastId);
+
     int purchase_nextIdFromList(const PurchaseList* list);
+    /* ʽɨ־ţļڷ -1 */
+    int purchase_maxIdFromFile(const char* path);
+
+    /* һŵļļÿһţȡֵΪ Journal ׷ӡѹ
+     * رţļڷ -1*outRecords ΪЧ */
+    int purchase_loadNextId(const char* path, size_t* outRecords);
 
     /*  */
     void purchase_printLog(const PurchaseList* list);
     void purchase_printSummaryByProduct(const PurchaseList* list);
+    /* ʽȡ־ļڷ -1 */
+    int  purchase_printLogFile(const char* path);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,230 @@
+#include "receiving.h"
+#include "inventory.h"
+#include "metrics.h"
+#include "timeutil.h"
+#include "trace.h"
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PURCHASE_LINE_MAX 128
+#define COST_LINE_MAX 160
+
+void manifest_init(Manifest* m) {
+    memset(m, 0, sizeof(*m));
+}
+
+void manifest_free(Manifest* m) {
+    free(m->data);
+    free(m->byProduct);
+    memset(m, 0, sizeof(*m));
+}
+
+static int push_line(Manifest* m, const ManifestLine* line) {
+    if (m->size >= m->capacity) {
+        size_t newCap = m->capacity == 0 ? 256 : m->capacity * 2;
+        ManifestLine* nd = (ManifestLine*)realloc(m->data, newCap * sizeof(ManifestLine));
+        if (!nd) return -1;
+        m->data = nd;
+        m->capacity = newCap;
+    }
+    m->data[m->size++] = *line;
+    return 0;
+}
+
+static void line_error(Manifest* m, int lineNo, const char* what, int productId) {
+    if (m->errors++ < MANIFEST_MAX_ERRORS) {
+        if (productId) printf("  line %d: %s (product %d)\n", lineNo, what, productId);
+        else printf("  line %d: %s\n", lineNo, what);
+    }
+}
+
+static const char* skip_spaces(const char* s) {
+    while (*s == ' ' || *s == '\t') s++;
+    return s;
+}
+
+static const char* parse_int(const char* s, int* out) {
+    char* end;
+    long long v = strtoll(s, &end, 10);
+    if (end == s || v < INT_MIN || v > INT_MAX) return NULL;
+    *out = (int)v;
+    return end;
+}
+
+/* 1 parsed, 0 skipped (blank, comment), -1 malformed */
+static int parse_manifest_line(const char* s, ManifestLine* out) {
+    s = skip_spaces(s);
+    if (*s == '\0' || *s == '\n' || *s == '\r' || *s == '#') return 0;
+    if (!(s = parse_int(s, &out->productId)) || *s++ != ',') return -1;
+    if (!(s = parse_int(s, &out->quantity)) || *s++ != ',') return -1;
+    if (!(s = money_parse(s, &out->unitCost))) return -1;
+    s = skip_spaces(s);
+    return (*s == '\0' || *s == '\n' || *s == '\r') ? 1 : -1;
+}
+
+static int cmp_ref(const void* a, const void* b) {
+    const ManifestRef* x = (const ManifestRef*)a;
+    const ManifestRef* y = (const ManifestRef*)b;
+    if (x->productId != y->productId) return x->productId < y->productId ? -1 : 1;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+/* per-product checks, one lookup per distinct product */
+static void validate_groups(Manifest* m, ProductList* products) {
+    size_t i = 0;
+    while (i < m->size) {
+        size_t j = i;
+        long long units = 0;
+        int pid = m->byProduct[i].productId;
+        for (; j < m->size && m->byProduct[j].productId == pid; ++j) {
+            units += m->data[m->byProduct[j].index].quantity;
+        }
+        m->products++;
+        const ManifestLine* first = &m->data[m->byProduct[i].index];
+        Product* p = findProductById(products, pid);
+        if (!p) line_error(m, first->lineNo, "product not found", pid);
+        else if ((long long)p->stock + units > INT_MAX) line_error(m, first->lineNo, "stock would overflow", pid);
+        i = j;
+    }
+}
+
+int manifest_load(Manifest* m, const char* path, ProductList* products) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return -1;
+    char line[256];
+    int lineNo = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        lineNo++;
+        ManifestLine ml;
+        int rc = parse_manifest_line(line, &ml);
+        if (rc == 0) continue;
+        if (rc < 0) {
+            /* a header row names the columns instead of numbers */
+            if (m->size == 0 && m->errors == 0 && isalpha((unsigned char)*skip_spaces(line))) continue;
+            line_error(m, lineNo, "malformed, expected productId,quantity,unitCost", 0);
+            continue;
+        }
+        if (ml.quantity <= 0) {
+            line_error(m, lineNo, "quantity must be positive", ml.productId);
+            continue;
+        }
+        if (ml.unitCost < 0) {
+            line_error(m, lineNo, "negative unit cost", ml.productId);
+            continue;
+        }
+        ml.lineNo = lineNo;
+        if (push_line(m, &ml) != 0) {
+            fclose(fp);
+            return -2;
+        }
+    }
+    fclose(fp);
+
+    if (m->size > 0) {
+        m->byProduct = (ManifestRef*)malloc(m->size * sizeof(ManifestRef));
+        if (!m->byProduct) return -2;
+        for (size_t i = 0; i < m->size; ++i) {
+            m->byProduct[i].productId = m->data[i].productId;
+            m->byProduct[i].index = i;
+        }
+        qsort(m->byProduct, m->size, sizeof(ManifestRef), cmp_ref);
+        validate_groups(m, products);
+    }
+    if (m->errors > MANIFEST_MAX_ERRORS) {
+        printf("  ... %zu more\n", m->errors - MANIFEST_MAX_ERRORS);
+    }
+    return (int)m->size;
+}
+
+static int receive_impl(const Manifest* m, ProductList* products, PurchaseList* purchases,
+    Valuation* v, int firstPurchaseId, long long now, ReceiveResult* out) {
+    memset(out, 0, sizeof(*out));
+    /* both buffers up front, so running out of memory changes nothing */
+    out->purchaseLog = (char*)malloc(m->size * PURCHASE_LINE_MAX + 1);
+    out->costLog = (char*)malloc(m->products * COST_LINE_MAX + 1);
+    if (!out->purchaseLog || !out->costLog) {
+        receive_freeResult(out);
+        return -1;
+    }
+    /* every product's cost pool too, before the first stock change; an
+     * empty pool left behind by a failure here changes no totals */
+    for (size_t k = 0; k < m->size; ++k) {
+        if (valuation_track(v, m->byProduct[k].productId) != 0) {
+            receive_freeResult(out);
+            return -1;
+        }
+    }
+    out->lines = m->size;
+    out->firstPurchaseId = firstPurchaseId;
+    out->lastPurchaseId = firstPurchaseId + (int)m->size - 1;
+
+    size_t i = 0;
+    while (i < m->size) {
+        int pid = m->byProduct[i].productId;
+        Product* p = findProductById(products, pid);
+        const CostEntry* e = NULL;
+        int units = 0;
+        for (; i < m->size && m->byProduct[i].productId == pid; ++i) {
+            const ManifestLine* ml = &m->data[m->byProduct[i].index];
+            units += ml->quantity;
+            out->cost += money_mul(ml->unitCost, ml->quantity);
+            /* per line: the pool's average must weigh each cost exactly */
+            e = valuation_receive(v, pid, ml->quantity, ml->unitCost);
+        }
+        increaseStock(p, units);
+        out->units += units;
+        out->products++;
+        if (e) {
+            out->costLogLen += (size_t)valuation_formatRecord(e, out->costLog + out->costLogLen,
+                COST_LINE_MAX + 1);
+        }
+    }
+
+    /* records in manifest order so the ids in the log stay ascending; the
+     * bounded in-memory tail only needs the last `limit` of them */
+    size_t keepFrom = 0;
+    if (purchases->limit > 0 && m->size > purchases->limit) keepFrom = m->size - purchases->limit;
+    for (size_t k = 0; k < m->size; ++k) {
+        const ManifestLine* ml = &m->data[k];
+        Purchase rec;
+        rec.purchaseId = firstPurchaseId + (int)k;
+        rec.productId = ml->productId;
+        rec.quantity = ml->quantity;
+        rec.unitCost = ml->unitCost;
+        rec.createdAt = now;
+        out->purchaseLogLen += (size_t)formatPurchaseRecord(&rec, out->purchaseLog + out->purchaseLogLen,
+            PURCHASE_LINE_MAX + 1);
+        if (k >= keepFrom) {
+            addPurchase(purchases, rec.purchaseId, rec.productId, rec.quantity, rec.unitCost, rec.createdAt);
+        }
+    }
+    return 0;
+}
+
+int manifest_receive(const Manifest* m, ProductList* products, PurchaseList* purchases,
+    Valuation* v, int firstPurchaseId, long long now, ReceiveResult* out) {
+    TRACE_BEGIN("manifest_receive");
+    int rc;
+    if (!METRICS_ON()) {
+        rc = receive_impl(m, products, purchases, v, firstPurchaseId, now, out);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        rc = receive_impl(m, products, purchases, v, firstPurchaseId, now, out);
+        metrics_record(MET_RECEIVE_MANIFEST, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+    return rc;
+}
+
+void receive_freeResult(ReceiveResult* r) {
+    free(r->purchaseLog);
+    free(r->costLog);
+    r->purchaseLog = NULL;
+    r->costLog = NULL;
+    r->purchaseLogLen = 0;
+    r->costLogLen = 0;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#ifndef RECEIVING_H
+#define RECEIVING_H
+
+#include <stddef.h>
+#include "money.h"
+#include "product.h"
+#include "purchase.h"
+#include "valuation.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Bulk receiving of a shipment manifest.
+     *
+     * A manifest is a CSV of "productId,quantity,unitCost" lines; blank
+     * lines, '#' comments and a non-numeric header line are skipped.
+     * manifest_load() reads and validates every line before anything is
+     * applied, so a shipment is received completely or not at all.
+     *
+     * manifest_receive() then walks the lines grouped by product: one
+     * lookup and one stock increase per product, one cost-pool update per
+     * line, and one valuation record per product (its final state). The
+     * purchases get the contiguous ids firstPurchaseId.. in manifest order
+     * and are formatted into a single buffer for one append.
+     */
+
+#define MANIFEST_MAX_ERRORS 20   /* problems printed; all are counted */
+
+    typedef struct {
+        int   productId;
+        int   quantity;
+        Money unitCost;
+        int   lineNo;
+    } ManifestLine;
+
+    typedef struct {
+        int    productId;
+        size_t index;              /* into Manifest.data */
+    } ManifestRef;
+
+    typedef struct {
+        ManifestLine* data;
+        size_t        size;
+        size_t        capacity;
+        ManifestRef*  byProduct;   /* sorted by productId, then manifest order */
+        size_t        products;    /* distinct products */
+        size_t        errors;      /* lines that failed validation */
+    } Manifest;
+
+    typedef struct {
+        size_t    lines;
+        size_t    products;
+        long long units;
+        Money     cost;
+        int       firstPurchaseId;
+        int       lastPurchaseId;
+        char*     purchaseLog;     /* purchase_log.csv records (malloc'd) */
+        size_t    purchaseLogLen;
+        char*     costLog;         /* valuation.csv records, one per product (malloc'd) */
+        size_t    costLogLen;
+    } ReceiveResult;
+
+    void manifest_init(Manifest* m);
+    void manifest_free(Manifest* m);
+
+    /* lines read (check m->errors before receiving), -1 if the file cannot
+     * be opened, -2 when out of memory */
+    int  manifest_load(Manifest* m, const char* path, ProductList* products);
+
+    /* applies a manifest without errors. 0 ok, -1 when out of memory (in
+     * which case nothing was applied). Free the result's buffers with
+     * receive_freeResult(). */
+    int  manifest_receive(const Manifest* m, ProductList* products, PurchaseList* purchases,
+        Valuation* v, int firstPurchaseId, long long now, ReceiveResult* out);
+    void receive_freeResult(ReceiveResult* r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
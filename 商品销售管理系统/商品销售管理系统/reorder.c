@@ -1,8 +1,19 @@
 #include "reorder.h"
 #include "utils.h"
+#include "compat.h"
+#include "metrics.h"
+#include "trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define REORDER_SSE2 1
+#else
+#define REORDER_SSE2 0
+#endif
 
 static void ensureCap(ReorderTable* t) {
     if (t->size >= t->capacity) {
@@ -17,18 +28,46 @@ static void ensureCap(ReorderTable* t) {
     }
 }
 
+static int is_direct(int productId) {
+    return productId > 0 && productId < REORDER_DIRECT_MAX;
+}
+
+static void ensureSlotCap(ReorderTable* t, int productId) {
+    if ((size_t)productId < t->slotCap) return;
+    size_t newCap = t->slotCap == 0 ? 64 : t->slotCap;
+    while (newCap <= (size_t)productId) newCap *= 2;
+    unsigned* ns = (unsigned*)realloc(t->slotOf, newCap * sizeof(unsigned));
+    if (!ns) {
+        fprintf(stderr, "reorder index realloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(ns + t->slotCap, 0, (newCap - t->slotCap) * sizeof(unsigned));
+    t->slotOf = ns;
+    t->slotCap = newCap;
+}
+
+/* data ±꣬δ÷ -1 */
+static long find_slot(const ReorderTable* t, int productId) {
+    if (is_direct(productId)) {
+        return (size_t)productId < t->slotCap ? (long)t->slotOf[productId] - 1 : -1;
+    }
+    if (t->sparse == 0) return -1;
+    for (size_t i = 0; i < t->size; ++i) {
+        if (t->data[i].productId == productId) return (long)i;
+    }
+    return -1;
+}
+
 void reorder_init(ReorderTable* t) {
-    t->data = NULL;
-    t->size = 0;
-    t->capacity = 0;
+    memset(t, 0, sizeof(*t));
 }
 
 void reorder_free(ReorderTable* t) {
     if (!t) return;
     free(t->data);
-    t->data = NULL;
-    t->size = 0;
-    t->capacity = 0;
+    free(t->slotOf);
+    free(t->levelAt);
+    memset(t, 0, sizeof(*t));
 }
 
 static void trim_eol(char* s) {
@@ -36,7 +75,7 @@ static void trim_eol(char* s) {
     while (n && (s[n - 1] == '\n' || s[n - 1] == '\r')) s[--n] = '\0';
 }
 
-int reorder_loadCSV(const char* path, ReorderTable* t) {
+static int load_csv_impl(const char* path, ReorderTable* t) {
     FILE* fp = fopen(path, "r");
     if (!fp) return -1;
 
@@ -64,7 +103,7 @@ int reorder_loadCSV(const char* path, ReorderTable* t) {
     return count;
 }
 
-int reorder_saveCSV(const char* path, const ReorderTable* t) {
+static int save_csv_impl(const char* path, const ReorderTable* t) {
     FILE* fp = fopen(path, "w");
     if (!fp) return -1;
 
@@ -75,77 +114,156 @@ int reorder_saveCSV(const char* path, const ReorderTable* t) {
     return 0;
 }
 
-int reorder_getLevel(const ReorderTable* t, int productId, int defaultLevel) {
-    if (!t) return defaultLevel;
+int reorder_formatRecord(int productId, int level, char* buf, size_t cap) {
+    return snprintf(buf, cap, "%d,%d\n", productId, level);
+}
+
+char* reorder_formatSnapshot(const ReorderTable* t, size_t* outLen) {
+    size_t cap = t->size * 24 + 1;   /* two ints, a comma and a newline */
+    char* buf = (char*)malloc(cap);
+    if (!buf) return NULL;
+    size_t len = 0;
     for (size_t i = 0; i < t->size; ++i) {
-        if (t->data[i].productId == productId) return t->data[i].reorderLevel;
+        len += (size_t)reorder_formatRecord(t->data[i].productId, t->data[i].reorderLevel,
+            buf + len, cap - len);
+    }
+    *outLen = len;
+    return buf;
+}
+
+int reorder_loadCSV(const char* path, ReorderTable* t) {
+    TRACE_BEGIN("reorder_loadCSV");
+    int rc;
+    if (!METRICS_ON()) {
+        rc = load_csv_impl(path, t);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        rc = load_csv_impl(path, t);
+        metrics_record(MET_LOAD_REORDER, timeutil_nowNs() - t0);
     }
-    return defaultLevel;
+    TRACE_END();
+    return rc;
+}
+
+int reorder_saveCSV(const char* path, const ReorderTable* t) {
+    if (!METRICS_ON()) return save_csv_impl(path, t);
+    uint64_t t0 = timeutil_nowNs();
+    int rc = save_csv_impl(path, t);
+    metrics_record(MET_SAVE_REORDER, timeutil_nowNs() - t0);
+    return rc;
+}
+
+int reorder_getLevel(const ReorderTable* t, int productId, int defaultLevel) {
+    if (!t) return defaultLevel;
+    long slot = find_slot(t, productId);
+    return slot >= 0 ? t->data[slot].reorderLevel : defaultLevel;
 }
 
 void reorder_setLevel(ReorderTable* t, int productId, int level) {
-    for (size_t i = 0; i < t->size; ++i) {
-        if (t->data[i].productId == productId) {
-            t->data[i].reorderLevel = level;
-            return;
-        }
+    t->changes++;
+    long slot = find_slot(t, productId);
+    if (slot >= 0) {
+        t->data[slot].reorderLevel = level;
+    }
+    else {
+        if (is_direct(productId)) ensureSlotCap(t, productId);
+        ensureCap(t);
+        t->data[t->size].productId = productId;
+        t->data[t->size].reorderLevel = level;
+        t->size++;
+        if (is_direct(productId)) t->slotOf[productId] = (unsigned)t->size;
+        else t->sparse++;
     }
-    ensureCap(t);
-    t->data[t->size].productId = productId;
-    t->data[t->size].reorderLevel = level;
-    t->size++;
+    if (t->onChange) t->onChange(productId, t->onChangeCtx);
 }
 
 void reorder_remove(ReorderTable* t, int productId) {
     if (!t) return;
-    for (size_t i = 0; i < t->size; ++i) {
-        if (t->data[i].productId == productId) {
-            t->data[i] = t->data[t->size - 1];
-            t->size--;
-            return;
-        }
+    long slot = find_slot(t, productId);
+    if (slot < 0) return;
+    t->changes++;
+    if (is_direct(productId)) t->slotOf[productId] = 0;
+    else t->sparse--;
+    /* ĩλ */
+    size_t last = t->size - 1;
+    if ((size_t)slot != last) {
+        t->data[slot] = t->data[last];
+        int movedId = t->data[slot].productId;
+        if (is_direct(movedId)) t->slotOf[movedId] = (unsigned)slot + 1;
     }
+    t->size--;
+    if (t->onChange) t->onChange(productId, t->onChangeCtx);
 }
 
-void reorder_printLowStock(const ProductList* products,
-    const ReorderTable* t,
-    int defaultLevel) {
-    printf("\n=== Low Stock Alert ===\n");
-    printf("%-6s %-20s %-8s %-8s\n", "ID", "Name", "Stock", "Level");
+/*  products->data ±ֵ飬Ʒṹֵ仯ؽ */
+static const int* aligned_levels(ReorderTable* t, const ProductList* products, int defaultLevel) {
+    size_t n = products->size;
+    if (t->levelAt && t->levelAtList == products && t->levelAtSize == n &&
+        t->levelAtVersion == products->version && t->levelAtChanges == t->changes &&
+        t->levelAtDefault == defaultLevel) {
+        return t->levelAt;
+    }
+    int* levels = (int*)realloc(t->levelAt, (n ? n : 1) * sizeof(int));
+    if (!levels) return NULL;
+    t->levelAt = levels;
+    for (size_t i = 0; i < n; ++i) {
+        levels[i] = reorder_getLevel(t, products->data[i].id, defaultLevel);
+    }
+    t->levelAtSize = n;
+    t->levelAtList = products;
+    t->levelAtVersion = products->version;
+    t->levelAtChanges = t->changes;
+    t->levelAtDefault = defaultLevel;
+    return levels;
+}
 
-    int any = 0;
-    for (size_t i = 0; i < products->size; ++i) {
-        const Product* p = &products->data[i];
-        int lvl = reorder_getLevel(t, p->id, defaultLevel);
-        if (p->stock < lvl) {
-            any = 1;
-            printf("%-6d %-20s %-8d %-8d\n", p->id, p->name, p->stock, lvl);
+/* д data[i].stock < levels[i] ± iظ */
+static size_t scan_below(const Product* data, const int* levels, size_t n, size_t* out) {
+    size_t i = 0, k = 0;
+#if REORDER_SSE2
+    if (sizeof(Product) == 16 && offsetof(Product, stock) == 4) {
+        /* ÿ 4 Ʒȡ 1  int ͨstockƴһֵȽ */
+        for (; i + 4 <= n; i += 4) {
+            const __m128i* src = (const __m128i*)&data[i];
+            __m128 a = _mm_castsi128_ps(_mm_loadu_si128(src));
+            __m128 b = _mm_castsi128_ps(_mm_loadu_si128(src + 1));
+            __m128 c = _mm_castsi128_ps(_mm_loadu_si128(src + 2));
+            __m128 d = _mm_castsi128_ps(_mm_loadu_si128(src + 3));
+            __m128 ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 1, 1));
+            __m128 cd = _mm_shuffle_ps(c, d, _MM_SHUFFLE(1, 1, 1, 1));
+            __m128i stock = _mm_castps_si128(_mm_shuffle_ps(ab, cd, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i lvl = _mm_loadu_si128((const __m128i*)&levels[i]);
+            int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(stock, lvl)));
+            if (!mask) continue;
+            /* k <= i4 д붼 out[0..n)  */
+            out[k] = i;     k += mask & 1;
+            out[k] = i + 1; k += (mask >> 1) & 1;
+            out[k] = i + 2; k += (mask >> 2) & 1;
+            out[k] = i + 3; k += (mask >> 3) & 1;
         }
     }
-    if (!any) printf("All stocks are above reorder levels.\n");
+#endif
+    for (; i < n; ++i) {
+        if (data[i].stock < levels[i]) out[k++] = i;
+    }
+    return k;
 }
 
-/* 飺 = level - stockΪ */
-void reorder_printReplenishList(const ProductList* products,
-    const ReorderTable* t,
-    int defaultLevel) {
-    printf("\n=== Replenish Suggestion List ===\n");
-    printf("%-6s %-20s %-8s %-8s %-10s\n", "ID", "Name", "Stock", "Level", "Suggest");
-
-    int any = 0;
+size_t reorder_findLowStock(ReorderTable* t, const ProductList* products,
+    int defaultLevel, size_t* outIdx) {
+    const int* levels = aligned_levels(t, products, defaultLevel);
+    if (levels) return scan_below(products->data, levels, products->size, outIdx);
+    /* ʧܣֵ */
+    size_t k = 0;
     for (size_t i = 0; i < products->size; ++i) {
         const Product* p = &products->data[i];
-        int lvl = reorder_getLevel(t, p->id, defaultLevel);
-        int need = lvl - p->stock;
-        if (need > 0) {
-            any = 1;
-            printf("%-6d %-20s %-8d %-8d %-10d\n", p->id, p->name, p->stock, lvl, need);
-        }
+        if (p->stock < reorder_getLevel(t, p->id, defaultLevel)) outIdx[k++] = i;
     }
-    if (!any) printf("No replenishment needed.\n");
+    return k;
 }
 
-void reorder_interactiveSetLevel(const char* csvPath,
+void reorder_interactiveSetLevel(Journal* journal,
     ReorderTable* t,
     ProductList* products,
     int defaultLevel) {
@@ -155,7 +273,7 @@ void reorder_interactiveSetLevel(const char* csvPath,
         printf("Product not found.\n");
         return;
     }
-    printf("Product: %s (current stock=%d)\n", p->name, p->stock);
+    printf("Product: %s (current stock=%d)\n", productName(products, p), p->stock);
 
     int cur = reorder_getLevel(t, pid, defaultLevel);
     printf("Current reorder level: %d\n", cur);
@@ -167,10 +285,20 @@ void reorder_interactiveSetLevel(const char* csvPath,
     }
 
     reorder_setLevel(t, pid, lvl);
-    if (reorder_saveCSV(csvPath, t) == 0) {
-        printf("Saved reorder level: productId=%d level=%d -> %s\n", pid, lvl, csvPath);
+    char rec[32];
+    int len = reorder_formatRecord(pid, lvl, rec, sizeof(rec));
+    if (journal_append(journal, rec, (size_t)len) == 0) {
+        printf("Saved reorder level: productId=%d level=%d -> %s\n", pid, lvl, journal->path);
     }
     else {
-        printf("Failed to save %s\n", csvPath);
+        printf("Failed to save %s\n", journal->path);
+        return;
+    }
+
+    /* ظõгһʱ̨滻ļ */
+    if (journal_shouldCompact(journal, t->size)) {
+        size_t snapLen = 0;
+        char* snap = reorder_formatSnapshot(t, &snapLen);
+        if (snap) journal_compact(journal, snap, snapLen, t->size);
     }
 }
\ No newline at end of file
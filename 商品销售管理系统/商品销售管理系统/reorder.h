@@ -1,10 +1,10 @@
 #pragma once
-#pragma once
 #ifndef REORDER_H
 #define REORDER_H
 
 #include <stddef.h>
 #include "product.h"
+#include "journal.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -21,30 +21,50 @@ extern "C" {
         ReorderLevel* data;
         size_t size;
         size_t capacity;
+        /* Ʒ id ֱslotOf[productId] = data ± + 10 ʾδã
+         * id ֱΧ<=0  >= REORDER_DIRECT_MAXм sparseԲ */
+        unsigned* slotOf;
+        size_t slotCap;
+        size_t sparse;
+        unsigned long changes;          /* ֵɾʱ */
+        /* Ϳɨ軺棺 products->data ±Чֵ */
+        int* levelAt;
+        size_t levelAtSize;
+        const ProductList* levelAtList;
+        unsigned long levelAtVersion;   /* ʱ products->version */
+        unsigned long levelAtChanges;   /* ʱ changes */
+        int levelAtDefault;
+        /* ֵ/ɾصάͿ漯ϣΪ NULL */
+        void (*onChange)(int productId, void* ctx);
+        void* onChangeCtx;
     } ReorderTable;
 
+#define REORDER_DIRECT_MAX (1 << 24)
+
     void reorder_init(ReorderTable* t);
     void reorder_free(ReorderTable* t);
 
     int  reorder_loadCSV(const char* path, ReorderTable* t);
     int  reorder_saveCSV(const char* path, const ReorderTable* t);
 
+    /* ־¼һ "productId,level\n"ʱ upsertֱ׷ӵ CSV ĩβ */
+    int  reorder_formatRecord(int productId, int level, char* buf, size_t cap);
+    /* գmalloc 䣬־ѹʧܷ NULL */
+    char* reorder_formatSnapshot(const ReorderTable* t, size_t* outLen);
+
     /* ȡ/ֵ */
     int  reorder_getLevel(const ReorderTable* t, int productId, int defaultLevel);
     void reorder_setLevel(ReorderTable* t, int productId, int level);
     void reorder_remove(ReorderTable* t, int productId);
 
-    /* /б */
-    void reorder_printLowStock(const ProductList* products,
-        const ReorderTable* t,
-        int defaultLevel);
-
-    void reorder_printReplenishList(const ProductList* products,
-        const ReorderTable* t,
-        int defaultLevel);
+    /* Ϳɨ裺 stock < ֵ Ʒ products->data е±갴˳д outIdx
+     *  products->size ԪأظֵƷֵ仯ؽ
+     * ֮ɨֻһȽ */
+    size_t reorder_findLowStock(ReorderTable* t, const ProductList* products,
+        int defaultLevel, size_t* outIdx);
 
-    /* ĳƷֵ棨 main.c ã */
-    void reorder_interactiveSetLevel(const char* csvPath,
+    /* ĳƷֵ׷ӵ־ main.c ã */
+    void reorder_interactiveSetLevel(Journal* journal,
         ReorderTable* t,
         ProductList* products,
         int defaultLevel);
@@ -0,0 +1,431 @@
+#include "replica.h"
+#include "orderbin.h"
+#include "timeutil.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#define REPLICA_BLOCK (64 * 1024)
+#define REPLICA_SEAL_RETRIES 3
+#define REPLICA_SLEEP_SLICE_MS 10
+
+static int seek_to(FILE* fp, uint64_t off) {
+#if defined(_MSC_VER)
+    return _fseeki64(fp, (long long)off, SEEK_SET);
+#else
+    return fseeko(fp, (off_t)off, SEEK_SET);
+#endif
+}
+
+static uint64_t file_size(FILE* fp) {
+#if defined(_MSC_VER)
+    if (_fseeki64(fp, 0, SEEK_END) != 0) return 0;
+    long long n = _ftelli64(fp);
+#else
+    if (fseeko(fp, 0, SEEK_END) != 0) return 0;
+    off_t n = ftello(fp);
+#endif
+    return n > 0 ? (uint64_t)n : 0;
+}
+
+/* volume and file number of an open file: kept across a rename, new when
+ * the path names a different file. 0 when unknown. */
+static uint64_t file_identity(FILE* fp) {
+#if defined(_WIN32)
+    BY_HANDLE_FILE_INFORMATION info;
+    HANDLE h = (HANDLE)_get_osfhandle(_fileno(fp));
+    if (h == INVALID_HANDLE_VALUE || !GetFileInformationByHandle(h, &info)) return 0;
+    return (((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow) ^
+        ((uint64_t)info.dwVolumeSerialNumber << 40);
+#else
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0) return 0;
+    return (uint64_t)st.st_ino ^ ((uint64_t)st.st_dev << 40);
+#endif
+}
+
+static void tail_init(LogTail* t, const char* path) {
+    snprintf(t->path, sizeof(t->path), "%s", path);
+    t->offset = 0;
+    t->size = 0;
+    t->fileId = 0;
+    t->missing = 0;
+}
+
+int replica_init(Replica* r, const char* ordersPath, const char* purchasesPath) {
+    memset(r, 0, sizeof(*r));
+    tail_init(&r->orders, ordersPath);
+    tail_init(&r->purchases, purchasesPath);
+    partial_init(&r->agg);
+    r->buf = (char*)malloc(REPLICA_BLOCK);
+    if (!r->buf) return -1;
+    r->bufCap = REPLICA_BLOCK;
+    mutex_init(&r->mu);
+    return 0;
+}
+
+void replica_free(Replica* r) {
+    replica_stop(r);
+    if (r->buf) mutex_destroy(&r->mu);
+    partial_free(&r->agg);
+    free(r->items);
+    free(r->buf);
+    memset(r, 0, sizeof(*r));
+}
+
+/* ---------- applying lines ---------- */
+
+static int apply_pending(Replica* r) {
+    r->pending.items = r->items;
+    r->pending.itemCount = r->itemCount;
+    r->havePending = 0;
+    r->itemCount = 0;
+    if (partial_addOrder(&r->agg, &r->pending) != 0) {
+        r->failed = 1;
+        return 0;
+    }
+    r->ordersApplied++;
+    return 1;
+}
+
+static int reserve_items(Replica* r, size_t n) {
+    if (n <= r->itemCap) return 1;
+    size_t newCap = r->itemCap == 0 ? 16 : r->itemCap;
+    while (newCap < n) newCap *= 2;
+    OrderItem* nd = (OrderItem*)realloc(r->items, newCap * sizeof(OrderItem));
+    if (!nd) return 0;
+    r->items = nd;
+    r->itemCap = newCap;
+    return 1;
+}
+
+static int on_order_line(Replica* r, const char* line) {
+    int applied = 0;
+    OrderLogRecord h;
+    size_t declared;
+    OrderItem it;
+    if (orderlog_parseHeader(line, &h, &declared)) {
+        /* a record with fewer items than it declared is closed by the next header */
+        if (r->havePending) applied += apply_pending(r);
+        r->pending = h;
+        r->itemsDeclared = declared;
+        r->havePending = 1;
+        r->itemCount = 0;
+    }
+    else if (r->havePending && orderlog_parseItem(line, &it)) {
+        if (!reserve_items(r, r->itemCount + 1)) {
+            r->failed = 1;
+            return 0;
+        }
+        r->items[r->itemCount++] = it;
+    }
+    if (r->havePending && r->itemCount >= r->itemsDeclared) applied += apply_pending(r);
+    return applied;
+}
+
+/* a binary record is complete on its own */
+static int on_order_record(Replica* r, const char* rec) {
+    int applied = 0;
+    if (r->havePending) applied += apply_pending(r);
+    if (r->failed) return applied;
+    if (!reserve_items(r, orderbin_itemCount(rec))) {
+        r->failed = 1;
+        return applied;
+    }
+    orderbin_decode(rec, &r->pending, r->items, r->itemCap);
+    r->itemCount = r->pending.itemCount;
+    return applied + apply_pending(r);
+}
+
+static int on_purchase_line(Replica* r, const char* line) {
+    Purchase p;
+    if (!purchase_parseLine(line, &p)) return 0;
+    if (partial_addPurchase(&r->agg, &p) != 0) {
+        r->failed = 1;
+        return 0;
+    }
+    r->purchasesApplied++;
+    return 1;
+}
+
+typedef int (*LineFn)(Replica* r, const char* line);
+typedef int (*RecordFn)(Replica* r, const char* rec);
+
+/* purchase_log.csv may hold the lead byte inside GBK names, orders.log
+ * lines are ASCII */
+static size_t line_length(const char* p, size_t len, int binaryRecords) {
+    if (binaryRecords) return orderbin_lineLength(p, len);
+    const char* nl = (const char*)memchr(p, '\n', len);
+    return nl ? (size_t)(nl - p) + 1 : 0;
+}
+
+/* feeds the complete lines appended since t->offset to onLine and, with
+ * onRecord, the binary records to that; a trailing partial line or record
+ * is left for the next poll. Returns the records applied, -2 when the
+ * file is shorter than what was already consumed or a record could not
+ * be applied (r->failed, its offset not consumed), -3 (nothing read) when
+ * the path now names a different file than the one consumed so far. */
+static long tail_read(Replica* r, LogTail* t, LineFn onLine, RecordFn onRecord) {
+    FILE* fp = fopen(t->path, "rb");
+    if (!fp) {
+        t->missing = 1;
+        return 0;
+    }
+    t->missing = 0;
+    uint64_t id = file_identity(fp);
+    if (t->offset > 0 && t->fileId != 0 && id != 0 && id != t->fileId) {
+        fclose(fp);
+        return -3;
+    }
+    t->fileId = id;
+    t->size = file_size(fp);
+    if (t->size < t->offset) {
+        fclose(fp);
+        return -2;
+    }
+    long applied = 0;
+    if (t->size > t->offset && seek_to(fp, t->offset) == 0) {
+        size_t have = 0;
+        for (;;) {
+            size_t got = fread(r->buf + have, 1, r->bufCap - have, fp);
+            have += got;
+            size_t start = 0;
+            long rec = 0;
+            while (start < have) {
+                char* p = r->buf + start;
+                size_t rest = have - start;
+                size_t len;
+                rec = onRecord && (unsigned char)*p == ORDERBIN_LEAD ? orderbin_check(p, rest) : 0;
+                if (rec == ORDERBIN_SHORT) break;
+                if (rec > 0) {
+                    applied += onRecord(r, p);
+                    len = (size_t)rec;
+                }
+                else if (rec == ORDERBIN_DAMAGED) {
+                    r->ordersDamaged++;
+                    len = 1;   /* resynchronise past its lead byte */
+                }
+                else {
+                    len = line_length(p, rest, onRecord != NULL);
+                    if (len == 0) break;
+                    /* a line cut off by a binary record was torn: skipped */
+                    if (p[len - 1] == '\n') {
+                        p[len - 1] = '\0';
+                        applied += onLine(r, p);
+                    }
+                }
+                if (r->failed) break;
+                t->offset += len;
+                start += len;
+            }
+            if (r->failed) break;
+            if (start == 0 && have == r->bufCap) {
+                size_t need = rec == ORDERBIN_SHORT ? ORDERBIN_RECORD_BYTES(orderbin_itemCount(r->buf)) : 0;
+                char* nb = need > r->bufCap ? (char*)realloc(r->buf, need) : NULL;
+                if (nb) {
+                    r->buf = nb;
+                    r->bufCap = need;
+                    continue;
+                }
+                /* no record line is this long: skip it */
+                t->offset += have;
+                have = 0;
+                continue;
+            }
+            memmove(r->buf, r->buf + start, have - start);
+            have -= start;
+            if (got == 0) break;
+        }
+    }
+    fclose(fp);
+    return r->failed ? -2 : applied;
+}
+
+/* segments sealed since the last poll, each read on from the offset
+ * reached in orders.log and the next from 0. Catching up from nothing
+ * reads every live sealed segment. Returns the records applied, -2 when
+ * a segment is shorter than the offset or is not the file that was
+ * being tailed. */
+static long follow_segments(Replica* r) {
+    OrderSegment* segs;
+    size_t n;
+    if (seglog_readManifest(r->orders.path, &segs, &n) != 0) return 0;
+    int catchUp = r->ordersSeq == 0 && r->orders.offset == 0;
+    long applied = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (segs[i].seq < r->ordersSeq) continue;
+        if (catchUp && segs[i].status == SEGMENT_ARCHIVED) {
+            r->ordersSeq = segs[i].seq + 1;
+            continue;
+        }
+        LogTail t;
+        char path[SEGLOG_PATH_MAX];
+        seglog_segmentPath(r->orders.path, &segs[i], path, sizeof(path));
+        tail_init(&t, path);
+        t.offset = r->orders.offset;
+        t.fileId = r->orders.fileId;   /* a rename keeps the identity */
+        long a = tail_read(r, &t, on_order_line, on_order_record);
+        if (t.missing) break;   /* not renamed yet: orders.log still is this segment */
+        if (a == -2 || a == -3) {
+            applied = -2;
+            break;
+        }
+        applied += a;
+        r->orders.offset = 0;
+        r->orders.fileId = 0;
+        r->ordersSeq = segs[i].seq + 1;
+    }
+    free(segs);
+    return applied;
+}
+
+static void reset_locked(Replica* r) {
+    partial_free(&r->agg);
+    r->ordersSeq = 0;
+    r->orders.offset = 0;
+    r->orders.fileId = 0;
+    r->purchases.offset = 0;
+    r->purchases.fileId = 0;
+    r->havePending = 0;
+    r->itemCount = 0;
+    r->ordersApplied = 0;
+    r->ordersDamaged = 0;
+    r->purchasesApplied = 0;
+    r->failed = 0;
+    r->rebuilds++;
+}
+
+/* orders.log, then the sealed segments the manifest lists by then when
+ * the file was sealed and replaced after follow_segments() read it. The
+ * manifest line is written before the rename, so a replaced file that no
+ * new segment accounts for was rewritten: -2. */
+static long read_orders(Replica* r, long* sealed) {
+    long a = tail_read(r, &r->orders, on_order_line, on_order_record);
+    for (int tries = 0; a == -3 && tries < REPLICA_SEAL_RETRIES; ++tries) {
+        int seq = r->ordersSeq;
+        long s = follow_segments(r);
+        if (s == -2 || r->ordersSeq == seq) return -2;
+        *sealed += s;
+        a = tail_read(r, &r->orders, on_order_line, on_order_record);
+    }
+    return a == -3 ? 0 : a;   /* sealing faster than this reads: next poll */
+}
+
+static long poll_locked(Replica* r) {
+    TRACE_BEGIN("replica_poll");
+    /* a rebuild that ran out of memory itself is retried first */
+    long s = r->failed ? -2 : follow_segments(r);
+    long a = s == -2 ? -2 : read_orders(r, &s);
+    long b = a == -2 ? -2 : tail_read(r, &r->purchases, on_purchase_line, NULL);
+    if (a == -2 || b == -2 || b == -3) {
+        /* both logs feed the same aggregates, so both are replayed */
+        reset_locked(r);
+        s = follow_segments(r);
+        a = read_orders(r, &s);
+        b = tail_read(r, &r->purchases, on_purchase_line, NULL);
+    }
+    r->lastPollNs = timeutil_nowNs();
+    TRACE_END();
+    return (s > 0 ? s : 0) + (a > 0 ? a : 0) + (b > 0 ? b : 0);
+}
+
+long replica_poll(Replica* r) {
+    mutex_lock(&r->mu);
+    long n = poll_locked(r);
+    mutex_unlock(&r->mu);
+    return n;
+}
+
+/* ---------- background poller ---------- */
+
+static void poller_main(void* arg) {
+    Replica* r = (Replica*)arg;
+    trace_setThreadName("replica");
+    while (!atomic_loadU64(&r->stop)) {
+        replica_poll(r);
+        for (unsigned waited = 0; waited < r->intervalMs && !atomic_loadU64(&r->stop);
+            waited += REPLICA_SLEEP_SLICE_MS) {
+            thread_sleepMs(REPLICA_SLEEP_SLICE_MS);
+        }
+    }
+}
+
+int replica_start(Replica* r, unsigned intervalMs) {
+    if (r->running) return 0;
+    r->intervalMs = intervalMs > 0 ? intervalMs : 1;
+    atomic_storeU64(&r->stop, 0);
+    if (thread_start(&r->thread, poller_main, r) != 0) return -1;
+    r->running = 1;
+    return 0;
+}
+
+void replica_stop(Replica* r) {
+    if (!r->running) return;
+    atomic_storeU64(&r->stop, 1);
+    thread_join(r->thread);
+    r->running = 0;
+}
+
+/* ---------- serving ---------- */
+
+void replica_printReport(Replica* r, ProductList* products, int topN) {
+    mutex_lock(&r->mu);
+    poll_locked(r);
+    printf("\n(replica: %llu order records, %llu purchases applied)\n",
+        r->ordersApplied, r->purchasesApplied);
+    if (r->failed) printf("(incomplete: out of memory while rebuilding, retried on the next poll)\n");
+    partial_printReport(&r->agg, products, topN);
+    mutex_unlock(&r->mu);
+}
+
+/* bytes appended since the last poll, without consuming them */
+static uint64_t bytes_behind(const LogTail* t) {
+    FILE* fp = fopen(t->path, "rb");
+    if (!fp) return 0;
+    uint64_t size = file_size(fp);
+    fclose(fp);
+    return size > t->offset ? size - t->offset : 0;
+}
+
+static void print_tail(const char* label, const LogTail* t) {
+    if (t->missing) {
+        printf("%-10s %s (not found)\n", label, t->path);
+        return;
+    }
+    printf("%-10s %s offset=%llu behind=%llu bytes\n", label, t->path,
+        (unsigned long long)t->offset, (unsigned long long)bytes_behind(t));
+}
+
+void replica_printStatus(Replica* r) {
+    mutex_lock(&r->mu);
+    printf("\n=== Replication Status ===\n");
+    print_tail("Orders:", &r->orders);
+    print_tail("Purchases:", &r->purchases);
+    if (r->ordersSeq > 0) printf("Orders log segment: %d (earlier ones sealed and read)\n", r->ordersSeq);
+    printf("Applied: %llu order records, %llu purchases, %u rebuilds\n",
+        r->ordersApplied, r->purchasesApplied, r->rebuilds);
+    if (r->ordersDamaged > 0) printf("Damaged binary order records skipped: %llu\n", r->ordersDamaged);
+    if (r->failed) printf("Aggregates incomplete (out of memory): rebuilt on the next poll\n");
+    if (r->lastPollNs) {
+        printf("Last poll: %.1f ms ago", (double)(timeutil_nowNs() - r->lastPollNs) / 1e6);
+        if (r->running) printf(" (every %u ms)", r->intervalMs);
+        printf("\n");
+    }
+    mutex_unlock(&r->mu);
+}
+
+int replica_writePartial(Replica* r, const char* path) {
+    mutex_lock(&r->mu);
+    poll_locked(r);
+    int rc = r->failed ? -1 : partial_write(&r->agg, path);
+    mutex_unlock(&r->mu);
+    return rc;
+}
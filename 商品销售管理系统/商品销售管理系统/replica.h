@@ -0,0 +1,100 @@
+#pragma once
+#ifndef REPLICA_H
+#define REPLICA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "partial.h"
+#include "orderlog.h"
+#include "thread_util.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Log-shipping read replica.
+     *
+     * A follower process tails orders.log and purchase_log.csv (local, or
+     * shipped from another node) by byte offset and folds every complete
+     * record into its own SalesPartial, so reports never touch the primary
+     * and the primary does nothing beyond appending its logs.
+     *
+     * An order record is applied once its header and all ITEMS lines have
+     * arrived, or once a binary record (orderbin.h) is complete and passes
+     * its CRC; a half-written line or record waits for the next poll. If a
+     * log shrinks (replaced or truncated) the replica rebuilds from offset 0,
+ * and so does a record that cannot be applied for lack of memory: its
+ * offset is not consumed, and the next poll replays both logs.
+     *
+     * A segmented orders.log (seglog.h) is followed through its manifest:
+     * when the file being tailed has been sealed, the rest of the sealed
+     * segment is read from the same offset before the new orders.log. A
+     * rebuild reads every live sealed segment first. Each tail remembers
+     * the identity of its file, so an orders.log sealed between reading
+     * the manifest and opening the file is never read at the old file's
+     * offset.
+     *
+     * replica_start() polls on a background thread every intervalMs, which
+     * bounds the replication lag; reports poll once more before printing,
+     * so they include everything appended before the request.
+     */
+
+    typedef struct {
+        char     path[260];
+        uint64_t offset;        /* bytes consumed (complete lines) */
+        uint64_t size;          /* file size at the last poll */
+        uint64_t fileId;        /* identity of the file consumed so far, 0 = unknown */
+        int      missing;
+    } LogTail;
+
+    typedef struct {
+        LogTail      orders;
+        LogTail      purchases;
+        int          ordersSeq;  /* seq orders.log will be sealed as, 0 = not known yet */
+        SalesPartial agg;
+
+        /* order record being assembled */
+        OrderLogRecord pending;
+        int          havePending;
+        size_t       itemsDeclared;
+        OrderItem*   items;
+        size_t       itemCount;
+        size_t       itemCap;
+
+        char*        buf;
+        size_t       bufCap;    /* grown for a binary record larger than a block */
+        unsigned long long ordersApplied;
+        unsigned long long ordersDamaged;   /* binary records that failed their CRC */
+        unsigned long long purchasesApplied;
+        unsigned     rebuilds;
+        int          failed;    /* a record was not applied (out of memory): rebuild */
+        uint64_t     lastPollNs;
+
+        Mutex        mu;        /* everything above */
+        ThreadHandle thread;
+        int          running;
+        volatile uint64_t stop;
+        unsigned     intervalMs;
+    } Replica;
+
+    /* 0 ok, -1 when out of memory */
+    int  replica_init(Replica* r, const char* ordersPath, const char* purchasesPath);
+    void replica_free(Replica* r);   /* stops the poller first */
+
+    /* reads what was appended since the last poll; returns the records applied */
+    long replica_poll(Replica* r);
+
+    int  replica_start(Replica* r, unsigned intervalMs);   /* 0 ok */
+    void replica_stop(Replica* r);
+
+    /* poll, then the consolidated reports from the replica's aggregates */
+    void replica_printReport(Replica* r, ProductList* products, int topN);
+    void replica_printStatus(Replica* r);
+    /* poll, then write the aggregates in the partial file format */
+    int  replica_writePartial(Replica* r, const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
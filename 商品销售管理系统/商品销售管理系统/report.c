@@ -1,4 +1,10 @@
 #include "report.h"
+#include "compat.h"
+#include "metrics.h"
+#include "trace.h"
+#include "money.h"
+#include "seglog.h"
+#include "orderbin.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,19 +35,14 @@ static int is_paid_line(const char* line) {
 }
 
 /* ֧ "Total: 12.34" / "total=12.34" / ": 12.34" */
-static int extract_total_amount(const char* line, double* out) {
+static int extract_total_amount(const char* line, Money* out) {
     const char* keys[] = { "Total:", "total=", "TOTAL:", "ܼ:", ":" };
     for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); ++k) {
         const char* pos = strstr(line, keys[k]);
         if (pos) {
             pos += strlen(keys[k]);
             while (*pos && isspace((unsigned char)*pos)) pos++;
-            char* endp = NULL;
-            double v = strtod(pos, &endp);
-            if (endp != pos) {
-                *out = v;
-                return 1;
-            }
+            if (money_parse(pos, out)) return 1;
         }
     }
     return 0;
@@ -224,6 +225,183 @@ static const char* find_product_name(const ProductName* arr, size_t n, int id) {
     return NULL;
 }
 
+/* ---------- block scanner ----------
+ * Reports read the log in blocks of complete lines so that reading
+ * ("scan"), per-line parsing ("parse") and folding the parsed records
+ * into the result ("aggregate") show up as separate trace spans.
+ */
+
+#define SCAN_BLOCK_BYTES (64 * 1024)
+/* text of a block of binary records; an item line is under 4x its record */
+#define SCAN_TEXT_BYTES  (4 * SCAN_BLOCK_BYTES)
+
+typedef struct {
+    FILE*  fp;
+    char*  buf;     /* bufCap + 1 for the terminator */
+    size_t bufCap;  /* SCAN_BLOCK_BYTES, grown for a binary record larger than that */
+    size_t len;     /* bytes held in buf */
+    size_t next;    /* start of the partial line carried to the next block */
+    int    eof;
+    SegmentFiles files;   /* segments of the log, read one after another */
+    size_t nextFile;
+    char*  text;    /* textCap: blocks holding binary records, as text */
+    size_t textCap; /* SCAN_TEXT_BYTES, or 4x the grown block */
+    OrderBinText bin;
+} LogScanner;
+
+/* opens the next segment that exists, 0 when none is left */
+static int scanner_nextFile(LogScanner* s) {
+    while (s->nextFile < s->files.count) {
+        FILE* fp = fopen(s->files.paths[s->nextFile++], "rb");
+        if (!fp) continue;
+        if (s->fp) fclose(s->fp);
+        s->fp = fp;
+        return 1;
+    }
+    return 0;
+}
+
+static int scanner_open(LogScanner* s, const char* path) {
+    memset(s, 0, sizeof(*s));
+    if (seglog_select(path, 0, 0, &s->files) != 0 || !scanner_nextFile(s)) {
+        seglog_freeFiles(&s->files);
+        return -1;
+    }
+    s->buf = (char*)malloc(SCAN_BLOCK_BYTES + 1);
+    s->text = (char*)malloc(SCAN_TEXT_BYTES + 1);
+    if (!s->buf || !s->text) {
+        free(s->buf);
+        free(s->text);
+        fclose(s->fp);
+        seglog_freeFiles(&s->files);
+        return -1;
+    }
+    s->bufCap = SCAN_BLOCK_BYTES;
+    s->textCap = SCAN_TEXT_BYTES;
+    return 0;
+}
+
+static void scanner_close(LogScanner* s) {
+    fclose(s->fp);
+    free(s->buf);
+    free(s->text);
+    orderbin_freeText(&s->bin);
+    seglog_freeFiles(&s->files);
+}
+
+/* grows the block to hold the binary record at its start, and the text
+ * to hold that record rewritten; 0 when it is not a record or there is
+ * no memory for it */
+static int scanner_grow(LogScanner* s) {
+    long rec = orderbin_check(s->buf, s->len);
+    size_t need = rec == ORDERBIN_SHORT ? ORDERBIN_RECORD_BYTES(orderbin_itemCount(s->buf))
+        : rec > 0 ? (size_t)rec : 0;
+    if (need == 0 || (need <= s->bufCap && 4 * need <= s->textCap)) return 0;
+    if (need > s->bufCap) {
+        char* nb = (char*)realloc(s->buf, need + 1);
+        if (!nb) return 0;
+        s->buf = nb;
+        s->bufCap = need;
+    }
+    if (4 * need > s->textCap) {
+        char* nt = (char*)realloc(s->text, 4 * need + 1);
+        if (!nt) return 0;
+        s->text = nt;
+        s->textCap = 4 * need;
+    }
+    return 1;
+}
+
+/* next block of complete lines in [*begin, *end); 0 at end of file.
+ * A block holding binary records is handed out rewritten as text. */
+static int scanner_next(LogScanner* s, char** begin, char** end) {
+    TRACE_BEGIN("scan");
+    size_t n;
+    for (;;) {
+        size_t keep = s->len - s->next;
+        memmove(s->buf, s->buf + s->next, keep);
+        s->len = keep;
+        if (!s->eof) {
+            size_t want = s->bufCap - s->len;
+            size_t got = fread(s->buf + s->len, 1, want, s->fp);
+            s->len += got;
+            /* segments end on a complete record, so the next one just follows */
+            while (got < want && scanner_nextFile(s)) {
+                want -= got;
+                got = fread(s->buf + s->len, 1, want, s->fp);
+                s->len += got;
+            }
+            if (got < want) s->eof = 1;
+        }
+        if (!memchr(s->buf, ORDERBIN_LEAD, s->len)) {
+            size_t cut = s->len;
+            if (!s->eof) {
+                while (cut > 0 && s->buf[cut - 1] != '\n') cut--;
+                if (cut == 0) cut = s->len;   /* line longer than a block: split it */
+            }
+            s->next = cut;
+            *begin = s->buf;
+            *end = s->buf + cut;
+            n = cut;
+            break;
+        }
+        size_t used = orderbin_toText(&s->bin, s->buf, s->len, s->eof, s->text, s->textCap, &n);
+        if (used == 0 && !s->eof) {
+            /* a record larger than a block: read it whole */
+            if (scanner_grow(s)) {
+                s->next = 0;
+                continue;
+            }
+            used = s->len;   /* a line longer than a block, or no memory: dropped */
+        }
+        s->next = used;
+        *begin = s->text;
+        *end = s->text + n;
+        /* a block of damaged bytes only: read on */
+        if (n > 0 || (s->eof && used == s->len)) break;
+    }
+    TRACE_END();
+    return n > 0;
+}
+
+/* splits off one line (without '\n') from a block, NULL when exhausted */
+static char* block_next_line(char** cur, char* end) {
+    if (*cur >= end) return NULL;
+    char* line = *cur;
+    char* nl = (char*)memchr(line, '\n', (size_t)(end - line));
+    if (nl) {
+        *nl = '\0';
+        *cur = nl + 1;
+    }
+    else {
+        *end = '\0';
+        *cur = end;
+    }
+    return line;
+}
+
+/* one parsed record waiting for the aggregate phase */
+typedef struct {
+    int key;            /* productId, or year * 100 + month */
+    long long qty;
+    Money amount;
+} ParsedRec;
+
+static void parsed_push(ParsedRec** arr, size_t* n, size_t* cap,
+    int key, long long qty, Money amount) {
+    if (*n >= *cap) {
+        size_t newCap = (*cap == 0) ? 256 : (*cap * 2);
+        ParsedRec* nd = (ParsedRec*)realloc(*arr, newCap * sizeof(ParsedRec));
+        if (!nd) return;
+        *arr = nd;
+        *cap = newCap;
+    }
+    (*arr)[*n].key = key;
+    (*arr)[*n].qty = qty;
+    (*arr)[*n].amount = amount;
+    (*n)++;
+}
+
 /* ---------- public APIs ---------- */
 
 void report_showMenu(void) {
@@ -231,36 +409,45 @@ void report_showMenu(void) {
     printf("13. Sales summary (from orders.log)\n");
     printf("14. Monthly sales (from orders.log)\n");
     printf("15. Top products (from orders.log + products.csv)\n");
+    printf("32. Frequently bought together (from orders.log)\n");
+    printf("35. Sales for a date range (reads only the log segments it needs)\n");
 }
 
-void report_salesSummaryFromLog(const char* orderLogPath) {
-    FILE* fp = fopen(orderLogPath, "r");
-    if (!fp) {
+static void sales_summary_impl(const char* orderLogPath) {
+    LogScanner sc;
+    if (scanner_open(&sc, orderLogPath) != 0) {
         printf("Cannot open %s\n", orderLogPath);
         return;
     }
 
     long long lines = 0;
     long long paidLines = 0;
-    double totalPaid = 0.0;
-
-    char buf[1024];
-    while (fgets(buf, sizeof(buf), fp)) {
-        lines++;
-        if (is_paid_line(buf)) {
-            paidLines++;
-            double amt = 0.0;
-            if (extract_total_amount(buf, &amt)) totalPaid += amt;
+    Money totalPaid = 0;
+
+    char* cur;
+    char* end;
+    while (scanner_next(&sc, &cur, &end)) {
+        TRACE_BEGIN("parse");
+        char* line;
+        while ((line = block_next_line(&cur, end)) != NULL) {
+            lines++;
+            if (is_paid_line(line)) {
+                paidLines++;
+                Money amt = 0;
+                if (extract_total_amount(line, &amt)) totalPaid += amt;
+            }
         }
+        TRACE_END();
     }
-    fclose(fp);
+    scanner_close(&sc);
 
     printf("\n=== Sales Summary (from %s) ===\n", orderLogPath);
     printf("Log lines: %lld\n", lines);
     printf("Paid records: %lld\n", paidLines);
-    printf("Total revenue (paid): %.2f\n", totalPaid);
+    char amount[MONEY_STR_MAX];
+    printf("Total revenue (paid): %s\n", money_str(totalPaid, amount));
     if (paidLines > 0) {
-        printf("Average per paid record: %.2f\n", totalPaid / (double)paidLines);
+        printf("Average per paid record: %s\n", money_str(money_div(totalPaid, paidLines), amount));
     }
 }
 
@@ -268,11 +455,11 @@ typedef struct {
     int year;
     int month;
     long long paidCount;
-    double paidSum;
+    Money paidSum;
 } MonthAgg;
 
 static void monthagg_add(MonthAgg** arr, size_t* n, size_t* cap,
-    int y, int m, double amt) {
+    int y, int m, Money amt) {
     for (size_t i = 0; i < *n; ++i) {
         if ((*arr)[i].year == y && (*arr)[i].month == m) {
             (*arr)[i].paidCount++;
@@ -302,70 +489,105 @@ static int cmp_month_asc(const void* a, const void* b) {
     return (ka > kb) - (ka < kb);
 }
 
-void report_monthlySalesFromLog(const char* orderLogPath) {
-    FILE* fp = fopen(orderLogPath, "r");
-    if (!fp) {
+static void monthly_sales_impl(const char* orderLogPath) {
+    LogScanner sc;
+    if (scanner_open(&sc, orderLogPath) != 0) {
         printf("Cannot open %s\n", orderLogPath);
         return;
     }
 
     MonthAgg* months = NULL;
     size_t n = 0, cap = 0;
+    ParsedRec* recs = NULL;
+    size_t recN = 0, recCap = 0;
+
+    char* cur;
+    char* end;
+    while (scanner_next(&sc, &cur, &end)) {
+        TRACE_BEGIN("parse");
+        recN = 0;
+        char* line;
+        while ((line = block_next_line(&cur, end)) != NULL) {
+            if (!is_paid_line(line)) continue;
+
+            Money amt = 0;
+            if (!extract_total_amount(line, &amt)) continue;
+
+            struct tm t;
+            if (!extract_time(line, &t)) {
+                time_t now = time(NULL);
+                struct tm* lt = localtime(&now);
+                if (!lt) continue;
+                t = *lt;
+            }
+            parsed_push(&recs, &recN, &recCap, (t.tm_year + 1900) * 100 + t.tm_mon + 1, 1, amt);
+        }
+        TRACE_END();
 
-    char line[1024];
-    while (fgets(line, sizeof(line), fp)) {
-        if (!is_paid_line(line)) continue;
-
-        double amt = 0.0;
-        if (!extract_total_amount(line, &amt)) continue;
-
-        struct tm t;
-        if (!extract_time(line, &t)) {
-            time_t now = time(NULL);
-            struct tm* lt = localtime(&now);
-            if (!lt) continue;
-            t = *lt;
+        TRACE_BEGIN("aggregate");
+        for (size_t i = 0; i < recN; ++i) {
+            monthagg_add(&months, &n, &cap, recs[i].key / 100, recs[i].key % 100, recs[i].amount);
         }
-        monthagg_add(&months, &n, &cap, t.tm_year + 1900, t.tm_mon + 1, amt);
+        TRACE_END();
     }
-    fclose(fp);
+    scanner_close(&sc);
+    free(recs);
 
+    TRACE_BEGIN("sort");
     qsort(months, n, sizeof(MonthAgg), cmp_month_asc);
+    TRACE_END();
 
     printf("\n=== Monthly Sales (paid only) ===\n");
     printf("%-7s %-10s %-10s\n", "Month", "PaidCount", "Revenue");
+    char revenue[MONEY_STR_MAX];
     for (size_t i = 0; i < n; ++i) {
-        printf("%04d-%02d %-10lld %-10.2f\n",
-            months[i].year, months[i].month, months[i].paidCount, months[i].paidSum);
+        printf("%04d-%02d %-10lld %-10s\n",
+            months[i].year, months[i].month, months[i].paidCount, money_str(months[i].paidSum, revenue));
     }
     free(months);
 }
 
-void report_topProductsFromLog(const char* orderLogPath,
+static void top_products_impl(const char* orderLogPath,
     const char* productsCsvPath,
     int topN) {
-    FILE* fp = fopen(orderLogPath, "r");
-    if (!fp) {
+    LogScanner sc;
+    if (scanner_open(&sc, orderLogPath) != 0) {
         printf("Cannot open %s\n", orderLogPath);
         return;
     }
 
     ProdAgg* aggs = NULL;
     size_t n = 0, cap = 0;
+    ParsedRec* recs = NULL;
+    size_t recN = 0, recCap = 0;
 
-    char line[1024];
     int parsedAny = 0;
 
-    while (fgets(line, sizeof(line), fp)) {
-        if (!is_paid_line(line)) continue;
+    char* cur;
+    char* end;
+    while (scanner_next(&sc, &cur, &end)) {
+        TRACE_BEGIN("parse");
+        recN = 0;
+        char* line;
+        while ((line = block_next_line(&cur, end)) != NULL) {
+            if (!is_paid_line(line)) continue;
+
+            int pid = 0, qty = 0;
+            if (extract_product_qty(line, &pid, &qty)) {
+                parsedAny = 1;
+                parsed_push(&recs, &recN, &recCap, pid, qty, 0);
+            }
+        }
+        TRACE_END();
 
-        int pid = 0, qty = 0;
-        if (extract_product_qty(line, &pid, &qty)) {
-            parsedAny = 1;
-            agg_add(&aggs, &n, &cap, pid, qty);
+        TRACE_BEGIN("aggregate");
+        for (size_t i = 0; i < recN; ++i) {
+            agg_add(&aggs, &n, &cap, recs[i].key, (int)recs[i].qty);
         }
+        TRACE_END();
     }
-    fclose(fp);
+    scanner_close(&sc);
+    free(recs);
 
     if (!parsedAny) {
         printf("\nTop products: cannot parse productId/qty from %s.\n", orderLogPath);
@@ -374,27 +596,83 @@ void report_topProductsFromLog(const char* orderLogPath,
         return;
     }
 
+    TRACE_BEGIN("sort");
     qsort(aggs, n, sizeof(ProdAgg), cmp_qty_desc);
+    TRACE_END();
 
+    if (topN <= 0) topN = 10;
+    if ((size_t)topN > n) topN = (int)n;
+
+    TRACE_BEGIN("name_lookup");
     ProductName* names = NULL;
     size_t namesN = 0;
-    if (load_product_names(productsCsvPath, &names, &namesN) != 0) {
-        printf("Warning: cannot open %s, will show productId only.\n", productsCsvPath);
+    int namesOk = load_product_names(productsCsvPath, &names, &namesN) == 0;
+    const char** topNames = (const char**)calloc((size_t)topN + 1, sizeof(const char*));
+    if (topNames && names) {
+        for (int i = 0; i < topN; ++i) {
+            topNames[i] = find_product_name(names, namesN, aggs[i].productId);
+        }
     }
+    TRACE_END();
 
-    if (topN <= 0) topN = 10;
-    if ((size_t)topN > n) topN = (int)n;
+    if (!namesOk) {
+        printf("Warning: cannot open %s, will show productId only.\n", productsCsvPath);
+    }
 
     printf("\n=== Top Products (paid only) ===\n");
     printf("%-6s %-20s %-10s\n", "ID", "Name", "Qty");
     for (int i = 0; i < topN; ++i) {
-        const char* nm = names ? find_product_name(names, namesN, aggs[i].productId) : NULL;
+        const char* nm = topNames ? topNames[i] : NULL;
         printf("%-6d %-20s %-10lld\n",
             aggs[i].productId,
             (nm ? nm : "(unknown)"),
             aggs[i].qty);
     }
 
+    free(topNames);
     free(names);
     free(aggs);
-}
\ No newline at end of file
+}
+
+/* ---------- instrumented entry points ---------- */
+
+void report_salesSummaryFromLog(const char* orderLogPath) {
+    TRACE_BEGIN("report_salesSummaryFromLog");
+    if (!METRICS_ON()) {
+        sales_summary_impl(orderLogPath);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        sales_summary_impl(orderLogPath);
+        metrics_record(MET_REPORT_SALES_SUMMARY, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+}
+
+void report_monthlySalesFromLog(const char* orderLogPath) {
+    TRACE_BEGIN("report_monthlySalesFromLog");
+    if (!METRICS_ON()) {
+        monthly_sales_impl(orderLogPath);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        monthly_sales_impl(orderLogPath);
+        metrics_record(MET_REPORT_MONTHLY_SALES, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+}
+
+void report_topProductsFromLog(const char* orderLogPath,
+    const char* productsCsvPath,
+    int topN) {
+    TRACE_BEGIN("report_topProductsFromLog");
+    if (!METRICS_ON()) {
+        top_products_impl(orderLogPath, productsCsvPath, topN);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        top_products_impl(orderLogPath, productsCsvPath, topN);
+        metrics_record(MET_REPORT_TOP_PRODUCTS, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+}
@@ -0,0 +1,447 @@
+#include "seglog.h"
+#include "orderlog.h"
+#include "persistence.h"
+#include "persist_queue.h"
+#include "compat.h"
+#include "metrics.h"
+#include "timeutil.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#define SEGLOG_LINE_MAX 512
+
+static const char* const g_statusNames[] = { "ACTIVE", "SEALED", "ARCHIVED" };
+
+static size_t dir_len(const char* path) {
+    size_t n = strlen(path);
+    while (n > 0 && path[n - 1] != '/' && path[n - 1] != '\\') n--;
+    return n;
+}
+
+static void manifest_path(const char* path, char* out, size_t cap) {
+    snprintf(out, cap, "%s.manifest", path);
+}
+
+void seglog_segmentPath(const char* path, const OrderSegment* seg, char* out, size_t cap) {
+    snprintf(out, cap, "%.*s%s", (int)dir_len(path), path, seg->file);
+}
+
+static int file_exists(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return 0;
+    fclose(fp);
+    return 1;
+}
+
+static uint64_t path_size(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return 0;
+#if defined(_MSC_VER)
+    long long n = _fseeki64(fp, 0, SEEK_END) == 0 ? _ftelli64(fp) : 0;
+#else
+    off_t n = fseeko(fp, 0, SEEK_END) == 0 ? ftello(fp) : 0;
+#endif
+    fclose(fp);
+    return n > 0 ? (uint64_t)n : 0;
+}
+
+static int make_dir(const char* path) {
+#if defined(_WIN32)
+    return _mkdir(path) == 0 || file_exists(path) ? 0 : -1;
+#else
+    return mkdir(path, 0755) == 0 || errno == EEXIST ? 0 : -1;
+#endif
+}
+
+/* ---------- manifest lines ---------- */
+
+static int format_line(const OrderSegment* seg, char* buf, size_t cap) {
+    return snprintf(buf, cap, "%d,%s,%s,%d,%d,%lld,%lld,%lld,%lld,%lld,%lld,%llu\n",
+        seg->seq, g_statusNames[seg->status], seg->file, seg->firstOrderId, seg->lastOrderId,
+        seg->firstTime, seg->lastTime, seg->records, seg->created, seg->paid, seg->cancelled,
+        (unsigned long long)seg->bytes);
+}
+
+static int parse_line(const char* line, OrderSegment* seg) {
+    char status[16];
+    unsigned long long bytes;
+    memset(seg, 0, sizeof(*seg));
+    if (sscanf_s(line, "%d,%15[^,],%63[^,],%d,%d,%lld,%lld,%lld,%lld,%lld,%lld,%llu",
+            &seg->seq, status SCANF_BUFSZ(status), seg->file SCANF_BUFSZ(seg->file),
+            &seg->firstOrderId, &seg->lastOrderId, &seg->firstTime, &seg->lastTime,
+            &seg->records, &seg->created, &seg->paid, &seg->cancelled, &bytes) != 12) {
+        return 0;
+    }
+    if (seg->seq <= 0) return 0;
+    if (strcmp(status, "SEALED") == 0) seg->status = SEGMENT_SEALED;
+    else if (strcmp(status, "ARCHIVED") == 0) seg->status = SEGMENT_ARCHIVED;
+    else return 0;
+    seg->bytes = bytes;
+    return 1;
+}
+
+/* inserts or replaces by seq, keeping the table in seq order */
+static int table_put(OrderSegment** data, size_t* size, size_t* capacity, const OrderSegment* seg) {
+    size_t i = *size;
+    while (i > 0 && (*data)[i - 1].seq > seg->seq) i--;
+    if (i > 0 && (*data)[i - 1].seq == seg->seq) {
+        (*data)[i - 1] = *seg;
+        return 0;
+    }
+    if (*size >= *capacity) {
+        size_t newCap = *capacity == 0 ? 16 : *capacity * 2;
+        OrderSegment* nd = (OrderSegment*)realloc(*data, newCap * sizeof(OrderSegment));
+        if (!nd) return -1;
+        *data = nd;
+        *capacity = newCap;
+    }
+    memmove(&(*data)[i + 1], &(*data)[i], (*size - i) * sizeof(OrderSegment));
+    (*data)[i] = *seg;
+    (*size)++;
+    return 0;
+}
+
+/* replays the manifest; *lines receives the record lines read */
+static int read_manifest(const char* path, OrderSegment** data, size_t* size, size_t* capacity, size_t* lines) {
+    char mpath[SEGLOG_PATH_MAX + 16];
+    manifest_path(path, mpath, sizeof(mpath));
+    FILE* fp = fopen(mpath, "r");
+    if (!fp) return 0;
+    char line[SEGLOG_LINE_MAX];
+    int rc = 0;
+    while (rc == 0 && fgets(line, sizeof(line), fp)) {
+        OrderSegment seg;
+        if (line[0] == '#' || !parse_line(line, &seg)) continue;
+        if (lines) (*lines)++;
+        if (table_put(data, size, capacity, &seg) != 0) rc = -2;
+    }
+    fclose(fp);
+    return rc;
+}
+
+int seglog_readManifest(const char* path, OrderSegment** out, size_t* count) {
+    size_t capacity = 0;
+    *out = NULL;
+    *count = 0;
+    int rc = read_manifest(path, out, count, &capacity, NULL);
+    if (rc != 0) {
+        free(*out);
+        *out = NULL;
+        *count = 0;
+    }
+    return rc;
+}
+
+/* ---------- segment statistics ---------- */
+
+static void note_time(OrderSegment* seg, long long t) {
+    if (t <= 0) return;
+    if (seg->firstTime == 0 || t < seg->firstTime) seg->firstTime = t;
+    if (t > seg->lastTime) seg->lastTime = t;
+}
+
+static void note_record(OrderSegment* seg, int orderId, OrderStatus status,
+    long long createdAt, long long paidAt, uint64_t bytes) {
+    if (seg->records == 0 || orderId < seg->firstOrderId) seg->firstOrderId = orderId;
+    if (seg->records == 0 || orderId > seg->lastOrderId) seg->lastOrderId = orderId;
+    note_time(seg, createdAt);
+    note_time(seg, paidAt);
+    seg->records++;
+    if (status == ORDER_PAID) seg->paid++;
+    else if (status == ORDER_CANCELLED) seg->cancelled++;
+    else seg->created++;
+    seg->bytes += bytes;
+}
+
+static void scan_active(SegmentLog* s) {
+    memset(&s->active, 0, sizeof(s->active));
+    OrderLogReader r;
+    if (orderlog_openRange(&r, s->path, 0, UINT64_MAX) != 0) return;
+    OrderLogRecord rec;
+    while (orderlog_next(&r, &rec)) {
+        note_record(&s->active, rec.orderId, rec.status, (long long)rec.createdAt, (long long)rec.paidAt, 0);
+    }
+    orderlog_close(&r);
+    s->active.bytes = path_size(s->path);
+}
+
+/* ---------- writer ---------- */
+
+void seglog_init(SegmentLog* s, const char* path) {
+    memset(s, 0, sizeof(*s));
+    strncpy_s(s->path, sizeof(s->path), path, _TRUNCATE);
+    s->dirLen = dir_len(s->path);
+    s->nextSeq = 1;
+    s->maxBytes = SEGLOG_DEFAULT_MAX_BYTES;
+    s->maxAge = SEGLOG_DEFAULT_MAX_AGE;
+    s->target = -1;
+    char mpath[SEGLOG_PATH_MAX + 16];
+    manifest_path(path, mpath, sizeof(mpath));
+    journal_init(&s->manifest, mpath, -1, 0);
+}
+
+void seglog_free(SegmentLog* s) {
+    free(s->data);
+    s->data = NULL;
+    s->size = 0;
+    s->capacity = 0;
+}
+
+/* one line per segment */
+static void compact_manifest(SegmentLog* s) {
+    size_t cap = s->size * SEGLOG_LINE_MAX + 1;
+    char* text = (char*)malloc(cap);
+    size_t len = 0;
+    for (size_t i = 0; text && i < s->size; ++i) {
+        int n = format_line(&s->data[i], text + len, cap - len);
+        if (n > 0) len += (size_t)n;
+    }
+    if (text) journal_compact(&s->manifest, text, len, s->size);
+}
+
+/* a sealed entry whose file is missing: 1 if it could be repaired */
+static int repair_sealed(SegmentLog* s, const OrderSegment* seg, int last) {
+    char sealed[SEGLOG_PATH_MAX];
+    seglog_segmentPath(s->path, seg, sealed, sizeof(sealed));
+    if (file_exists(sealed)) return 1;
+    /* listed but never renamed: finish the seal, provided orders.log is
+     * still exactly the segment that was described */
+    return last && file_exists(s->path) && path_size(s->path) == seg->bytes &&
+        rename(s->path, sealed) == 0;
+}
+
+int seglog_load(SegmentLog* s) {
+    size_t lines = 0;
+    s->size = 0;
+    if (read_manifest(s->path, &s->data, &s->size, &s->capacity, &lines) != 0) return -1;
+    s->manifest.records = lines;
+    /* from the highest seq ever listed, so a dropped one is never reused */
+    s->nextSeq = s->size > 0 ? s->data[s->size - 1].seq + 1 : 1;
+
+    /* any other sealed entry without its file would be listed forever:
+     * a crash between the manifest line and the rename left orders.log
+     * changed since, or the file was removed. Its records, if any, are
+     * still in orders.log. */
+    size_t kept = 0;
+    for (size_t i = 0; i < s->size; ++i) {
+        if (s->data[i].status == SEGMENT_SEALED && !repair_sealed(s, &s->data[i], i + 1 == s->size)) continue;
+        s->data[kept++] = s->data[i];
+    }
+    if (kept < s->size) {
+        s->size = kept;
+        compact_manifest(s);
+    }
+    scan_active(s);
+    return (int)s->size;
+}
+
+void seglog_attach(SegmentLog* s, int target, int manifestTarget) {
+    s->target = target;
+    s->manifest.target = manifestTarget;
+}
+
+void seglog_countWriteErrors(SegmentLog* s) {
+    if (s->target < 0 || !METRICS_ON()) return;
+    unsigned long long n = pq_takeErrors(s->target);
+    if (n) metrics_count(CTR_ORDER_LOG_ERRORS, n);
+}
+
+/* appendOrderToFileAs() records MET_APPEND_ORDER for direct writes; a
+ * queued append is timed up to the enqueue, and the writer thread's
+ * failures are counted as they are collected */
+static int enqueue_record(SegmentLog* s, const char* buf, size_t len) {
+    if (!METRICS_ON()) return pq_append(s->target, buf, len);
+    uint64_t t0 = timeutil_nowNs();
+    int rc = pq_append(s->target, buf, len);
+    metrics_record(MET_APPEND_ORDER, timeutil_nowNs() - t0);
+    if (rc != 0) metrics_count(CTR_ORDER_LOG_ERRORS, 1);
+    seglog_countWriteErrors(s);
+    return rc;
+}
+
+static int seal_impl(SegmentLog* s) {
+    if (s->active.records == 0) return 1;
+    OrderSegment seg = s->active;
+    seg.seq = s->nextSeq;
+    seg.status = SEGMENT_SEALED;
+    snprintf(seg.file, sizeof(seg.file), "%s.%06d", s->path + s->dirLen, seg.seq);
+    char sealed[SEGLOG_PATH_MAX];
+    seglog_segmentPath(s->path, &seg, sealed, sizeof(sealed));
+    if (table_put(&s->data, &s->size, &s->capacity, &seg) != 0) return -1;
+
+    /* manifest line first: a segment listed without its file is still active */
+    char line[SEGLOG_LINE_MAX];
+    int len = format_line(&seg, line, sizeof(line));
+    if (len < 0 || (size_t)len >= sizeof(line) || journal_append(&s->manifest, line, (size_t)len) != 0) {
+        s->size--;
+        return -1;
+    }
+    int rc = (s->target >= 0 && pq_isRunning()) ? pq_rename(s->target, sealed)
+        : (rename(s->path, sealed) == 0 ? 0 : -1);
+    if (rc != 0) return -1;
+    s->nextSeq++;
+    memset(&s->active, 0, sizeof(s->active));
+    return 0;
+}
+
+int seglog_seal(SegmentLog* s) {
+    TRACE_BEGIN("seglog_seal");
+    int rc;
+    if (!METRICS_ON()) {
+        rc = seal_impl(s);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        rc = seal_impl(s);
+        metrics_record(MET_SEAL_ORDER_SEGMENT, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+    return rc;
+}
+
+int seglog_append(SegmentLog* s, const Order* o) {
+    char stackBuf[1024];
+    char* buf = stackBuf;
+    OrderLogFormat fmt = (OrderLogFormat)s->format;
+    size_t len = formatOrderRecordAs(o, fmt, stackBuf, sizeof(stackBuf));
+    if (len >= sizeof(stackBuf)) {
+        buf = (char*)malloc(len + 1);
+        if (!buf) return -1;
+        formatOrderRecordAs(o, fmt, buf, len + 1);
+    }
+
+    long long latest = (long long)(o->paidAt > o->createdAt ? o->paidAt : o->createdAt);
+    if (s->active.records > 0 &&
+        ((s->maxBytes > 0 && s->active.bytes + len > s->maxBytes) ||
+         (s->maxAge > 0 && latest - s->active.firstTime >= s->maxAge))) {
+        /* on failure the record still goes to the active file */
+        seglog_seal(s);
+    }
+
+    int rc = (s->target >= 0 && pq_isRunning()) ? enqueue_record(s, buf, len)
+        : appendOrderToFileAs(s->path, o, fmt);
+    if (buf != stackBuf) free(buf);
+    if (rc != 0) return -1;
+    note_record(&s->active, o->orderId, o->status, (long long)o->createdAt, (long long)o->paidAt, len);
+    return 0;
+}
+
+int seglog_archive(SegmentLog* s, long long before) {
+    char dir[SEGLOG_PATH_MAX];
+    snprintf(dir, sizeof(dir), "%.*s%s", (int)s->dirLen, s->path, SEGLOG_ARCHIVE_DIR);
+    if (make_dir(dir) != 0) return -1;
+    int moved = 0;
+    for (size_t i = 0; i < s->size; ++i) {
+        OrderSegment seg = s->data[i];
+        if (seg.status != SEGMENT_SEALED || seg.lastTime >= before) continue;
+        char from[SEGLOG_PATH_MAX], to[SEGLOG_PATH_MAX];
+        char name[sizeof(seg.file) + sizeof(SEGLOG_ARCHIVE_DIR)];
+        seglog_segmentPath(s->path, &seg, from, sizeof(from));
+        snprintf(name, sizeof(name), "%s/%s", SEGLOG_ARCHIVE_DIR, seg.file);
+        if (strlen(name) >= sizeof(seg.file)) continue;
+        strncpy_s(seg.file, sizeof(seg.file), name, _TRUNCATE);
+        seg.status = SEGMENT_ARCHIVED;
+        seglog_segmentPath(s->path, &seg, to, sizeof(to));
+        if (rename(from, to) != 0) continue;   /* not sealed on disk yet */
+        char line[SEGLOG_LINE_MAX];
+        int len = format_line(&seg, line, sizeof(line));
+        if (len > 0 && (size_t)len < sizeof(line)) journal_append(&s->manifest, line, (size_t)len);
+        s->data[i] = seg;
+        moved++;
+    }
+
+    /* once superseded lines dominate */
+    if (moved > 0 && journal_shouldCompact(&s->manifest, s->size)) compact_manifest(s);
+    return moved;
+}
+
+/* ---------- listing ---------- */
+
+static void format_day(long long t, char* buf, size_t cap) {
+    time_t tt = (time_t)t;
+    struct tm* lt = t > 0 ? localtime(&tt) : NULL;
+    if (!lt || strftime(buf, cap, "%Y-%m-%d", lt) == 0) snprintf(buf, cap, "-");
+}
+
+static void print_row(const OrderSegment* seg, const char* file) {
+    char from[16], to[16];
+    format_day(seg->firstTime, from, sizeof(from));
+    format_day(seg->lastTime, to, sizeof(to));
+    printf("%-6d %-9s %-26s %-8d %-8d %-11s %-11s %-8lld %-7lld %-7lld %-7lld %-10llu\n",
+        seg->seq, g_statusNames[seg->status], file, seg->firstOrderId, seg->lastOrderId,
+        from, to, seg->records, seg->created, seg->paid, seg->cancelled,
+        (unsigned long long)seg->bytes);
+}
+
+void seglog_print(const SegmentLog* s) {
+    printf("\n=== Order Log Segments ===\n");
+    printf("Seal at %llu bytes or %lld days; manifest %s\n",
+        (unsigned long long)s->maxBytes, s->maxAge / 86400, s->manifest.path);
+    printf("%-6s %-9s %-26s %-8s %-8s %-11s %-11s %-8s %-7s %-7s %-7s %-10s\n", "Seq", "Status", "File",
+        "FirstId", "LastId", "From", "To", "Records", "Created", "Paid", "Cancel", "Bytes");
+    size_t live = 0, archived = 0;
+    for (size_t i = 0; i < s->size; ++i) {
+        print_row(&s->data[i], s->data[i].file);
+        if (s->data[i].status == SEGMENT_ARCHIVED) archived++;
+        else live++;
+    }
+    OrderSegment active = s->active;
+    active.seq = s->nextSeq;
+    print_row(&active, s->path + s->dirLen);
+    printf("(%zu sealed, %zu archived; archived segments are left out of reports)\n", live, archived);
+}
+
+/* ---------- readers ---------- */
+
+static int files_push(SegmentFiles* f, size_t* capacity, const char* path) {
+    if (f->count >= *capacity) {
+        size_t newCap = *capacity == 0 ? 8 : *capacity * 2;
+        char (*nd)[SEGLOG_PATH_MAX] = (char (*)[SEGLOG_PATH_MAX])realloc(f->paths, newCap * SEGLOG_PATH_MAX);
+        if (!nd) return -1;
+        f->paths = nd;
+        *capacity = newCap;
+    }
+    strncpy_s(f->paths[f->count], SEGLOG_PATH_MAX, path, _TRUNCATE);
+    f->count++;
+    return 0;
+}
+
+int seglog_select(const char* path, long long from, long long to, SegmentFiles* out) {
+    memset(out, 0, sizeof(*out));
+    OrderSegment* segs;
+    size_t n;
+    if (seglog_readManifest(path, &segs, &n) != 0) return -2;
+    size_t capacity = 0;
+    int rc = 0;
+    for (size_t i = 0; rc == 0 && i < n; ++i) {
+        if (segs[i].status != SEGMENT_SEALED) continue;
+        out->sealed++;
+        if ((from > 0 && segs[i].lastTime < from) || (to > 0 && segs[i].firstTime > to)) {
+            out->skipped++;
+            continue;
+        }
+        char p[SEGLOG_PATH_MAX];
+        seglog_segmentPath(path, &segs[i], p, sizeof(p));
+        if (files_push(out, &capacity, p) != 0) rc = -2;
+    }
+    free(segs);
+    if (rc == 0 && files_push(out, &capacity, path) != 0) rc = -2;
+    if (rc != 0) seglog_freeFiles(out);
+    return rc;
+}
+
+void seglog_freeFiles(SegmentFiles* f) {
+    free(f->paths);
+    memset(f, 0, sizeof(*f));
+}
@@ -0,0 +1,137 @@
+#pragma once
+#ifndef SEGLOG_H
+#define SEGLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "order.h"
+#include "journal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* orders.log as a series of bounded segment files.
+     *
+     * Orders are appended to the active segment, orders.log. Before an
+     * append that would take it past maxBytes, or once its oldest record
+     * is maxAge seconds older than the one being appended, it is sealed:
+     * renamed to orders.log.<seq> (000001, 000002, ...), and the next
+     * append starts a new orders.log. Sealed segments never change again.
+     *
+     * orders.log.manifest has one line per sealed segment:
+     *   seq,status,file,firstOrderId,lastOrderId,firstTime,lastTime,
+     *   records,created,paid,cancelled,bytes
+     * file is relative to the log's directory. firstTime/lastTime bound
+     * every creation and payment time in the segment, and the counts are
+     * per record status. The manifest is a journal: a later line for a seq
+     * supersedes the earlier one.
+     *
+     * Sealing appends the manifest line first and renames the file second,
+     * in order through the persistence queue. A listed segment whose file
+     * does not exist yet is still the active file. seglog_load() completes
+     * a rename that was cut short, and drops a sealed entry whose file is
+     * missing otherwise (orders.log changed after the cut, or the file was
+     * removed) by rewriting the manifest without it.
+     *
+     * seglog_archive() moves sealed segments that end before a cutoff into
+     * archive/ beside the log and marks them ARCHIVED. Reads leave archived
+     * segments out. The active segment is never touched.
+     *
+     * Readers call seglog_select(). It reads the manifest from disk, so it
+     * also works in other processes. It returns the sealed segments that
+     * overlap a time range, oldest first, then the active file. Without a
+     * manifest that is orders.log alone.
+     */
+
+#define SEGLOG_PATH_MAX          260
+#define SEGLOG_DEFAULT_MAX_BYTES (64ull << 20)
+#define SEGLOG_DEFAULT_MAX_AGE   (31LL * 86400)   /* seconds */
+#define SEGLOG_ARCHIVE_DIR       "archive"
+
+    typedef enum {
+        SEGMENT_ACTIVE = 0,
+        SEGMENT_SEALED,
+        SEGMENT_ARCHIVED
+    } SegmentStatus;
+
+    typedef struct {
+        int           seq;            /* 0 for the active segment */
+        SegmentStatus status;
+        char          file[64];       /* relative to the log's directory */
+        int           firstOrderId;
+        int           lastOrderId;
+        long long     firstTime;      /* 0 while empty */
+        long long     lastTime;
+        long long     records;
+        long long     created;
+        long long     paid;
+        long long     cancelled;
+        uint64_t      bytes;
+    } OrderSegment;
+
+    typedef struct {
+        char          path[SEGLOG_PATH_MAX];   /* the active segment */
+        size_t        dirLen;                  /* path[0, dirLen) is its directory */
+        OrderSegment* data;                    /* sealed and archived, by seq */
+        size_t        size;
+        size_t        capacity;
+        OrderSegment  active;
+        int           nextSeq;
+        uint64_t      maxBytes;                /* 0 = no size bound */
+        long long     maxAge;                  /* 0 = no time bound */
+        int           target;                  /* persist-queue target of path, -1 = none */
+        int           format;                  /* OrderLogFormat of new records (orderbin.h) */
+        Journal       manifest;
+    } SegmentLog;
+
+    typedef struct {
+        char   (*paths)[SEGLOG_PATH_MAX];
+        size_t count;        /* the active file is last */
+        size_t sealed;       /* live sealed segments in the manifest */
+        size_t skipped;      /* of those, outside the time range */
+    } SegmentFiles;
+
+    /* default bounds; no I/O */
+    void seglog_init(SegmentLog* s, const char* path);
+    void seglog_free(SegmentLog* s);
+
+    /* reads the manifest, completes or drops an interrupted seal and scans
+     * the active file. Returns the sealed and archived segments, -1 when out
+     * of memory. */
+    int  seglog_load(SegmentLog* s);
+    /* route the writes through the persistence queue */
+    void seglog_attach(SegmentLog* s, int target, int manifestTarget);
+    /* adds the queued appends the writer thread failed to write so far to
+     * CTR_ORDER_LOG_ERRORS; seglog_append() does this as it goes */
+    void seglog_countWriteErrors(SegmentLog* s);
+
+    /* append one order record, sealing the active segment first when the
+     * record would overrun it. 0 ok, -1 when the write fails */
+    int  seglog_append(SegmentLog* s, const Order* o);
+    /* seal the active segment now. 0 ok, 1 if it is empty, -1 on failure */
+    int  seglog_seal(SegmentLog* s);
+
+    /* archive the sealed segments whose lastTime is before `before`;
+     * returns how many were moved, -1 if archive/ cannot be created */
+    int  seglog_archive(SegmentLog* s, long long before);
+
+    void seglog_print(const SegmentLog* s);
+
+    /* the manifest of the log at path, one entry per seq in seq order
+     * (*out is malloc'd, NULL when there is none). 0 ok, -2 when out of
+     * memory */
+    int  seglog_readManifest(const char* path, OrderSegment** out, size_t* count);
+    /* path of a manifest entry's file */
+    void seglog_segmentPath(const char* path, const OrderSegment* seg, char* out, size_t cap);
+
+    /* the files to read for records in [from, to] (0 = unbounded).
+     * 0 ok, -2 when out of memory */
+    int  seglog_select(const char* path, long long from, long long to, SegmentFiles* out);
+    void seglog_freeFiles(SegmentFiles* f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,331 @@
+#include "snapshot.h"
+#include "persistence.h"
+#include "persist_queue.h"
+#include "seglog.h"
+#include "metrics.h"
+#include "timeutil.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#define SNAPSHOT_HAVE_FORK 0
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define SNAPSHOT_HAVE_FORK 1
+#endif
+
+#define SNAPSHOT_COPY_BLOCK (64 * 1024)
+
+static const char* const g_stageNames[SNAPSHOT_STAGES] = {
+    "products", "users", "reorder levels", "valuation", "orders log", "purchase log"
+};
+
+/* fixed-size progress message; a pipe write this small is atomic */
+typedef struct {
+    int       stage;      /* stages completed */
+    int       done;       /* 1 after the final rename */
+    long long amount;
+} SnapshotMsg;
+
+static void report(int fd, int stage, int done, long long amount) {
+#if SNAPSHOT_HAVE_FORK
+    if (fd < 0) return;
+    SnapshotMsg m;
+    m.stage = stage;
+    m.done = done;
+    m.amount = amount;
+    ssize_t w;
+    do {
+        w = write(fd, &m, sizeof(m));
+    } while (w < 0 && errno == EINTR);
+#else
+    (void)fd; (void)stage; (void)done; (void)amount;
+#endif
+}
+
+static int make_dir(const char* path) {
+#if defined(_WIN32)
+    return _mkdir(path) == 0 ? 0 : -1;
+#else
+    return mkdir(path, 0755) == 0 || errno == EEXIST ? 0 : -1;
+#endif
+}
+
+static uint64_t path_size(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return 0;
+#if defined(_MSC_VER)
+    long long n = _fseeki64(fp, 0, SEEK_END) == 0 ? _ftelli64(fp) : 0;
+#else
+    off_t n = fseeko(fp, 0, SEEK_END) == 0 ? ftello(fp) : 0;
+#endif
+    fclose(fp);
+    return n > 0 ? (uint64_t)n : 0;
+}
+
+static long long write_buffer(const char* path, char* data, size_t len) {
+    if (!data) return -1;
+    FILE* fp = fopen(path, "wb");
+    int ok = fp != NULL && fwrite(data, 1, len, fp) == len;
+    if (fp && fclose(fp) != 0) ok = 0;
+    free(data);
+    return ok ? (long long)len : -1;
+}
+
+/* appends up to `bytes` of in to out; the bytes copied, -1 on failure */
+static long long append_prefix(FILE* out, FILE* in, uint64_t bytes) {
+    char* buf = (char*)malloc(SNAPSHOT_COPY_BLOCK);
+    if (!buf) return -1;
+    uint64_t left = bytes;
+    int ok = 1;
+    while (ok && left > 0) {
+        size_t want = left < SNAPSHOT_COPY_BLOCK ? (size_t)left : SNAPSHOT_COPY_BLOCK;
+        size_t got = fread(buf, 1, want, in);
+        if (got == 0) break;
+        if (fwrite(buf, 1, got, out) != got) ok = 0;
+        left -= got;
+    }
+    free(buf);
+    return ok ? (long long)(bytes - left) : -1;
+}
+
+/* copies the first `bytes` of src (an append-only log); a missing log
+ * gives an empty file */
+static long long copy_prefix(const char* src, uint64_t bytes, const char* dst) {
+    FILE* out = fopen(dst, "wb");
+    if (!out) return -1;
+    FILE* in = fopen(src, "rb");
+    long long n = in ? append_prefix(out, in, bytes) : 0;
+    if (in) fclose(in);
+    if (fclose(out) != 0) n = -1;
+    return n;
+}
+
+/* the order log as one file: the live sealed segments whole, then the
+ * first `bytes` of the active file, which was opened before the fork
+ * because it may be sealed and renamed while the export runs */
+static long long copy_orders(const SegmentFiles* files, FILE* active, uint64_t bytes, const char* dst) {
+    FILE* out = fopen(dst, "wb");
+    if (!out) return -1;
+    long long total = 0;
+    for (size_t i = 0; total >= 0 && i + 1 < files->count; ++i) {
+        FILE* in = fopen(files->paths[i], "rb");
+        if (!in) continue;
+        long long n = append_prefix(out, in, UINT64_MAX);
+        fclose(in);
+        total = n < 0 ? -1 : total + n;
+    }
+    if (total >= 0 && active) {
+        long long n = append_prefix(out, active, bytes);
+        total = n < 0 ? -1 : total + n;
+    }
+    if (fclose(out) != 0) total = -1;
+    return total;
+}
+
+/* writes every table into dir; runs in the child, or inline without fork */
+static int write_snapshot(const SnapshotSource* src, const SegmentFiles* orderFiles, FILE* ordersActive,
+    uint64_t ordersBytes, uint64_t purchasesBytes, const char* dir, int fd) {
+    char tmp[300];
+    char path[340];
+    long long amounts[SNAPSHOT_STAGES];
+    char* text;
+    size_t len = 0;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", dir);
+    if (make_dir(tmp) != 0) return -1;
+
+    snprintf(path, sizeof(path), "%s/products.csv", tmp);
+    if (saveProductsToCSV(path, src->products) != 0) return -1;
+    amounts[0] = (long long)src->products->size;
+    report(fd, 1, 0, amounts[0]);
+
+    snprintf(path, sizeof(path), "%s/users.csv", tmp);
+    if (saveUsersToCSV(path, src->users) != 0) return -1;
+    amounts[1] = (long long)src->users->size;
+    report(fd, 2, 0, amounts[1]);
+
+    snprintf(path, sizeof(path), "%s/reorder_levels.csv", tmp);
+    text = reorder_formatSnapshot(src->reorder, &len);
+    amounts[2] = write_buffer(path, text, len);
+    if (amounts[2] < 0) return -1;
+    report(fd, 3, 0, amounts[2]);
+
+    snprintf(path, sizeof(path), "%s/valuation.csv", tmp);
+    text = valuation_formatSnapshot(src->valuation, &len);
+    amounts[3] = write_buffer(path, text, len);
+    if (amounts[3] < 0) return -1;
+    report(fd, 4, 0, amounts[3]);
+
+    snprintf(path, sizeof(path), "%s/orders.log", tmp);
+    amounts[4] = copy_orders(orderFiles, ordersActive, ordersBytes, path);
+    if (amounts[4] < 0) return -1;
+    report(fd, 5, 0, amounts[4]);
+
+    snprintf(path, sizeof(path), "%s/purchase_log.csv", tmp);
+    amounts[5] = copy_prefix(src->purchaseLogPath, purchasesBytes, path);
+    if (amounts[5] < 0) return -1;
+    report(fd, 6, 0, amounts[5]);
+
+    snprintf(path, sizeof(path), "%s/MANIFEST", tmp);
+    FILE* mf = fopen(path, "w");
+    if (!mf) return -1;
+    fprintf(mf, "SNAPSHOT,1,%lld\n", (long long)time(NULL));
+    fprintf(mf, "products,%lld rows\nusers,%lld rows\n", amounts[0], amounts[1]);
+    fprintf(mf, "reorder_levels,%lld bytes\nvaluation,%lld bytes\n", amounts[2], amounts[3]);
+    fprintf(mf, "orders.log,%lld bytes\npurchase_log.csv,%lld bytes\n", amounts[4], amounts[5]);
+    if (fclose(mf) != 0) return -1;
+
+    if (rename(tmp, dir) != 0) return -1;
+    report(fd, SNAPSHOT_STAGES, 1, 0);
+    return 0;
+}
+
+int snapshot_start(SnapshotJob* job, const SnapshotSource* src, const char* dir) {
+    if (job->state == SNAPSHOT_RUNNING) return -2;
+    memset(job, 0, sizeof(*job));
+    snprintf(job->dir, sizeof(job->dir), "%s", dir);
+    job->fd = -1;
+    /* the logs only grow: what exists now is the point-in-time image. The
+     * writer is parked only while the files and their sizes are taken, so
+     * no append is half-written and no segment is sealed in between */
+    pq_pause();
+    SegmentFiles orderFiles;
+    int selected = seglog_select(src->orderLogPath, 0, 0, &orderFiles);
+    FILE* ordersActive = selected == 0 ? fopen(src->orderLogPath, "rb") : NULL;
+    uint64_t ordersBytes = path_size(src->orderLogPath);
+    uint64_t purchasesBytes = path_size(src->purchaseLogPath);
+    pq_resume();
+    if (selected != 0) return -1;
+    job->startNs = timeutil_nowNs();
+#if SNAPSHOT_HAVE_FORK
+    int fds[2];
+    if (pipe(fds) != 0) {
+        if (ordersActive) fclose(ordersActive);
+        seglog_freeFiles(&orderFiles);
+        return -1;
+    }
+    /* only the calling thread survives in the child. The writer keeps
+     * running: fork() takes the malloc and stdio list locks itself, and
+     * the child never touches the writer's files or buffers (it leaves
+     * through _exit), so a lock held on one of them does not matter */
+    fflush(NULL);   /* the child must not inherit unflushed stdio buffers */
+    uint64_t t0 = timeutil_nowNs();
+    pid_t pid = fork();
+    if (pid == 0) {
+        /* copy-on-write image of the parent; no locks, queues or metrics */
+        close(fds[0]);
+        signal(SIGINT, SIG_IGN);
+        metrics_setEnabled(0);
+        g_traceEnabled = 0;
+        int rc = write_snapshot(src, &orderFiles, ordersActive, ordersBytes, purchasesBytes, dir, fds[1]);
+        _exit(rc == 0 ? 0 : 1);
+    }
+    job->forkNs = timeutil_nowNs() - t0;
+    close(fds[1]);
+    if (ordersActive) fclose(ordersActive);
+    seglog_freeFiles(&orderFiles);
+    if (pid < 0) {
+        close(fds[0]);
+        return -1;
+    }
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    job->pid = (int)pid;
+    job->fd = fds[0];
+    job->state = SNAPSHOT_RUNNING;
+    return 0;
+#else
+    int rc = write_snapshot(src, &orderFiles, ordersActive, ordersBytes, purchasesBytes, dir, -1);
+    if (ordersActive) fclose(ordersActive);
+    seglog_freeFiles(&orderFiles);
+    job->stage = rc == 0 ? SNAPSHOT_STAGES : 0;
+    job->state = rc == 0 ? SNAPSHOT_DONE : SNAPSHOT_FAILED;
+    job->elapsedNs = timeutil_nowNs() - job->startNs;
+    return rc;
+#endif
+}
+
+#if SNAPSHOT_HAVE_FORK
+/* drains the pipe; returns 1 at end of file */
+static int read_progress(SnapshotJob* job, int* sawDone) {
+    SnapshotMsg m;
+    for (;;) {
+        ssize_t n = read(job->fd, &m, sizeof(m));
+        if (n == (ssize_t)sizeof(m)) {
+            job->stage = m.stage;
+            if (m.done) *sawDone = 1;
+            else job->amount = m.amount;
+            continue;
+        }
+        if (n == 0) return 1;
+        if (n < 0 && errno == EINTR) continue;
+        return 0;   /* EAGAIN: nothing more for now */
+    }
+}
+
+static void finish(SnapshotJob* job, int sawDone) {
+    int status = 0;
+    pid_t r;
+    do {
+        r = waitpid((pid_t)job->pid, &status, 0);
+    } while (r < 0 && errno == EINTR);
+    close(job->fd);
+    job->fd = -1;
+    int ok = sawDone && r == (pid_t)job->pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    job->state = ok ? SNAPSHOT_DONE : SNAPSHOT_FAILED;
+    job->elapsedNs = timeutil_nowNs() - job->startNs;
+}
+#endif
+
+int snapshot_poll(SnapshotJob* job) {
+#if SNAPSHOT_HAVE_FORK
+    if (job->state != SNAPSHOT_RUNNING) return job->state;
+    int sawDone = job->stage == SNAPSHOT_STAGES;
+    /* the child closes its end by exiting, so EOF means it is done */
+    if (read_progress(job, &sawDone)) finish(job, sawDone);
+#endif
+    return job->state;
+}
+
+int snapshot_wait(SnapshotJob* job) {
+#if SNAPSHOT_HAVE_FORK
+    if (job->state != SNAPSHOT_RUNNING) return job->state;
+    fcntl(job->fd, F_SETFL, fcntl(job->fd, F_GETFL) & ~O_NONBLOCK);
+    int sawDone = job->stage == SNAPSHOT_STAGES;
+    while (!read_progress(job, &sawDone)) {}
+    finish(job, sawDone);
+#endif
+    return job->state;
+}
+
+void snapshot_printStatus(const SnapshotJob* job) {
+    switch (job->state) {
+    case SNAPSHOT_IDLE:
+        printf("No snapshot export has been started.\n");
+        return;
+    case SNAPSHOT_RUNNING:
+        printf("Snapshot %s: running, %d/%d stages done", job->dir, job->stage, SNAPSHOT_STAGES);
+        if (job->stage > 0) {
+            printf(" (%s: %lld)", g_stageNames[job->stage - 1], job->amount);
+        }
+        printf(", %.1f ms elapsed\n", (double)(timeutil_nowNs() - job->startNs) / 1e6);
+        break;
+    case SNAPSHOT_DONE:
+        printf("Snapshot %s: complete in %.1f ms.\n", job->dir, (double)job->elapsedNs / 1e6);
+        break;
+    default:
+        printf("Snapshot %s: FAILED after %d/%d stages (partial files left in %s.tmp).\n",
+            job->dir, job->stage, SNAPSHOT_STAGES, job->dir);
+        break;
+    }
+    if (job->pid) printf("Parent pause (fork): %.1f us\n", (double)job->forkNs / 1e3);
+}
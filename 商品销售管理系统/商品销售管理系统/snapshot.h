@@ -0,0 +1,81 @@
+#pragma once
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "product.h"
+#include "user.h"
+#include "reorder.h"
+#include "valuation.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Point-in-time export of the live tables into a directory.
+     *
+     * On POSIX the export runs in a fork()ed child: the copy-on-write
+     * image is the snapshot, the parent only pays for the fork itself
+     * (page tables) and keeps serving. The child writes
+     *   products.csv, users.csv, reorder_levels.csv, valuation.csv,
+     *   orders.log, purchase_log.csv, MANIFEST
+     * into <dir>.tmp and renames it to <dir> when everything is written.
+     * The two logs are append-only, so they are exported as the prefix
+     * that existed at fork time; flush queued appends (pq_flush) first.
+     * The persistence writer is parked (pq_pause) only while the log files
+     * and sizes are captured, not across the fork; apart from it the parent
+     * must have no other threads running.
+     * A segmented order log is exported as one orders.log: the live sealed
+     * segments, then the active file.
+     * Progress messages come back through a pipe and are picked up by
+     * snapshot_poll(), which never blocks.
+     *
+     * On Windows there is no fork(), so snapshot_start() writes the same
+     * files synchronously.
+     */
+
+    typedef struct {
+        const ProductList*  products;
+        const UserList*     users;
+        const ReorderTable* reorder;
+        const Valuation*    valuation;
+        const char*         orderLogPath;
+        const char*         purchaseLogPath;
+    } SnapshotSource;
+
+    enum {
+        SNAPSHOT_IDLE = 0,
+        SNAPSHOT_RUNNING,
+        SNAPSHOT_DONE,
+        SNAPSHOT_FAILED
+    };
+
+#define SNAPSHOT_STAGES 6
+
+    typedef struct {
+        int       state;
+        char      dir[256];
+        int       stage;        /* stages completed */
+        long long amount;       /* rows or bytes written by the last stage */
+        int       pid;
+        int       fd;           /* read end of the progress pipe */
+        uint64_t  startNs;
+        uint64_t  forkNs;       /* time the parent spent in fork() */
+        uint64_t  elapsedNs;    /* set when the job ends */
+    } SnapshotJob;
+
+    /* 0 started (or, without fork, finished), -1 on failure, -2 while
+     * another export is still running */
+    int  snapshot_start(SnapshotJob* job, const SnapshotSource* src, const char* dir);
+    /* reads pending progress and reaps a finished child; returns job->state */
+    int  snapshot_poll(SnapshotJob* job);
+    /* blocks until a running export ends; returns job->state */
+    int  snapshot_wait(SnapshotJob* job);
+    void snapshot_printStatus(const SnapshotJob* job);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
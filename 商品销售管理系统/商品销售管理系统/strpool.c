@@ -0,0 +1,121 @@
+#include "strpool.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct StrPool {
+    char*     data;
+    size_t    len;
+    size_t    cap;
+    uint32_t* slots;    /* refs, STRPOOL_NONE = empty */
+    uint32_t* hashes;   /* hash of the string in the same slot */
+    size_t    nSlots;   /* power of two */
+    size_t    count;
+};
+
+static uint32_t hash_bytes(const char* s, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; ++i) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+StrPool* strpool_create(void) {
+    StrPool* pool = (StrPool*)calloc(1, sizeof(StrPool));
+    if (!pool) return NULL;
+    pool->cap = 4096;
+    pool->data = (char*)malloc(pool->cap);
+    if (!pool->data) {
+        free(pool);
+        return NULL;
+    }
+    pool->data[0] = '\0';   /* ref 0: "" */
+    pool->len = 1;
+    return pool;
+}
+
+void strpool_free(StrPool* pool) {
+    if (!pool) return;
+    free(pool->data);
+    free(pool->slots);
+    free(pool->hashes);
+    free(pool);
+}
+
+void strpool_clear(StrPool* pool) {
+    if (!pool) return;
+    pool->len = 1;
+    pool->count = 0;
+    if (pool->slots) memset(pool->slots, 0xff, pool->nSlots * sizeof(uint32_t));
+}
+
+static int grow_slots(StrPool* pool) {
+    size_t newN = pool->nSlots == 0 ? 1024 : pool->nSlots * 2;
+    uint32_t* ns = (uint32_t*)malloc(newN * sizeof(uint32_t));
+    uint32_t* nh = (uint32_t*)malloc(newN * sizeof(uint32_t));
+    if (!ns || !nh) {
+        free(ns);
+        free(nh);
+        return -1;
+    }
+    memset(ns, 0xff, newN * sizeof(uint32_t));
+    for (size_t i = 0; i < pool->nSlots; ++i) {
+        if (pool->slots[i] == STRPOOL_NONE) continue;
+        size_t j = pool->hashes[i] & (newN - 1);
+        while (ns[j] != STRPOOL_NONE) j = (j + 1) & (newN - 1);
+        ns[j] = pool->slots[i];
+        nh[j] = pool->hashes[i];
+    }
+    free(pool->slots);
+    free(pool->hashes);
+    pool->slots = ns;
+    pool->hashes = nh;
+    pool->nSlots = newN;
+    return 0;
+}
+
+uint32_t strpool_intern(StrPool* pool, const char* s, size_t maxLen) {
+    if (!pool || !s) return STRPOOL_NONE;
+    size_t n = 0;
+    while (n < maxLen && s[n]) n++;
+    if (n == 0) return 0;
+    if ((pool->count + 1) * 2 > pool->nSlots && grow_slots(pool) != 0) return STRPOOL_NONE;
+
+    uint32_t h = hash_bytes(s, n);
+    size_t mask = pool->nSlots - 1;
+    size_t i = h & mask;
+    for (; pool->slots[i] != STRPOOL_NONE; i = (i + 1) & mask) {
+        const char* cand = pool->data + pool->slots[i];
+        if (pool->hashes[i] == h && strncmp(cand, s, n) == 0 && cand[n] == '\0') {
+            return pool->slots[i];
+        }
+    }
+
+    if (pool->len + n + 1 >= STRPOOL_NONE) return STRPOOL_NONE;
+    if (pool->len + n + 1 > pool->cap) {
+        size_t newCap = pool->cap * 2;
+        while (newCap < pool->len + n + 1) newCap *= 2;
+        char* nd = (char*)realloc(pool->data, newCap);
+        if (!nd) return STRPOOL_NONE;
+        pool->data = nd;
+        pool->cap = newCap;
+    }
+    uint32_t ref = (uint32_t)pool->len;
+    memcpy(pool->data + ref, s, n);
+    pool->data[ref + n] = '\0';
+    pool->len += n + 1;
+    pool->slots[i] = ref;
+    pool->hashes[i] = h;
+    pool->count++;
+    return ref;
+}
+
+const char* strpool_get(const StrPool* pool, uint32_t ref) {
+    if (!pool || ref >= pool->len) return "";
+    return pool->data + ref;
+}
+
+size_t strpool_bytes(const StrPool* pool) {
+    return pool ? pool->len : 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#ifndef STRPOOL_H
+#define STRPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Interned string pool: each distinct string is stored once in one
+     * contiguous buffer and named by its 32-bit offset. Ref 0 is always the
+     * empty string. Strings are never removed; the pool is dropped as a
+     * whole with strpool_clear / strpool_free.
+     *
+     * Pointers from strpool_get stay valid until the next intern (the
+     * buffer may move); refs stay valid until the pool is cleared.
+     */
+
+#define STRPOOL_NONE UINT32_MAX
+
+    typedef struct StrPool StrPool;
+
+    StrPool*    strpool_create(void);
+    void        strpool_free(StrPool* pool);
+    void        strpool_clear(StrPool* pool);
+
+    /* stores at most maxLen bytes of s; STRPOOL_NONE when out of memory */
+    uint32_t    strpool_intern(StrPool* pool, const char* s, size_t maxLen);
+    const char* strpool_get(const StrPool* pool, uint32_t ref);
+    size_t      strpool_bytes(const StrPool* pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
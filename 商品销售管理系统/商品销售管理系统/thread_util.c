@@ -0,0 +1,123 @@
+#include "thread_util.h"
+#include <stdlib.h>
+#if !defined(_WIN32)
+#include <time.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+    ThreadFunc fn;
+    void* arg;
+} ThreadStart;
+
+#if defined(_WIN32)
+#include <process.h>
+
+static unsigned __stdcall thread_trampoline(void* p) {
+    ThreadStart ts = *(ThreadStart*)p;
+    free(p);
+    ts.fn(ts.arg);
+    return 0;
+}
+
+int thread_start(ThreadHandle* th, ThreadFunc fn, void* arg) {
+    ThreadStart* ts = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (!ts) return -1;
+    ts->fn = fn;
+    ts->arg = arg;
+    uintptr_t h = _beginthreadex(NULL, 0, thread_trampoline, ts, 0, NULL);
+    if (h == 0) {
+        free(ts);
+        return -1;
+    }
+    *th = (HANDLE)h;
+    return 0;
+}
+
+void thread_join(ThreadHandle th) {
+    WaitForSingleObject(th, INFINITE);
+    CloseHandle(th);
+}
+
+void thread_sleepMs(unsigned ms) { Sleep(ms); }
+
+unsigned thread_cpuCount(void) {
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors > 0 ? (unsigned)si.dwNumberOfProcessors : 1;
+}
+
+void mutex_init(Mutex* m) { InitializeCriticalSection(m); }
+void mutex_destroy(Mutex* m) { DeleteCriticalSection(m); }
+void mutex_lock(Mutex* m) { EnterCriticalSection(m); }
+void mutex_unlock(Mutex* m) { LeaveCriticalSection(m); }
+
+void cond_init(CondVar* c) { InitializeConditionVariable(c); }
+void cond_destroy(CondVar* c) { (void)c; }
+void cond_wait(CondVar* c, Mutex* m) { SleepConditionVariableCS(c, m, INFINITE); }
+void cond_signal(CondVar* c) { WakeConditionVariable(c); }
+void cond_broadcast(CondVar* c) { WakeAllConditionVariable(c); }
+
+uint64_t atomic_loadU64(volatile uint64_t* p) {
+    return (uint64_t)InterlockedCompareExchange64((volatile LONG64*)p, 0, 0);
+}
+
+void atomic_storeU64(volatile uint64_t* p, uint64_t v) {
+    InterlockedExchange64((volatile LONG64*)p, (LONG64)v);
+}
+
+#else
+
+static void* thread_trampoline(void* p) {
+    ThreadStart ts = *(ThreadStart*)p;
+    free(p);
+    ts.fn(ts.arg);
+    return NULL;
+}
+
+int thread_start(ThreadHandle* th, ThreadFunc fn, void* arg) {
+    ThreadStart* ts = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (!ts) return -1;
+    ts->fn = fn;
+    ts->arg = arg;
+    if (pthread_create(th, NULL, thread_trampoline, ts) != 0) {
+        free(ts);
+        return -1;
+    }
+    return 0;
+}
+
+void thread_join(ThreadHandle th) { pthread_join(th, NULL); }
+
+void thread_sleepMs(unsigned ms) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ms / 1000);
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) != 0) {}
+}
+
+unsigned thread_cpuCount(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 1;
+}
+
+void mutex_init(Mutex* m) { pthread_mutex_init(m, NULL); }
+void mutex_destroy(Mutex* m) { pthread_mutex_destroy(m); }
+void mutex_lock(Mutex* m) { pthread_mutex_lock(m); }
+void mutex_unlock(Mutex* m) { pthread_mutex_unlock(m); }
+
+void cond_init(CondVar* c) { pthread_cond_init(c, NULL); }
+void cond_destroy(CondVar* c) { pthread_cond_destroy(c); }
+void cond_wait(CondVar* c, Mutex* m) { pthread_cond_wait(c, m); }
+void cond_signal(CondVar* c) { pthread_cond_signal(c); }
+void cond_broadcast(CondVar* c) { pthread_cond_broadcast(c); }
+
+uint64_t atomic_loadU64(volatile uint64_t* p) {
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+void atomic_storeU64(volatile uint64_t* p, uint64_t v) {
+    __atomic_store_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+#endif
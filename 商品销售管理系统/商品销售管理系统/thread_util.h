@@ -0,0 +1,55 @@
+#pragma once
+#ifndef THREAD_UTIL_H
+#define THREAD_UTIL_H
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Minimal thread / lock / atomic wrappers (Win32 or pthreads) */
+
+#if defined(_WIN32)
+    typedef HANDLE             ThreadHandle;
+    typedef CRITICAL_SECTION   Mutex;
+    typedef CONDITION_VARIABLE CondVar;
+#else
+    typedef pthread_t          ThreadHandle;
+    typedef pthread_mutex_t    Mutex;
+    typedef pthread_cond_t     CondVar;
+#endif
+
+    typedef void (*ThreadFunc)(void* arg);
+
+    int  thread_start(ThreadHandle* th, ThreadFunc fn, void* arg); /* 0 on success */
+    void thread_join(ThreadHandle th);
+    void thread_sleepMs(unsigned ms);
+    unsigned thread_cpuCount(void);   /* online processors, at least 1 */
+
+    void mutex_init(Mutex* m);
+    void mutex_destroy(Mutex* m);
+    void mutex_lock(Mutex* m);
+    void mutex_unlock(Mutex* m);
+
+    void cond_init(CondVar* c);
+    void cond_destroy(CondVar* c);
+    void cond_wait(CondVar* c, Mutex* m);
+    void cond_signal(CondVar* c);
+    void cond_broadcast(CondVar* c);
+
+    /* sequentially consistent 64-bit load/store */
+    uint64_t atomic_loadU64(volatile uint64_t* p);
+    void     atomic_storeU64(volatile uint64_t* p, uint64_t v);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
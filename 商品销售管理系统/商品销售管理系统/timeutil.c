@@ -0,0 +1,63 @@
+#include "timeutil.h"
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+
+uint64_t timeutil_nowNs(void) {
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    /* split to avoid overflow of now * 1e9 */
+    uint64_t sec = (uint64_t)(now.QuadPart / freq.QuadPart);
+    uint64_t rem = (uint64_t)(now.QuadPart % freq.QuadPart);
+    return sec * 1000000000ull + rem * 1000000000ull / (uint64_t)freq.QuadPart;
+}
+
+#else
+#include <time.h>
+
+uint64_t timeutil_nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#endif
+
+void timeutil_monthCacheInit(MonthCache* c) {
+    c->count = 0;
+    c->next = 0;
+}
+
+int timeutil_monthKey(MonthCache* c, time_t t) {
+    for (size_t i = 0; i < c->count; ++i) {
+        const MonthSpan* s = &c->spans[i];
+        if (t >= s->from && t < s->to) return s->key;
+    }
+    struct tm* lt = localtime(&t);
+    if (!lt) return 0;
+    int year = lt->tm_year, mon = lt->tm_mon;
+    int key = (year + 1900) * 100 + mon + 1;
+    struct tm b;
+    memset(&b, 0, sizeof(b));
+    b.tm_year = year;
+    b.tm_mon = mon;
+    b.tm_mday = 1;
+    b.tm_isdst = -1;
+    time_t from = mktime(&b);
+    memset(&b, 0, sizeof(b));
+    b.tm_year = year;
+    b.tm_mon = mon + 1;
+    b.tm_mday = 1;
+    b.tm_isdst = -1;
+    time_t to = mktime(&b);
+    if (from != (time_t)-1 && to != (time_t)-1 && from <= t && t < to) {
+        size_t slot = c->count < TIMEUTIL_MONTH_CACHE ? c->count++ : c->next++ % TIMEUTIL_MONTH_CACHE;
+        c->spans[slot].from = from;
+        c->spans[slot].to = to;
+        c->spans[slot].key = key;
+    }
+    return key;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#ifndef TIMEUTIL_H
+#define TIMEUTIL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* monotonic clock in nanoseconds (arbitrary epoch) */
+    uint64_t timeutil_nowNs(void);
+
+#define TIMEUTIL_MONTH_CACHE 32
+
+    typedef struct {
+        time_t from;
+        time_t to;
+        int    key;
+    } MonthSpan;
+
+    /* recently seen local months and their bounds, so localtime() and
+     * mktime() run about once per month rather than once per record */
+    typedef struct {
+        MonthSpan spans[TIMEUTIL_MONTH_CACHE];
+        size_t    count;
+        size_t    next;    /* slot replaced when full */
+    } MonthCache;
+
+    void timeutil_monthCacheInit(MonthCache* c);
+    /* yyyymm of t in local time, 0 when localtime() fails */
+    int  timeutil_monthKey(MonthCache* c, time_t t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,202 @@
+#include "trace.h"
+#include "thread_util.h"
+#include "timeutil.h"
+#include "compat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#define TRACE_TLS __declspec(thread)
+#else
+#define TRACE_TLS _Thread_local
+#endif
+
+#define TRACE_PATH_MAX          260
+#define TRACE_NAME_MAX          32
+#define TRACE_MAX_THREAD_EVENTS (1u << 20)
+
+typedef struct {
+    const char* name;   /* NULL for an end event */
+    uint64_t    ts;
+} TraceEvent;
+
+typedef struct TraceBuffer {
+    TraceEvent* events;
+    size_t      size;
+    size_t      capacity;
+    size_t      depth;      /* recorded spans still open */
+    size_t      skipped;    /* open spans dropped because the buffer was full */
+    unsigned long long dropped;
+    int         tid;
+    char        threadName[TRACE_NAME_MAX];
+    struct TraceBuffer* next;
+} TraceBuffer;
+
+int g_traceEnabled = 0;
+
+static Mutex        g_mu;
+static int          g_muReady = 0;
+static TraceBuffer* g_buffers = NULL;
+static int          g_nextTid = 1;
+static unsigned     g_generation = 0;
+static uint64_t     g_startNs = 0;
+static char         g_path[TRACE_PATH_MAX];
+
+static TRACE_TLS TraceBuffer* t_buf = NULL;
+static TRACE_TLS unsigned     t_generation = 0;
+
+/* the calling thread's buffer, registered on first use in this session */
+static TraceBuffer* thread_buffer(void) {
+    if (t_buf && t_generation == g_generation) return t_buf;
+    TraceBuffer* b = (TraceBuffer*)calloc(1, sizeof(TraceBuffer));
+    if (!b) return NULL;
+    mutex_lock(&g_mu);
+    b->tid = g_nextTid++;
+    b->next = g_buffers;
+    g_buffers = b;
+    mutex_unlock(&g_mu);
+    t_buf = b;
+    t_generation = g_generation;
+    return b;
+}
+
+static int push_event(TraceBuffer* b, const char* name, uint64_t ts) {
+    if (b->size >= b->capacity) {
+        size_t newCap = b->capacity == 0 ? 1024 : b->capacity * 2;
+        if (newCap > TRACE_MAX_THREAD_EVENTS) newCap = TRACE_MAX_THREAD_EVENTS;
+        if (newCap <= b->size) return -1;
+        TraceEvent* nd = (TraceEvent*)realloc(b->events, newCap * sizeof(TraceEvent));
+        if (!nd) return -1;
+        b->events = nd;
+        b->capacity = newCap;
+    }
+    b->events[b->size].name = name;
+    b->events[b->size].ts = ts;
+    b->size++;
+    return 0;
+}
+
+void trace_begin(const char* name) {
+    TraceBuffer* b = thread_buffer();
+    if (!b) return;
+    /* keep room for the end events of every open span */
+    if (b->skipped > 0 || b->size + b->depth + 2 > TRACE_MAX_THREAD_EVENTS ||
+        push_event(b, name, timeutil_nowNs()) != 0) {
+        b->skipped++;
+        b->dropped++;
+        return;
+    }
+    b->depth++;
+}
+
+void trace_end(void) {
+    TraceBuffer* b = thread_buffer();
+    if (!b) return;
+    if (b->skipped > 0) {
+        b->skipped--;
+        return;
+    }
+    if (b->depth == 0) return;
+    if (push_event(b, NULL, timeutil_nowNs()) == 0) b->depth--;
+}
+
+void trace_setThreadName(const char* name) {
+    if (!TRACE_ON() || !name) return;
+    TraceBuffer* b = thread_buffer();
+    if (b) strncpy_s(b->threadName, sizeof(b->threadName), name, _TRUNCATE);
+}
+
+int trace_start(const char* path) {
+    /* compiled out: the macros would never record or stop */
+    if (!SALES_TRACE || g_traceEnabled || !path || !*path) return -1;
+    if (!g_muReady) {
+        mutex_init(&g_mu);
+        g_muReady = 1;
+    }
+    strncpy_s(g_path, sizeof(g_path), path, _TRUNCATE);
+    g_generation++;
+    g_nextTid = 1;
+    g_startNs = timeutil_nowNs();
+    g_traceEnabled = 1;
+    trace_setThreadName("main");
+    return 0;
+}
+
+static void write_json_string(FILE* fp, const char* s) {
+    fputc('"', fp);
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(fp, "\\%c", c);
+        else if (c < 0x20) fprintf(fp, "\\u%04x", c);
+        else fputc(c, fp);
+    }
+    fputc('"', fp);
+}
+
+static void write_buffer(FILE* fp, const TraceBuffer* b, int* first) {
+    if (b->threadName[0]) {
+        fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",
+            *first ? "" : ",", b->tid);
+        write_json_string(fp, b->threadName);
+        fprintf(fp, "}}");
+        *first = 0;
+    }
+    for (size_t i = 0; i < b->size; ++i) {
+        const TraceEvent* e = &b->events[i];
+        double us = (double)(e->ts - g_startNs) / 1000.0;
+        fprintf(fp, "%s\n{", *first ? "" : ",");
+        *first = 0;
+        if (e->name) {
+            fprintf(fp, "\"name\":");
+            write_json_string(fp, e->name);
+            fprintf(fp, ",\"cat\":\"sales\",\"ph\":\"B\"");
+        }
+        else {
+            fprintf(fp, "\"ph\":\"E\"");
+        }
+        fprintf(fp, ",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", us, b->tid);
+    }
+    /* close spans still open on this thread so the viewer draws them */
+    for (size_t d = 0; d < b->depth; ++d) {
+        fprintf(fp, "%s\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+            *first ? "" : ",", (double)(timeutil_nowNs() - g_startNs) / 1000.0, b->tid);
+        *first = 0;
+    }
+}
+
+int trace_stop(void) {
+    if (!g_traceEnabled) return -1;
+    g_traceEnabled = 0;
+
+    mutex_lock(&g_mu);
+    TraceBuffer* list = g_buffers;
+    g_buffers = NULL;
+    mutex_unlock(&g_mu);
+
+    int rc = 0;
+    FILE* fp = fopen(g_path, "w");
+    if (fp) {
+        unsigned long long dropped = 0;
+        int first = 1;
+        fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+        for (TraceBuffer* b = list; b; b = b->next) {
+            write_buffer(fp, b, &first);
+            dropped += b->dropped;
+        }
+        fprintf(fp, "\n],\"otherData\":{\"droppedSpans\":%llu}}\n", dropped);
+        if (fclose(fp) != 0) rc = -1;
+    }
+    else {
+        rc = -1;
+    }
+
+    while (list) {
+        TraceBuffer* next = list->next;
+        free(list->events);
+        free(list);
+        list = next;
+    }
+    return rc;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Span tracing in Chrome trace-event format (open in Perfetto or
+     * chrome://tracing).
+     *
+     * TRACE_BEGIN / TRACE_END record nested B/E events into a buffer owned
+     * by the calling thread, so recording takes no lock. trace_stop()
+     * writes every thread's events as one JSON file; call it once the
+     * other traced threads are idle (e.g. after pq_stop()).
+     *
+     * Span names are stored by pointer and must be string literals.
+     * Build with -DSALES_TRACE=0 to compile the macros out.
+     */
+
+#ifndef SALES_TRACE
+#define SALES_TRACE 1
+#endif
+
+    extern int g_traceEnabled;
+
+#if SALES_TRACE
+#define TRACE_ON() (g_traceEnabled)
+#else
+#define TRACE_ON() 0
+#endif
+
+#define TRACE_BEGIN(name) do { if (TRACE_ON()) trace_begin(name); } while (0)
+#define TRACE_END()       do { if (TRACE_ON()) trace_end(); } while (0)
+
+    /* enable tracing; events go to path when trace_stop() is called */
+    int  trace_start(const char* path);
+    /* disable, write the JSON file and free all buffers (0 on success) */
+    int  trace_stop(void);
+
+    void trace_begin(const char* name);
+    void trace_end(void);
+
+    /* label the calling thread in the viewer */
+    void trace_setThreadName(const char* name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "user.h"
+#include "compat.h"
 
 void initUserList(UserList* list) {
     list->data = NULL;
@@ -17,6 +17,15 @@ double readDouble(const char* prompt) {
     return atof(buf);
 }
 
+Money readMoney(const char* prompt) {
+    char buf[64];
+    Money m;
+    printf("%s", prompt);
+    if (!fgets(buf, sizeof(buf), stdin)) return -1;
+    if (!money_parse(buf, &m)) return -1;
+    return m;
+}
+
 void readLine(const char* prompt, char* buf, int size) {
     printf("%s", prompt);
     if (fgets(buf, size, stdin)) {
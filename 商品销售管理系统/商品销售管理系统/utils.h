@@ -1,7 +1,9 @@
 #pragma once
 #ifndef UTILS_H
 #define UTILS_H
+#include "money.h"
 int readInt(const char* prompt);
 double readDouble(const char* prompt);
+Money readMoney(const char* prompt);   // -1 if the input is not an amount
 void readLine(const char* prompt, char* buf, int size);
 #endif
\ No newline at end of file
@@ -0,0 +1,287 @@
+#include "valuation.h"
+#include "metrics.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void valuation_init(Valuation* v) {
+    v->data = NULL;
+    v->size = 0;
+    v->capacity = 0;
+    idmap_init(&v->indexOf);
+    v->totalValue = 0;
+    v->totalCogs = 0;
+}
+
+void valuation_free(Valuation* v) {
+    free(v->data);
+    idmap_free(&v->indexOf);
+    valuation_init(v);
+}
+
+const CostEntry* valuation_find(const Valuation* v, int productId) {
+    long i = idmap_find(&v->indexOf, productId);
+    return i >= 0 ? &v->data[i] : NULL;
+}
+
+static CostEntry* entry_for(Valuation* v, int productId) {
+    long i = idmap_find(&v->indexOf, productId);
+    if (i >= 0) return &v->data[i];
+    if (productId <= 0) return NULL;
+    if (v->size >= v->capacity) {
+        size_t newCap = v->capacity == 0 ? 64 : v->capacity * 2;
+        CostEntry* nd = (CostEntry*)realloc(v->data, newCap * sizeof(CostEntry));
+        if (!nd) return NULL;
+        v->data = nd;
+        v->capacity = newCap;
+    }
+    if (idmap_put(&v->indexOf, productId, v->size) != 0) return NULL;
+    CostEntry* e = &v->data[v->size++];
+    memset(e, 0, sizeof(*e));
+    e->productId = productId;
+    return e;
+}
+
+Money valuation_avgCost(const CostEntry* e) {
+    return (e && e->units > 0) ? money_div(e->value, e->units) : 0;
+}
+
+int valuation_track(Valuation* v, int productId) {
+    return entry_for(v, productId) ? 0 : -1;
+}
+
+const CostEntry* valuation_receive(Valuation* v, int productId, int qty, Money unitCost) {
+    if (qty <= 0) return NULL;
+    CostEntry* e = entry_for(v, productId);
+    if (!e) return NULL;
+    Money cost = money_mul(unitCost, qty);
+    e->units += qty;
+    e->value += cost;
+    e->receivedUnits += qty;
+    e->receivedCost += cost;
+    v->totalValue += cost;
+    return e;
+}
+
+const CostEntry* valuation_sell(Valuation* v, int productId, int qty, Money* outCost) {
+    if (outCost) *outCost = 0;
+    if (qty <= 0) return NULL;
+    CostEntry* e = entry_for(v, productId);
+    if (!e) return NULL;
+    Money cost;
+    if (e->units <= 0) {
+        cost = 0;
+    }
+    else if (qty >= e->units) {
+        /* the whole pool, so rounding never leaves a residue behind */
+        cost = e->value;
+        e->units = 0;
+    }
+    else {
+        cost = money_div(money_mul(e->value, qty), e->units);
+        e->units -= qty;
+    }
+    e->value -= cost;
+    e->cogs += cost;
+    e->unitsSold += qty;
+    v->totalValue -= cost;
+    v->totalCogs += cost;
+    if (outCost) *outCost = cost;
+    return e;
+}
+
+/* the units a pool holds beyond the product's stock left before tracking
+ * began; they go to COGS at the pool's average cost */
+static void cap_at_stock(Valuation* v, CostEntry* e, ProductList* products) {
+    const Product* p = findProductById(products, e->productId);
+    long long stock = (p && p->stock > 0) ? p->stock : 0;
+    if (e->units <= stock) return;
+    long long gone = e->units - stock;
+    Money cost = stock == 0 ? e->value : money_div(money_mul(e->value, gone), e->units);
+    e->units = stock;
+    e->value -= cost;
+    e->cogs += cost;
+    e->unitsSold += gone;
+    v->totalValue -= cost;
+    v->totalCogs += cost;
+}
+
+int valuation_seedFromPurchaseLog(Valuation* v, const char* path, ProductList* products) {
+    PurchaseReader r;
+    if (purchase_openReader(&r, path) != 0) return -1;
+    Purchase p;
+    int count = 0;
+    while (purchase_next(&r, &p)) {
+        valuation_receive(v, p.productId, p.quantity, p.unitCost);
+        count++;
+    }
+    purchase_closeReader(&r);
+    for (size_t i = 0; i < v->size; ++i) cap_at_stock(v, &v->data[i], products);
+    return count;
+}
+
+int valuation_formatRecord(const CostEntry* e, char* buf, size_t cap) {
+    char value[MONEY_STR_MAX], cogs[MONEY_STR_MAX], received[MONEY_STR_MAX];
+    return snprintf(buf, cap, "%d,%lld,%s,%s,%lld,%lld,%s\n",
+        e->productId, e->units, money_str(e->value, value), money_str(e->cogs, cogs),
+        e->unitsSold, e->receivedUnits, money_str(e->receivedCost, received));
+}
+
+char* valuation_formatSnapshot(const Valuation* v, size_t* outLen) {
+    /* an int, three long longs, three amounts and the separators */
+    const size_t lineMax = 12 + 3 * 21 + 3 * MONEY_STR_MAX + 8;
+    size_t cap = v->size * lineMax + 1;
+    char* buf = (char*)malloc(cap);
+    if (!buf) return NULL;
+    size_t len = 0;
+    for (size_t i = 0; i < v->size; ++i) {
+        len += (size_t)valuation_formatRecord(&v->data[i], buf + len, cap - len);
+    }
+    *outLen = len;
+    return buf;
+}
+
+static const char* parse_ll(const char* s, long long* out) {
+    char* end;
+    *out = strtoll(s, &end, 10);
+    return end == s ? NULL : end;
+}
+
+/* expects a ',' and moves past it */
+static const char* next_field(const char* s) {
+    return (s && *s == ',') ? s + 1 : NULL;
+}
+
+static int parse_line(const char* line, CostEntry* e) {
+    long long id;
+    const char* s = parse_ll(line, &id);
+    if (!s || id <= 0 || id > 0x7fffffff) return 0;
+    e->productId = (int)id;
+    if (!(s = next_field(s)) || !(s = parse_ll(s, &e->units))) return 0;
+    if (!(s = next_field(s)) || !(s = money_parse(s, &e->value))) return 0;
+    if (!(s = next_field(s)) || !(s = money_parse(s, &e->cogs))) return 0;
+    if (!(s = next_field(s)) || !(s = parse_ll(s, &e->unitsSold))) return 0;
+    if (!(s = next_field(s)) || !(s = parse_ll(s, &e->receivedUnits))) return 0;
+    if (!(s = next_field(s)) || !(s = money_parse(s, &e->receivedCost))) return 0;
+    return 1;
+}
+
+static int load_impl(const char* path, Valuation* v) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return -1;
+    char line[256];
+    int count = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        CostEntry rec;
+        if (!parse_line(line, &rec)) continue;
+        CostEntry* e = entry_for(v, rec.productId);
+        if (!e) break;
+        /* later lines supersede earlier ones */
+        v->totalValue += rec.value - e->value;
+        v->totalCogs += rec.cogs - e->cogs;
+        *e = rec;
+        count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+int valuation_load(const char* path, Valuation* v) {
+    TRACE_BEGIN("valuation_load");
+    int rc;
+    if (!METRICS_ON()) {
+        rc = load_impl(path, v);
+    }
+    else {
+        uint64_t t0 = timeutil_nowNs();
+        rc = load_impl(path, v);
+        metrics_record(MET_LOAD_VALUATION, timeutil_nowNs() - t0);
+    }
+    TRACE_END();
+    return rc;
+}
+
+static int cmp_entry_id(const void* a, const void* b) {
+    const CostEntry* x = *(const CostEntry* const*)a;
+    const CostEntry* y = *(const CostEntry* const*)b;
+    return (x->productId > y->productId) - (x->productId < y->productId);
+}
+
+static void print_report_impl(const Valuation* v, ProductList* products) {
+    char value[MONEY_STR_MAX], cogs[MONEY_STR_MAX], avg[MONEY_STR_MAX];
+    printf("\n=== Inventory Valuation (weighted average cost) ===\n");
+    if (v->size > 0) {
+        const CostEntry** rows = (const CostEntry**)malloc(v->size * sizeof(CostEntry*));
+        if (!rows) {
+            printf("Out of memory.\n");
+            return;
+        }
+        for (size_t i = 0; i < v->size; ++i) rows[i] = &v->data[i];
+        qsort(rows, v->size, sizeof(CostEntry*), cmp_entry_id);
+
+        printf("%-6s %-20s %-8s %-10s %-12s %-8s %-12s\n",
+            "ID", "Name", "OnHand", "AvgCost", "Value", "Sold", "COGS");
+        for (size_t i = 0; i < v->size; ++i) {
+            const CostEntry* e = rows[i];
+            const Product* p = findProductById(products, e->productId);
+            printf("%-6d %-20s %-8lld %-10s %-12s %-8lld %-12s\n",
+                e->productId, p ? productName(products, p) : "(deleted)", e->units,
+                money_str(valuation_avgCost(e), avg), money_str(e->value, value),
+                e->unitsSold, money_str(e->cogs, cogs));
+        }
+        free(rows);
+    }
+    printf("Inventory value: %s\n", money_str(v->totalValue, value));
+    printf("Cost of goods sold: %s\n", money_str(v->totalCogs, cogs));
+}
+
+void valuation_printReport(const Valuation* v, ProductList* products) {
+    if (!METRICS_ON()) {
+        print_report_impl(v, products);
+        return;
+    }
+    uint64_t t0 = timeutil_nowNs();
+    print_report_impl(v, products);
+    metrics_record(MET_REPORT_VALUATION, timeutil_nowNs() - t0);
+}
+
+static int cmp_received_desc(const void* a, const void* b) {
+    const CostEntry* x = *(const CostEntry* const*)a;
+    const CostEntry* y = *(const CostEntry* const*)b;
+    return (x->receivedUnits < y->receivedUnits) - (x->receivedUnits > y->receivedUnits);
+}
+
+static void print_purchase_summary_impl(const Valuation* v) {
+    const CostEntry** rows = v->size ? (const CostEntry**)malloc(v->size * sizeof(CostEntry*)) : NULL;
+    size_t n = 0;
+    for (size_t i = 0; rows && i < v->size; ++i) {
+        if (v->data[i].receivedUnits > 0) rows[n++] = &v->data[i];
+    }
+    if (n == 0) {
+        printf("No purchases.\n");
+        free(rows);
+        return;
+    }
+    qsort(rows, n, sizeof(CostEntry*), cmp_received_desc);
+
+    printf("=== Purchase Summary By Product ===\n");
+    printf("%-8s %-10s %-12s %-12s\n", "ProdID", "TotalQty", "TotalCost", "AvgCost");
+    char total[MONEY_STR_MAX], avg[MONEY_STR_MAX];
+    for (size_t i = 0; i < n; ++i) {
+        const CostEntry* e = rows[i];
+        printf("%-8d %-10lld %-12s %-12s\n", e->productId, e->receivedUnits,
+            money_str(e->receivedCost, total), money_str(money_div(e->receivedCost, e->receivedUnits), avg));
+    }
+    free(rows);
+}
+
+void valuation_printPurchaseSummary(const Valuation* v) {
+    if (!METRICS_ON()) {
+        print_purchase_summary_impl(v);
+        return;
+    }
+    uint64_t t0 = timeutil_nowNs();
+    print_purchase_summary_impl(v);
+    metrics_record(MET_REPORT_PURCHASE_SUMMARY, timeutil_nowNs() - t0);
+}
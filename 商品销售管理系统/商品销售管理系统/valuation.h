@@ -0,0 +1,86 @@
+#pragma once
+#ifndef VALUATION_H
+#define VALUATION_H
+
+#include <stddef.h>
+#include "money.h"
+#include "idmap.h"
+#include "product.h"
+#include "purchase.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Running weighted-average cost (WAC) per product.
+     *
+     * A receipt adds qty * unitCost to the product's cost pool; a sale takes
+     * the pool's average share (value * qty / units) out of it and into cost
+     * of goods sold. Both are O(1), and so are the catalog totals, which are
+     * kept alongside. Units sold beyond the costed units on hand (stock that
+     * never came in through a purchase) are sold at zero cost.
+     *
+     * valuation.csv is a journal of full entry states, one line per change:
+     *   productId,units,value,cogs,unitsSold,receivedUnits,receivedCost
+     * Loading keeps the last line per product, so the file never needs the
+     * purchase log replayed; the owner compacts it with a snapshot.
+     */
+
+    typedef struct {
+        int       productId;
+        long long units;          /* costed units on hand */
+        Money     value;          /* cost of those units */
+        Money     cogs;           /* cost of goods sold to date */
+        long long unitsSold;
+        long long receivedUnits;  /* all purchases to date */
+        Money     receivedCost;
+    } CostEntry;
+
+    typedef struct {
+        CostEntry* data;
+        size_t     size;
+        size_t     capacity;
+        IdMap      indexOf;       /* productId -> index in data */
+        Money      totalValue;
+        Money      totalCogs;
+    } Valuation;
+
+    void valuation_init(Valuation* v);
+    void valuation_free(Valuation* v);
+
+    /* returns the lines read, -1 if the file cannot be opened */
+    int  valuation_load(const char* path, Valuation* v);
+    /* one-time seed from an existing purchase log, streamed. Units already
+     * gone from stock were sold or written off before tracking began: each
+     * pool is cut to the product's current stock, and the rest goes to COGS
+     * at the pool's average cost. Returns the purchases read, -1 if the log
+     * cannot be opened. */
+    int  valuation_seedFromPurchaseLog(Valuation* v, const char* path, ProductList* products);
+
+    /* entry line incl. '\n', like snprintf */
+    int   valuation_formatRecord(const CostEntry* e, char* buf, size_t cap);
+    /* all entries (malloc'd) for journal compaction, NULL on failure */
+    char* valuation_formatSnapshot(const Valuation* v, size_t* outLen);
+
+    /* creates productId's (empty) entry if it has none, so that a later
+     * receive or sell of it cannot run out of memory; 0 ok, -1 out of
+     * memory or productId <= 0 */
+    int  valuation_track(Valuation* v, int productId);
+    /* the updated entry, NULL when out of memory or qty <= 0 */
+    const CostEntry* valuation_receive(Valuation* v, int productId, int qty, Money unitCost);
+    /* outCost (may be NULL) receives the cost taken into COGS */
+    const CostEntry* valuation_sell(Valuation* v, int productId, int qty, Money* outCost);
+
+    const CostEntry* valuation_find(const Valuation* v, int productId);
+    Money valuation_avgCost(const CostEntry* e);   /* per unit, 0 with nothing on hand */
+
+    /* per-product table sorted by id, then the totals */
+    void valuation_printReport(const Valuation* v, ProductList* products);
+    /* same columns as purchase_printSummaryByProduct, without the purchase log */
+    void valuation_printPurchaseSummary(const Valuation* v);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif